@@ -0,0 +1,52 @@
+#!/usr/bin/env bash
+# Run a lab1 report both ways - the sort pipeline from README and logtop - and
+# print timings plus the per-key / distinct-count errors of the sketches.
+#
+# Usage: compare.sh auth|words|dpkg LOGFILE [logtop options...]
+set -euo pipefail
+
+HERE="$(cd "$(dirname "$0")" && pwd)"
+mode="${1:-}"
+log="${2:-}"
+if [[ -z "$mode" || -z "$log" ]]; then
+  echo "Usage: $0 auth|words|dpkg LOGFILE [logtop options...]" >&2
+  exit 1
+fi
+shift 2
+
+[[ -x "$HERE/logtop" ]] || make -C "$HERE" logtop >/dev/null
+
+exact="$(mktemp)"
+trap 'rm -f "$exact"' EXIT
+
+# The exact reference keeps every distinct key: memory grows with the input
+pipeline() {
+  case "$mode" in
+    auth)
+      grep -E 'Failed|Invalid' "$log" \
+        | grep -oE '([0-9]{1,3}\.){3}[0-9]{1,3}' \
+        | sed -E 's/([0-9]+\.[0-9]+\.[0-9]+\.)[0-9]+/\1x/'
+      ;;
+    words)
+      tr -cs '[:alnum:]' '\n' < "$log" | tr '[:upper:]' '[:lower:]' | grep -v '^$'
+      ;;
+    dpkg)
+      awk '$3 == "install" { print $4 }' "$log"
+      ;;
+    *)
+      echo "unknown mode: $mode" >&2
+      exit 1
+      ;;
+  esac
+}
+
+export LC_ALL=C
+start=$(date +%s.%N)
+pipeline | sort | uniq -c | sort -nr > "$exact"
+end=$(date +%s.%N)
+echo "sort pipeline: $(awk -v a="$start" -v b="$end" 'BEGIN { printf "%.2f", b - a }')s, $(wc -l < "$exact") distinct keys"
+
+# grep -oE above knows only IPv4
+extra=()
+[[ "$mode" == auth ]] && extra=(--ipv4)
+"$HERE/logtop" --mode "$mode" --compare "$exact" "${extra[@]}" "$@" "$log"
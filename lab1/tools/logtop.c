@@ -0,0 +1,640 @@
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Top-N for the lab1 reports in fixed memory, instead of sort | uniq -c | sort -nr:
+//   auth  - source IPs (IPv4 and IPv6) of Failed|Invalid lines, last octet masked
+//   words - syslog words (alnum runs, lower case), like tr -cs '[:alnum:]' '\n'
+//   dpkg  - packages of "install" events, like awk '$3=="install"{print $4}'
+//
+// Space-Saving keeps the top-K candidates (count is an upper bound, count-err a
+// lower bound), Count-Min gives an independent estimate for any key, HyperLogLog
+// counts distinct keys. Memory does not depend on the input. --compare reads the
+// exact `uniq -c | sort -nr` output of the sort pipeline and prints the errors.
+
+#define KEYMAX 64                       // keys are cut to KEYMAX-1 bytes
+
+enum mode { MODE_AUTH, MODE_WORDS, MODE_DPKG };
+
+/* ---------- hashing ---------- */
+
+static inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+static uint64_t hash_key(const char *s, size_t n) {
+    uint64_t h = 0x9E3779B97F4A7C15ull ^ n;
+    while (n >= 8) {
+        uint64_t w;
+        memcpy(&w, s, 8);
+        h = (h ^ mix64(w)) * 0x100000001b3ull;
+        s += 8;
+        n -= 8;
+    }
+    uint64_t w = 0;
+    memcpy(&w, s, n);
+    h ^= mix64(w ^ 0x5bd1e995ull);
+    return mix64(h);
+}
+
+/* ---------- Space-Saving (min-heap + open addressing index) ---------- */
+
+struct ss_counter {
+    uint64_t count, err, hash;
+    uint32_t slot;                      // position in index[], kept in sync on moves
+    uint8_t len;
+    char key[KEYMAX];
+};
+
+struct space_saving {
+    struct ss_counter *c;               // heap order: c[0] has the minimum count
+    int32_t *index;                     // hash slot -> heap position, -1 = empty
+    uint32_t cap, size, mask;
+};
+
+static int ss_init(struct space_saving *ss, uint32_t cap) {
+    uint32_t slots = 1;
+    while (slots < cap * 2) slots <<= 1;
+    ss->c = calloc(cap, sizeof(*ss->c));
+    ss->index = malloc(slots * sizeof(int32_t));
+    if (!ss->c || !ss->index) return -1;
+    memset(ss->index, 0xff, slots * sizeof(int32_t));
+    ss->cap = cap;
+    ss->size = 0;
+    ss->mask = slots - 1;
+    return 0;
+}
+
+static uint32_t ss_find_slot(const struct space_saving *ss, uint64_t h, const char *k, size_t n) {
+    uint32_t i = (uint32_t)h & ss->mask;
+    for (;;) {
+        int32_t p = ss->index[i];
+        if (p < 0) return i;
+        const struct ss_counter *c = &ss->c[p];
+        if (c->hash == h && c->len == n && memcmp(c->key, k, n) == 0) return i;
+        i = (i + 1) & ss->mask;
+    }
+}
+
+// Linear probing delete with backward shift: no tombstones
+static void ss_index_remove(struct space_saving *ss, uint32_t i) {
+    uint32_t j = i;
+    for (;;) {
+        j = (j + 1) & ss->mask;
+        int32_t p = ss->index[j];
+        if (p < 0) break;
+        uint32_t home = (uint32_t)ss->c[p].hash & ss->mask;
+        // Move p back into i unless its home lies cyclically in (i, j]
+        if ((j > i && (home <= i || home > j)) || (j < i && home <= i && home > j)) {
+            ss->index[i] = p;
+            ss->c[p].slot = i;
+            i = j;
+        }
+    }
+    ss->index[i] = -1;
+}
+
+static void ss_swap(struct space_saving *ss, uint32_t a, uint32_t b) {
+    struct ss_counter t = ss->c[a];
+    ss->c[a] = ss->c[b];
+    ss->c[b] = t;
+    ss->index[ss->c[a].slot] = (int32_t)a;
+    ss->index[ss->c[b].slot] = (int32_t)b;
+}
+
+static void ss_sift_down(struct space_saving *ss, uint32_t p) {
+    for (;;) {
+        uint32_t l = 2 * p + 1, r = l + 1, m = p;
+        if (l < ss->size && ss->c[l].count < ss->c[m].count) m = l;
+        if (r < ss->size && ss->c[r].count < ss->c[m].count) m = r;
+        if (m == p) return;
+        ss_swap(ss, p, m);
+        p = m;
+    }
+}
+
+static void ss_sift_up(struct space_saving *ss, uint32_t p) {
+    while (p > 0) {
+        uint32_t parent = (p - 1) / 2;
+        if (ss->c[parent].count <= ss->c[p].count) return;
+        ss_swap(ss, p, parent);
+        p = parent;
+    }
+}
+
+static void ss_add(struct space_saving *ss, const char *k, size_t n, uint64_t h) {
+    uint32_t slot = ss_find_slot(ss, h, k, n);
+    int32_t p = ss->index[slot];
+    if (p >= 0) {
+        ss->c[p].count++;
+        ss_sift_down(ss, (uint32_t)p);
+        return;
+    }
+    struct ss_counter *c;
+    int fresh = ss->size < ss->cap;
+    if (fresh) {
+        p = (int32_t)ss->size++;
+        c = &ss->c[p];
+        c->count = 1;
+        c->err = 0;
+    } else {
+        // Evict the minimum: the newcomer inherits its count as possible overestimate
+        p = 0;
+        c = &ss->c[0];
+        ss_index_remove(ss, c->slot);
+        c->err = c->count;
+        c->count++;
+        slot = ss_find_slot(ss, h, k, n);
+    }
+    c->hash = h;
+    c->slot = slot;
+    c->len = (uint8_t)n;
+    memcpy(c->key, k, n);
+    c->key[n] = '\0';
+    ss->index[slot] = p;
+    if (fresh) ss_sift_up(ss, (uint32_t)p);
+    else ss_sift_down(ss, (uint32_t)p);
+}
+
+/* ---------- Count-Min ---------- */
+
+struct count_min {
+    uint64_t *t;
+    uint32_t width, depth, mask;
+};
+
+static int cm_init(struct count_min *cm, uint32_t width, uint32_t depth) {
+    uint32_t w = 1;
+    while (w < width) w <<= 1;
+    cm->t = calloc((size_t)w * depth, sizeof(uint64_t));
+    cm->width = w;
+    cm->depth = depth;
+    cm->mask = w - 1;
+    return cm->t ? 0 : -1;
+}
+
+// Row i uses h1 + i*h2 (Kirsch-Mitzenmacher)
+static void cm_add(struct count_min *cm, uint64_t h) {
+    uint32_t h1 = (uint32_t)h, h2 = (uint32_t)(h >> 32) | 1;
+    for (uint32_t i = 0; i < cm->depth; i++) cm->t[(size_t)i * cm->width + ((h1 + i * h2) & cm->mask)]++;
+}
+
+static uint64_t cm_estimate(const struct count_min *cm, uint64_t h) {
+    uint32_t h1 = (uint32_t)h, h2 = (uint32_t)(h >> 32) | 1;
+    uint64_t m = UINT64_MAX;
+    for (uint32_t i = 0; i < cm->depth; i++) {
+        uint64_t v = cm->t[(size_t)i * cm->width + ((h1 + i * h2) & cm->mask)];
+        if (v < m) m = v;
+    }
+    return m;
+}
+
+/* ---------- HyperLogLog ---------- */
+
+#define HLL_P 14
+#define HLL_M (1u << HLL_P)
+
+static uint8_t hll_reg[HLL_M];
+
+static void hll_add(uint64_t h) {
+    uint32_t idx = (uint32_t)(h >> (64 - HLL_P));
+    uint64_t w = (h << HLL_P) | (1ull << (HLL_P - 1));     // guard bit: rank <= 64-P+1
+    uint8_t rank = (uint8_t)(__builtin_clzll(w) + 1);
+    if (rank > hll_reg[idx]) hll_reg[idx] = rank;
+}
+
+static double hll_estimate(void) {
+    double sum = 0;
+    unsigned zeros = 0;
+    for (unsigned i = 0; i < HLL_M; i++) {
+        sum += ldexp(1.0, -hll_reg[i]);
+        zeros += hll_reg[i] == 0;
+    }
+    double m = HLL_M, alpha = 0.7213 / (1 + 1.079 / m);
+    double e = alpha * m * m / sum;
+    if (e <= 2.5 * m && zeros) e = m * log(m / zeros);     // linear counting for small sets
+    return e;
+}
+
+/* ---------- sketch front end ---------- */
+
+static struct space_saving ss;
+static struct count_min cm;
+static uint64_t total_keys, total_lines, matched_lines;
+
+static void add_key(const char *k, size_t n) {
+    if (n == 0) return;
+    if (n >= KEYMAX) n = KEYMAX - 1;
+    uint64_t h = hash_key(k, n);
+    ss_add(&ss, k, n, h);
+    cm_add(&cm, h);
+    hll_add(h);
+    total_keys++;
+}
+
+/* ---------- extractors ---------- */
+
+#ifdef __SSE2__
+// Bit i set if p[i] is in [lo, hi] (unsigned)
+static inline unsigned range_mask(__m128i v, char lo, char hi) {
+    __m128i bias = _mm_set1_epi8((char)(0x80 - (unsigned char)lo));
+    __m128i lim = _mm_set1_epi8((char)(0x80 + (unsigned char)(hi - lo)));
+    return (unsigned)_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_add_epi8(v, bias), lim)) ^ 0xffffu;
+}
+
+static inline unsigned alnum_mask16(const char *p) {
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    return range_mask(v, '0', '9') | range_mask(lower, 'a', 'z');
+}
+
+static inline unsigned sep_mask16(const char *p) {
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    return (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('.')),
+                                                    _mm_cmpeq_epi8(v, _mm_set1_epi8(':'))));
+}
+#endif
+
+static inline int is_digit(unsigned char c) { return (unsigned)(c - '0') < 10u; }
+static inline int is_alnum(unsigned char c) { return is_digit(c) || (unsigned)((c | 0x20) - 'a') < 26u; }
+static inline int is_hex(unsigned char c) { return is_digit(c) || (unsigned)((c | 0x20) - 'a') < 6u; }
+
+static void words_line(const char *s, size_t n) {
+    char tok[KEYMAX];
+    size_t i = 0;
+    while (i < n) {
+#ifdef __SSE2__
+        // Skip separators 16 bytes at a time
+        while (i + 16 <= n) {
+            unsigned m = alnum_mask16(s + i);
+            if (m) { i += (unsigned)__builtin_ctz(m); break; }
+            i += 16;
+        }
+#endif
+        while (i < n && !is_alnum((unsigned char)s[i])) i++;
+        if (i >= n) break;
+        size_t start = i;
+#ifdef __SSE2__
+        while (i + 16 <= n) {
+            unsigned m = ~alnum_mask16(s + i) & 0xffffu;
+            if (m) { i += (unsigned)__builtin_ctz(m); goto token_end; }
+            i += 16;
+        }
+#endif
+        while (i < n && is_alnum((unsigned char)s[i])) i++;
+#ifdef __SSE2__
+    token_end:
+#endif
+        {
+            size_t len = i - start < KEYMAX - 1 ? i - start : KEYMAX - 1;
+            for (size_t k = 0; k < len; k++) {
+                unsigned char c = (unsigned char)s[start + k];
+                tok[k] = (char)((unsigned)(c - 'A') < 26u ? c | 0x20 : c);
+            }
+            add_key(tok, len);
+        }
+    }
+}
+
+static int mask_ip = 1, ipv4_only = 0;
+
+// Candidate around a '.' or ':' at s[pos]: validated with inet_pton, masked, added
+static size_t ip_at(const char *s, size_t n, size_t pos) {
+    size_t a = pos, b = pos;
+    char tok[64], out[INET6_ADDRSTRLEN + 2];
+    if (s[pos] == '.') {
+        while (a > 0 && (is_digit((unsigned char)s[a - 1]) || s[a - 1] == '.')) a--;
+        while (b < n && (is_digit((unsigned char)s[b]) || s[b] == '.')) b++;
+        while (b > a && s[b - 1] == '.') b--;                   // "from 1.2.3.4."
+        // Part of a longer token (version string, hostname): not an address
+        // sshd prints IPv4 clients of a dual-stack socket as ::ffff:1.2.3.4
+        int mapped = a >= 7 && strncasecmp(s + a - 7, "::ffff:", 7) == 0;
+        if ((a > 0 && !mapped && (is_alnum((unsigned char)s[a - 1]) || s[a - 1] == ':')) ||
+            b - a < 7 || b - a > 15)
+            return b;
+        struct in_addr v4;
+        memcpy(tok, s + a, b - a);
+        tok[b - a] = '\0';
+        if (inet_pton(AF_INET, tok, &v4) != 1) return b;
+        if (mask_ip) {
+            char *dot = strrchr(tok, '.');
+            dot[1] = 'x';
+            dot[2] = '\0';
+        }
+        add_key(tok, strlen(tok));
+        return b;
+    }
+    if (ipv4_only) return pos + 1;
+    while (a > 0 && (is_hex((unsigned char)s[a - 1]) || s[a - 1] == ':')) a--;
+    while (b < n && (is_hex((unsigned char)s[b]) || s[b] == ':')) b++;
+    if (b - a < 3 || b - a > 39 || (a > 0 && is_alnum((unsigned char)s[a - 1])) ||
+        (b < n && (is_alnum((unsigned char)s[b]) || s[b] == '.')))
+        return b;
+    memcpy(tok, s + a, b - a);
+    tok[b - a] = '\0';
+    struct in6_addr v6;
+    // "10:00:00" (time) has no "::" and too few groups: inet_pton rejects it
+    if (inet_pton(AF_INET6, tok, &v6) != 1) return b;
+    if (mask_ip) {
+        // Mask the last 16 bits, then print canonically: one key per /112
+        v6.s6_addr[14] = v6.s6_addr[15] = 0;
+        inet_ntop(AF_INET6, &v6, out, sizeof(out));
+        size_t len = strlen(out);
+        if (len >= 2 && out[len - 1] == ':' && out[len - 2] == ':') {
+            out[len] = 'x';
+            out[len + 1] = '\0';
+        } else {
+            char *colon = strrchr(out, ':');
+            colon[1] = 'x';
+            colon[2] = '\0';
+        }
+    } else {
+        inet_ntop(AF_INET6, &v6, out, sizeof(out));
+    }
+    add_key(out, strlen(out));
+    return b;
+}
+
+static void auth_line(const char *s, size_t n) {
+    if (!memmem(s, n, "Failed", 6) && !memmem(s, n, "Invalid", 7)) return;
+    matched_lines++;
+    size_t i = 0;
+    while (i < n) {
+#ifdef __SSE2__
+        // Most of a line has neither '.' nor ':': skip it 16 bytes at a time
+        while (i + 16 <= n) {
+            unsigned m = sep_mask16(s + i);
+            if (m) { i += (unsigned)__builtin_ctz(m); break; }
+            i += 16;
+        }
+#endif
+        while (i < n && s[i] != '.' && s[i] != ':') i++;
+        if (i >= n) break;
+        size_t next = ip_at(s, n, i);
+        i = next > i ? next : i + 1;        // "1.2.3.4." ends right at its trailing dot
+    }
+}
+
+// "2024-03-01 10:00:00 install pkg:amd64 <none> 1.2-3"
+static void dpkg_line(const char *s, size_t n) {
+    const char *f[4];
+    size_t len[4], i = 0;
+    for (int k = 0; k < 4; k++) {
+        while (i < n && (s[i] == ' ' || s[i] == '\t')) i++;
+        if (i >= n) return;
+        f[k] = s + i;
+        while (i < n && s[i] != ' ' && s[i] != '\t') i++;
+        len[k] = (size_t)(s + i - f[k]);
+    }
+    if (len[2] != 7 || memcmp(f[2], "install", 7) != 0) return;
+    matched_lines++;
+    add_key(f[3], len[3]);
+}
+
+static void process(int fd, enum mode mode) {
+    static char buf[1 << 20];
+    size_t have = 0;
+    for (;;) {
+        ssize_t r = read(fd, buf + have, sizeof(buf) - have);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            perror("read");
+            exit(1);
+        }
+        int eof = r == 0;
+        size_t end = have + (size_t)r, start = 0;
+        while (start < end) {
+            char *nl = memchr(buf + start, '\n', end - start);
+            if (!nl) {
+                // Keep the tail for the next read, unless it is the last line or fills the buffer
+                if (!eof && !(start == 0 && end == sizeof(buf))) break;
+                nl = buf + end;
+            }
+            size_t len = (size_t)(nl - (buf + start));
+            total_lines++;
+            if (mode == MODE_AUTH) auth_line(buf + start, len);
+            else if (mode == MODE_WORDS) words_line(buf + start, len);
+            else dpkg_line(buf + start, len);
+            start += len + 1;
+        }
+        if (start > end) start = end;
+        have = end - start;
+        memmove(buf, buf + start, have);
+        if (eof) break;
+    }
+}
+
+/* ---------- exact reference (--compare) ---------- */
+
+struct exact_entry { uint64_t count, hash; char *key; };
+static struct exact_entry *ex;
+static size_t ex_n, ex_cap;
+static size_t *ex_index;
+static size_t ex_slots;
+
+static int cmp_exact(const void *a, const void *b) {
+    const struct exact_entry *x = a, *y = b;
+    if (x->count != y->count) return x->count < y->count ? 1 : -1;
+    return strcmp(x->key, y->key);
+}
+
+// Full `uniq -c | sort -nr` output, sorted by count desc and indexed by key
+static int load_exact(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) { perror(path); return -1; }
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t len;
+    while ((len = getline(&line, &cap, f)) > 0) {
+        if (line[len - 1] == '\n') line[--len] = '\0';
+        char *p = line, *end;
+        while (*p == ' ') p++;
+        unsigned long long c = strtoull(p, &end, 10);
+        if (end == p || *end != ' ') continue;
+        char *key = end + 1;
+        size_t kn = strlen(key);
+        if (kn >= KEYMAX) key[kn = KEYMAX - 1] = '\0';
+        if (ex_n == ex_cap) {
+            ex_cap = ex_cap ? ex_cap * 2 : 1024;
+            ex = realloc(ex, ex_cap * sizeof(*ex));
+            if (!ex) return -1;
+        }
+        ex[ex_n++] = (struct exact_entry){ .count = c, .hash = hash_key(key, kn), .key = strdup(key) };
+    }
+    free(line);
+    fclose(f);
+    qsort(ex, ex_n, sizeof(*ex), cmp_exact);
+    ex_slots = 1;
+    while (ex_slots < ex_n * 2 + 2) ex_slots <<= 1;
+    ex_index = malloc(ex_slots * sizeof(size_t));
+    if (!ex_index) return -1;
+    memset(ex_index, 0xff, ex_slots * sizeof(size_t));
+    for (size_t i = 0; i < ex_n; i++) {
+        size_t s = ex[i].hash & (ex_slots - 1);
+        while (ex_index[s] != SIZE_MAX) s = (s + 1) & (ex_slots - 1);
+        ex_index[s] = i;
+    }
+    return 0;
+}
+
+static uint64_t exact_count(const char *key, uint64_t h) {
+    for (size_t s = h & (ex_slots - 1); ex_index[s] != SIZE_MAX; s = (s + 1) & (ex_slots - 1))
+        if (ex[ex_index[s]].hash == h && strcmp(ex[ex_index[s]].key, key) == 0) return ex[ex_index[s]].count;
+    return 0;
+}
+
+/* ---------- report ---------- */
+
+static int cmp_counter(const void *a, const void *b) {
+    const struct ss_counter *x = a, *y = b;
+    if (x->count != y->count) return x->count < y->count ? 1 : -1;
+    return strcmp(x->key, y->key);
+}
+
+static void print_usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s --mode auth|words|dpkg [--top K] [--capacity N] [--cm-width W] [--cm-depth D]\n"
+            "          [--no-mask] [--ipv4] [--compare EXACT.txt] [FILE...]\n"
+            "Prints the top K as `uniq -c | sort -nr` does; reads stdin without FILE.\n"
+            "--compare takes the full `sort | uniq -c | sort -nr` output and reports the errors.\n",
+            prog);
+}
+
+int main(int argc, char **argv) {
+    enum mode mode = MODE_AUTH;
+    int mode_set = 0, top = 10;
+    uint32_t capacity = 1024, cm_width = 1u << 16, cm_depth = 4;
+    const char *compare = NULL;
+
+    static struct option opts[] = {
+        {"mode", required_argument, 0, 'm'},
+        {"top", required_argument, 0, 'k'},
+        {"capacity", required_argument, 0, 'c'},
+        {"cm-width", required_argument, 0, 'w'},
+        {"cm-depth", required_argument, 0, 'd'},
+        {"no-mask", no_argument, 0, 'n'},
+        {"ipv4", no_argument, 0, '4'},
+        {"compare", required_argument, 0, 'C'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+    int ch;
+    while ((ch = getopt_long(argc, argv, "", opts, NULL)) != -1) {
+        switch (ch) {
+            case 'm':
+                mode_set = 1;
+                if (strcmp(optarg, "auth") == 0) mode = MODE_AUTH;
+                else if (strcmp(optarg, "words") == 0) mode = MODE_WORDS;
+                else if (strcmp(optarg, "dpkg") == 0) mode = MODE_DPKG;
+                else { print_usage(argv[0]); return 1; }
+                break;
+            case 'k': top = atoi(optarg); break;
+            case 'c': capacity = (uint32_t)atol(optarg); break;
+            case 'w': cm_width = (uint32_t)atol(optarg); break;
+            case 'd': cm_depth = (uint32_t)atol(optarg); break;
+            case 'n': mask_ip = 0; break;
+            case '4': ipv4_only = 1; break;
+            case 'C': compare = optarg; break;
+            case 'h': print_usage(argv[0]); return 0;
+            default: print_usage(argv[0]); return 1;
+        }
+    }
+    if (!mode_set || top <= 0 || capacity < (uint32_t)top || capacity > (1u << 24) ||
+        cm_width == 0 || cm_width > (1u << 28) || cm_depth == 0 || cm_depth > 16) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (ss_init(&ss, capacity) < 0 || cm_init(&cm, cm_width, cm_depth) < 0) {
+        fprintf(stderr, "logtop: out of memory\n");
+        return 1;
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    off_t bytes = 0;
+    if (optind == argc) {
+        process(0, mode);
+    }
+    for (int i = optind; i < argc; i++) {
+        int fd = open(argv[i], O_RDONLY | O_CLOEXEC);
+        if (fd < 0) { perror(argv[i]); return 1; }
+        process(fd, mode);
+        off_t sz = lseek(fd, 0, SEEK_END);
+        if (sz > 0) bytes += sz;
+        close(fd);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    qsort(ss.c, ss.size, sizeof(*ss.c), cmp_counter);       // heap order is not needed any more
+    uint32_t shown = ss.size < (uint32_t)top ? ss.size : (uint32_t)top;
+    double distinct = hll_estimate();
+
+    if (!compare) {
+        for (uint32_t i = 0; i < shown; i++) printf("%7llu %s\n", (unsigned long long)ss.c[i].count, ss.c[i].key);
+    } else {
+        if (load_exact(compare) < 0) return 1;
+        printf("%-4s %-40s %10s %10s %10s %10s %8s %8s\n", "rank", "key", "exact", "ss", "ss_err", "cm",
+               "ss_rel%", "cm_rel%");
+        double max_ss = 0, max_cm = 0;
+        unsigned recall = 0, outside = 0;
+        for (uint32_t i = 0; i < shown; i++) {
+            const struct ss_counter *c = &ss.c[i];
+            uint64_t e = exact_count(c->key, c->hash), m = cm_estimate(&cm, c->hash);
+            double rs = e ? 100.0 * ((double)c->count - (double)e) / (double)e : 100.0;
+            double rc = e ? 100.0 * ((double)m - (double)e) / (double)e : 100.0;
+            if (fabs(rs) > max_ss) max_ss = fabs(rs);
+            if (fabs(rc) > max_cm) max_cm = fabs(rc);
+            // Space-Saving guarantee: count-err <= exact <= count
+            if (e > c->count || e + c->err < c->count) outside++;
+            printf("%-4u %-40s %10llu %10llu %10llu %10llu %8.2f %8.2f\n", i + 1, c->key,
+                   (unsigned long long)e, (unsigned long long)c->count, (unsigned long long)c->err,
+                   (unsigned long long)m, rs, rc);
+        }
+        // Ties at the K-th count make any of the tied keys a correct answer
+        uint64_t kth = ex_n >= shown && shown ? ex[shown - 1].count : 0;
+        for (uint32_t i = 0; i < shown; i++) {
+            uint64_t e = exact_count(ss.c[i].key, ss.c[i].hash);
+            if (e >= kth && e > 0) recall++;
+        }
+        printf("recall@%u=%.2f  max_rel_err ss=%.2f%% cm=%.2f%%  ss_bound_violations=%u\n", shown,
+               shown ? (double)recall / shown : 1.0, max_ss, max_cm, outside);
+        printf("distinct: hll=%.0f exact=%zu err=%+.2f%%\n", distinct, ex_n,
+               ex_n ? 100.0 * (distinct - (double)ex_n) / (double)ex_n : 0.0);
+    }
+
+    double secs = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+    size_t mem = (size_t)ss.cap * sizeof(struct ss_counter) + ((size_t)ss.mask + 1) * sizeof(int32_t) +
+                 (size_t)cm.width * cm.depth * sizeof(uint64_t) + sizeof(hll_reg);
+    fprintf(stderr,
+            "logtop: lines=%llu matched=%llu keys=%llu distinct~%.0f memory=%.1fMB time=%.2fs%s",
+            (unsigned long long)total_lines, (unsigned long long)(mode == MODE_WORDS ? total_lines : matched_lines),
+            (unsigned long long)total_keys, distinct, (double)mem / 1048576.0, secs,
+#ifdef __SSE2__
+            " simd=sse2"
+#else
+            " simd=none"
+#endif
+    );
+    if (bytes > 0 && secs > 0) fprintf(stderr, " %.1fMB/s", (double)bytes / 1e6 / secs);
+    fprintf(stderr, "\n");
+    return 0;
+}
@@ -0,0 +1,616 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Synthetic Docker json-file logs at scale: nginx- and app-style containers,
+// one <name>-json.log per container, lines sorted by time like dockerd writes
+// them. The timeline is cut into (minute, sub-chunk) work items; every item
+// has its own RNG seed derived from --seed, so the output is byte-identical
+// for any --threads. Items are formatted in parallel and appended to their
+// file in order.
+//
+// Ground truth goes to truth_errors.csv (same format and order as out/top_errors.csv),
+// truth_minutes.csv (per container and minute: lines, error lines, 5xx, what
+// was injected) and truth_bursts.csv (injected burst minutes).
+
+#define MAX_CONTAINERS 64
+#define MAX_BURSTS     32
+#define MAX_RESTARTS   32
+#define SUB_LINES      65536            // lines per work item at most
+#define MAX_LINE       512
+
+enum kind { NGINX, APP };
+
+struct container {
+    char name[32];
+    enum kind kind;
+    int fd;
+    uint64_t next_seq;                  // next item to append (ordered writes)
+    uint64_t nitems;
+    uint64_t *minute_lines;             // planned lines per minute
+    uint64_t *minute_first;             // index of the first line of each minute
+    uint64_t *errors, *x5xx;            // ground truth per minute, filled by workers
+    unsigned char *injected;            // 1 = burst, 2 = restart, 4 = 5xx spike
+};
+
+struct burst { int start, len; double mult; char who[32]; };
+struct restart { int minute; char who[32]; };
+
+struct item { int c, minute; uint32_t sub; uint64_t seq; };
+
+static struct {
+    char out_dir[256];
+    int nginx, app;
+    int minutes;
+    double rate;                        // lines per second per container
+    double error_rate, rate_5xx;
+    uint64_t seed;
+    time_t start;
+    int threads;
+    int restart_gap_s, spike_minutes;
+    struct burst bursts[MAX_BURSTS];
+    int nbursts;
+    struct restart restarts[MAX_RESTARTS];
+    int nrestarts;
+} opt;
+
+static struct container cont[MAX_CONTAINERS];
+static int ncont;
+static struct item *items;
+static uint64_t nitems, next_item;
+static pthread_mutex_t write_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t write_cond = PTHREAD_COND_INITIALIZER;
+static uint64_t total_bytes, total_lines;
+static volatile int failed;
+
+/* ---------- deterministic RNG ---------- */
+
+static uint64_t splitmix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+static uint64_t rng_next(uint64_t *s) {
+    uint64_t x = *s;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *s = x;
+}
+
+static uint32_t rng_below(uint64_t *s, uint32_t n) { return (uint32_t)(((rng_next(s) >> 32) * n) >> 32); }
+static int rng_chance(uint64_t *s, double p) { return (double)(rng_next(s) >> 11) * 0x1p-53 < p; }
+
+/* ---------- formatting ---------- */
+
+struct buf { char *p; size_t len, cap; };
+
+static inline void put(struct buf *b, const char *s, size_t n) { memcpy(b->p + b->len, s, n); b->len += n; }
+#define PUTS(b, lit) put((b), (lit), sizeof(lit) - 1)
+
+static inline void put_u(struct buf *b, uint64_t v) {
+    char tmp[24];
+    int n = 0;
+    do { tmp[n++] = (char)('0' + v % 10); v /= 10; } while (v);
+    while (n) b->p[b->len++] = tmp[--n];
+}
+
+static inline void put_fixed(struct buf *b, uint64_t v, int digits) {
+    for (int i = digits - 1; i >= 0; i--) { b->p[b->len + i] = (char)('0' + v % 10); v /= 10; }
+    b->len += (size_t)digits;
+}
+
+static const char *const paths[] = { "/", "/api/orders", "/health", "/static/logo.png", "/login", "/notfound" };
+static const char *const agents[] = { "curl/8.4.0", "Mozilla/5.0 (X11; Linux x86_64)", "k6/0.50", "Go-http-client/1.1" };
+static const char *const app_errors[] = {
+    "ERROR %s app: db connection failed: timeout",
+    "FATAL %s app: panic: nil pointer dereference",
+    "ERROR %s app: fatal: cannot allocate resource",
+    "ERROR %s app: error: upstream service unavailable",
+};
+
+// Everything that depends on the minute only
+struct minute_fmt {
+    char iso[20];                       // 2025-09-12T00:01:
+    char clf[20];                       // 12/Sep/2025:00:01:
+    char errlog[20];                    // 2025/09/12 00:01:
+};
+
+static void minute_format(struct minute_fmt *f, int minute) {
+    time_t t = opt.start + (time_t)minute * 60;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    strftime(f->iso, sizeof(f->iso), "%Y-%m-%dT%H:%M:", &tm);
+    strftime(f->clf, sizeof(f->clf), "%d/%b/%Y:%H:%M:", &tm);
+    strftime(f->errlog, sizeof(f->errlog), "%Y/%m/%d %H:%M:", &tm);
+}
+
+static void put_ip(struct buf *b, uint64_t *rng) {
+    PUTS(b, "172.17.");
+    put_u(b, rng_below(rng, 4));
+    PUTS(b, ".");
+    put_u(b, 1 + rng_below(rng, 254));
+}
+
+static void put_str(struct buf *b, const char *s) { put(b, s, strlen(s)); }
+
+// One json-file line. what: 0 normal, 1 error (matches error|fail|fatal|panic), 2 5xx access
+static void line_nginx(struct buf *b, const struct minute_fmt *mf, int sec, uint64_t ns,
+                       uint64_t *rng, int what) {
+    const char *path = paths[rng_below(rng, 6)];
+    PUTS(b, "{\"log\":\"");
+    if (what == 1) {
+        put_str(b, mf->errlog);
+        put_fixed(b, (uint64_t)sec, 2);
+        PUTS(b, " [error] 29#29: *");
+        put_u(b, 1 + rng_below(rng, 100000));
+        if (rng_below(rng, 2)) PUTS(b, " upstream timed out (110: Connection timed out) while reading response header from upstream, client: ");
+        else PUTS(b, " connect() failed (111: Connection refused) while connecting to upstream, client: ");
+        put_ip(b, rng);
+        PUTS(b, ", server: _, request: \\\"GET ");
+        put_str(b, path);
+        PUTS(b, " HTTP/1.1\\\", upstream: \\\"http://172.17.0.2:8080");
+        put_str(b, path);
+        PUTS(b, "\\\", host: \\\"localhost\\\"\\n\",\"stream\":\"stderr\",\"time\":\"");
+    } else {
+        static const unsigned ok[] = { 200, 200, 200, 200, 200, 200, 304, 301, 404, 404 };
+        static const unsigned bad[] = { 500, 502, 502, 503, 504 };
+        unsigned status = what == 2 ? bad[rng_below(rng, 5)] : ok[rng_below(rng, 10)];
+        put_ip(b, rng);
+        PUTS(b, " - - [");
+        put_str(b, mf->clf);
+        put_fixed(b, (uint64_t)sec, 2);
+        PUTS(b, " +0000] \\\"GET ");
+        put_str(b, path);
+        PUTS(b, " HTTP/1.1\\\" ");
+        put_u(b, status);
+        PUTS(b, " ");
+        put_u(b, status >= 500 ? 157 + rng_below(rng, 40) : rng_below(rng, 8192));
+        PUTS(b, " \\\"-\\\" \\\"");
+        put_str(b, agents[rng_below(rng, 4)]);
+        PUTS(b, "\\\"\\n\",\"stream\":\"stdout\",\"time\":\"");
+    }
+    put_str(b, mf->iso);
+    put_fixed(b, (uint64_t)sec, 2);
+    PUTS(b, ".");
+    put_fixed(b, ns, 9);
+    PUTS(b, "Z\"}\n");
+}
+
+static void line_app(struct buf *b, const struct minute_fmt *mf, int sec, uint64_t ns,
+                     uint64_t *rng, int what, uint64_t index) {
+    char ts[24];
+    memcpy(ts, mf->iso, 17);
+    ts[17] = (char)('0' + sec / 10);
+    ts[18] = (char)('0' + sec % 10);
+    ts[19] = '\0';
+
+    PUTS(b, "{\"log\":\"");
+    if (what == 1 || what == 4) {
+        const char *tmpl = what == 4 ? app_errors[1] : app_errors[rng_below(rng, 4)];
+        const char *mark = strstr(tmpl, "%s");
+        put(b, tmpl, (size_t)(mark - tmpl));
+        put(b, ts, 19);
+        put_str(b, mark + 2);
+        PUTS(b, "\\n\",\"stream\":\"stderr\",\"time\":\"");
+    } else if (what == 3) {
+        PUTS(b, "INFO ");
+        put(b, ts, 19);
+        PUTS(b, " app: starting app v1.4.2, listening on :8080\\n\",\"stream\":\"stdout\",\"time\":\"");
+    } else if (rng_below(rng, 113) == 0) {
+        PUTS(b, "WARN ");
+        put(b, ts, 19);
+        PUTS(b, " app: slow query detected (");
+        put_u(b, 500 + rng_below(rng, 4500));
+        PUTS(b, " ms)\\n\",\"stream\":\"stdout\",\"time\":\"");
+    } else {
+        PUTS(b, "INFO ");
+        put(b, ts, 19);
+        PUTS(b, " app: request handled ok ");
+        put_u(b, index);
+        PUTS(b, "\\n\",\"stream\":\"stdout\",\"time\":\"");
+    }
+    put_str(b, mf->iso);
+    put_fixed(b, (uint64_t)sec, 2);
+    PUTS(b, ".");
+    put_fixed(b, ns, 9);
+    PUTS(b, "Z\"}\n");
+}
+
+/* ---------- plan ---------- */
+
+static int applies(const char *who, const struct container *c) {
+    return who[0] == '\0' || strncmp(c->name, who, strlen(who)) == 0;
+}
+
+static int restart_at(const struct container *c, int minute) {
+    for (int i = 0; i < opt.nrestarts; i++)
+        if (opt.restarts[i].minute == minute && applies(opt.restarts[i].who, c)) return 1;
+    return 0;
+}
+
+// nginx proxies to the app: any app restart shows up there as a 5xx spike
+static int spike_at(const struct container *c, int minute) {
+    (void)c;
+    for (int i = 0; i < opt.nrestarts; i++)
+        if (minute >= opt.restarts[i].minute && minute < opt.restarts[i].minute + opt.spike_minutes)
+            return 1;
+    return 0;
+}
+
+// First second with lines in this minute: an app restarting is silent for restart_gap_s
+static int first_second(const struct container *c, int minute) {
+    return c->kind == APP && restart_at(c, minute) ? opt.restart_gap_s : 0;
+}
+
+static int plan(void) {
+    uint64_t total_items = 0;
+    for (int i = 0; i < ncont; i++) {
+        struct container *c = &cont[i];
+        size_t m = (size_t)opt.minutes;
+        c->minute_lines = calloc(m, sizeof(uint64_t));
+        c->minute_first = calloc(m, sizeof(uint64_t));
+        c->errors = calloc(m, sizeof(uint64_t));
+        c->x5xx = calloc(m, sizeof(uint64_t));
+        c->injected = calloc(m, 1);
+        if (!c->minute_lines || !c->minute_first || !c->errors || !c->x5xx || !c->injected) return -1;
+        uint64_t first = 0;
+        for (int k = 0; k < opt.minutes; k++) {
+            double mult = 1.0;
+            for (int b = 0; b < opt.nbursts; b++) {
+                const struct burst *bu = &opt.bursts[b];
+                if (k >= bu->start && k < bu->start + bu->len && applies(bu->who, c)) {
+                    mult *= bu->mult;
+                    c->injected[k] |= 1;
+                }
+            }
+            if (restart_at(c, k)) c->injected[k] |= 2;
+            if (c->kind == NGINX && spike_at(c, k)) c->injected[k] |= 4;
+            double secs = 60.0 - first_second(c, k);
+            c->minute_lines[k] = (uint64_t)(opt.rate * secs * mult + 0.5);
+            c->minute_first[k] = first;
+            first += c->minute_lines[k];
+            total_items += (c->minute_lines[k] + SUB_LINES - 1) / SUB_LINES;
+        }
+    }
+    items = malloc((total_items ? total_items : 1) * sizeof(*items));
+    if (!items) return -1;
+    // Minute-major order, so all files grow together
+    for (int k = 0; k < opt.minutes; k++)
+        for (int i = 0; i < ncont; i++)
+            for (uint64_t s = 0; s * SUB_LINES < cont[i].minute_lines[k]; s++)
+                items[nitems++] = (struct item){ .c = i, .minute = k, .sub = (uint32_t)s, .seq = cont[i].nitems++ };
+    return 0;
+}
+
+/* ---------- workers ---------- */
+
+static void generate(const struct item *it, struct buf *b) {
+    struct container *c = &cont[it->c];
+    uint64_t n = c->minute_lines[it->minute];
+    uint64_t lo = (uint64_t)it->sub * SUB_LINES;
+    uint64_t hi = lo + SUB_LINES < n ? lo + SUB_LINES : n;
+    uint64_t rng = splitmix64(opt.seed ^ ((uint64_t)it->c << 48) ^ ((uint64_t)it->minute << 20) ^ it->sub) | 1;
+    struct minute_fmt mf;
+    minute_format(&mf, it->minute);
+
+    int sec0 = first_second(c, it->minute);
+    uint64_t span_ns = (uint64_t)(60 - sec0) * 1000000000ull;
+    uint64_t step = n ? span_ns / n : span_ns;
+    int restart = c->kind == APP && restart_at(c, it->minute);
+    int dying = c->kind == APP && it->minute + 1 < opt.minutes && restart_at(c, it->minute + 1);
+    int spike = c->kind == NGINX && spike_at(c, it->minute);
+    double err_p = opt.error_rate, x5xx_p = spike ? 0.5 : opt.rate_5xx;
+    uint64_t errors = 0, x5xx = 0;
+
+    b->len = 0;
+    for (uint64_t k = lo; k < hi; k++) {
+        // Evenly spaced with jitter inside the slot: sorted, not periodic
+        uint64_t t = (uint64_t)sec0 * 1000000000ull + k * step + (step > 1 ? rng_next(&rng) % step : 0);
+        int sec = (int)(t / 1000000000ull);
+        uint64_t ns = t % 1000000000ull;
+        if (c->kind == NGINX) {
+            int what = rng_chance(&rng, spike ? err_p * 10 : err_p) ? 1 : rng_chance(&rng, x5xx_p) ? 2 : 0;
+            errors += what == 1;
+            x5xx += what == 2;
+            line_nginx(b, &mf, sec, ns, &rng, what);
+        } else {
+            // Restart: the old process ends the previous minute with a few FATAL
+            // lines, the new one starts restart_gap_s later with a banner
+            int what = restart && k == 0 ? 3 : dying && k + 3 >= n ? 4 : rng_chance(&rng, err_p) ? 1 : 0;
+            errors += what == 1 || what == 4;
+            line_app(b, &mf, sec, ns, &rng, what, c->minute_first[it->minute] + k + 1);
+        }
+    }
+    __atomic_fetch_add(&c->errors[it->minute], errors, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&c->x5xx[it->minute], x5xx, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&total_lines, hi - lo, __ATOMIC_RELAXED);
+}
+
+static int write_all(int fd, const char *p, size_t n) {
+    while (n) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+static void *worker(void *arg) {
+    (void)arg;
+    struct buf b = { .cap = (size_t)SUB_LINES * MAX_LINE };
+    b.p = malloc(b.cap);
+    if (!b.p) { failed = 1; return NULL; }
+    for (;;) {
+        uint64_t i = __atomic_fetch_add(&next_item, 1, __ATOMIC_RELAXED);
+        if (i >= nitems || failed) break;
+        const struct item *it = &items[i];
+        struct container *c = &cont[it->c];
+        generate(it, &b);
+
+        // Items of a container are taken in seq order, so the one we wait for
+        // is already being formatted by another worker
+        pthread_mutex_lock(&write_lock);
+        while (c->next_seq != it->seq && !failed) pthread_cond_wait(&write_cond, &write_lock);
+        pthread_mutex_unlock(&write_lock);
+        if (failed) break;
+        if (write_all(c->fd, b.p, b.len) < 0) {
+            fprintf(stderr, "loggen: write %s-json.log: %s\n", c->name, strerror(errno));
+            failed = 1;
+        }
+        __atomic_fetch_add(&total_bytes, b.len, __ATOMIC_RELAXED);
+        pthread_mutex_lock(&write_lock);
+        c->next_seq++;
+        pthread_cond_broadcast(&write_cond);
+        pthread_mutex_unlock(&write_lock);
+    }
+    free(b.p);
+    return NULL;
+}
+
+/* ---------- ground truth ---------- */
+
+static FILE *open_out(const char *name) {
+    char path[sizeof(opt.out_dir) + 64];
+    snprintf(path, sizeof(path), "%s/%s", opt.out_dir, name);
+    FILE *f = fopen(path, "w");
+    if (!f) fprintf(stderr, "loggen: %s: %s\n", path, strerror(errno));
+    return f;
+}
+
+struct err_row { char name[48]; uint64_t count; };  // name as in the logs: <container>-json
+
+// Order of out/top_errors.csv: count desc, then name (sort's last-resort key in the C locale)
+static int cmp_err_row(const void *a, const void *b) {
+    const struct err_row *x = a, *y = b;
+    if (x->count != y->count) return x->count < y->count ? 1 : -1;
+    return strcmp(x->name, y->name);
+}
+
+static int write_truth(void) {
+    FILE *fe = open_out("truth_errors.csv"), *fm = open_out("truth_minutes.csv"), *fb = open_out("truth_bursts.csv");
+    if (!fe || !fm || !fb) return -1;
+    fprintf(fe, "container,error_count\n");
+    fprintf(fm, "container,minute,count,errors,status_5xx,injected\n");
+    fprintf(fb, "container,minute,count,multiplier\n");
+    struct err_row rows[MAX_CONTAINERS];
+    int nrows = 0;
+    for (int i = 0; i < ncont; i++) {
+        struct container *c = &cont[i];
+        uint64_t err = 0;
+        for (int k = 0; k < opt.minutes; k++) {
+            struct minute_fmt mf;
+            minute_format(&mf, k);
+            mf.iso[16] = '\0';                          // YYYY-MM-DDTHH:MM, the analyzer's minute key
+            err += c->errors[k];
+            char inj[32] = "";
+            if (c->injected[k] & 1) strcat(inj, "burst;");
+            if (c->injected[k] & 2) strcat(inj, "restart;");
+            if (c->injected[k] & 4) strcat(inj, "5xx_spike;");
+            if (inj[0]) inj[strlen(inj) - 1] = '\0';
+            fprintf(fm, "%s-json,%s,%llu,%llu,%llu,%s\n", c->name, mf.iso,
+                    (unsigned long long)c->minute_lines[k], (unsigned long long)c->errors[k],
+                    (unsigned long long)c->x5xx[k], inj);
+            if (c->injected[k] & 1) {
+                double mult = 1.0;
+                for (int b = 0; b < opt.nbursts; b++)
+                    if (k >= opt.bursts[b].start && k < opt.bursts[b].start + opt.bursts[b].len &&
+                        applies(opt.bursts[b].who, c))
+                        mult *= opt.bursts[b].mult;
+                fprintf(fb, "%s-json,%s,%llu,%.2f\n", c->name, mf.iso,
+                        (unsigned long long)c->minute_lines[k], mult);
+            }
+        }
+        if (err) {
+            snprintf(rows[nrows].name, sizeof(rows[nrows].name), "%.31s-json", c->name);
+            rows[nrows++].count = err;
+        }
+    }
+    qsort(rows, (size_t)nrows, sizeof(rows[0]), cmp_err_row);
+    for (int i = 0; i < nrows; i++)
+        fprintf(fe, "%s,%llu\n", rows[i].name, (unsigned long long)rows[i].count);
+    int rc = 0;
+    if (fclose(fe) || fclose(fm) || fclose(fb)) rc = -1;
+    return rc;
+}
+
+/* ---------- main ---------- */
+
+static void print_usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [--out DIR] [--nginx N] [--app N] [--minutes M] [--rate LINES_PER_SEC]\n"
+            "          [--error-rate P] [--5xx-rate P] [--seed S] [--start YYYY-MM-DDTHH:MM] [--threads N]\n"
+            "          [--burst MIN:LEN:MULT[:NAME]]... [--restart MIN[:NAME]]... [--restart-gap SEC]\n"
+            "          [--spike-minutes N]\n"
+            "Rates are per container. NAME matches containers by prefix (nginx, app, app-2, ...).\n"
+            "Example (~10 GB): %s --out /var/tmp/logs --nginx 2 --app 2 --minutes 60 --rate 3000 \\\n"
+            "                      --burst 20:3:6 --restart 40:app\n",
+            prog, prog);
+}
+
+static int parse_who(const char *s, char *who, size_t n) {
+    if (!s) { who[0] = '\0'; return 0; }
+    if (strlen(s + 1) >= n) return -1;
+    strcpy(who, s + 1);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    strcpy(opt.out_dir, ".");
+    opt.nginx = 1;
+    opt.app = 1;
+    opt.minutes = 60;
+    opt.rate = 100;
+    opt.error_rate = 0.02;
+    opt.rate_5xx = 0.01;
+    opt.seed = 42;
+    opt.start = 1757635200;             // 2025-09-12T00:00:00Z, same day as the fixtures
+    opt.threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    opt.restart_gap_s = 20;
+    opt.spike_minutes = 2;
+
+    static struct option opts[] = {
+        {"out", required_argument, 0, 'o'},
+        {"nginx", required_argument, 0, 'n'},
+        {"app", required_argument, 0, 'a'},
+        {"minutes", required_argument, 0, 'm'},
+        {"rate", required_argument, 0, 'r'},
+        {"error-rate", required_argument, 0, 'e'},
+        {"5xx-rate", required_argument, 0, 'x'},
+        {"seed", required_argument, 0, 's'},
+        {"start", required_argument, 0, 'S'},
+        {"threads", required_argument, 0, 't'},
+        {"burst", required_argument, 0, 'b'},
+        {"restart", required_argument, 0, 'R'},
+        {"restart-gap", required_argument, 0, 'g'},
+        {"spike-minutes", required_argument, 0, 'k'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int ch;
+    while ((ch = getopt_long(argc, argv, "", opts, NULL)) != -1) {
+        switch (ch) {
+            case 'o': snprintf(opt.out_dir, sizeof(opt.out_dir), "%s", optarg); break;
+            case 'n': opt.nginx = atoi(optarg); break;
+            case 'a': opt.app = atoi(optarg); break;
+            case 'm': opt.minutes = atoi(optarg); break;
+            case 'r': opt.rate = atof(optarg); break;
+            case 'e': opt.error_rate = atof(optarg); break;
+            case 'x': opt.rate_5xx = atof(optarg); break;
+            case 's': opt.seed = strtoull(optarg, NULL, 0); break;
+            case 'S': {
+                struct tm tm = {0};
+                if (!strptime(optarg, "%Y-%m-%dT%H:%M", &tm)) { print_usage(argv[0]); return 1; }
+                opt.start = timegm(&tm);
+                break;
+            }
+            case 't': opt.threads = atoi(optarg); break;
+            case 'b': {
+                struct burst *bu = &opt.bursts[opt.nbursts];
+                char *end;
+                if (opt.nbursts == MAX_BURSTS) { fprintf(stderr, "loggen: too many --burst\n"); return 1; }
+                bu->start = (int)strtol(optarg, &end, 10);
+                if (*end != ':') { print_usage(argv[0]); return 1; }
+                bu->len = (int)strtol(end + 1, &end, 10);
+                if (*end != ':') { print_usage(argv[0]); return 1; }
+                bu->mult = strtod(end + 1, &end);
+                if ((*end && *end != ':') || parse_who(*end ? end : NULL, bu->who, sizeof(bu->who)) < 0 ||
+                    bu->len <= 0 || bu->mult <= 0) {
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                opt.nbursts++;
+                break;
+            }
+            case 'R': {
+                struct restart *re = &opt.restarts[opt.nrestarts];
+                char *end;
+                if (opt.nrestarts == MAX_RESTARTS) { fprintf(stderr, "loggen: too many --restart\n"); return 1; }
+                re->minute = (int)strtol(optarg, &end, 10);
+                if ((*end && *end != ':') || parse_who(*end ? end : NULL, re->who, sizeof(re->who)) < 0) {
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                opt.nrestarts++;
+                break;
+            }
+            case 'g': opt.restart_gap_s = atoi(optarg); break;
+            case 'k': opt.spike_minutes = atoi(optarg); break;
+            case 'h': print_usage(argv[0]); return 0;
+            default: print_usage(argv[0]); return 1;
+        }
+    }
+    if (opt.nginx < 0 || opt.app < 0 || opt.nginx + opt.app == 0 || opt.nginx + opt.app > MAX_CONTAINERS ||
+        opt.minutes <= 0 || opt.rate <= 0 || opt.threads <= 0 || opt.restart_gap_s < 0 || opt.restart_gap_s >= 60) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // nginx, nginx-2, ..., app, app-2, ...
+    for (int k = 0; k < opt.nginx + opt.app; k++) {
+        struct container *c = &cont[ncont++];
+        int app = k >= opt.nginx, idx = app ? k - opt.nginx : k;
+        c->kind = app ? APP : NGINX;
+        if (idx == 0) snprintf(c->name, sizeof(c->name), "%s", app ? "app" : "nginx");
+        else snprintf(c->name, sizeof(c->name), "%s-%d", app ? "app" : "nginx", idx + 1);
+    }
+
+    if (mkdir(opt.out_dir, 0755) == -1 && errno != EEXIST) {
+        fprintf(stderr, "loggen: mkdir %s: %s\n", opt.out_dir, strerror(errno));
+        return 1;
+    }
+    if (plan() < 0) {
+        fprintf(stderr, "loggen: out of memory\n");
+        return 1;
+    }
+    for (int i = 0; i < ncont; i++) {
+        char path[sizeof(opt.out_dir) + 64];
+        snprintf(path, sizeof(path), "%s/%.31s-json.log", opt.out_dir, cont[i].name);
+        cont[i].fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (cont[i].fd < 0) {
+            fprintf(stderr, "loggen: %s: %s\n", path, strerror(errno));
+            return 1;
+        }
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    pthread_t *th = calloc((size_t)opt.threads, sizeof(*th));
+    if (!th) return 1;
+    int started = 0;
+    for (; started < opt.threads; started++)
+        if (pthread_create(&th[started], NULL, worker, NULL) != 0) break;
+    if (started == 0) {
+        fprintf(stderr, "loggen: pthread_create failed\n");
+        return 1;
+    }
+    for (int i = 0; i < started; i++) pthread_join(th[i], NULL);
+    free(th);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    for (int i = 0; i < ncont; i++) close(cont[i].fd);
+    if (failed) return 1;
+    if (write_truth() < 0) return 1;
+
+    double secs = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+    fprintf(stderr, "loggen: %d containers, %llu lines, %.2f GB in %.2f s = %.2f GB/s (threads=%d)\n",
+            ncont, (unsigned long long)total_lines, (double)total_bytes / 1e9, secs,
+            (double)total_bytes / 1e9 / (secs > 0 ? secs : 1e-9), started);
+    return 0;
+}
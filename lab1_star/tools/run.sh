@@ -3,11 +3,15 @@ set -euo pipefail
 
 # Usage:
 #   bash tools/run.sh --fixtures fixtures
+#   bash tools/run.sh --logs '/var/lib/docker/containers/*/*-json.log*' --jobs 8
 #   bash tools/run.sh --from-docker --since "2025-09-12 00:00" --until "2025-09-12 01:00" --containers "nginx,app"
 
 ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")"/.. && pwd)"
 OUT_DIR="$ROOT_DIR/out"
 FIXTURES_DIR=""
+LOG_GLOBS=()
+JOBS="$(nproc 2>/dev/null || echo 4)"
+STATE_FILE=""
 FROM_DOCKER=0
 SINCE=""
 UNTIL=""
@@ -19,7 +23,13 @@ mkdir -p "$OUT_DIR"
 
 print_help() {
   cat <<EOF
-Usage: $0 [--fixtures DIR | --from-docker] [--since "YYYY-MM-DD HH:MM"] [--until "YYYY-MM-DD HH:MM"] [--containers "c1,c2"] [--window-minutes N] [--burst-multiplier X]
+Usage: $0 [--fixtures DIR | --logs GLOB... | --from-docker] [--jobs N] [--state FILE] [--since "YYYY-MM-DD HH:MM"] [--until "YYYY-MM-DD HH:MM"] [--containers "c1,c2"] [--window-minutes N] [--burst-multiplier X]
+
+  --logs GLOB   json-file logs, including rotated (*.log.1) and compressed (*.gz, *.zst) ones;
+                may be repeated. Quote the glob so the script expands it.
+  --jobs N      files decompressed and parsed concurrently (default: nproc)
+  --state FILE  incremental mode: remember offsets and aggregates in FILE, read only
+                bytes appended since the previous run (with --fixtures/--logs)
 
 Outputs:
   out/docker_normalized.csv   ts_iso,container,stream,message
@@ -32,6 +42,12 @@ while [[ $# -gt 0 ]]; do
   case "$1" in
     --fixtures)
       FIXTURES_DIR="$2"; shift 2;;
+    --logs)
+      LOG_GLOBS+=("$2"); shift 2;;
+    --jobs)
+      JOBS="$2"; shift 2;;
+    --state)
+      STATE_FILE="$2"; shift 2;;
     --from-docker)
       FROM_DOCKER=1; shift;;
     --since)
@@ -51,32 +67,255 @@ while [[ $# -gt 0 ]]; do
   esac
 done
 
-normalize_from_fixtures() {
-  local src_dir="$1"
-  local out_csv="$2"
-  # Expect docker json-file like lines: {"log":"...","stream":"stdout","time":"2025-09-12T00:00:01.234567890Z"}
-  # Fallback parser without jq: extract keys conservatively.
-  awk '
-    function json_unquote(s){
-      gsub(/^"|"$/, "", s); gsub(/\\n/, " ", s); gsub(/,/, " ", s); return s
-    }
-    BEGIN { OFS=","; print "ts_iso","container","stream","message" }
-    {
-      line=$0
-      # naive field extraction
-      log=""; stream=""; time=""; container=FILENAME
-      if (match(line, /"time"\s*:\s*"[^"]+"/)) { t=substr(line, RSTART, RLENGTH); split(t, a, ":"); time=a[2]; sub(/^\s*"/, "", time); sub(/"\s*$/, "", time) }
-      if (match(line, /"stream"\s*:\s*"[^"]+"/)) { s=substr(line, RSTART, RLENGTH); split(s, a, ":"); stream=a[2]; sub(/^\s*"/, "", stream); sub(/"\s*$/, "", stream) }
-      if (match(line, /"log"\s*:\s*"[^"]*"/)) { l=substr(line, RSTART, RLENGTH); split(l, a, ":"); log=substr(l, index(l, ":")+1); sub(/^\s*"/, "", log); sub(/"\s*$/, "", log) }
-      gsub(/\\t/, " ", log); gsub(/\\n/, " ", log)
-      gsub(/,/, " ", log)
-      # derive container name from filename (strip dir and extension)
-      n=split(container, parts, "/"); base=parts[n]; sub(/\.[^.]*$/, "", base)
-      if (time=="") next
-      print time, base, (stream==""?"stdout":stream), log
-    }
-  ' "$src_dir"/*.log | sort -t, -k1,1 > "$out_csv"
+# Docker json-file line -> ts_iso,container,stream,message.
+# Lines look like {"log":"...","stream":"stdout","time":"2025-09-12T00:00:01.234567890Z"};
+# parsed without jq. Counts input bytes and writes the total to the file in $meta.
+NORMALIZE_AWK='
+  function field(line, key,    v) {
+    if (!match(line, "\"" key "\"[ \t]*:[ \t]*\"([^\"\\\\]|\\\\.)*\"")) return ""
+    v = substr(line, RSTART, RLENGTH)
+    sub("^\"" key "\"[ \t]*:[ \t]*\"", "", v); sub(/"$/, "", v)
+    return v
+  }
+  function handle(line,    time, stream, msg) {
+    bytes += length(line) + 1
+    time = field(line, "time")
+    if (time == "") return
+    stream = field(line, "stream")
+    msg = field(line, "log")
+    gsub(/\\[nrt]/, " ", msg); gsub(/\\"/, "\"", msg); gsub(/\\\\/, "\\", msg)
+    gsub(/,/, " ", msg); sub(/ +$/, "", msg)
+    print time, cname, (stream == "" ? "stdout" : stream), msg
+  }
+  BEGIN { OFS="," }
+  # partial=1: the input ends in a line still being written; leave it for the next run
+  partial { if (have) handle(prev); prev = $0; have = 1; next }
+  { handle($0) }
+  END { print bytes + 0 > meta }
+'
+
+# nginx-json.log.2.gz -> nginx-json (same name as the live nginx-json.log)
+container_of() {
+  local base="${1##*/}"
+  base="${base%.gz}"; base="${base%.zst}"
+  while [[ "$base" =~ ^(.*)\.[0-9]+$ ]]; do base="${BASH_REMATCH[1]}"; done
+  echo "${base%.log}"
+}
+
+is_compressed() { [[ "$1" == *.gz || "$1" == *.zst ]]; }
+
+decompress() {
+  case "$1" in
+    *.gz)  gzip -dc -- "$1";;
+    *.zst) zstd -dcq -- "$1";;
+    *)     cat -- "$1";;
+  esac
+}
+
+# Uncompressed bytes [start, end) of a file; end is empty for "to EOF". Plain
+# files are read from the offset directly, compressed ones have to be
+# decompressed from the beginning.
+read_range() {
+  local file="$1" start="$2" end="$3"
+  if is_compressed "$file"; then
+    decompress "$file" | tail -c +"$((start + 1))"
+  elif [[ -n "$end" ]]; then
+    tail -c +"$((start + 1))" -- "$file" | head -c "$((end - start))"
+  else
+    tail -c +"$((start + 1))" -- "$file"
+  fi
+}
+
+# Checksum of the first line: recognizes a file after rename or compression
+fingerprint() {
+  { decompress "$1" 2>/dev/null || true; } | head -n1 | cksum | cut -d' ' -f1
+}
+
+# Files to read: JOB_FILE[i] from uncompressed offset JOB_START[i] up to
+# JOB_END[i] (empty = EOF); JOB_PARTIAL[i]=1 keeps an unterminated last line
+# for later. After normalize_files, JOB_BYTES[i] is how many bytes were consumed.
+JOB_FILE=(); JOB_START=(); JOB_END=(); JOB_PARTIAL=(); JOB_BYTES=()
+FILES=()
+
+collect_files() {
+  local g f
+  for g in "$@"; do
+    for f in $g; do [[ -f "$f" ]] && FILES+=("$f"); done
+  done
+  if [[ ${#FILES[@]} -eq 0 ]]; then
+    echo "No log files match: $*" >&2; exit 1
+  fi
+  for f in "${FILES[@]}"; do
+    if [[ "$f" == *.zst ]] && ! command -v zstd >/dev/null 2>&1; then
+      echo "zstd is not installed, cannot read $f" >&2; exit 1
+    fi
+  done
+}
+
+plan_full() {
+  local i
+  for i in "${!FILES[@]}"; do
+    JOB_FILE+=("${FILES[$i]}"); JOB_START+=(0); JOB_END+=(""); JOB_PARTIAL+=(0)
+  done
+}
+
+# One job: read | normalize | sort into a sorted run. The stages are connected
+# by pipes, so the decompressed text never sits on disk in full.
+ingest_one() {
+  local i="$1" run="$2"
+  local file="${JOB_FILE[$i]}"
+  local cname; cname="$(container_of "$file")"
+  read_range "$file" "${JOB_START[$i]}" "${JOB_END[$i]}" |
+    LC_ALL=C awk -v cname="$cname" -v meta="$run.bytes" -v partial="${JOB_PARTIAL[$i]}" "$NORMALIZE_AWK" |
+    LC_ALL=C sort -t, -k1,1 > "$run"
+  # first_ts container run last_ts: used to order runs and chain them below
+  if [[ -s "$run" ]]; then
+    printf '%s\t%s\t%s\t%s\n' "$(head -n1 "$run" | cut -d, -f1)" "$cname" "$run" \
+      "$(tail -n1 "$run" | cut -d, -f1)" > "$run.meta"
+  fi
+}
+
+# Jobs run on a pool of $JOBS workers, then get merged. Runs of one container
+# are ordered by their first timestamp and concatenated while they do not
+# overlap (rotation keeps them disjoint), so the final step is a k-way merge of
+# one stream per container, not a full sort. Rows (no header) go to $1.
+normalize_files() {
+  local out_rows="$1"
+  local tmp; tmp="$(mktemp -d "${TMPDIR:-/tmp}/lab1_ingest.XXXXXX")"
+  trap 'rm -rf "$tmp"' EXIT
+  local t0; t0="$(date +%s.%N)"
+
+  local i running=0
+  for i in "${!JOB_FILE[@]}"; do
+    ingest_one "$i" "$tmp/run.$i" &
+    if (( ++running >= JOBS )); then wait -n; running=$((running - 1)); fi
+  done
+  wait
+
+  # Chains of non-overlapping runs per container; each chain is one merge input.
+  # Chains of several runs are streamed through a FIFO by cat.
+  local inputs=() n=0 chain runs
+  while IFS= read -r chain; do
+    read -r -a runs <<<"$chain"
+    if [[ ${#runs[@]} -eq 1 ]]; then
+      inputs+=("${runs[0]}")
+    else
+      mkfifo "$tmp/chain.$n"
+      cat "${runs[@]}" > "$tmp/chain.$n" &
+      inputs+=("$tmp/chain.$n"); n=$((n + 1))
+    fi
+  done < <(cat "$tmp"/run.*.meta 2>/dev/null | LC_ALL=C sort -t$'\t' -k2,2 -k1,1 |
+           awk -F'\t' '{
+             if ($2 == c && $1 >= last) { line = line " " $3 }
+             else { if (line != "") print line; line = $3; c = $2 }
+             last = $4
+           } END { if (line != "") print line }')
+
+  : > "$out_rows"
+  if [[ ${#inputs[@]} -gt 0 ]]; then
+    local batch=$(( ${#inputs[@]} > 16 ? ${#inputs[@]} : 16 ))
+    LC_ALL=C sort -m -t, -k1,1 --batch-size="$batch" "${inputs[@]}" > "$out_rows"
+  fi
+  wait
+
+  local total=0
+  JOB_BYTES=()
+  for i in "${!JOB_FILE[@]}"; do
+    JOB_BYTES[$i]="$(cat "$tmp/run.$i.bytes")"
+    total=$((total + JOB_BYTES[$i]))
+  done
+  local t1; t1="$(date +%s.%N)"
+  awk -v n="${#JOB_FILE[@]}" -v j="$JOBS" -v t0="$t0" -v t1="$t1" -v b="$total" 'BEGIN {
+    t = t1 - t0; if (t <= 0) t = 1e-9
+    printf "ingest: %d files, %.1f MB uncompressed in %.2f s = %.1f MB/s (jobs=%d)\n",
+           n, b / 1e6, t, b / 1e6 / t, j }' >&2
+  rm -rf "$tmp"
+  trap - EXIT
+}
+
+# ---- incremental mode (--state) ----
+# State file, tab-separated:
+#   F  dev:inode  size  offset  fingerprint  seen_epoch  path   -- per input file
+#   E  container  error_count
+#   M  container  minute  count      -- last WINDOW_MINUTES+1 minutes per container
+#   B  container,minute,count,baseline_avg,multiplier   -- bursts found so far
+# A file is found by inode; its first-line fingerprint guards against inode
+# reuse. A file with a new inode but a known fingerprint is a renamed or
+# compressed copy of one already read and continues from its offset.
+declare -A ST_SIZE=() ST_OFF=() ST_FP=() ST_SEEN=() ST_PATH=() FP_ID=()
+JOB_ID=(); JOB_FP=(); JOB_SIZE=()
+STATE_KEEP_DAYS=7     # entries of vanished files are kept this long (for .gz successors)
+
+load_state() {
+  local state="$1" tag id size off fp seen path
+  [[ -f "$state" ]] || return 0
+  while IFS=$'\t' read -r tag id size off fp seen path; do
+    [[ "$tag" == F ]] || continue
+    ST_SIZE[$id]="$size"; ST_OFF[$id]="$off"; ST_FP[$id]="$fp"; ST_SEEN[$id]="$seen"; ST_PATH[$id]="$path"
+    FP_ID[$fp]="$id"
+  done < "$state"
+}
+
+plan_incremental() {
+  local f id size fp start end partial prev skipped=0
+  declare -A claimed=() seen_fp=()
+  for f in "${FILES[@]}"; do
+    id="$(stat -c '%d:%i' -- "$f")"; size="$(stat -c '%s' -- "$f")"
+    fp="$(fingerprint "$f")"
+    start=0; end=""; partial=0; prev=""
+    if [[ -n "${ST_FP[$id]+x}" && "${ST_FP[$id]}" == "$fp" ]]; then
+      prev="$id"
+    elif [[ -n "${seen_fp[$fp]+x}" ]]; then
+      # Same content as a file already planned in this run (x.log.1 next to its
+      # fresh x.log.1.gz): read only one of them
+      start=-1
+    elif [[ -n "${FP_ID[$fp]+x}" && -z "${claimed[${FP_ID[$fp]}]+x}" ]]; then
+      prev="${FP_ID[$fp]}"
+    fi
+    seen_fp[$fp]=1
+    if [[ -n "$prev" && -z "${claimed[$prev]+x}" ]]; then
+      claimed[$prev]=1
+      if is_compressed "$f"; then
+        if [[ "$prev" == "$id" && "$size" == "${ST_SIZE[$prev]}" ]]; then
+          start=-1                                  # unchanged archive
+        else
+          start="${ST_OFF[$prev]}"                  # compressed copy of a file read up to offset
+        fi
+      elif (( size < ST_OFF[$prev] )); then
+        start=0                                     # truncated (copytruncate): read anew
+      elif (( size == ST_OFF[$prev] )); then
+        start=-1                                    # nothing appended
+      else
+        start="${ST_OFF[$prev]}"
+      fi
+    fi
+    if (( start < 0 )); then
+      # Offset stays as it was; a duplicate counts as read to the end
+      skipped=$((skipped + 1))
+      JOB_ID+=("$id"); JOB_FP+=("$fp"); JOB_SIZE+=("$size")
+      if [[ -n "$prev" ]]; then start="${ST_OFF[$prev]}"; else start="$size"; fi
+      JOB_FILE+=("$f"); JOB_START+=("$start"); JOB_END+=(""); JOB_PARTIAL+=(-1)
+      continue
+    fi
+    if ! is_compressed "$f"; then
+      end="$size"
+      # the writer may be in the middle of a line: stop at the last newline
+      [[ "$size" -gt 0 && "$(tail -c 1 -- "$f" | wc -l)" -eq 0 ]] && partial=1
+    fi
+    JOB_ID+=("$id"); JOB_FP+=("$fp"); JOB_SIZE+=("$size")
+    JOB_FILE+=("$f"); JOB_START+=("$start"); JOB_END+=("$end"); JOB_PARTIAL+=("$partial")
+  done
+  # Entries of files no longer present stay for STATE_KEEP_DAYS unless a successor took them over
+  local now; now="$(date +%s)"
+  for id in "${!ST_FP[@]}"; do
+    [[ -n "${claimed[$id]+x}" || -n "${seen_fp[${ST_FP[$id]}]+x}" ]] && continue
+    (( now - ST_SEEN[$id] > STATE_KEEP_DAYS * 86400 )) && continue
+    CARRY+=("$(printf 'F\t%s\t%s\t%s\t%s\t%s\t%s' "$id" "${ST_SIZE[$id]}" "${ST_OFF[$id]}" \
+      "${ST_FP[$id]}" "${ST_SEEN[$id]}" "${ST_PATH[$id]}")")
+  done
+  echo "incremental: ${#FILES[@]} files, $skipped unchanged" >&2
 }
+CARRY=()
 
 normalize_from_docker() {
   local out_csv="$1"
@@ -109,74 +348,137 @@ normalize_from_docker() {
   rm -f "$out_csv.tmp"
 }
 
-compute_top_errors() {
-  local in_csv="$1"; local out_csv="$2"
-  awk -F, 'BEGIN{OFS=","; print "container","error_count"}
-    NR==1{next}
-    {
-      msg=$4; low=tolower(msg)
-      if (low ~ /(error|fail|fatal|panic)/) cnt[$2]++
-    }
-    END{
-      for (c in cnt) print c, cnt[c]
+# Error counts and bursts. Reads the aggregation state (E/M/B lines from a
+# previous run, or nothing) and new normalized rows sorted by time, writes the
+# updated state and both reports. The baseline of a minute is the average of
+# the previous W minutes that had messages; only minutes that got new rows
+# (and everything after them) are re-evaluated.
+aggregate() {
+  local state_in="$1" rows="$2" state_out="$3"
+  LC_ALL=C awk -v W="$WINDOW_MINUTES" -v M="$BURST_MULTIPLIER" \
+      -v top="$OUT_DIR/top_errors.csv" -v bursts="$OUT_DIR/bursts.csv" -v state="$state_out" '
+    BEGIN { OFS = "," }
+    FILENAME == ARGV[1] {
+      split($0, f, "\t")
+      if (f[1] == "E") err[f[2]] = f[3]
+      else if (f[1] == "M") { n = ++nm[f[2]]; mins[f[2], n] = f[3]; cnt[f[2], f[3]] = f[4] }
+      else if (f[1] == "B") { split(f[2], b, ","); burst[b[1], b[2]] = f[2] }
+      next
     }
-  ' "$in_csv" | sort -t, -k2,2nr > "$out_csv"
-}
-
-compute_bursts() {
-  local in_csv="$1"; local out_csv="$2"; local window="$3"; local mult="$4"
-  awk -F, -v W="$window" -v M="$mult" 'BEGIN{OFS=","; print "container","minute","count","baseline_avg","multiplier"}
-    NR==1{next}
     {
+      split($0, f, ",")
+      c = f[2]; low = tolower(f[4])
+      if (low ~ /(error|fail|fatal|panic)/) err[c]++
       # minute key: YYYY-MM-DDTHH:MM
-      minute=substr($1,1,16)
-      key=$2"\t"minute
-      counts[key]++
-    }
-    END{
-      # collect per container minutes, compute rolling baseline over previous W minutes (approximate: treat as sorted string order)
-      # build lists
-      for (k in counts) {
-        split(k, a, "\t"); c=a[1]; m=a[2]
-        idx[c] = idx[c] ":" m
+      m = substr(f[1], 1, 16)
+      if (!((c, m) in cnt)) {
+        # rows are sorted, so new minutes normally go to the end; a late one is inserted in place
+        n = ++nm[c]
+        while (n > 1 && mins[c, n - 1] > m) { mins[c, n] = mins[c, n - 1]; n-- }
+        mins[c, n] = m
+        if (!(c in first) || n < first[c]) first[c] = n
+      } else if (!(c in first) || mins[c, first[c]] > m) {
+        for (n = nm[c]; mins[c, n] != m; n--) ;
+        first[c] = n
       }
-      for (c in idx) {
-        split(substr(idx[c],2), arr, ":")
-        n=asort(arr)
-        for (i=1;i<=n;i++) {
-          m=arr[i]; key=c"\t"m; cur=counts[key]
-          # baseline: average of last W minutes in array index space
-          start=i-W; if (start<1) start=1
-          sum=0; cntw=0
-          for (j=start;j<i;j++) { mm=arr[j]; kk=c"\t"mm; sum+=counts[kk]; cntw++ }
-          base=(cntw>0?sum/cntw:0)
-          if (cntw>0 && base>0 && cur >= base*M) {
-            print c, m, cur, base, sprintf("%.2f", cur/(base>0?base:1))
-          }
+      cnt[c, m]++
+    }
+    END {
+      for (c in first) {
+        for (i = first[c]; i <= nm[c]; i++) {
+          m = mins[c, i]; cur = cnt[c, m]
+          start = i - W; if (start < 1) start = 1
+          sum = 0; cntw = 0
+          for (j = start; j < i; j++) { sum += cnt[c, mins[c, j]]; cntw++ }
+          base = (cntw > 0 ? sum / cntw : 0)
+          delete burst[c, m]
+          if (cntw > 0 && base > 0 && cur >= base * M)
+            burst[c, m] = c OFS m OFS cur OFS base OFS sprintf("%.2f", cur / base)
         }
       }
+      print "container,error_count" > top; close(top)
+      sort = "sort -t, -k2,2nr >> \"" top "\""
+      for (c in err) print c, err[c] | sort
+      close(sort)
+      print "container,minute,count,baseline_avg,multiplier" > bursts; close(bursts)
+      sort = "sort -t, -k1,1 -k2,2 >> \"" bursts "\""
+      for (k in burst) print burst[k] | sort
+      close(sort)
+      if (state == "") exit
+      for (c in err) printf "E\t%s\t%s\n", c, err[c] > state
+      for (c in nm)
+        for (i = (nm[c] > W + 1 ? nm[c] - W : 1); i <= nm[c]; i++)
+          printf "M\t%s\t%s\t%s\n", c, mins[c, i], cnt[c, mins[c, i]] > state
+      for (k in burst) printf "B\t%s\n", burst[k] > state
     }
-  ' "$in_csv" > "$out_csv"
+  ' "$state_in" "$rows"
 }
 
 main() {
   local normalized="$OUT_DIR/docker_normalized.csv"
+  if [[ -n "$STATE_FILE" && $FROM_DOCKER -eq 1 ]]; then
+    echo "--state works with --fixtures/--logs only" >&2; exit 1
+  fi
   if [[ -n "$FIXTURES_DIR" ]]; then
-    normalize_from_fixtures "$ROOT_DIR/$FIXTURES_DIR" "$normalized"
+    LOG_GLOBS=("$ROOT_DIR/$FIXTURES_DIR/*.log*")
+  fi
+
+  if [[ ${#LOG_GLOBS[@]} -gt 0 && -n "$STATE_FILE" ]]; then
+    collect_files "${LOG_GLOBS[@]}"
+    load_state "$STATE_FILE"
+    plan_incremental
+    # Skipped jobs (JOB_PARTIAL=-1) are not run, only carried into the new state
+    local all_file=("${JOB_FILE[@]}") all_start=("${JOB_START[@]}") all_end=("${JOB_END[@]}") all_partial=("${JOB_PARTIAL[@]}")
+    local run_idx=() i
+    JOB_FILE=(); JOB_START=(); JOB_END=(); JOB_PARTIAL=()
+    for i in "${!all_file[@]}"; do
+      [[ "${all_partial[$i]}" == -1 ]] && continue
+      run_idx+=("$i")
+      JOB_FILE+=("${all_file[$i]}"); JOB_START+=("${all_start[$i]}"); JOB_END+=("${all_end[$i]}"); JOB_PARTIAL+=("${all_partial[$i]}")
+    done
+    local rows="$OUT_DIR/.new_rows.csv"
+    normalize_files "$rows"
+
+    # A first run (no state yet) writes the normalized CSV anew, later ones append
+    if [[ ! -f "$STATE_FILE" || ! -f "$normalized" ]]; then
+      echo "ts_iso,container,stream,message" > "$normalized"
+    fi
+    cat "$rows" >> "$normalized"
+
+    local state_new="$STATE_FILE.tmp" now; now="$(date +%s)"
+    aggregate <(grep -v '^F' "$STATE_FILE" 2>/dev/null || true) "$rows" "$state_new"
+    local k j off
+    declare -A consumed=()
+    for k in "${!run_idx[@]}"; do consumed[${run_idx[$k]}]="${JOB_BYTES[$k]}"; done
+    for i in "${!all_file[@]}"; do
+      off=$(( ${all_start[$i]} + ${consumed[$i]:-0} ))
+      printf 'F\t%s\t%s\t%s\t%s\t%s\t%s\n' "${JOB_ID[$i]}" "${JOB_SIZE[$i]}" "$off" "${JOB_FP[$i]}" "$now" "${all_file[$i]}" >> "$state_new"
+    done
+    for j in "${CARRY[@]+"${CARRY[@]}"}"; do printf '%s\n' "$j" >> "$state_new"; done
+    mv "$state_new" "$STATE_FILE"
+    rm -f "$rows"
+    echo "Done. See out/ folder."
+    return
+  fi
+
+  if [[ ${#LOG_GLOBS[@]} -gt 0 ]]; then
+    collect_files "${LOG_GLOBS[@]}"
+    plan_full
+    echo "ts_iso,container,stream,message" > "$normalized"
+    normalize_files "$normalized.rows"
+    cat "$normalized.rows" >> "$normalized"
+    rm -f "$normalized.rows"
   elif [[ $FROM_DOCKER -eq 1 ]]; then
     if ! command -v docker >/dev/null 2>&1; then
       echo "docker is not installed. Use --fixtures instead." >&2; exit 1
     fi
     normalize_from_docker "$normalized"
   else
-    echo "Specify --fixtures DIR or --from-docker" >&2; exit 1
+    echo "Specify --fixtures DIR, --logs GLOB or --from-docker" >&2; exit 1
   fi
 
-  compute_top_errors "$normalized" "$OUT_DIR/top_errors.csv"
-  compute_bursts "$normalized" "$OUT_DIR/bursts.csv" "$WINDOW_MINUTES" "$BURST_MULTIPLIER"
+  aggregate /dev/null <(tail -n +2 "$normalized") ""
   echo "Done. See out/ folder."
 }
 
 main "$@"
-
-
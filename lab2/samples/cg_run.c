@@ -0,0 +1,581 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// cgroup v2 experiment runner: puts cpu_burn / mem_touch (or any command)
+// into purpose-made groups with limits and samples cpu.stat, memory.*,
+// and PSI of every group at a fixed interval. One CSV row per group per tick.
+
+#define MAX_GROUPS   16
+#define MAX_SETTINGS 8
+#define MAX_RUNS     64
+#define MAX_ARGS     32
+
+struct sample {
+    uint64_t usage_usec, throttled_usec, nr_throttled;
+    uint64_t mem_current, anon, file, pgmajfault;
+    uint64_t ev_high, ev_max, ev_oom_kill;
+    uint64_t cpu_some, cpu_full, mem_some, mem_full; // PSI totals, usec
+};
+
+struct setting {
+    char key[64];
+    char value[128];
+};
+
+struct group {
+    char name[64];
+    char path[PATH_MAX];
+    struct setting settings[MAX_SETTINGS];
+    int nsettings;
+    int fd_cpu_stat, fd_mem_current, fd_mem_stat, fd_mem_events, fd_cpu_psi, fd_mem_psi;
+    struct sample prev;
+    int have_prev;
+    // summary
+    int nsamples;
+    double sum_cpu_pct, sum_thr_pct, sum_cpu_some, sum_mem_some, sum_mem_full;
+    uint64_t max_mem;
+};
+
+struct run {
+    int group;
+    char *argv[MAX_ARGS + 1];
+    pid_t pid;
+    int done;
+    int status;
+};
+
+static struct group groups[MAX_GROUPS];
+static int ngroups;
+static struct run runs[MAX_RUNS];
+static int nruns;
+static char cg_root[256] = "";
+static char parent_path[512];
+static int child_output = 0;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void handle_sigterm(int sig) { (void)sig; stop_requested = 1; }
+
+static void print_usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s --group NAME[:FILE=VALUE]... --run 'NAME:CMD ARGS' ...\n"
+            "          [--interval-ms N] [--duration SEC] [--root DIR] [--keep]\n"
+            "  --group hi:cpu.weight=1000:cpuset.cpus=0      create group with limits\n"
+            "          (cpu.max=50000/100000 -> \"50000 100000\"; memory.high=256M, memory.max=512M)\n"
+            "  --run 'hi:./cpu_burn --duration 20'           start command inside group\n"
+            "  --interval-ms N   sampling period (default 100)\n"
+            "  --duration SEC    stop everything after SEC (default: when all commands exit)\n"
+            "  --root DIR        cgroup v2 mount (default: /sys/fs/cgroup or /sys/fs/cgroup/unified)\n"
+            "  --keep            do not remove groups at exit\n"
+            "  --child-output    keep stdout of commands (mixed into the CSV)\n"
+            "CSV time series goes to stdout, summary to stderr.\n",
+            prog);
+}
+
+/* ---------- cgroupfs helpers ---------- */
+
+static int write_file(const char *dir, const char *file, const char *value) {
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s/%s", dir, file) >= (int)sizeof(path)) return -ENAMETOOLONG;
+    int fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) return -errno;
+    ssize_t n = write(fd, value, strlen(value));
+    int err = n < 0 ? -errno : 0;
+    close(fd);
+    return err;
+}
+
+static int open_ro(const char *dir, const char *file) {
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s/%s", dir, file) >= (int)sizeof(path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+// cgroup files are regenerated on every read from offset 0, so the fds stay
+// open for the whole run: one pread per file per tick, no open/close.
+static int read_fd(int fd, char *buf, size_t size) {
+    if (fd < 0) return -1;
+    ssize_t n = pread(fd, buf, size - 1, 0);
+    if (n < 0) return -1;
+    buf[n] = '\0';
+    return 0;
+}
+
+// "key value" per line (cpu.stat, memory.stat, memory.events)
+static uint64_t kv_get(const char *buf, const char *key) {
+    size_t klen = strlen(key);
+    for (const char *p = buf; p && *p; p = strchr(p, '\n'), p = p ? p + 1 : NULL) {
+        if (!strncmp(p, key, klen) && p[klen] == ' ')
+            return strtoull(p + klen + 1, NULL, 10);
+    }
+    return 0;
+}
+
+// PSI: "some avg10=0.00 avg60=0.00 avg300=0.00 total=12345"
+static uint64_t psi_total(const char *buf, const char *kind) {
+    size_t klen = strlen(kind);
+    for (const char *p = buf; p && *p; p = strchr(p, '\n'), p = p ? p + 1 : NULL) {
+        if (!strncmp(p, kind, klen) && p[klen] == ' ') {
+            const char *t = strstr(p, "total=");
+            const char *eol = strchr(p, '\n');
+            if (t && (!eol || t < eol)) return strtoull(t + 6, NULL, 10);
+        }
+    }
+    return 0;
+}
+
+static int detect_root(void) {
+    static const char *candidates[] = { "/sys/fs/cgroup", "/sys/fs/cgroup/unified" };
+    char probe[PATH_MAX];
+    if (cg_root[0]) {
+        snprintf(probe, sizeof(probe), "%s/cgroup.controllers", cg_root);
+        return access(probe, F_OK) == 0 ? 0 : -1;
+    }
+    for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++) {
+        snprintf(probe, sizeof(probe), "%s/cgroup.controllers", candidates[i]);
+        if (access(probe, F_OK) == 0) {
+            snprintf(cg_root, sizeof(cg_root), "%s", candidates[i]);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// The host root's subtree_control is not ours to change: only report which
+// controllers the experiment groups will not get
+static void check_root_controllers(void) {
+    static const char *ctrls[] = { "cpu", "memory", "cpuset" };
+    char buf[512];
+    int fd = open_ro(cg_root, "cgroup.subtree_control");
+    if (read_fd(fd, buf, sizeof(buf)) < 0) buf[0] = '\0';
+    if (fd >= 0) close(fd);
+    for (size_t i = 0; i < sizeof(ctrls) / sizeof(ctrls[0]); i++) {
+        size_t len = strlen(ctrls[i]);
+        const char *p = buf;
+        while ((p = strstr(p, ctrls[i])) && ((p > buf && p[-1] != ' ') || (p[len] && p[len] != ' ' && p[len] != '\n')))
+            p += len;
+        if (!p)
+            fprintf(stderr, "warning: %s/cgroup.subtree_control lacks %s; enable it there to use %s.* files\n",
+                    cg_root, ctrls[i], ctrls[i]);
+    }
+}
+
+// Enable controllers for children of dir; missing ones are reported, not fatal
+static void enable_controllers(const char *dir) {
+    static const char *ctrls[] = { "+cpu", "+memory", "+cpuset" };
+    for (size_t i = 0; i < sizeof(ctrls) / sizeof(ctrls[0]); i++) {
+        int err = write_file(dir, "cgroup.subtree_control", ctrls[i]);
+        if (err < 0)
+            fprintf(stderr, "warning: %s/cgroup.subtree_control %s: %s\n", dir, ctrls[i], strerror(-err));
+    }
+}
+
+static int setup_group(struct group *g) {
+    snprintf(g->path, sizeof(g->path), "%s/%.63s", parent_path, g->name);
+    if (mkdir(g->path, 0755) < 0 && errno != EEXIST) {
+        fprintf(stderr, "mkdir %s: %s\n", g->path, strerror(errno));
+        return -1;
+    }
+    for (int i = 0; i < g->nsettings; i++) {
+        int err = write_file(g->path, g->settings[i].key, g->settings[i].value);
+        if (err < 0) {
+            fprintf(stderr, "%s/%s <- '%s': %s\n", g->path, g->settings[i].key,
+                    g->settings[i].value, strerror(-err));
+            return -1;
+        }
+    }
+
+    g->fd_cpu_stat = open_ro(g->path, "cpu.stat");
+    g->fd_mem_current = open_ro(g->path, "memory.current");
+    g->fd_mem_stat = open_ro(g->path, "memory.stat");
+    g->fd_mem_events = open_ro(g->path, "memory.events");
+    g->fd_cpu_psi = open_ro(g->path, "cpu.pressure");
+    g->fd_mem_psi = open_ro(g->path, "memory.pressure");
+    if (g->fd_mem_current < 0)
+        fprintf(stderr, "warning: group %s: memory controller unavailable, memory columns are 0\n", g->name);
+    if (g->fd_cpu_psi < 0)
+        fprintf(stderr, "warning: group %s: no PSI (boot with psi=1), pressure columns are 0\n", g->name);
+    return 0;
+}
+
+// Kill whatever is left in the group: grandchildren of --run commands do not
+// exit with them and would keep the group busy (rmdir -> EBUSY).
+// cgroup.kill needs 5.14+; before that, SIGKILL every pid in cgroup.procs
+static void kill_group(const struct group *g) {
+    if (!g->path[0]) return;
+    int fd = open_ro(g->path, "cgroup.events");
+    if (write_file(g->path, "cgroup.kill", "1") < 0) {
+        char buf[4096];
+        for (int pass = 0; pass < 10; pass++) {
+            int pfd = open_ro(g->path, "cgroup.procs");
+            int ok = read_fd(pfd, buf, sizeof(buf));
+            if (pfd >= 0) close(pfd);
+            if (ok < 0 || !buf[0]) break;
+            for (char *p = buf; *p; p = strchr(p, '\n') ? strchr(p, '\n') + 1 : p + strlen(p))
+                kill((pid_t)atoi(p), SIGKILL);
+            usleep(10000);
+        }
+    }
+    // The group empties asynchronously: wait for "populated 0" (up to 1 s)
+    char ev[256];
+    for (int i = 0; i < 100 && read_fd(fd, ev, sizeof(ev)) == 0 && kv_get(ev, "populated"); i++)
+        usleep(10000);
+    if (fd >= 0) close(fd);
+}
+
+static void teardown_group(struct group *g) {
+    int *fds[] = { &g->fd_cpu_stat, &g->fd_mem_current, &g->fd_mem_stat,
+                   &g->fd_mem_events, &g->fd_cpu_psi, &g->fd_mem_psi };
+    for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); i++) {
+        if (*fds[i] >= 0) close(*fds[i]);
+        *fds[i] = -1;
+    }
+}
+
+/* ---------- parsing ---------- */
+
+static int find_group(const char *name, size_t len) {
+    for (int i = 0; i < ngroups; i++)
+        if (strlen(groups[i].name) == len && !strncmp(groups[i].name, name, len))
+            return i;
+    return -1;
+}
+
+static int parse_group(const char *spec) {
+    if (ngroups == MAX_GROUPS) return -1;
+    struct group *g = &groups[ngroups];
+    memset(g, 0, sizeof(*g));
+    char *copy = strdup(spec);
+    if (!copy) return -1;
+    char *save = NULL;
+    char *tok = strtok_r(copy, ":", &save);
+    if (!tok || !*tok || strchr(tok, '/') || find_group(tok, strlen(tok)) >= 0) {
+        free(copy);
+        return -1;
+    }
+    snprintf(g->name, sizeof(g->name), "%s", tok);
+    while ((tok = strtok_r(NULL, ":", &save))) {
+        char *eq = strchr(tok, '=');
+        if (!eq || g->nsettings == MAX_SETTINGS) {
+            free(copy);
+            return -1;
+        }
+        *eq = '\0';
+        struct setting *s = &g->settings[g->nsettings++];
+        snprintf(s->key, sizeof(s->key), "%s", tok);
+        snprintf(s->value, sizeof(s->value), "%s", eq + 1);
+        for (char *p = s->value; *p; p++)
+            if (*p == '/') *p = ' ';    // cpu.max=QUOTA/PERIOD
+    }
+    free(copy);
+    ngroups++;
+    return 0;
+}
+
+static int parse_run(const char *spec) {
+    const char *colon = strchr(spec, ':');
+    if (!colon || nruns == MAX_RUNS) return -1;
+    int gi = find_group(spec, (size_t)(colon - spec));
+    if (gi < 0) return -1;
+    struct run *r = &runs[nruns];
+    memset(r, 0, sizeof(*r));
+    r->group = gi;
+    char *cmd = strdup(colon + 1);
+    if (!cmd) return -1;
+    int argc = 0;
+    char *save = NULL;
+    for (char *tok = strtok_r(cmd, " \t", &save); tok && argc < MAX_ARGS;
+         tok = strtok_r(NULL, " \t", &save))
+        r->argv[argc++] = tok;
+    if (argc == 0) return -1;
+    nruns++;
+    return 0;
+}
+
+/* ---------- launching ---------- */
+
+static int launch(struct run *r) {
+    const struct group *g = &groups[r->group];
+    int pfd[2];
+    if (pipe2(pfd, O_CLOEXEC) < 0) return -1;
+
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        // Move self into the group before exec: the command never runs outside it
+        int err = write_file(g->path, "cgroup.procs", "0");
+        if (!child_output) {
+            // stdout is the CSV; the generators' own chatter would interleave with it
+            int devnull = open("/dev/null", O_WRONLY);
+            if (devnull >= 0) dup2(devnull, STDOUT_FILENO);
+        }
+        if (err == 0) {
+            execvp(r->argv[0], r->argv);
+            err = -errno;
+        }
+        ssize_t n = write(pfd[1], &err, sizeof(err));
+        (void)n;
+        _exit(127);
+    }
+    close(pfd[1]);
+    int err = 0;
+    ssize_t n = read(pfd[0], &err, sizeof(err));
+    close(pfd[0]);
+    if (n == sizeof(err)) {
+        fprintf(stderr, "%s in group %s: %s\n", r->argv[0], g->name, strerror(-err));
+        waitpid(pid, NULL, 0);
+        return -1;
+    }
+    r->pid = pid;
+    fprintf(stderr, "started pid=%d in %s: %s\n", pid, g->name, r->argv[0]);
+    return 0;
+}
+
+static int reap(void) {
+    int alive = 0;
+    for (int i = 0; i < nruns; i++) {
+        struct run *r = &runs[i];
+        if (r->done || r->pid <= 0) continue;
+        if (waitpid(r->pid, &r->status, WNOHANG) == r->pid)
+            r->done = 1;
+        else
+            alive++;
+    }
+    return alive;
+}
+
+/* ---------- sampling ---------- */
+
+static void read_sample(struct group *g, struct sample *s) {
+    char buf[8192];
+    memset(s, 0, sizeof(*s));
+    if (read_fd(g->fd_cpu_stat, buf, sizeof(buf)) == 0) {
+        s->usage_usec = kv_get(buf, "usage_usec");
+        s->throttled_usec = kv_get(buf, "throttled_usec");
+        s->nr_throttled = kv_get(buf, "nr_throttled");
+    }
+    if (read_fd(g->fd_mem_current, buf, sizeof(buf)) == 0)
+        s->mem_current = strtoull(buf, NULL, 10);
+    if (read_fd(g->fd_mem_stat, buf, sizeof(buf)) == 0) {
+        s->anon = kv_get(buf, "anon");
+        s->file = kv_get(buf, "file");
+        s->pgmajfault = kv_get(buf, "pgmajfault");
+    }
+    if (read_fd(g->fd_mem_events, buf, sizeof(buf)) == 0) {
+        s->ev_high = kv_get(buf, "high");
+        s->ev_max = kv_get(buf, "max");
+        s->ev_oom_kill = kv_get(buf, "oom_kill");
+    }
+    if (read_fd(g->fd_cpu_psi, buf, sizeof(buf)) == 0) {
+        s->cpu_some = psi_total(buf, "some");
+        s->cpu_full = psi_total(buf, "full");
+    }
+    if (read_fd(g->fd_mem_psi, buf, sizeof(buf)) == 0) {
+        s->mem_some = psi_total(buf, "some");
+        s->mem_full = psi_total(buf, "full");
+    }
+}
+
+static double pct(uint64_t cur, uint64_t prev, double dt_usec) {
+    return cur >= prev && dt_usec > 0 ? 100.0 * (double)(cur - prev) / dt_usec : 0.0;
+}
+
+static void print_header(void) {
+    printf("t_s,group,cpu_pct,throttled_pct,nr_throttled,mem_current,anon,file,pgmajfault,"
+           "high_events,max_events,oom_kill,cpu_some_pct,cpu_full_pct,mem_some_pct,mem_full_pct\n");
+}
+
+// PSI totals are cumulative stall time, so their delta over the tick is the
+// exact pressure of that tick, unlike avg10 which lags by seconds.
+static void sample_all(double t_s, double dt_usec) {
+    for (int i = 0; i < ngroups; i++) {
+        struct group *g = &groups[i];
+        struct sample s;
+        read_sample(g, &s);
+        if (g->have_prev) {
+            const struct sample *p = &g->prev;
+            double cpu = pct(s.usage_usec, p->usage_usec, dt_usec);
+            double thr = pct(s.throttled_usec, p->throttled_usec, dt_usec);
+            double cs = pct(s.cpu_some, p->cpu_some, dt_usec);
+            double cf = pct(s.cpu_full, p->cpu_full, dt_usec);
+            double ms = pct(s.mem_some, p->mem_some, dt_usec);
+            double mf = pct(s.mem_full, p->mem_full, dt_usec);
+            printf("%.3f,%s,%.1f,%.1f,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%.2f,%.2f,%.2f,%.2f\n",
+                   t_s, g->name, cpu, thr, (unsigned long long)s.nr_throttled,
+                   (unsigned long long)s.mem_current, (unsigned long long)s.anon,
+                   (unsigned long long)s.file, (unsigned long long)s.pgmajfault,
+                   (unsigned long long)s.ev_high, (unsigned long long)s.ev_max,
+                   (unsigned long long)s.ev_oom_kill, cs, cf, ms, mf);
+            g->nsamples++;
+            g->sum_cpu_pct += cpu;
+            g->sum_thr_pct += thr;
+            g->sum_cpu_some += cs;
+            g->sum_mem_some += ms;
+            g->sum_mem_full += mf;
+        }
+        if (s.mem_current > g->max_mem) g->max_mem = s.mem_current;
+        g->prev = s;
+        g->have_prev = 1;
+    }
+    fflush(stdout);
+}
+
+static void print_summary(void) {
+    fprintf(stderr, "\n%-12s %8s %8s %10s %12s %10s %10s %10s %8s\n", "group", "samples",
+            "cpu_%", "thrott_%", "max_mem_MB", "cpu_some%", "mem_some%", "mem_full%", "oom_kill");
+    for (int i = 0; i < ngroups; i++) {
+        const struct group *g = &groups[i];
+        double n = g->nsamples ? g->nsamples : 1;
+        fprintf(stderr, "%-12s %8d %8.1f %10.1f %12.1f %10.2f %10.2f %10.2f %8llu\n", g->name,
+                g->nsamples, g->sum_cpu_pct / n, g->sum_thr_pct / n, g->max_mem / 1048576.0,
+                g->sum_cpu_some / n, g->sum_mem_some / n, g->sum_mem_full / n,
+                (unsigned long long)g->prev.ev_oom_kill);
+    }
+}
+
+static double mono_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    long interval_ms = 100;
+    int duration_sec = 0; // 0 = until all commands exit
+    int keep = 0;
+
+    static struct option opts[] = {
+        {"group", required_argument, 0, 'g'},
+        {"run", required_argument, 0, 'r'},
+        {"interval-ms", required_argument, 0, 'i'},
+        {"duration", required_argument, 0, 'd'},
+        {"root", required_argument, 0, 'R'},
+        {"keep", no_argument, 0, 'k'},
+        {"child-output", no_argument, 0, 'o'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "", opts, NULL)) != -1) {
+        switch (c) {
+            case 'g':
+                if (parse_group(optarg) < 0) {
+                    fprintf(stderr, "bad --group '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'r':
+                if (parse_run(optarg) < 0) {
+                    fprintf(stderr, "bad --run '%s' (group must be defined first)\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'i': interval_ms = atol(optarg); break;
+            case 'd': duration_sec = atoi(optarg); break;
+            case 'R': snprintf(cg_root, sizeof(cg_root), "%s", optarg); break;
+            case 'k': keep = 1; break;
+            case 'o': child_output = 1; break;
+            default: print_usage(argv[0]); return 1;
+        }
+    }
+    if (ngroups == 0 || nruns == 0 || interval_ms <= 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (detect_root() < 0) {
+        fprintf(stderr, "cgroup v2 hierarchy not found (no cgroup.controllers under %s)\n",
+                cg_root[0] ? cg_root : "/sys/fs/cgroup");
+        return 1;
+    }
+
+    struct sigaction sa = {0};
+    sa.sa_handler = handle_sigterm;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+
+    // Parent group owns the experiment; leaves hold the processes
+    // ("no internal processes" rule of cgroup v2)
+    snprintf(parent_path, sizeof(parent_path), "%s/lab2.%d", cg_root, getpid());
+    if (mkdir(parent_path, 0755) < 0) {
+        fprintf(stderr, "mkdir %s: %s (run as root or delegate a subtree)\n", parent_path, strerror(errno));
+        return 1;
+    }
+    check_root_controllers();
+    enable_controllers(parent_path);
+
+    int rc = 0;
+    for (int i = 0; i < ngroups; i++) {
+        groups[i].fd_cpu_stat = groups[i].fd_mem_current = groups[i].fd_mem_stat = -1;
+        groups[i].fd_mem_events = groups[i].fd_cpu_psi = groups[i].fd_mem_psi = -1;
+    }
+    for (int i = 0; i < ngroups && rc == 0; i++)
+        if (setup_group(&groups[i]) < 0) rc = 1;
+
+    if (rc == 0) {
+        print_header();
+        double t0 = mono_s();
+        for (int i = 0; i < nruns && rc == 0; i++)
+            if (launch(&runs[i]) < 0) rc = 1;
+
+        double last = mono_s();
+        sample_all(last - t0, 0);   // baseline only, no row
+
+        struct timespec next;
+        clock_gettime(CLOCK_MONOTONIC, &next);
+        while (!stop_requested && rc == 0) {
+            next.tv_nsec += (interval_ms % 1000) * 1000000L;
+            next.tv_sec += interval_ms / 1000 + next.tv_nsec / 1000000000L;
+            next.tv_nsec %= 1000000000L;
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR && !stop_requested) {}
+
+            double now = mono_s();
+            sample_all(now - t0, (now - last) * 1e6);
+            last = now;
+
+            if (reap() == 0) break;
+            if (duration_sec > 0 && now - t0 >= duration_sec) break;
+        }
+    }
+
+    // Stop what is still running, then remove the groups
+    for (int i = 0; i < nruns; i++)
+        if (runs[i].pid > 0 && !runs[i].done) kill(runs[i].pid, SIGTERM);
+    for (int i = 0; i < nruns; i++)
+        if (runs[i].pid > 0 && !runs[i].done) {
+            waitpid(runs[i].pid, &runs[i].status, 0);
+            runs[i].done = 1;
+        }
+
+    print_summary();
+    for (int i = 0; i < ngroups; i++) {
+        kill_group(&groups[i]);
+        teardown_group(&groups[i]);
+    }
+    if (!keep) {
+        for (int i = 0; i < ngroups; i++)
+            if (groups[i].path[0] && rmdir(groups[i].path) < 0 && errno != ENOENT)
+                fprintf(stderr, "rmdir %s: %s\n", groups[i].path, strerror(errno));
+        if (rmdir(parent_path) < 0)
+            fprintf(stderr, "rmdir %s: %s\n", parent_path, strerror(errno));
+    } else {
+        fprintf(stderr, "groups kept under %s\n", parent_path);
+    }
+    return rc;
+}
@@ -9,6 +9,9 @@
 #include <time.h>
 #include <unistd.h>
 
+#include "metrics_shm.h"
+#include "perf_group.h"
+
 static volatile sig_atomic_t mode_heavy = 1;     // 1=heavy, 0=light
 static volatile sig_atomic_t stop_requested = 0; // graceful stop
 
@@ -62,14 +65,61 @@ static void set_affinity_optional(int cpu) {
 }
 #endif
 
+static long long elapsed_ns(const struct timespec *a, const struct timespec *b) {
+    return (long long)(b->tv_sec - a->tv_sec) * 1000000000LL + (b->tv_nsec - a->tv_nsec);
+}
+
 static void print_usage(const char *prog) {
     fprintf(stderr,
-            "Usage: %s [--work-us N] [--sleep-us N] [--light-work-us N] [--light-sleep-us N]\\n"
-            "          [--duration SEC] [--cpu CPU]\\n"
-            "Signals: SIGUSR1 -> light, SIGUSR2 -> heavy, SIGTERM/SIGINT -> stop\\n",
+            "Usage: %s [--work-us N] [--sleep-us N] [--light-work-us N] [--light-sleep-us N]\n"
+            "          [--duration SEC] [--cpu CPU] [--perf] [--perf-ms N] [--metrics] [--quiet]\n"
+            "  --metrics  publish counters in /dev/shm/cpu_burn.<pid> (read with ./metrics_dump)\n"
+            "  --quiet    no tick lines on stdout\n"
+            "Signals: SIGUSR1 -> light, SIGUSR2 -> heavy, SIGTERM/SIGINT -> stop\n",
             prog);
 }
 
+// Shared-memory metrics (--metrics). All pointers stay NULL without the flag
+struct burn_metrics {
+    struct metrics *m;
+    _Atomic uint64_t *cycles[2];    // [0]=light, [1]=heavy
+    _Atomic uint64_t *busy_ns[2];
+    _Atomic uint64_t *switches;
+    _Atomic int64_t *mode;
+    struct metric_hist *work_ns, *cycle_ns;
+    _Atomic uint64_t *perf[PERF_EV_COUNT];
+};
+
+static void burn_metrics_open(struct burn_metrics *bm, const struct perf_group *pg) {
+    static const char *const ev_names[PERF_EV_COUNT] = {
+        "cycles", "instructions", "cache_misses", "branch_misses", "page_faults", "context_switches"};
+    bm->m = metrics_open("cpu_burn");
+    if (!bm->m) {
+        perror("metrics_open");
+        return;
+    }
+    for (int h = 0; h < 2; h++) {
+        const char *mode = h ? "heavy" : "light";
+        char name[METRICS_NAME];
+        snprintf(name, sizeof(name), "cpu_burn_cycles_total{mode=\"%s\"}", mode);
+        bm->cycles[h] = metrics_counter(bm->m, name, "Work+sleep cycles completed");
+        snprintf(name, sizeof(name), "cpu_burn_busy_ns_total{mode=\"%s\"}", mode);
+        bm->busy_ns[h] = metrics_counter(bm->m, name, "Wall time spent in busy_work");
+    }
+    bm->switches = metrics_counter(bm->m, "cpu_burn_mode_switches_total", "Heavy<->light switches (SIGUSR1/SIGUSR2)");
+    bm->mode = metrics_gauge(bm->m, "cpu_burn_mode_heavy", "1 = heavy, 0 = light");
+    bm->work_ns = metrics_histogram(bm->m, "cpu_burn_work_ns", "Wall time of one busy_work call");
+    bm->cycle_ns = metrics_histogram(bm->m, "cpu_burn_cycle_ns", "Wall time of one work+sleep cycle");
+    // Raw counts, not scaled for multiplexing: rates are what matters here
+    for (int e = 0; pg && e < PERF_EV_COUNT; e++) {
+        if (pg->fd[e] < 0) continue;
+        char name[METRICS_NAME];
+        snprintf(name, sizeof(name), "cpu_burn_perf_events_total{event=\"%s\"}", ev_names[e]);
+        bm->perf[e] = metrics_counter(bm->m, name, "perf_event_open counters of the main thread");
+    }
+    fprintf(stderr, "cpu_burn: metrics in /dev/shm%s\n", metrics_name(bm->m));
+}
+
 int main(int argc, char **argv) {
     long work_us_heavy = 9000;
     long sleep_us_heavy = 1000;
@@ -77,6 +127,10 @@ int main(int argc, char **argv) {
     long sleep_us_light = 8000;
     int duration_sec = 0; // 0 = infinite
     int pin_cpu = -1;     // -1 = no pin
+    int use_perf = 0;
+    long perf_ms = 1000;  // perf report interval
+    int use_metrics = 0;
+    int quiet = 0;
 
     static struct option opts[] = {
         {"work-us", required_argument, 0, 'w'},
@@ -85,6 +139,10 @@ int main(int argc, char **argv) {
         {"light-sleep-us", required_argument, 0, 'S'},
         {"duration", required_argument, 0, 'd'},
         {"cpu", required_argument, 0, 'c'},
+        {"perf", no_argument, 0, 'p'},
+        {"perf-ms", required_argument, 0, 'P'},
+        {"metrics", no_argument, 0, 'M'},
+        {"quiet", no_argument, 0, 'q'},
         {0, 0, 0, 0}
     };
 
@@ -97,6 +155,10 @@ int main(int argc, char **argv) {
             case 'S': sleep_us_light = atol(optarg); break;
             case 'd': duration_sec = atoi(optarg); break;
             case 'c': pin_cpu = atoi(optarg); break;
+            case 'p': use_perf = 1; break;
+            case 'P': perf_ms = atol(optarg); break;
+            case 'M': use_metrics = 1; break;
+            case 'q': quiet = 1; break;
             default: print_usage(argv[0]); return 1;
         }
     }
@@ -124,22 +186,93 @@ int main(int argc, char **argv) {
             getpid(), pin_cpu, work_us_heavy, sleep_us_heavy, work_us_light, sleep_us_light);
     fflush(stdout);
 
+    // Counters are read after every work+sleep cycle and charged to the mode the
+    // cycle ran in. An interval line is printed every perf_ms or on mode switch.
+    struct perf_group pg;
+    struct perf_sample last, cur, delta, interval, phase[2];
+    char pbuf[512];
+    int perf_ok = 0, interval_mode = mode_heavy;
+    struct timespec interval_start;
+    memset(&interval, 0, sizeof(interval));
+    memset(phase, 0, sizeof(phase));
+    if (use_perf) {
+        int err = perf_group_open(&pg);
+        perf_group_describe(&pg, err, "cpu_burn");
+        perf_ok = err == 0 && perf_group_read(&pg, &last) == 0;
+        clock_gettime(CLOCK_MONOTONIC, &interval_start);
+    }
+
+    // The main loop is the only writer, so counters use metric_add_owner
+    struct burn_metrics bm;
+    memset(&bm, 0, sizeof(bm));
+    if (use_metrics) burn_metrics_open(&bm, perf_ok ? &pg : NULL);
+    int prev_heavy = mode_heavy;
+    metric_set(bm.mode, prev_heavy);
+
     time_t t0 = time(NULL);
     while (!stop_requested) {
         int heavy = mode_heavy;
         long w = heavy ? work_us_heavy : work_us_light;
         long s = heavy ? sleep_us_heavy : sleep_us_light;
+        struct timespec c0, c1, c2;
 
+        if (heavy != prev_heavy) {
+            metric_add_owner(bm.switches, 1);
+            metric_set(bm.mode, heavy);
+            prev_heavy = heavy;
+        }
+        if (bm.m) clock_gettime(CLOCK_MONOTONIC, &c0);
         busy_work((uint64_t)w * 400); // калибровка условная
+        if (bm.m) clock_gettime(CLOCK_MONOTONIC, &c1);
         nanosleep_us(s);
+        if (bm.m) {
+            clock_gettime(CLOCK_MONOTONIC, &c2);
+            metric_add_owner(bm.cycles[heavy], 1);
+            metric_add_owner(bm.busy_ns[heavy], (uint64_t)elapsed_ns(&c0, &c1));
+            metric_observe(bm.work_ns, (uint64_t)elapsed_ns(&c0, &c1));
+            metric_observe(bm.cycle_ns, (uint64_t)elapsed_ns(&c0, &c2));
+        }
+
+        if (perf_ok && perf_group_read(&pg, &cur) == 0) {
+            perf_sample_sub(&delta, &cur, &last);
+            last = cur;
+            for (int e = 0; e < PERF_EV_COUNT; e++) metric_add_owner(bm.perf[e], delta.value[e]);
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            long elapsed_ms = (now.tv_sec - interval_start.tv_sec) * 1000 +
+                              (now.tv_nsec - interval_start.tv_nsec) / 1000000;
+            if (heavy != interval_mode || elapsed_ms >= perf_ms) {
+                if (interval.time_enabled) {
+                    fprintf(stdout, "perf pid=%d mode=%s interval_ms=%ld %s\n", getpid(),
+                            interval_mode ? "heavy" : "light", elapsed_ms,
+                            perf_sample_format(pbuf, sizeof(pbuf), &pg, &interval));
+                    fflush(stdout);
+                }
+                memset(&interval, 0, sizeof(interval));
+                interval_mode = heavy;
+                interval_start = now;
+            }
+            perf_sample_add(&interval, &delta);
+            perf_sample_add(&phase[heavy ? 1 : 0], &delta);
+        }
 
         if (duration_sec > 0 && (time(NULL) - t0) >= duration_sec) break;
-        if ((time(NULL) % 2) == 0) {
+        if (!quiet && (time(NULL) % 2) == 0) {
             fprintf(stdout, "tick pid=%d mode=%s\n", getpid(), heavy ? "heavy" : "light");
             fflush(stdout);
         }
     }
 
+    if (perf_ok) {
+        for (int m = 1; m >= 0; m--) {
+            if (!phase[m].time_enabled) continue;
+            fprintf(stdout, "perf pid=%d phase=%s total %s\n", getpid(), m ? "heavy" : "light",
+                    perf_sample_format(pbuf, sizeof(pbuf), &pg, &phase[m]));
+        }
+    }
+    if (use_perf) perf_group_close(&pg);
+    metrics_close(bm.m);
+
     fprintf(stdout, "cpu_burn stop: pid=%d\n", getpid());
     fflush(stdout);
     return 0;
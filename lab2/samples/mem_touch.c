@@ -1,6 +1,8 @@
 #define _GNU_SOURCE
 #include <errno.h>
 #include <getopt.h>
+#include <math.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -10,6 +12,12 @@
 #include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h>     // malloc_trim
+#endif
+
+#include "metrics_shm.h"
+#include "perf_group.h"
 
 static volatile sig_atomic_t stop_requested = 0;
 static volatile sig_atomic_t add_step = 0;
@@ -19,11 +27,458 @@ static void handle_sigterm(int sig) { (void)sig; stop_requested = 1; }
 static void handle_sigusr1(int sig) { (void)sig; add_step = 1; }
 static void handle_sigusr2(int sig) { (void)sig; remove_step = 1; }
 
+static int quiet = 0;                   // --quiet: no periodic lines on stdout
+
 static void print_usage(const char *prog) {
     fprintf(stderr,
-            "Usage: %s [--rss-mb N] [--step-mb N] [--sleep-ms N] [--set-rlimit-as MB]\\n"
-            "Signals: SIGUSR1 -> allocate +step, SIGUSR2 -> free -step, SIGTERM -> stop\\n",
-            prog);
+            "Usage: %s [--rss-mb N] [--step-mb N] [--sleep-ms N] [--hot-mb N] [--set-rlimit-as MB] [--perf]\n"
+            "       %s --churn [--threads N] [--live-mb N] [--min-size B] [--max-size B] [--alpha A]\n"
+            "          [--sizes B:W,B:W,...] [--long-pct P] [--xfree-pct P] [--sample-every N]\n"
+            "          [--report-ms N] [--trim-ms N] [--duration SEC] [--perf]\n"
+            "--hot-mb N: rewrite the first N MB of the held blocks every iteration (known working set)\n"
+            "Both modes: --metrics publishes counters in /dev/shm/mem_touch.<pid> (read with\n"
+            "            ./metrics_dump), --quiet drops the periodic stdout lines\n"
+            "Signals: SIGUSR1 -> allocate +step, SIGUSR2 -> free -step, SIGTERM -> stop\n",
+            prog, prog);
+}
+
+/* ---------- churn mode: allocator stress ---------- */
+
+// Fixed-size blocks in LIFO order are easy for any allocator. Churn mode
+// allocates from a size distribution (power law or explicit table), keeps
+// objects for mixed lifetimes (short FIFO window + long-lived table with
+// random replacement) and hands a share of frees to other threads. The
+// report shows allocs/s, sampled malloc/free latency, RSS vs live bytes
+// (fragmentation) and what malloc_trim gives back. Run the same binary
+// with LD_PRELOAD=libjemalloc.so / libtcmalloc.so to compare allocators.
+
+#define CHURN_MAX_THREADS 64
+#define SHORT_WINDOW      64
+#define SUB_BITS          3                                  // 8 buckets per power of two
+#define NBUCKETS          ((40 - SUB_BITS + 2) << SUB_BITS)
+#define MAX_SIZES         32
+
+struct churn_opts {
+    int threads;
+    long live_mb;
+    size_t min_size, max_size;
+    double alpha;
+    size_t sizes[MAX_SIZES];
+    double size_cdf[MAX_SIZES];
+    int nsizes;
+    int long_pct, xfree_pct;
+    int sample_every;
+    long report_ms, trim_ms;
+    int duration_sec;
+    int perf;
+};
+
+struct churn_thread {
+    pthread_t thread;
+    int idx;
+    uint64_t rng;
+    void **table;               // long-lived objects
+    size_t table_len;
+    void *ring[SHORT_WINDOW];   // short-lived objects, freed SHORT_WINDOW allocs later
+    size_t ring_pos;
+    void *inbox;                // objects freed here on behalf of other threads (Treiber stack)
+    struct perf_group pg;       // counts this thread; read by the reporter
+    int perf_ok;
+    // Written by the owner only, read by the reporter
+    _Alignas(64) uint64_t allocs, frees;
+    int64_t live_bytes;
+    uint64_t malloc_hist[NBUCKETS], free_hist[NBUCKETS];
+};
+
+static struct churn_opts copts;
+static struct churn_thread *cthreads;
+
+// Shared-memory metrics (--metrics); every pointer stays NULL without the flag
+static struct metrics *mt;
+static struct {
+    _Atomic int64_t *target, *allocated, *blocks, *rss, *live;
+    _Atomic uint64_t *steps_add, *steps_remove, *allocs, *frees, *trim_released;
+    struct metric_hist *touch_ns, *malloc_ns, *free_ns;
+} mtm;
+
+static void metrics_start(int churn) {
+    mt = metrics_open("mem_touch");
+    if (!mt) {
+        perror("metrics_open");
+        return;
+    }
+    mtm.rss = metrics_gauge(mt, "mem_touch_rss_bytes", "Resident set size");
+    if (churn) {
+        // Totals are aggregated by the reporter thread every --report-ms;
+        // latencies are observed by the workers as they are sampled
+        mtm.live = metrics_gauge(mt, "mem_touch_live_bytes", "Bytes requested and not yet freed");
+        mtm.allocs = metrics_counter(mt, "mem_touch_allocs_total", "malloc calls");
+        mtm.frees = metrics_counter(mt, "mem_touch_frees_total", "free calls");
+        mtm.trim_released = metrics_counter(mt, "mem_touch_trim_released_bytes_total",
+                                            "RSS given back by malloc_trim");
+        mtm.malloc_ns = metrics_histogram(mt, "mem_touch_malloc_ns", "Sampled malloc latency (--sample-every)");
+        mtm.free_ns = metrics_histogram(mt, "mem_touch_free_ns", "Sampled free latency (--sample-every)");
+    } else {
+        mtm.target = metrics_gauge(mt, "mem_touch_target_bytes", "--rss-mb");
+        mtm.allocated = metrics_gauge(mt, "mem_touch_allocated_bytes", "Bytes held in touched blocks");
+        mtm.blocks = metrics_gauge(mt, "mem_touch_blocks", "Blocks held");
+        mtm.steps_add = metrics_counter(mt, "mem_touch_steps_total{dir=\"add\"}", "Blocks allocated or freed");
+        mtm.steps_remove = metrics_counter(mt, "mem_touch_steps_total{dir=\"remove\"}", "Blocks allocated or freed");
+        mtm.touch_ns = metrics_histogram(mt, "mem_touch_alloc_touch_ns", "malloc + memset of one block (page faults)");
+    }
+    fprintf(stderr, "mem_touch: metrics in /dev/shm%s\n", metrics_name(mt));
+}
+
+static uint64_t xorshift(uint64_t *s) {
+    uint64_t x = *s;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *s = x;
+}
+
+static double rand01(uint64_t *s) { return (xorshift(s) >> 11) * (1.0 / 9007199254740992.0); }
+
+static size_t draw_size(uint64_t *rng) {
+    double u = rand01(rng);
+    if (copts.nsizes > 0) {
+        for (int i = 0; i < copts.nsizes; i++)
+            if (u <= copts.size_cdf[i]) return copts.sizes[i];
+        return copts.sizes[copts.nsizes - 1];
+    }
+    // Truncated power law p(s) ~ s^-alpha on [min, max], inverse CDF
+    double lo = (double)copts.min_size, hi = (double)copts.max_size, a = copts.alpha;
+    double s;
+    if (fabs(a - 1.0) < 1e-9) {
+        s = lo * pow(hi / lo, u);
+    } else {
+        double e = 1.0 - a;
+        s = pow(pow(lo, e) + u * (pow(hi, e) - pow(lo, e)), 1.0 / e);
+    }
+    return (size_t)s;
+}
+
+static unsigned bucket_of(uint64_t v) {
+    if (v < (1u << SUB_BITS)) return (unsigned)v;
+    unsigned msb = 63 - (unsigned)__builtin_clzll(v);
+    if (msb > 40) return NBUCKETS - 1;
+    return ((msb - SUB_BITS + 1) << SUB_BITS) | (unsigned)((v >> (msb - SUB_BITS)) & ((1u << SUB_BITS) - 1));
+}
+
+static uint64_t bucket_upper(unsigned b) {
+    if (b < (1u << SUB_BITS)) return b;
+    unsigned msb = (b >> SUB_BITS) + SUB_BITS - 1;
+    uint64_t lo = (1ull << msb) | ((uint64_t)(b & ((1u << SUB_BITS) - 1)) << (msb - SUB_BITS));
+    return lo + (1ull << (msb - SUB_BITS)) - 1;
+}
+
+static uint64_t hist_pct(const uint64_t *h, double q) {
+    uint64_t total = 0, seen = 0;
+    for (int b = 0; b < NBUCKETS; b++) total += h[b];
+    if (total == 0) return 0;
+    uint64_t rank = (uint64_t)(q * (double)total);
+    if (rank == 0) rank = 1;
+    for (int b = 0; b < NBUCKETS; b++) {
+        seen += h[b];
+        if (seen >= rank) return bucket_upper((unsigned)b);
+    }
+    return 0;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void add_relaxed(uint64_t *p, uint64_t d) { __atomic_store_n(p, *p + d, __ATOMIC_RELAXED); }
+
+// Block header: [0] requested size, [1] inbox link
+static void *churn_alloc(struct churn_thread *t) {
+    size_t size = draw_size(&t->rng);
+    if (size < 2 * sizeof(uint64_t)) size = 2 * sizeof(uint64_t);
+    int timed = copts.sample_every > 0 && t->allocs % (uint64_t)copts.sample_every == 0;
+    uint64_t t0 = timed ? now_ns() : 0;
+    uint64_t *p = malloc(size);
+    if (timed) {
+        uint64_t d = now_ns() - t0;
+        add_relaxed(&t->malloc_hist[bucket_of(d)], 1);
+        metric_observe(mtm.malloc_ns, d);
+    }
+    if (!p) return NULL;
+    // Objects get written like real ones: small fully, large once per page
+    if (size <= 4096) memset(p, 0x5A, size);
+    else for (size_t off = 0; off < size; off += 4096) ((char *)p)[off] = 0x5A;
+    p[0] = size;
+    add_relaxed(&t->allocs, 1);
+    __atomic_store_n(&t->live_bytes, t->live_bytes + (int64_t)size, __ATOMIC_RELAXED);
+    return p;
+}
+
+static void churn_free_local(struct churn_thread *t, void *obj) {
+    uint64_t size = ((uint64_t *)obj)[0];
+    int timed = copts.sample_every > 0 && t->frees % (uint64_t)copts.sample_every == 0;
+    uint64_t t0 = timed ? now_ns() : 0;
+    free(obj);
+    if (timed) {
+        uint64_t d = now_ns() - t0;
+        add_relaxed(&t->free_hist[bucket_of(d)], 1);
+        metric_observe(mtm.free_ns, d);
+    }
+    add_relaxed(&t->frees, 1);
+    __atomic_store_n(&t->live_bytes, t->live_bytes - (int64_t)size, __ATOMIC_RELAXED);
+}
+
+static void churn_release(struct churn_thread *t, void *obj) {
+    if (!obj) return;
+    if (copts.threads > 1 && (int)(xorshift(&t->rng) % 100) < copts.xfree_pct) {
+        // Cross-thread free: push onto another thread's inbox
+        int other = (int)(xorshift(&t->rng) % (uint64_t)(copts.threads - 1));
+        if (other >= t->idx) other++;
+        struct churn_thread *o = &cthreads[other];
+        void **link = (void **)((uint64_t *)obj + 1);
+        void *head = __atomic_load_n(&o->inbox, __ATOMIC_RELAXED);
+        do {
+            *link = head;
+        } while (!__atomic_compare_exchange_n(&o->inbox, &head, obj, 1,
+                                              __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+        return;
+    }
+    churn_free_local(t, obj);
+}
+
+static void drain_inbox(struct churn_thread *t) {
+    void *obj = __atomic_exchange_n(&t->inbox, NULL, __ATOMIC_ACQUIRE);
+    while (obj) {
+        void *next = *(void **)((uint64_t *)obj + 1);
+        churn_free_local(t, obj);
+        obj = next;
+    }
+}
+
+static void *churn_worker(void *arg) {
+    struct churn_thread *t = arg;
+    uint64_t iter = 0;
+    if (copts.perf) {
+        int err = perf_group_open(&t->pg);
+        if (t->idx == 0) perf_group_describe(&t->pg, err, "mem_touch");
+        __atomic_store_n(&t->perf_ok, err == 0, __ATOMIC_RELEASE);
+    }
+    while (!stop_requested) {
+        void *obj = churn_alloc(t);
+        if (!obj) {
+            perror("malloc");
+            stop_requested = 1;
+            break;
+        }
+        if ((int)(xorshift(&t->rng) % 100) < copts.long_pct) {
+            // Long-lived: replaces a random resident, which dies now
+            size_t slot = xorshift(&t->rng) % t->table_len;
+            churn_release(t, t->table[slot]);
+            t->table[slot] = obj;
+        } else {
+            size_t slot = t->ring_pos++ % SHORT_WINDOW;
+            churn_release(t, t->ring[slot]);
+            t->ring[slot] = obj;
+        }
+        if ((++iter & 255) == 0) drain_inbox(t);
+    }
+    for (size_t i = 0; i < t->table_len; i++)
+        if (t->table[i]) churn_free_local(t, t->table[i]);
+    for (size_t i = 0; i < SHORT_WINDOW; i++)
+        if (t->ring[i]) churn_free_local(t, t->ring[i]);
+    return NULL;
+}
+
+static double rss_mb(void) {
+#ifdef __linux__
+    FILE *f = fopen("/proc/self/statm", "r");
+    unsigned long size = 0, resident = 0;
+    if (f) {
+        if (fscanf(f, "%lu %lu", &size, &resident) != 2) resident = 0;
+        fclose(f);
+    }
+    return resident * (double)sysconf(_SC_PAGESIZE) / 1048576.0;
+#else
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss / 1048576.0;    // macOS: peak, bytes
+#endif
+}
+
+struct churn_totals {
+    uint64_t allocs, frees;
+    int64_t live;
+    uint64_t mh[NBUCKETS], fh[NBUCKETS];
+    struct perf_sample perf;    // sum over threads
+    int perf_threads;
+    const struct perf_group *perf_ref;  // which events are present
+};
+
+static void churn_collect(struct churn_totals *tot) {
+    memset(tot, 0, sizeof(*tot));
+    for (int i = 0; i < copts.threads; i++) {
+        struct churn_thread *t = &cthreads[i];
+        tot->allocs += __atomic_load_n(&t->allocs, __ATOMIC_RELAXED);
+        tot->frees += __atomic_load_n(&t->frees, __ATOMIC_RELAXED);
+        tot->live += __atomic_load_n(&t->live_bytes, __ATOMIC_RELAXED);
+        for (int b = 0; b < NBUCKETS; b++) {
+            tot->mh[b] += __atomic_load_n(&t->malloc_hist[b], __ATOMIC_RELAXED);
+            tot->fh[b] += __atomic_load_n(&t->free_hist[b], __ATOMIC_RELAXED);
+        }
+        struct perf_sample ps;
+        if (__atomic_load_n(&t->perf_ok, __ATOMIC_ACQUIRE) && perf_group_read(&t->pg, &ps) == 0) {
+            perf_sample_add(&tot->perf, &ps);
+            if (tot->perf_threads++ == 0) tot->perf_ref = &t->pg;
+        }
+    }
+}
+
+static int parse_sizes(const char *spec) {
+    double total = 0;
+    char *copy = strdup(spec), *save = NULL;
+    if (!copy) return -1;
+    for (char *tok = strtok_r(copy, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        char *colon = strchr(tok, ':');
+        if (copts.nsizes == MAX_SIZES) { free(copy); return -1; }
+        copts.sizes[copts.nsizes] = (size_t)atol(tok);
+        double w = colon ? atof(colon + 1) : 1.0;
+        if (copts.sizes[copts.nsizes] == 0 || w <= 0) { free(copy); return -1; }
+        total += w;
+        copts.size_cdf[copts.nsizes++] = total;
+    }
+    free(copy);
+    for (int i = 0; i < copts.nsizes; i++) copts.size_cdf[i] /= total;
+    return copts.nsizes > 0 ? 0 : -1;
+}
+
+static int run_churn(void) {
+    if (copts.threads < 1 || copts.threads > CHURN_MAX_THREADS ||
+        copts.min_size == 0 || copts.max_size < copts.min_size) {
+        fprintf(stderr, "churn: bad options (threads 1..%d, 0 < min-size <= max-size)\n", CHURN_MAX_THREADS);
+        return 1;
+    }
+
+    // Mean object size of the distribution sets the long-lived table size
+    uint64_t rng = 0x9E3779B97F4A7C15ull;
+    double mean = 0;
+    for (int i = 0; i < 100000; i++) mean += (double)draw_size(&rng);
+    mean /= 100000;
+    size_t per_thread = (size_t)((double)copts.live_mb * 1048576.0 / mean / copts.threads);
+    if (per_thread < 1) per_thread = 1;
+
+    cthreads = aligned_alloc(64, ((sizeof(*cthreads) * (size_t)copts.threads) + 63) & ~(size_t)63);
+    if (!cthreads) return 1;
+    memset(cthreads, 0, sizeof(*cthreads) * (size_t)copts.threads);
+    for (int i = 0; i < copts.threads; i++) {
+        cthreads[i].idx = i;
+        cthreads[i].rng = 0x2545F4914F6CDD1Dull * (uint64_t)(i + 1);
+        cthreads[i].table_len = per_thread;
+        cthreads[i].table = calloc(per_thread, sizeof(void *));
+        if (!cthreads[i].table) return 1;
+    }
+
+    fprintf(stdout, "mem_touch churn start: pid=%d threads=%d live=%ldMB mean_size=%.0fB long=%d%% xfree=%d%%\n",
+            getpid(), copts.threads, copts.live_mb, mean, copts.long_pct, copts.xfree_pct);
+    fflush(stdout);
+
+    for (int i = 0; i < copts.threads; i++) {
+        if (pthread_create(&cthreads[i].thread, NULL, churn_worker, &cthreads[i]) != 0) {
+            perror("pthread_create");
+            stop_requested = 1;
+            copts.threads = i;
+            break;
+        }
+    }
+
+    static struct churn_totals prev, cur;
+    uint64_t t_start = now_ns(), t_prev = t_start, last_trim = t_start;
+    double peak_rss = 0;
+    while (!stop_requested) {
+        struct timespec ts = { .tv_sec = copts.report_ms / 1000, .tv_nsec = (copts.report_ms % 1000) * 1000000 };
+        while (nanosleep(&ts, &ts) == -1 && errno == EINTR && !stop_requested) {}
+        uint64_t now = now_ns();
+        churn_collect(&cur);
+
+        uint64_t mh[NBUCKETS], fh[NBUCKETS];
+        for (int b = 0; b < NBUCKETS; b++) {
+            mh[b] = cur.mh[b] - prev.mh[b];
+            fh[b] = cur.fh[b] - prev.fh[b];
+        }
+        double dt = (now - t_prev) / 1e9;
+        double rss = rss_mb();
+        double live = cur.live / 1048576.0;
+        if (rss > peak_rss) peak_rss = rss;
+        metric_store(mtm.allocs, cur.allocs);
+        metric_store(mtm.frees, cur.frees);
+        metric_set(mtm.live, cur.live);
+        metric_set(mtm.rss, (int64_t)(rss * 1048576.0));
+        if (!quiet) fprintf(stdout,
+                "churn t=%.1fs allocs/s=%.2fM live=%.1fMB rss=%.1fMB frag=%.2f "
+                "malloc_ns p50=%llu p99=%llu p999=%llu free_ns p50=%llu p99=%llu p999=%llu\n",
+                (now - t_start) / 1e9, (cur.allocs - prev.allocs) / dt / 1e6, live, rss,
+                live > 0 ? rss / live : 0.0,
+                (unsigned long long)hist_pct(mh, 0.50), (unsigned long long)hist_pct(mh, 0.99),
+                (unsigned long long)hist_pct(mh, 0.999), (unsigned long long)hist_pct(fh, 0.50),
+                (unsigned long long)hist_pct(fh, 0.99), (unsigned long long)hist_pct(fh, 0.999));
+        if (cur.perf_threads > 0 && !quiet) {     // groups start at zero, so a late opener adds nothing stale
+            struct perf_sample d;
+            char pbuf[512];
+            perf_sample_sub(&d, &cur.perf, &prev.perf);
+            fprintf(stdout, "perf t=%.1fs %s\n", (now - t_start) / 1e9,
+                    perf_sample_format(pbuf, sizeof(pbuf), cur.perf_ref, &d));
+        }
+        prev = cur;
+        t_prev = now;
+
+        if (copts.trim_ms > 0 && (now - last_trim) / 1000000 >= (uint64_t)copts.trim_ms) {
+#ifdef __GLIBC__
+            // With LD_PRELOAD'ed jemalloc/tcmalloc this trims glibc's unused arenas: ~0 effect
+            double before = rss_mb();
+            uint64_t t0 = now_ns();
+            malloc_trim(0);
+            double took = (now_ns() - t0) / 1e6;
+            double after = rss_mb();
+            if (after < before) metric_add_owner(mtm.trim_released, (uint64_t)((before - after) * 1048576.0));
+            fprintf(stdout, "trim t=%.1fs rss %.1fMB -> %.1fMB (%+.1fMB) in %.2fms\n",
+                    (now - t_start) / 1e9, before, after, after - before, took);
+#else
+            fprintf(stdout, "trim: malloc_trim not available on this libc\n");
+#endif
+            last_trim = now_ns();
+        }
+        fflush(stdout);
+
+        if (copts.duration_sec > 0 && now - t_start >= (uint64_t)copts.duration_sec * 1000000000ull) break;
+    }
+
+    stop_requested = 1;
+    for (int i = 0; i < copts.threads; i++) pthread_join(cthreads[i].thread, NULL);
+    for (int i = 0; i < copts.threads; i++) drain_inbox(&cthreads[i]);   // pushed after owner exited
+
+    churn_collect(&cur);     // exited threads' counters stay readable until close
+    double total_s = (now_ns() - t_start) / 1e9;
+    fprintf(stdout,
+            "mem_touch churn stop: pid=%d allocs=%llu avg_allocs/s=%.2fM peak_rss=%.1fMB "
+            "malloc_ns p50=%llu p99=%llu p999=%llu free_ns p50=%llu p99=%llu p999=%llu\n",
+            getpid(), (unsigned long long)cur.allocs, cur.allocs / total_s / 1e6, peak_rss,
+            (unsigned long long)hist_pct(cur.mh, 0.50), (unsigned long long)hist_pct(cur.mh, 0.99),
+            (unsigned long long)hist_pct(cur.mh, 0.999), (unsigned long long)hist_pct(cur.fh, 0.50),
+            (unsigned long long)hist_pct(cur.fh, 0.99), (unsigned long long)hist_pct(cur.fh, 0.999));
+    if (cur.perf_threads > 0) {
+        char pbuf[512];
+        fprintf(stdout, "perf total threads=%d %s\n", cur.perf_threads,
+                perf_sample_format(pbuf, sizeof(pbuf), cur.perf_ref, &cur.perf));
+    }
+    fflush(stdout);
+
+    for (int i = 0; i < copts.threads; i++) {
+        if (cthreads[i].perf_ok) perf_group_close(&cthreads[i].pg);
+        free(cthreads[i].table);
+    }
+    free(cthreads);
+    metrics_close(mt);
+    return 0;
 }
 
 static void *allocate_mb(size_t mb) {
@@ -53,12 +508,42 @@ int main(int argc, char **argv) {
     long step_mb = 64;
     long sleep_ms = 200;
     long rlimit_as_mb = 0; // 0=disabled
+    long hot_mb = 0;       // re-touched every iteration, the rest stays cold
+    int churn = 0;
+    int use_metrics = 0;
+
+    copts.threads = 4;
+    copts.live_mb = 256;
+    copts.min_size = 16;
+    copts.max_size = 256 * 1024;
+    copts.alpha = 1.5;
+    copts.long_pct = 10;
+    copts.xfree_pct = 20;
+    copts.sample_every = 64;
+    copts.report_ms = 1000;
 
     static struct option opts[] = {
         {"rss-mb", required_argument, 0, 'r'},
         {"step-mb", required_argument, 0, 's'},
         {"sleep-ms", required_argument, 0, 't'},
         {"set-rlimit-as", required_argument, 0, 'l'},
+        {"hot-mb", required_argument, 0, 'H'},
+        {"churn", no_argument, 0, 'C'},
+        {"threads", required_argument, 0, 'T'},
+        {"live-mb", required_argument, 0, 'L'},
+        {"min-size", required_argument, 0, 'm'},
+        {"max-size", required_argument, 0, 'M'},
+        {"alpha", required_argument, 0, 'a'},
+        {"sizes", required_argument, 0, 'z'},
+        {"long-pct", required_argument, 0, 'g'},
+        {"xfree-pct", required_argument, 0, 'x'},
+        {"sample-every", required_argument, 0, 'e'},
+        {"report-ms", required_argument, 0, 'p'},
+        {"trim-ms", required_argument, 0, 'k'},
+        {"duration", required_argument, 0, 'd'},
+        {"perf", no_argument, 0, 'P'},
+        {"metrics", no_argument, 0, 'E'},
+        {"quiet", no_argument, 0, 'q'},
         {0,0,0,0}
     };
 
@@ -69,6 +554,25 @@ int main(int argc, char **argv) {
             case 's': step_mb = atol(optarg); break;
             case 't': sleep_ms = atol(optarg); break;
             case 'l': rlimit_as_mb = atol(optarg); break;
+            case 'H': hot_mb = atol(optarg); break;
+            case 'C': churn = 1; break;
+            case 'T': copts.threads = atoi(optarg); break;
+            case 'L': copts.live_mb = atol(optarg); break;
+            case 'm': copts.min_size = (size_t)atol(optarg); break;
+            case 'M': copts.max_size = (size_t)atol(optarg); break;
+            case 'a': copts.alpha = atof(optarg); break;
+            case 'z':
+                if (parse_sizes(optarg) < 0) { print_usage(argv[0]); return 1; }
+                break;
+            case 'g': copts.long_pct = atoi(optarg); break;
+            case 'x': copts.xfree_pct = atoi(optarg); break;
+            case 'e': copts.sample_every = atoi(optarg); break;
+            case 'p': copts.report_ms = atol(optarg); break;
+            case 'k': copts.trim_ms = atol(optarg); break;
+            case 'd': copts.duration_sec = atoi(optarg); break;
+            case 'P': copts.perf = 1; break;
+            case 'E': use_metrics = 1; break;
+            case 'q': quiet = 1; break;
             default: print_usage(argv[0]); return 1;
         }
     }
@@ -90,6 +594,9 @@ int main(int argc, char **argv) {
     sigaction(SIGUSR2, &su2, NULL);
 
     maybe_set_rlimit_as(rlimit_as_mb);
+    if (use_metrics) metrics_start(churn);
+
+    if (churn) return run_churn();
 
     size_t capacity = (size_t)((target_mb + step_mb) / step_mb) + 8;
     void **blocks = calloc(capacity, sizeof(void*));
@@ -99,31 +606,76 @@ int main(int argc, char **argv) {
     fprintf(stdout, "mem_touch start: pid=%d target=%ldMB step=%ldMB sleep=%ldms\n",
             getpid(), target_mb, step_mb, sleep_ms);
     fflush(stdout);
+    metric_set(mtm.target, target_mb * 1048576L);
+
+    // Phases: "touch" — this iteration allocated (and memset) or freed a block,
+    // "idle" — it only slept. Counters are read once per iteration.
+    struct perf_group pg;
+    struct perf_sample last, cur, delta, phase[2];
+    char pbuf[512];
+    int perf_ok = 0;
+    memset(phase, 0, sizeof(phase));
+    if (copts.perf) {
+        int err = perf_group_open(&pg);
+        perf_group_describe(&pg, err, "mem_touch");
+        perf_ok = err == 0 && perf_group_read(&pg, &last) == 0;
+    }
 
     while (!stop_requested) {
+        size_t count_before = count;
         if (allocated_mb < target_mb && count < capacity) {
+            uint64_t t0 = now_ns();
             void *p = allocate_mb((size_t)step_mb);
             if (!p) {
                 perror("malloc");
                 break;
             }
+            metric_observe(mtm.touch_ns, now_ns() - t0);
+            metric_add_owner(mtm.steps_add, 1);
             blocks[count++] = p;
             allocated_mb += step_mb;
         }
 
         if (add_step && count < capacity) {
             add_step = 0;
+            uint64_t t0 = now_ns();
             void *p = allocate_mb((size_t)step_mb);
-            if (p) { blocks[count++] = p; allocated_mb += step_mb; }
+            if (p) {
+                metric_observe(mtm.touch_ns, now_ns() - t0);
+                metric_add_owner(mtm.steps_add, 1);
+                blocks[count++] = p;
+                allocated_mb += step_mb;
+            }
         }
         if (remove_step && count > 0) {
             remove_step = 0;
             free_block(&blocks[--count]);
             allocated_mb -= step_mb;
+            metric_add_owner(mtm.steps_remove, 1);
+        }
+
+        // One write per page is enough for the accessed/young bit: pstat --wss should see ~hot_mb hot
+        long left_kb = hot_mb * 1024;
+        for (size_t i = 0; i < count && left_kb > 0; i++) {
+            size_t kb = (size_t)(left_kb < step_mb * 1024 ? left_kb : step_mb * 1024);
+            for (size_t off = 0; off < kb * 1024; off += 4096) ((volatile char *)blocks[i])[off]++;
+            left_kb -= (long)kb;
         }
 
-        fprintf(stdout, "rss_target=%ldMB allocated=%ldMB blocks=%zu\n",
-                target_mb, allocated_mb, count);
+        metric_set(mtm.allocated, allocated_mb * 1048576L);
+        metric_set(mtm.blocks, (int64_t)count);
+        if (mt) metric_set(mtm.rss, (int64_t)(rss_mb() * 1048576.0));
+        if (!quiet)
+            fprintf(stdout, "rss_target=%ldMB allocated=%ldMB blocks=%zu\n",
+                    target_mb, allocated_mb, count);
+        if (perf_ok && perf_group_read(&pg, &cur) == 0) {
+            int touch = count != count_before;
+            perf_sample_sub(&delta, &cur, &last);
+            last = cur;
+            perf_sample_add(&phase[touch], &delta);
+            if (!quiet) fprintf(stdout, "perf phase=%s %s\n", touch ? "touch" : "idle",
+                    perf_sample_format(pbuf, sizeof(pbuf), &pg, &delta));
+        }
         fflush(stdout);
 
         struct timespec ts = { .tv_sec = sleep_ms / 1000, .tv_nsec = (sleep_ms % 1000) * 1000000 };
@@ -132,6 +684,14 @@ int main(int argc, char **argv) {
 
     for (size_t i = 0; i < count; i++) free_block(&blocks[i]);
     free(blocks);
+    if (perf_ok) {
+        for (int m = 1; m >= 0; m--)
+            if (phase[m].time_enabled)
+                fprintf(stdout, "perf phase=%s total %s\n", m ? "touch" : "idle",
+                        perf_sample_format(pbuf, sizeof(pbuf), &pg, &phase[m]));
+    }
+    if (copts.perf) perf_group_close(&pg);
+    metrics_close(mt);
     fprintf(stdout, "mem_touch stop: pid=%d\n", getpid());
     fflush(stdout);
     return 0;
@@ -0,0 +1,382 @@
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "metrics_shm.h"
+
+// Reader for metrics_shm segments: maps /dev/shm/<tool>.<pid> read-only and
+// prints every metric in the Prometheus text format. The writer is never
+// interrupted: values are plain loads, histograms and the descriptor table are
+// copied under their seqlocks and re-read if a writer was inside.
+
+#define MAX_TARGETS 256
+#define SEQ_TRIES 1000              // seqlock retries before a series counts as torn
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void handle_sigint(int sig) { (void)sig; stop_requested = 1; }
+
+static void print_usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [--watch MS] [--gc] [TARGET...]\n"
+            "  TARGET        pid, tool.pid (cpu_burn.1234) or /dev/shm/tool.pid;\n"
+            "                without targets every metrics segment in /dev/shm is read\n"
+            "  --watch MS    print again every MS milliseconds until Ctrl-C\n"
+            "  --gc          unlink segments whose process is gone\n"
+            "Output: Prometheus text format, every series gets tool=\"...\" and pid=\"...\" labels.\n",
+            prog);
+}
+
+struct segment {
+    char name[300];                 // shm name with the leading '/'
+    const struct metrics_header *hdr;
+    size_t size;
+};
+
+// Map a segment read-only and check it is ours. 0 on success
+static int segment_map(struct segment *s, const char *name, int quiet) {
+    snprintf(s->name, sizeof(s->name), "/%s", name[0] == '/' ? name + 1 : name);
+    int fd = shm_open(s->name, O_RDONLY, 0);
+    if (fd < 0) {
+        if (!quiet) fprintf(stderr, "%s: %s\n", s->name, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(struct metrics_header)) {
+        close(fd);
+        if (!quiet) fprintf(stderr, "%s: not a metrics segment\n", s->name);
+        return -1;
+    }
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        if (!quiet) fprintf(stderr, "%s: mmap: %s\n", s->name, strerror(errno));
+        return -1;
+    }
+    s->hdr = p;
+    s->size = (size_t)st.st_size;
+    const struct metrics_header *h = s->hdr;
+    if (__atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) != METRICS_MAGIC || h->version != METRICS_VERSION ||
+        h->size > s->size || h->capacity > METRICS_MAX ||
+        h->desc_offset + (size_t)h->capacity * sizeof(struct metric_desc) > s->size) {
+        if (!quiet)
+            fprintf(stderr, "%s: not a metrics segment (or version %u, expected %u)\n", s->name, h->version,
+                    METRICS_VERSION);
+        munmap(p, s->size);
+        return -1;
+    }
+    return 0;
+}
+
+static void segment_unmap(struct segment *s) { munmap((void *)s->hdr, s->size); }
+
+static int segment_alive(const struct segment *s) { return kill(s->hdr->pid, 0) == 0 || errno == EPERM; }
+
+// A writer killed inside its critical section leaves the sequence odd forever.
+// Retry a bounded number of times; for a dead owner one look is enough.
+// Returns 1 while the caller may retry, 0 to give up
+static int seq_retry(int *tries, int alive) {
+    if (!alive || ++*tries >= SEQ_TRIES) return 0;
+    sched_yield();
+    return 1;
+}
+
+// Consistent copy of the descriptor table. Returns the number of descriptors.
+// Torn: count is stored before the closing seq increment, so the first count
+// entries are complete and only a registration in progress is lost
+static uint32_t read_descs(const struct segment *s, struct metric_desc *out, int alive, int *torn) {
+    const struct metrics_header *h = s->hdr;
+    const struct metric_desc *descs = (const void *)((const char *)h + h->desc_offset);
+    int tries = 0;
+    for (;;) {
+        uint64_t s1 = atomic_load_explicit(&((struct metrics_header *)h)->seq, memory_order_acquire);
+        uint32_t n = atomic_load_explicit(&((struct metrics_header *)h)->count, memory_order_relaxed);
+        if (n > h->capacity) n = h->capacity;
+        memcpy(out, descs, n * sizeof(*out));
+        atomic_thread_fence(memory_order_acquire);
+        if ((s1 & 1) == 0 && atomic_load_explicit(&((struct metrics_header *)h)->seq, memory_order_relaxed) == s1) {
+            *torn = 0;
+            return n;
+        }
+        if (!seq_retry(&tries, alive)) {
+            *torn = 1;
+            return n;
+        }
+    }
+}
+
+// 0 on a consistent copy, -1 if the histogram stays torn
+static int read_hist(const struct metric_hist *src, struct metric_hist *dst, int alive) {
+    struct metric_hist *h = (struct metric_hist *)src;
+    int tries = 0;
+    for (;;) {
+        uint64_t s1 = atomic_load_explicit(&h->seq, memory_order_acquire);
+        if ((s1 & 1) == 0) {
+            dst->count = __atomic_load_n(&h->count, __ATOMIC_RELAXED);
+            dst->sum = __atomic_load_n(&h->sum, __ATOMIC_RELAXED);
+            for (int b = 0; b < METRICS_BUCKETS; b++)
+                dst->bucket[b] = __atomic_load_n(&h->bucket[b], __ATOMIC_RELAXED);
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&h->seq, memory_order_relaxed) == s1) return 0;
+        }
+        if (!seq_retry(&tries, alive)) return -1;
+    }
+}
+
+// "name{a=\"b\"}" -> base "name", labels "a=\"b\"" (without braces)
+static void split_name(const char *full, char *base, size_t nbase, char *labels, size_t nlabels) {
+    const char *brace = strchr(full, '{');
+    size_t len = brace ? (size_t)(brace - full) : strlen(full);
+    snprintf(base, nbase, "%.*s", (int)len, full);
+    labels[0] = 0;
+    if (brace) {
+        const char *end = strrchr(brace, '}');
+        size_t llen = end ? (size_t)(end - brace - 1) : strlen(brace + 1);
+        snprintf(labels, nlabels, "%.*s", (int)llen, brace + 1);
+    }
+}
+
+// A mapped segment with its descriptor table copied out
+struct view {
+    struct segment seg;
+    int alive;
+    uint32_t n;
+    struct metric_desc descs[METRICS_MAX];
+    char base[METRICS_MAX][METRICS_NAME];
+    char labels[METRICS_MAX][METRICS_NAME * 2 + 64];
+};
+
+static void print_series(const struct view *v, uint32_t i) {
+    const struct metric_desc *d = &v->descs[i];
+    const char *base = v->base[i], *lab = v->labels[i];
+    const void *value = (const char *)v->seg.hdr + d->offset;
+    switch (d->type) {
+    case METRIC_COUNTER:
+        printf("%s{%s} %llu\n", base, lab,
+               (unsigned long long)__atomic_load_n((const uint64_t *)value, __ATOMIC_RELAXED));
+        break;
+    case METRIC_GAUGE:
+        printf("%s{%s} %lld\n", base, lab, (long long)__atomic_load_n((const int64_t *)value, __ATOMIC_RELAXED));
+        break;
+    case METRIC_HISTOGRAM: {
+        struct metric_hist hv;
+        if (read_hist(value, &hv, v->alive) < 0) {
+            // Series skipped: a half-updated histogram would break the cumulative buckets
+            fprintf(stderr, "%s: %s torn (writer %s inside an update), skipped\n", v->seg.name, d->name,
+                    v->alive ? "stuck" : "died");
+            break;
+        }
+        int first = 0, last = -1;
+        for (int b = 0; b < METRICS_BUCKETS - 1; b++)
+            if (hv.bucket[b]) last = b;
+        while (first < last && hv.bucket[first] == 0) first++;
+        // Cumulative buckets, only over the populated range; empty ones carry no information
+        unsigned long long cum = 0;
+        for (int b = first; b <= last; b++) {
+            cum += hv.bucket[b];
+            printf("%s_bucket{%s,le=\"%llu\"} %llu\n", base, lab, (unsigned long long)metric_bucket_le((unsigned)b),
+                   cum);
+        }
+        printf("%s_bucket{%s,le=\"+Inf\"} %llu\n", base, lab, (unsigned long long)hv.count);
+        printf("%s_sum{%s} %llu\n", base, lab, (unsigned long long)hv.sum);
+        printf("%s_count{%s} %llu\n", base, lab, (unsigned long long)hv.count);
+        break;
+    }
+    }
+}
+
+static const char *type_name(uint32_t type) {
+    return type == METRIC_COUNTER ? "counter" : type == METRIC_GAUGE ? "gauge" : "histogram";
+}
+
+// The exposition format wants all series of a family in one block, so the
+// output goes family by family across every segment, in first-seen order
+static void print_views(struct view **views, int nviews) {
+    printf("# HELP metrics_up 1 while the process that owns the segment is alive\n# TYPE metrics_up gauge\n");
+    for (int k = 0; k < nviews; k++)
+        printf("metrics_up{tool=\"%.*s\",pid=\"%d\"} %d\n", METRICS_TOOL - 1, views[k]->seg.hdr->tool,
+               views[k]->seg.hdr->pid, views[k]->alive);
+    printf("# HELP process_start_time_seconds Start time of the process since unix epoch in seconds\n"
+           "# TYPE process_start_time_seconds gauge\n");
+    for (int k = 0; k < nviews; k++)
+        printf("process_start_time_seconds{tool=\"%.*s\",pid=\"%d\"} %.3f\n", METRICS_TOOL - 1,
+               views[k]->seg.hdr->tool, views[k]->seg.hdr->pid, (double)views[k]->seg.hdr->start_unix_ns / 1e9);
+
+    for (int k = 0; k < nviews; k++) {
+        for (uint32_t i = 0; i < views[k]->n; i++) {
+            const char *base = views[k]->base[i];
+            if (!base[0]) continue;
+            // Seen in an earlier segment or earlier in this one: already printed
+            int seen = 0;
+            for (int kk = 0; kk <= k && !seen; kk++)
+                for (uint32_t j = 0; j < (kk == k ? i : views[kk]->n) && !seen; j++)
+                    seen = strcmp(views[kk]->base[j], base) == 0;
+            if (seen) continue;
+            const struct metric_desc *d = &views[k]->descs[i];
+            if (d->help[0]) printf("# HELP %s %s\n", base, d->help);
+            printf("# TYPE %s %s\n", base, type_name(d->type));
+            for (int kk = k; kk < nviews; kk++)
+                for (uint32_t j = kk == k ? i : 0; j < views[kk]->n; j++)
+                    if (strcmp(views[kk]->base[j], base) == 0 && views[kk]->descs[j].type == d->type)
+                        print_series(views[kk], j);
+        }
+    }
+}
+
+// Copy out and validate the descriptors of a mapped segment
+static void view_load(struct view *v) {
+    const struct metrics_header *h = v->seg.hdr;
+    char ident[METRICS_TOOL + 48];
+    snprintf(ident, sizeof(ident), "tool=\"%.*s\",pid=\"%d\"", METRICS_TOOL - 1, h->tool, h->pid);
+    int torn;
+    v->n = read_descs(&v->seg, v->descs, v->alive, &torn);
+    if (torn)
+        fprintf(stderr, "%s: descriptor table torn (writer %s inside a registration), using %u complete entries\n",
+                v->seg.name, v->alive ? "stuck" : "died", v->n);
+    for (uint32_t i = 0; i < v->n; i++) {
+        struct metric_desc *d = &v->descs[i];
+        size_t need = d->type == METRIC_HISTOGRAM ? sizeof(struct metric_hist) : sizeof(uint64_t);
+        d->name[METRICS_NAME - 1] = 0;
+        d->help[METRICS_HELP - 1] = 0;
+        v->base[i][0] = 0;
+        if (d->type < METRIC_COUNTER || d->type > METRIC_HISTOGRAM || (size_t)d->offset + need > v->seg.size)
+            continue;               // base stays empty: skipped
+        char labels[METRICS_NAME];
+        split_name(d->name, v->base[i], sizeof(v->base[i]), labels, sizeof(labels));
+        snprintf(v->labels[i], sizeof(v->labels[i]), "%s%s%s", labels, labels[0] ? "," : "", ident);
+    }
+}
+
+static int is_number(const char *s) {
+    if (!*s) return 0;
+    for (; *s; s++)
+        if (*s < '0' || *s > '9') return 0;
+    return 1;
+}
+
+// Segment names in /dev/shm that carry our magic (optionally only for one pid)
+static int scan_shm(char names[][256], int max, const char *pid) {
+    DIR *dir = opendir("/dev/shm");
+    if (!dir) {
+        fprintf(stderr, "/dev/shm: %s (pass tool.pid explicitly)\n", strerror(errno));
+        return 0;
+    }
+    int n = 0;
+    struct dirent *e;
+    while ((e = readdir(dir)) && n < max) {
+        if (e->d_name[0] == '.') continue;
+        if (pid) {
+            const char *dot = strrchr(e->d_name, '.');
+            if (!dot || strcmp(dot + 1, pid) != 0) continue;
+        }
+        struct segment s;
+        if (segment_map(&s, e->d_name, 1) < 0) continue;
+        segment_unmap(&s);
+        snprintf(names[n++], 256, "%s", e->d_name);
+    }
+    closedir(dir);
+    return n;
+}
+
+static int name_cmp(const void *a, const void *b) { return strcmp(a, b); }
+
+static char names[MAX_TARGETS][256];
+
+// One pass over all targets. Returns the number of segments printed
+static int dump_once(char **targets, int ntargets, int gc) {
+    int n = 0;
+    if (ntargets == 0) {
+        n = scan_shm(names, MAX_TARGETS, NULL);
+    } else {
+        for (int i = 0; i < ntargets && n < MAX_TARGETS; i++) {
+            const char *t = targets[i];
+            if (strncmp(t, "/dev/shm/", 9) == 0) t += 9;
+            if (is_number(t))
+                n += scan_shm(names + n, MAX_TARGETS - n, t);
+            else
+                snprintf(names[n++], 256, "%s", t[0] == '/' ? t + 1 : t);
+        }
+    }
+    qsort(names, (size_t)n, sizeof(names[0]), name_cmp);
+
+    static struct view *views[MAX_TARGETS];
+    int printed = 0;
+    for (int i = 0; i < n; i++) {
+        if (!views[printed] && !(views[printed] = malloc(sizeof(struct view)))) break;
+        struct view *v = views[printed];
+        if (segment_map(&v->seg, names[i], ntargets == 0) < 0) continue;
+        v->alive = segment_alive(&v->seg);
+        if (!v->alive && gc) {
+            segment_unmap(&v->seg);
+            if (shm_unlink(v->seg.name) == 0)
+                fprintf(stderr, "removed stale %s\n", v->seg.name);
+            else
+                fprintf(stderr, "%s: shm_unlink: %s\n", v->seg.name, strerror(errno));
+            continue;
+        }
+        view_load(v);
+        printed++;
+    }
+    if (printed) print_views(views, printed);
+    for (int k = 0; k < printed; k++) segment_unmap(&views[k]->seg);
+    fflush(stdout);
+    return printed;
+}
+
+int main(int argc, char **argv) {
+    long watch_ms = 0;
+    int gc = 0;
+
+    static struct option long_opts[] = {
+        {"watch", required_argument, 0, 'w'},
+        {"gc", no_argument, 0, 'g'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "w:gh", long_opts, NULL)) != -1) {
+        switch (opt) {
+        case 'w':
+            watch_ms = strtol(optarg, NULL, 10);
+            if (watch_ms <= 0) {
+                fprintf(stderr, "--watch expects a positive number of milliseconds\n");
+                return 2;
+            }
+            break;
+        case 'g': gc = 1; break;
+        case 'h': print_usage(argv[0]); return 0;
+        default: print_usage(argv[0]); return 2;
+        }
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_sigint;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    char **targets = argv + optind;
+    int ntargets = argc - optind;
+    int printed = dump_once(targets, ntargets, gc);
+    while (watch_ms > 0 && !stop_requested) {
+        struct timespec ts = {watch_ms / 1000, (watch_ms % 1000) * 1000000L};
+        nanosleep(&ts, NULL);
+        if (stop_requested) break;
+        printf("\n");
+        printed = dump_once(targets, ntargets, gc);
+    }
+    if (printed == 0 && ntargets > 0) return 1;
+    return 0;
+}
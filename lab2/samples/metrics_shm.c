@@ -0,0 +1,142 @@
+#define _GNU_SOURCE
+#include "metrics_shm.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+struct metrics {
+    struct metrics_header *hdr;
+    size_t size;
+    atomic_flag reg_lock;           // registration only; updates never take it
+    char name[METRICS_TOOL + 24];
+};
+
+#define ALIGN64(x) (((x) + 63u) & ~(size_t)63u)
+
+static size_t desc_offset(void) { return ALIGN64(sizeof(struct metrics_header)); }
+static size_t data_offset(void) { return ALIGN64(desc_offset() + METRICS_MAX * sizeof(struct metric_desc)); }
+
+struct metrics *metrics_open(const char *tool) {
+    struct metrics *m = calloc(1, sizeof(*m));
+    if (!m) return NULL;
+    // macOS limits shm names to 31 characters, so keep the tool part short
+    snprintf(m->name, sizeof(m->name), "/%.20s.%d", tool, (int)getpid());
+    m->size = data_offset() + METRICS_DATA;
+
+    int fd = shm_open(m->name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0 && errno == EEXIST) {
+        // Left behind by a crashed process whose pid we now have
+        shm_unlink(m->name);
+        fd = shm_open(m->name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    }
+    if (fd < 0) goto fail;
+    if (ftruncate(fd, (off_t)m->size) < 0) {
+        int err = errno;
+        close(fd);
+        shm_unlink(m->name);
+        errno = err;
+        goto fail;
+    }
+    void *p = mmap(NULL, m->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int err = errno;
+    close(fd);
+    if (p == MAP_FAILED) {
+        shm_unlink(m->name);
+        errno = err;
+        goto fail;
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    m->hdr = p;
+    m->hdr->version = METRICS_VERSION;
+    m->hdr->capacity = METRICS_MAX;
+    m->hdr->size = m->size;
+    m->hdr->pid = (int32_t)getpid();
+    m->hdr->desc_offset = (uint32_t)desc_offset();
+    m->hdr->start_unix_ns = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    snprintf(m->hdr->tool, sizeof(m->hdr->tool), "%s", tool);
+    atomic_thread_fence(memory_order_release);
+    __atomic_store_n(&m->hdr->magic, METRICS_MAGIC, __ATOMIC_RELEASE);
+    atomic_flag_clear(&m->reg_lock);
+    return m;
+
+fail:
+    free(m);
+    return NULL;
+}
+
+void metrics_close(struct metrics *m) {
+    if (!m) return;
+    munmap(m->hdr, m->size);
+    shm_unlink(m->name);
+    free(m);
+}
+
+const char *metrics_name(const struct metrics *m) { return m ? m->name : ""; }
+
+static void *metrics_register(struct metrics *m, enum metric_type type, const char *name, const char *help,
+                              size_t block) {
+    if (!m) return NULL;
+    while (atomic_flag_test_and_set_explicit(&m->reg_lock, memory_order_acquire)) {}
+
+    struct metrics_header *h = m->hdr;
+    struct metric_desc *descs = (struct metric_desc *)((char *)h + h->desc_offset);
+    uint32_t n = atomic_load_explicit(&h->count, memory_order_relaxed);
+    void *value = NULL;
+    block = ALIGN64(block);         // one cache line at least: no false sharing between metrics
+    if (n < h->capacity && h->data_used + block <= METRICS_DATA) {
+        uint32_t off = (uint32_t)(data_offset() + h->data_used);
+        value = (char *)h + off;    // ftruncate'd memory is already zero
+
+        // Header seqlock: readers that copy the table while we write it retry
+        atomic_fetch_add_explicit(&h->seq, 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        struct metric_desc *d = &descs[n];
+        snprintf(d->name, sizeof(d->name), "%s", name);
+        snprintf(d->help, sizeof(d->help), "%s", help ? help : "");
+        d->type = (uint32_t)type;
+        d->offset = off;
+        h->data_used += (uint32_t)block;
+        atomic_store_explicit(&h->count, n + 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&h->seq, 1, memory_order_release);
+    }
+    atomic_flag_clear_explicit(&m->reg_lock, memory_order_release);
+    return value;
+}
+
+_Atomic uint64_t *metrics_counter(struct metrics *m, const char *name, const char *help) {
+    return metrics_register(m, METRIC_COUNTER, name, help, sizeof(uint64_t));
+}
+
+_Atomic int64_t *metrics_gauge(struct metrics *m, const char *name, const char *help) {
+    return metrics_register(m, METRIC_GAUGE, name, help, sizeof(int64_t));
+}
+
+struct metric_hist *metrics_histogram(struct metrics *m, const char *name, const char *help) {
+    return metrics_register(m, METRIC_HISTOGRAM, name, help, sizeof(struct metric_hist));
+}
+
+void metric_observe(struct metric_hist *h, uint64_t v) {
+    if (!h) return;
+    // Writer side of the seqlock: even -> odd by CAS also serializes writers
+    uint64_t s = atomic_load_explicit(&h->seq, memory_order_relaxed);
+    for (;;) {
+        if ((s & 1) == 0 &&
+            atomic_compare_exchange_weak_explicit(&h->seq, &s, s + 1, memory_order_acquire, memory_order_relaxed))
+            break;
+        s = atomic_load_explicit(&h->seq, memory_order_relaxed);
+    }
+    atomic_thread_fence(memory_order_release);  // odd seq is visible before the data changes
+    unsigned b = metric_bucket(v);
+    __atomic_store_n(&h->bucket[b], h->bucket[b] + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&h->count, h->count + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&h->sum, h->sum + v, __ATOMIC_RELAXED);
+    atomic_store_explicit(&h->seq, s + 2, memory_order_release);
+}
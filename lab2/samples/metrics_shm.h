@@ -0,0 +1,112 @@
+// metrics_shm.h - counters, gauges and histograms in a shared-memory segment
+//
+// A tool calls metrics_open("cpu_burn") once; that creates /dev/shm/cpu_burn.<pid>
+// with a fixed layout (versioned header, descriptor table, value blocks) and
+// unlinks it in metrics_close(). metrics_dump maps any such segment read-only
+// and prints it in the Prometheus text format, so state no longer has to be
+// scraped from stdout.
+//
+// Writers never make syscalls:
+//   - counters are relaxed atomic adds (metric_add) or, when exactly one thread
+//     owns the counter, a plain load+store without the lock prefix
+//     (metric_add_owner) or a store of an already aggregated total (metric_store);
+//   - gauges are atomic stores;
+//   - a histogram (count, sum, 64 power-of-two buckets) is guarded by its own
+//     seqlock: a writer makes the sequence odd with a CAS, which also keeps
+//     other writers out, updates and makes it even again. Readers copy the block
+//     and retry if the sequence moved, so they never see a half-applied sample.
+// Registration updates the descriptor table under the header seqlock, so a
+// reader attached early still gets a consistent list.
+//
+// Every registration function returns NULL when metrics are off (m == NULL or
+// the segment is full), and every update accepts NULL: call sites do not branch.
+
+#ifndef METRICS_SHM_H
+#define METRICS_SHM_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define METRICS_MAGIC    0x3152544d534c4144ull  // "DLASMTR1"
+#define METRICS_VERSION  1
+#define METRICS_MAX      128                    // descriptors per segment
+#define METRICS_NAME     64                     // series name, labels allowed: x{op="read"}
+#define METRICS_HELP     96
+#define METRICS_TOOL     32
+#define METRICS_BUCKETS  64                     // bucket b: bit length of the value (b=0: zero)
+#define METRICS_DATA     (128 * 1024)           // value blocks
+
+enum metric_type { METRIC_COUNTER = 1, METRIC_GAUGE = 2, METRIC_HISTOGRAM = 3 };
+
+struct metric_desc {
+    char name[METRICS_NAME];
+    char help[METRICS_HELP];
+    uint32_t type;
+    uint32_t offset;                // value block, from the start of the segment
+};
+
+struct metrics_header {
+    uint64_t magic;                 // written last: the segment is ready
+    uint32_t version;
+    uint32_t capacity;              // descriptor slots
+    uint64_t size;                  // whole segment, bytes
+    int32_t pid;
+    uint32_t desc_offset;
+    uint64_t start_unix_ns;
+    char tool[METRICS_TOOL];
+    _Atomic uint64_t seq;           // seqlock over count and descriptors
+    _Atomic uint32_t count;
+    uint32_t data_used;             // bytes of the value area handed out
+};
+
+struct metric_hist {
+    _Atomic uint64_t seq;           // odd while a writer is inside
+    uint64_t count, sum;
+    uint64_t bucket[METRICS_BUCKETS];
+};
+
+struct metrics;                     // process-local handle
+
+// Create /dev/shm/<tool>.<pid>. NULL (errno set) if shared memory is unavailable
+struct metrics *metrics_open(const char *tool);
+// Unmap and unlink; NULL is fine
+void metrics_close(struct metrics *m);
+// Segment name for messages: "/cpu_burn.1234"
+const char *metrics_name(const struct metrics *m);
+
+_Atomic uint64_t *metrics_counter(struct metrics *m, const char *name, const char *help);
+_Atomic int64_t *metrics_gauge(struct metrics *m, const char *name, const char *help);
+struct metric_hist *metrics_histogram(struct metrics *m, const char *name, const char *help);
+
+static inline void metric_add(_Atomic uint64_t *c, uint64_t d) {
+    if (c) atomic_fetch_add_explicit(c, d, memory_order_relaxed);
+}
+
+// Single writer only: no lock prefix, readers still see whole 64-bit values
+static inline void metric_add_owner(_Atomic uint64_t *c, uint64_t d) {
+    if (c) atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + d, memory_order_relaxed);
+}
+
+// Publish a total the caller aggregated itself (must not decrease)
+static inline void metric_store(_Atomic uint64_t *c, uint64_t v) {
+    if (c) atomic_store_explicit(c, v, memory_order_relaxed);
+}
+
+static inline void metric_set(_Atomic int64_t *g, int64_t v) {
+    if (g) atomic_store_explicit(g, v, memory_order_relaxed);
+}
+
+void metric_observe(struct metric_hist *h, uint64_t v);
+
+static inline unsigned metric_bucket(uint64_t v) {
+    unsigned b = v ? 64u - (unsigned)__builtin_clzll(v) : 0u;
+    return b < METRICS_BUCKETS ? b : METRICS_BUCKETS - 1;
+}
+
+// Inclusive upper bound of bucket b (the last one is open-ended)
+static inline uint64_t metric_bucket_le(unsigned b) {
+    return b == 0 ? 0 : b >= 64 ? UINT64_MAX : (1ull << b) - 1;
+}
+
+#endif
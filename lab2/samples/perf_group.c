@@ -0,0 +1,198 @@
+#define _GNU_SOURCE
+#include "perf_group.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+static const char *const ev_names[PERF_EV_COUNT] = {
+    "cycles", "instructions", "cache_misses", "branch_misses", "page_faults", "cs",
+};
+
+void perf_sample_sub(struct perf_sample *d, const struct perf_sample *a, const struct perf_sample *b) {
+    for (int i = 0; i < PERF_EV_COUNT; i++) d->value[i] = a->value[i] - b->value[i];
+    d->time_enabled = a->time_enabled - b->time_enabled;
+    d->time_running = a->time_running - b->time_running;
+}
+
+void perf_sample_add(struct perf_sample *d, const struct perf_sample *a) {
+    for (int i = 0; i < PERF_EV_COUNT; i++) d->value[i] += a->value[i];
+    d->time_enabled += a->time_enabled;
+    d->time_running += a->time_running;
+}
+
+char *perf_sample_format(char *buf, size_t len, const struct perf_group *g, const struct perf_sample *s) {
+    // Scale for multiplexing: the group was on the PMU only time_running of time_enabled
+    double scale = s->time_running ? (double)s->time_enabled / (double)s->time_running : 1.0;
+    double v[PERF_EV_COUNT];
+    for (int i = 0; i < PERF_EV_COUNT; i++) v[i] = (double)s->value[i] * scale;
+
+    size_t off = 0;
+    buf[0] = '\0';
+#define APPEND(...) do { \
+        int n_ = snprintf(buf + off, len - off, __VA_ARGS__); \
+        if (n_ > 0) off += ((size_t)n_ < len - off) ? (size_t)n_ : len - off - 1; \
+    } while (0)
+
+    for (int i = 0; i < PERF_EV_COUNT; i++)
+        if (g->fd[i] >= 0) APPEND("%s%s=%.0f", off ? " " : "", ev_names[i], v[i]);
+    double ki = v[PERF_EV_INSTRUCTIONS] / 1000.0;
+    if (g->fd[PERF_EV_CYCLES] >= 0 && g->fd[PERF_EV_INSTRUCTIONS] >= 0)
+        APPEND(" ipc=%.2f", v[PERF_EV_CYCLES] > 0 ? v[PERF_EV_INSTRUCTIONS] / v[PERF_EV_CYCLES] : 0.0);
+    if (g->fd[PERF_EV_INSTRUCTIONS] >= 0 && g->fd[PERF_EV_CACHE_MISSES] >= 0)
+        APPEND(" cache_mpki=%.2f", ki > 0 ? v[PERF_EV_CACHE_MISSES] / ki : 0.0);
+    if (g->fd[PERF_EV_INSTRUCTIONS] >= 0 && g->fd[PERF_EV_BRANCH_MISSES] >= 0)
+        APPEND(" branch_mpki=%.2f", ki > 0 ? v[PERF_EV_BRANCH_MISSES] / ki : 0.0);
+    if (scale > 1.0001) APPEND(" multiplexed=%.0f%%", 100.0 / scale);
+#undef APPEND
+    return buf;
+}
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+static int read_paranoid(void) {
+    int level = -100;
+    FILE *f = fopen("/proc/sys/kernel/perf_event_paranoid", "r");
+    if (f) {
+        if (fscanf(f, "%d", &level) != 1) level = -100;
+        fclose(f);
+    }
+    return level;
+}
+
+static int open_event(uint32_t type, uint64_t config, int group_fd, int exclude_kernel) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = group_fd == -1;     // the leader starts the whole group at once
+    attr.exclude_kernel = (uint64_t)exclude_kernel;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID |
+                       PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // pid=0, cpu=-1: the calling thread, on any CPU
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+}
+
+int perf_group_open(struct perf_group *g) {
+    static const struct { uint32_t type; uint64_t config; } evs[PERF_EV_COUNT] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+        { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+        { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+    };
+    int first_err = 0;
+
+    memset(g, 0, sizeof(*g));
+    g->leader = -1;
+    for (int i = 0; i < PERF_EV_COUNT; i++) {
+        // Full counting first; at perf_event_paranoid >= 2 only user space is allowed.
+        // Context switches happen in the kernel, so user-only counts them as 0.
+        int fd = open_event(evs[i].type, evs[i].config, g->leader, 0);
+        if (fd < 0 && (errno == EACCES || errno == EPERM)) {
+            fd = open_event(evs[i].type, evs[i].config, g->leader, 1);
+            if (fd >= 0) g->user_only = 1;
+        }
+        if (fd < 0) {
+            // ENOENT/EOPNOTSUPP: no such counter here (VM without PMU)
+            if (!first_err) first_err = errno;
+            g->fd[i] = -1;
+            continue;
+        }
+        if (ioctl(fd, PERF_EVENT_IOC_ID, &g->id[i]) == -1) {
+            if (!first_err) first_err = errno;
+            close(fd);
+            g->fd[i] = -1;
+            continue;
+        }
+        g->fd[i] = fd;
+        if (g->leader < 0) g->leader = fd;
+    }
+    if (g->leader < 0) return -(first_err ? first_err : ENOENT);
+
+    ioctl(g->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    if (ioctl(g->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) == -1) {
+        int err = errno;
+        perf_group_close(g);
+        return -err;
+    }
+    return 0;
+}
+
+int perf_group_read(const struct perf_group *g, struct perf_sample *s) {
+    // nr, time_enabled, time_running, { value, id } * nr
+    uint64_t buf[3 + 2 * PERF_EV_COUNT];
+    if (g->leader < 0) return -EBADF;
+    ssize_t n = read(g->leader, buf, sizeof(buf));
+    if (n < 0) return -errno;
+    if (n < (ssize_t)(3 * sizeof(uint64_t))) return -EIO;
+
+    memset(s, 0, sizeof(*s));
+    uint64_t nr = buf[0];
+    if (nr > PERF_EV_COUNT || (size_t)n < (3 + 2 * nr) * sizeof(uint64_t)) return -EIO;
+    s->time_enabled = buf[1];
+    s->time_running = buf[2];
+    for (uint64_t k = 0; k < nr; k++) {
+        uint64_t value = buf[3 + 2 * k], id = buf[4 + 2 * k];
+        for (int i = 0; i < PERF_EV_COUNT; i++)
+            if (g->fd[i] >= 0 && g->id[i] == id) s->value[i] = value;
+    }
+    return 0;
+}
+
+void perf_group_close(struct perf_group *g) {
+    for (int i = 0; i < PERF_EV_COUNT; i++) {
+        if (g->fd[i] >= 0) close(g->fd[i]);
+        g->fd[i] = -1;
+    }
+    g->leader = -1;
+}
+
+void perf_group_describe(const struct perf_group *g, int open_err, const char *prog) {
+    if (open_err) {
+        fprintf(stderr, "%s: perf counters unavailable (%s, perf_event_paranoid=%d), continuing without them\n",
+                prog, strerror(-open_err), read_paranoid());
+        return;
+    }
+    char names[128];
+    size_t off = 0;
+    names[0] = '\0';
+    for (int i = 0; i < PERF_EV_COUNT && off < sizeof(names); i++)
+        if (g->fd[i] >= 0)
+            off += (size_t)snprintf(names + off, sizeof(names) - off, "%s%s", off ? "," : "", ev_names[i]);
+    fprintf(stderr, "%s: perf counting %s%s%s\n", prog, names,
+            g->user_only ? " (user space only: perf_event_paranoid)" : "",
+            g->fd[PERF_EV_CYCLES] < 0 ? " (no hardware counters)" : "");
+}
+
+#else   /* !__linux__ */
+
+int perf_group_open(struct perf_group *g) {
+    memset(g, 0, sizeof(*g));
+    for (int i = 0; i < PERF_EV_COUNT; i++) g->fd[i] = -1;
+    g->leader = -1;
+    return -ENOSYS;
+}
+
+int perf_group_read(const struct perf_group *g, struct perf_sample *s) {
+    (void)g;
+    memset(s, 0, sizeof(*s));
+    return -ENOSYS;
+}
+
+void perf_group_close(struct perf_group *g) { (void)g; }
+
+void perf_group_describe(const struct perf_group *g, int open_err, const char *prog) {
+    (void)g;
+    (void)open_err;
+    fprintf(stderr, "%s: perf counters need Linux perf_event_open, continuing without them\n", prog);
+}
+
+#endif
@@ -0,0 +1,60 @@
+// perf_group.h - in-process hardware/software counters via perf_event_open
+//
+// One group per thread: cycles, instructions, cache-misses, branch-misses,
+// page-faults, context-switches. All members are read with a single read()
+// (PERF_FORMAT_GROUP), so a snapshot is consistent across counters. Events the
+// machine does not have (no PMU in a VM) or is not allowed to count
+// (perf_event_paranoid) are skipped; if nothing opens the caller just runs
+// without counters.
+//
+// Only Linux has perf_event_open; elsewhere perf_group_open() fails with ENOSYS.
+
+#ifndef PERF_GROUP_H
+#define PERF_GROUP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum perf_ev {
+    PERF_EV_CYCLES,
+    PERF_EV_INSTRUCTIONS,
+    PERF_EV_CACHE_MISSES,
+    PERF_EV_BRANCH_MISSES,
+    PERF_EV_PAGE_FAULTS,
+    PERF_EV_CONTEXT_SWITCHES,
+    PERF_EV_COUNT
+};
+
+struct perf_group {
+    int fd[PERF_EV_COUNT];          // -1 = event not opened
+    uint64_t id[PERF_EV_COUNT];
+    int leader;                     // fd of the group leader, -1 = group not opened
+    int user_only;                  // some events fell back to exclude_kernel
+};
+
+// Raw counts; deltas and sums are taken on raw values and scaled when printed
+struct perf_sample {
+    uint64_t value[PERF_EV_COUNT];
+    uint64_t time_enabled, time_running;
+};
+
+// Open a group counting the calling thread. 0 if at least one event opened, else -errno
+int perf_group_open(struct perf_group *g);
+
+// Snapshot all counters of the group. 0 or -errno
+int perf_group_read(const struct perf_group *g, struct perf_sample *s);
+
+void perf_group_close(struct perf_group *g);
+
+// d = a - b, d += a
+void perf_sample_sub(struct perf_sample *d, const struct perf_sample *a, const struct perf_sample *b);
+void perf_sample_add(struct perf_sample *d, const struct perf_sample *a);
+
+// "cycles=.. instructions=.. ipc=.. cache_mpki=.. branch_mpki=.. page_faults=.. cs=.."
+// (events not in the group are left out). Returns buf
+char *perf_sample_format(char *buf, size_t len, const struct perf_group *g, const struct perf_sample *s);
+
+// One line for stderr: which events are counted, or why there are none
+void perf_group_describe(const struct perf_group *g, int open_err, const char *prog);
+
+#endif
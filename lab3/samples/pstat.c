@@ -0,0 +1,530 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// pstat - summary of one process from /proc (stat, status, io, smaps_rollup)
+// and, with --wss, an estimate of its working set: how many resident bytes it
+// actually touches within an interval, per VMA.
+//
+// Working set via idle page tracking (Linux >= 4.3, CONFIG_IDLE_PAGE_TRACKING, root):
+//   1. /proc/<pid>/maps gives the VMAs; /proc/<pid>/pagemap gives the PFN of
+//      every resident page (64-bit entry per virtual page, bit 63 = present).
+//   2. The PFNs are set in a local bitmap laid out like
+//      /sys/kernel/mm/page_idle/bitmap (bit = PFN, 64-bit words). Runs of
+//      non-zero words are written with one pwrite each: the kernel marks idle
+//      exactly the set bits, the zero words in between are skipped.
+//   3. After the interval the same runs are read back. A bit that is still set
+//      means nobody referenced the page: cold. A cleared bit: hot.
+//   Transparent huge pages: page_idle keeps the idle flag of a compound page
+//   on its head only, so a tail PFN always reads back as "not idle". Tails are
+//   replaced by their head PFN (from /proc/kpageflags) before marking, and the
+//   whole huge page is marked and tested through that one bit.
+// Cost is one pagemap pread per 64K pages plus a few syscalls per run of
+// PFNs, so a multi-GB process takes tens of milliseconds.
+//
+// Without page_idle (--method refs, or automatically) the fallback is the
+// older clear_refs scheme: write 1 to /proc/<pid>/clear_refs, wait, read
+// Referenced from smaps. It also resets the referenced bits the kernel's own
+// reclaim relies on, which page_idle does not.
+
+#define PAGEMAP_PRESENT   (1ull << 63)
+#define PAGEMAP_SWAPPED   (1ull << 62)
+#define PAGEMAP_PFN_MASK  ((1ull << 55) - 1)
+#define PAGEMAP_CHUNK     65536                 // entries per pread (512 KiB)
+#define RUN_GAP_WORDS     64                    // zero words tolerated inside one bitmap write
+#define PAGE_IDLE_BITMAP  "/sys/kernel/mm/page_idle/bitmap"
+#define KPAGEFLAGS        "/proc/kpageflags"
+#define KPF_COMPOUND_HEAD (1ull << 15)
+#define KPF_COMPOUND_TAIL (1ull << 16)
+#define KPF_THP           (1ull << 22)
+#define COMPOUND_MAX      512                   // tail -> head search (PMD THP of 4K pages)
+
+struct vma {
+    uint64_t start, end;
+    char perms[5];
+    char name[256];
+    size_t first, npfn;         // range in the pfns[] array
+    uint64_t rss, hot, swapped; // bytes
+};
+
+static struct vma *vmas;
+static size_t nvmas, cap_vmas;
+static uint64_t *pfns;
+static size_t npfns, cap_pfns;
+static long page_size;
+
+static void print_usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [--wss] [--interval MS] [--method idle|refs] [--min-kb N] <pid>\n"
+            "  (no options)      PPid, Threads, State, CPU time, context switches, RSS, IO\n"
+            "  --wss             working set per VMA: hot (touched) vs cold resident bytes\n"
+            "  --interval MS     observation window for --wss (default 1000)\n"
+            "  --method M        idle: page_idle bitmap + pagemap (default, needs root)\n"
+            "                    refs: clear_refs + smaps Referenced (fallback, disturbs reclaim)\n"
+            "  --min-kb N        hide VMAs with less resident memory (default 4)\n",
+            prog);
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void fmt_bytes(char *buf, size_t len, uint64_t bytes) {
+    if (bytes >= 1024ull * 1048576ull) snprintf(buf, len, "%.2f GiB", bytes / (1024.0 * 1048576.0));
+    else if (bytes >= 1048576ull) snprintf(buf, len, "%.1f MiB", bytes / 1048576.0);
+    else snprintf(buf, len, "%.0f KiB", bytes / 1024.0);
+}
+
+/* ---------- summary mode ---------- */
+
+// "Key:   123 kB" from a status-like file; -1 if missing
+static long long status_field(const char *path, const char *key) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    char line[512];
+    size_t klen = strlen(key);
+    long long v = -1;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, key, klen) == 0 && line[klen] == ':') {
+            v = strtoll(line + klen + 1, NULL, 10);
+            break;
+        }
+    }
+    fclose(f);
+    return v;
+}
+
+static int print_summary(int pid) {
+    char path[64], buf[4096];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return 1;
+    }
+    size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[n] = 0;
+    // comm may contain spaces and ')': fields start after the last ')'
+    char *rp = strrchr(buf, ')');
+    if (!rp) return 1;
+    char state = 0;
+    int ppid = 0;
+    unsigned long long utime = 0, stime = 0;
+    long threads = 0;
+    if (sscanf(rp + 2, "%c %d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu %*d %*d %*d %*d %ld", &state, &ppid,
+               &utime, &stime, &threads) != 5) {
+        fprintf(stderr, "%s: unexpected format\n", path);
+        return 1;
+    }
+    long hz = sysconf(_SC_CLK_TCK);
+
+    snprintf(path, sizeof(path), "/proc/%d/status", pid);
+    long long vol = status_field(path, "voluntary_ctxt_switches");
+    long long nonvol = status_field(path, "nonvoluntary_ctxt_switches");
+    long long rss = status_field(path, "VmRSS");
+    long long anon = status_field(path, "RssAnon");
+    long long file = status_field(path, "RssFile");
+    snprintf(path, sizeof(path), "/proc/%d/io", pid);
+    long long rd = status_field(path, "read_bytes");
+    long long wr = status_field(path, "write_bytes");
+    snprintf(path, sizeof(path), "/proc/%d/smaps_rollup", pid);
+    long long pss = status_field(path, "Pss");
+
+    char b1[32];
+    printf("pid=%d ppid=%d state=%c threads=%ld\n", pid, ppid, state, threads);
+    printf("utime_ticks=%llu stime_ticks=%llu hz=%ld cpu_time_sec=%.2f\n", utime, stime, hz,
+           (double)(utime + stime) / (double)hz);
+    printf("voluntary_ctxt_switches=%lld nonvoluntary_ctxt_switches=%lld\n", vol, nonvol);
+    fmt_bytes(b1, sizeof(b1), rss > 0 ? (uint64_t)rss * 1024 : 0);
+    printf("vmrss_kb=%lld rss_anon_kb=%lld rss_file_kb=%lld pss_kb=%lld (%s)\n", rss, anon, file, pss, b1);
+    // -1: /proc/<pid>/io is readable only by the owner (or root)
+    printf("read_bytes=%lld write_bytes=%lld\n", rd, wr);
+    return 0;
+}
+
+/* ---------- working set ---------- */
+
+static int read_maps(int pid) {
+    char path[64], line[4096];
+    snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        struct vma v;
+        memset(&v, 0, sizeof(v));
+        int name_at = 0;
+        unsigned long long start, end;
+        if (sscanf(line, "%llx-%llx %4s %*s %*s %*s %n", &start, &end, v.perms, &name_at) < 3) continue;
+        v.start = start;
+        v.end = end;
+        if (name_at > 0) {
+            char *nl = strchr(line + name_at, '\n');
+            if (nl) *nl = 0;
+            snprintf(v.name, sizeof(v.name), "%s", line + name_at);
+        }
+        if (nvmas == cap_vmas) {
+            cap_vmas = cap_vmas ? cap_vmas * 2 : 256;
+            struct vma *nv = realloc(vmas, cap_vmas * sizeof(*vmas));
+            if (!nv) { fclose(f); return -1; }
+            vmas = nv;
+        }
+        vmas[nvmas++] = v;
+    }
+    fclose(f);
+    return 0;
+}
+
+static int push_pfn(uint64_t pfn) {
+    if (npfns == cap_pfns) {
+        cap_pfns = cap_pfns ? cap_pfns * 2 : 65536;
+        uint64_t *np = realloc(pfns, cap_pfns * sizeof(*pfns));
+        if (!np) return -1;
+        pfns = np;
+    }
+    pfns[npfns++] = pfn;
+    return 0;
+}
+
+// Resident PFNs of every VMA. -1 on error, -2 if the kernel hides PFNs (not root)
+static int scan_pagemap(int pid) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/pagemap", pid);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    uint64_t *buf = malloc(PAGEMAP_CHUNK * sizeof(uint64_t));
+    if (!buf) { close(fd); return -1; }
+    int hidden = 0;
+    for (size_t i = 0; i < nvmas; i++) {
+        struct vma *v = &vmas[i];
+        v->first = npfns;
+        uint64_t vpn = v->start / (uint64_t)page_size, vend = v->end / (uint64_t)page_size;
+        while (vpn < vend) {
+            size_t want = vend - vpn < PAGEMAP_CHUNK ? (size_t)(vend - vpn) : PAGEMAP_CHUNK;
+            ssize_t got = pread(fd, buf, want * sizeof(uint64_t), (off_t)(vpn * sizeof(uint64_t)));
+            if (got <= 0) break;            // [vsyscall] and friends
+            size_t n = (size_t)got / sizeof(uint64_t);
+            for (size_t k = 0; k < n; k++) {
+                uint64_t e = buf[k];
+                if (e & PAGEMAP_PRESENT) {
+                    uint64_t pfn = e & PAGEMAP_PFN_MASK;
+                    v->rss += (uint64_t)page_size;
+                    if (pfn == 0) { hidden = 1; continue; }
+                    if (push_pfn(pfn) < 0) { free(buf); close(fd); return -1; }
+                } else if (e & PAGEMAP_SWAPPED) {
+                    v->swapped += (uint64_t)page_size;
+                }
+            }
+            vpn += n;
+        }
+        v->npfn = npfns - v->first;
+    }
+    free(buf);
+    close(fd);
+    return hidden && npfns == 0 ? -2 : 0;
+}
+
+// Local copy of the page_idle bitmap over [base_word, base_word + nwords)
+struct idle_map {
+    uint64_t *bits;
+    uint64_t base_word, nwords;
+};
+
+static int idle_map_build(struct idle_map *m) {
+    uint64_t lo = UINT64_MAX, hi = 0;
+    for (size_t i = 0; i < npfns; i++) {
+        if (pfns[i] < lo) lo = pfns[i];
+        if (pfns[i] > hi) hi = pfns[i];
+    }
+    m->base_word = lo / 64;
+    m->nwords = hi / 64 - m->base_word + 1;
+    m->bits = calloc(m->nwords, sizeof(uint64_t));
+    if (!m->bits) return -1;
+    for (size_t i = 0; i < npfns; i++) m->bits[pfns[i] / 64 - m->base_word] |= 1ull << (pfns[i] % 64);
+    return 0;
+}
+
+// Call fn on every run of non-zero words (small zero gaps are merged in)
+static int for_each_run(const struct idle_map *m, int (*fn)(int, uint64_t *, uint64_t, uint64_t), int fd,
+                        uint64_t *dst, uint64_t *nruns) {
+    uint64_t w = 0;
+    *nruns = 0;
+    while (w < m->nwords) {
+        while (w < m->nwords && m->bits[w] == 0) w++;
+        if (w == m->nwords) break;
+        uint64_t start = w, last = w;
+        for (w++; w < m->nwords && w - last <= RUN_GAP_WORDS; w++)
+            if (m->bits[w]) last = w;
+        uint64_t *buf = dst ? dst + start : m->bits + start;
+        if (fn(fd, buf, m->base_word + start, last - start + 1) < 0) return -1;
+        (*nruns)++;
+        w = last + 1;
+    }
+    return 0;
+}
+
+static int run_write(int fd, uint64_t *buf, uint64_t word, uint64_t n) {
+    size_t done = 0, len = n * sizeof(uint64_t);
+    while (done < len) {
+        ssize_t r = pwrite(fd, (char *)buf + done, len - done, (off_t)(word * sizeof(uint64_t) + done));
+        if (r <= 0) return -1;
+        done += (size_t)r;
+    }
+    return 0;
+}
+
+static int run_read(int fd, uint64_t *buf, uint64_t word, uint64_t n) {
+    size_t done = 0, len = n * sizeof(uint64_t);
+    while (done < len) {
+        ssize_t r = pread(fd, (char *)buf + done, len - done, (off_t)(word * sizeof(uint64_t) + done));
+        if (r <= 0) return -1;
+        done += (size_t)r;
+    }
+    return 0;
+}
+
+// Head PFN of the compound page that tail pfn belongs to, UINT64_MAX if not found
+static uint64_t find_head(int fd, uint64_t pfn) {
+    uint64_t fl[COMPOUND_MAX];
+    uint64_t first = pfn > COMPOUND_MAX ? pfn - COMPOUND_MAX : 0;
+    if (pfn == first || run_read(fd, fl, first, pfn - first) < 0) return UINT64_MAX;
+    for (uint64_t k = pfn - first; k-- > 0;) {
+        if (fl[k] & KPF_COMPOUND_HEAD) return first + k;
+        if (!(fl[k] & KPF_COMPOUND_TAIL)) break;
+    }
+    return UINT64_MAX;
+}
+
+// Replace every compound tail in pfns[] by its head PFN (see the THP note at
+// the top). One kpageflags pread per run of consecutive PFNs. Returns the
+// number of THP pages, -1 if kpageflags cannot be read
+static long fold_compound(void) {
+    int fd = open(KPAGEFLAGS, O_RDONLY);
+    if (fd < 0) return -1;
+    uint64_t *fl = malloc(PAGEMAP_CHUNK * sizeof(uint64_t));
+    if (!fl) {
+        close(fd);
+        return -1;
+    }
+    long thp = 0;
+    size_t i = 0;
+    while (i < npfns) {
+        size_t n = 1;
+        while (i + n < npfns && n < PAGEMAP_CHUNK && pfns[i + n] == pfns[i] + n) n++;
+        if (run_read(fd, fl, pfns[i], n) < 0) {
+            free(fl);
+            close(fd);
+            return -1;
+        }
+        uint64_t head = UINT64_MAX;     // head of the compound page the previous PFN is in
+        for (size_t k = 0; k < n; k++) {
+            uint64_t f = fl[k];
+            if (f & KPF_THP) thp++;
+            if (f & KPF_COMPOUND_HEAD) {
+                head = pfns[i + k];
+            } else if (f & KPF_COMPOUND_TAIL) {
+                if (head == UINT64_MAX) head = find_head(fd, pfns[i + k]);
+                if (head != UINT64_MAX) pfns[i + k] = head;
+            } else {
+                head = UINT64_MAX;
+            }
+        }
+        i += n;
+    }
+    free(fl);
+    close(fd);
+    return thp;
+}
+
+static void sleep_ms(long ms) {
+    struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000L };
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {}
+}
+
+static int wss_idle(int pid, long interval_ms) {
+    int idle_fd = open(PAGE_IDLE_BITMAP, O_RDWR);
+    if (idle_fd < 0) {
+        perror(PAGE_IDLE_BITMAP);
+        return -2;
+    }
+
+    double t0 = now_ms();
+    int err = scan_pagemap(pid);
+    if (err == -2) fprintf(stderr, "pagemap: PFNs are hidden, run as root (CAP_SYS_ADMIN)\n");
+    else if (err == 0 && npfns == 0) fprintf(stderr, "pid %d has no resident pages\n", pid);
+    if (err < 0 || npfns == 0) {
+        close(idle_fd);
+        return -1;
+    }
+    long thp = fold_compound();
+    if (thp < 0) perror(KPAGEFLAGS ": THP tail pages will count as hot");
+    struct idle_map m;
+    if (idle_map_build(&m) < 0) {
+        close(idle_fd);
+        return -1;
+    }
+    double t1 = now_ms();
+    uint64_t nruns = 0;
+    if (for_each_run(&m, run_write, idle_fd, NULL, &nruns) < 0) {
+        perror(PAGE_IDLE_BITMAP " write");
+        close(idle_fd);
+        return -1;
+    }
+    double t2 = now_ms();
+
+    sleep_ms(interval_ms);
+
+    double t3 = now_ms();
+    uint64_t *now_idle = calloc(m.nwords, sizeof(uint64_t));
+    if (!now_idle || for_each_run(&m, run_read, idle_fd, now_idle, &nruns) < 0) {
+        perror(PAGE_IDLE_BITMAP " read");
+        close(idle_fd);
+        return -1;
+    }
+    close(idle_fd);
+    for (size_t i = 0; i < nvmas; i++) {
+        struct vma *v = &vmas[i];
+        uint64_t hot = 0;
+        for (size_t k = v->first; k < v->first + v->npfn; k++) {
+            uint64_t pfn = pfns[k];
+            if (!(now_idle[pfn / 64 - m.base_word] & (1ull << (pfn % 64)))) hot++;
+        }
+        v->hot = hot * (uint64_t)page_size;
+    }
+    double t4 = now_ms();
+    fprintf(stderr, "timing scan_ms=%.1f mark_ms=%.1f read_ms=%.1f pages=%zu thp_pages=%ld bitmap_runs=%llu\n",
+            t1 - t0, t2 - t1, t4 - t3, npfns, thp, (unsigned long long)nruns);
+    free(now_idle);
+    free(m.bits);
+    return 0;
+}
+
+// Fallback: clear referenced bits, wait, read Rss/Referenced per VMA from smaps
+static int wss_refs(int pid, long interval_ms) {
+    char path[64], line[4096];
+    snprintf(path, sizeof(path), "/proc/%d/clear_refs", pid);
+    int fd = open(path, O_WRONLY);
+    if (fd < 0 || write(fd, "1", 1) != 1) {
+        perror(path);
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    close(fd);
+    sleep_ms(interval_ms);
+
+    snprintf(path, sizeof(path), "/proc/%d/smaps", pid);
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    // smaps lists the same VMAs as maps, in order; match them by start address
+    size_t vi = 0;
+    struct vma *cur = NULL;
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long long start, end;
+        unsigned long long kb;
+        if (sscanf(line, "%llx-%llx ", &start, &end) == 2 && strchr(line, '-') < strchr(line, ' ')) {
+            cur = NULL;
+            while (vi < nvmas && vmas[vi].start < start) vi++;
+            if (vi < nvmas && vmas[vi].start == start) cur = &vmas[vi];
+        } else if (cur && sscanf(line, "Rss: %llu kB", &kb) == 1) {
+            cur->rss = kb * 1024;
+        } else if (cur && sscanf(line, "Referenced: %llu kB", &kb) == 1) {
+            cur->hot = kb * 1024;
+        } else if (cur && sscanf(line, "Swap: %llu kB", &kb) == 1) {
+            cur->swapped = kb * 1024;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+static void print_wss(const char *method, long interval_ms, long min_kb) {
+    uint64_t rss = 0, hot = 0, swapped = 0;
+    printf("%-33s %-4s %11s %11s %11s %6s  %s\n", "VMA", "PERM", "RSS_KB", "HOT_KB", "COLD_KB", "HOT%", "NAME");
+    for (size_t i = 0; i < nvmas; i++) {
+        const struct vma *v = &vmas[i];
+        rss += v->rss;
+        hot += v->hot;
+        swapped += v->swapped;
+        if (v->rss == 0 || v->rss < (uint64_t)min_kb * 1024) continue;
+        char range[40];
+        snprintf(range, sizeof(range), "%llx-%llx", (unsigned long long)v->start, (unsigned long long)v->end);
+        printf("%-33s %-4s %11llu %11llu %11llu %6.1f  %s\n", range, v->perms, (unsigned long long)(v->rss / 1024),
+               (unsigned long long)(v->hot / 1024), (unsigned long long)((v->rss - v->hot) / 1024),
+               100.0 * (double)v->hot / (double)v->rss, v->name);
+    }
+    char b1[32], b2[32];
+    fmt_bytes(b1, sizeof(b1), hot);
+    fmt_bytes(b2, sizeof(b2), rss);
+    printf("wss method=%s interval_ms=%ld rss_bytes=%llu hot_bytes=%llu cold_bytes=%llu swapped_bytes=%llu "
+           "hot_pct=%.1f (%s of %s)\n",
+           method, interval_ms, (unsigned long long)rss, (unsigned long long)hot, (unsigned long long)(rss - hot),
+           (unsigned long long)swapped, rss ? 100.0 * (double)hot / (double)rss : 0.0, b1, b2);
+}
+
+int main(int argc, char **argv) {
+    int wss = 0;
+    long interval_ms = 1000;
+    long min_kb = 4;
+    const char *method = NULL;
+
+    static struct option opts[] = {
+        {"wss", no_argument, 0, 'w'},
+        {"interval", required_argument, 0, 'i'},
+        {"method", required_argument, 0, 'm'},
+        {"min-kb", required_argument, 0, 'k'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "", opts, NULL)) != -1) {
+        switch (c) {
+            case 'w': wss = 1; break;
+            case 'i': interval_ms = atol(optarg); break;
+            case 'm': method = optarg; break;
+            case 'k': min_kb = atol(optarg); break;
+            case 'h': print_usage(argv[0]); return 0;
+            default: print_usage(argv[0]); return 1;
+        }
+    }
+    if (optind != argc - 1 || (method && strcmp(method, "idle") && strcmp(method, "refs"))) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    int pid = atoi(argv[optind]);
+    if (!wss) return print_summary(pid);
+
+    page_size = sysconf(_SC_PAGESIZE);
+    if (read_maps(pid) < 0) return 1;
+    if (!method || !strcmp(method, "idle")) {
+        int err = wss_idle(pid, interval_ms);
+        if (err == 0) {
+            print_wss("idle", interval_ms, min_kb);
+            return 0;
+        }
+        if (err == -1 || method) return 1;
+        fprintf(stderr, "idle page tracking needs root and CONFIG_IDLE_PAGE_TRACKING; using --method refs\n");
+    }
+    for (size_t i = 0; i < nvmas; i++) vmas[i].rss = vmas[i].hot = vmas[i].swapped = 0;
+    if (wss_refs(pid, interval_ms) < 0) return 1;
+    print_wss("refs", interval_ms, min_kb);
+    return 0;
+}
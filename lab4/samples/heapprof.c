@@ -0,0 +1,590 @@
+/*
+ * heapprof.c - сэмплирующий профилировщик кучи через LD_PRELOAD
+ *
+ * Перехватывает malloc/calloc/realloc/free/posix_memalign/aligned_alloc/memalign
+ * в любой динамически слинкованной программе, пересобирать которую не нужно.
+ * Записывается не каждое выделение, а выборка по байтам, как в tcmalloc.
+ * Расстояние между сэмплами случайное, распределено экспоненциально со средним
+ * HEAPPROF_RATE байт. Поэтому крупный блок попадает в выборку с вероятностью
+ * 1 - exp(-size/rate), и результат можно честно отмасштабировать обратно.
+ *
+ * Горячий путь malloc — вычитание из счётчика в TLS и одно сравнение; стек
+ * снимается только для сэмплов. free проверяет указатель по 64К-фильтру
+ * (счётный Bloom-фильтр в один хэш) и лишь при попадании ищет его в таблице
+ * живых сэмплов. Обе таблицы (стеки и живые указатели) — открытая адресация
+ * на CAS, без мьютексов: профилировщик не может заблокироваться сам на себе
+ * и не ломает fork().
+ *
+ * Стек:
+ *   - по умолчанию — проход по цепочке frame pointer (нужен
+ *     -fno-omit-frame-pointer у профилируемого кода, иначе стек короче);
+ *   - HEAPPROF_UNWIND=libunwind — unw_backtrace() из libunwind.so.8 по
+ *     .eh_frame; библиотека подгружается через dlopen, заголовки не нужны.
+ *
+ * Вывод — по сигналу (HEAPPROF_SIGNAL, по умолчанию SIGRTMIN+3: SIGUSR1/2
+ * часто заняты самой программой) и при выходе:
+ *   <HEAPPROF_OUT>.<pid>.<N>.heap    формат gperftools heap_v2: go tool pprof,
+ *                                    pprof --text/--svg и т.п.;
+ *   <HEAPPROF_OUT>.<pid>.<N>.folded  «свёрнутые» стеки для flamegraph.pl.
+ * Обработчик сигнала только ставит флаг: сам дамп пишет ближайший сэмпл
+ * (dladdr/fopen в обработчике сигнала небезопасны).
+ *
+ * Переменные окружения:
+ *   HEAPPROF_RATE=524288     средний шаг выборки в байтах (0 — выключить)
+ *   HEAPPROF_OUT=heapprof    префикс файлов
+ *   HEAPPROF_FORMAT=both     pprof | folded | both
+ *   HEAPPROF_METRIC=alloc_space   что класть в .folded: alloc_space,
+ *                            alloc_objects, inuse_space, inuse_objects
+ *   HEAPPROF_SIGNAL=N        номер сигнала для дампа (0 — без сигнала)
+ *   HEAPPROF_UNWIND=fp       fp | libunwind
+ *
+ * Компиляция: make libheapprof.so
+ * Использование:
+ *   LD_PRELOAD=./libheapprof.so ./prog
+ *   kill -s RTMIN+3 <pid>                   # промежуточный дамп
+ *   go tool pprof -top ./prog heapprof.<pid>.1.heap
+ *   flamegraph.pl heapprof.<pid>.1.folded > heap.svg
+ *
+ * Только x86_64/aarch64 с frame pointer'ами в стандартной раскладке
+ * ([fp] — предыдущий fp, [fp+8] — адрес возврата).
+ */
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_DEPTH 48
+#define STACK_SLOTS (1u << 14)      // разных стеков
+#define LIVE_SLOTS (1u << 18)       // одновременно живых сэмплов
+#define LIVE_PROBES 64              // дальше от «дома» запись не кладём
+#define FILTER_SLOTS (1u << 16)
+#define TOMBSTONE ((uintptr_t)1)
+
+#define TLS __attribute__((tls_model("initial-exec")))
+#define HOOK __attribute__((visibility("default")))
+
+struct stack_entry {
+    _Atomic uint64_t hash;          // 0 = свободно
+    _Atomic int ready;              // pc[] уже записаны
+    uint32_t depth;
+    uintptr_t pc[MAX_DEPTH];
+    // Сырые (немасштабированные) сэмплы, как их ждёт heap_v2
+    _Atomic uint64_t alloc_n, alloc_b, free_n, free_b;
+};
+
+struct live_entry {
+    _Atomic uintptr_t ptr;          // 0 = пусто, TOMBSTONE = удалено
+    uint32_t stack;
+    uint64_t size;
+};
+
+static struct stack_entry *stacks;
+static struct live_entry *live;
+static _Atomic uint16_t filter[FILTER_SLOTS];
+static _Atomic uint64_t n_stacks, n_dropped;
+
+/* ---------- Настоящие функции и начальная загрузка ---------- */
+
+static void *(*real_malloc)(size_t);
+static void *(*real_calloc)(size_t, size_t);
+static void *(*real_realloc)(void *, size_t);
+static void (*real_free)(void *);
+static int (*real_posix_memalign)(void **, size_t, size_t);
+static void *(*real_aligned_alloc)(size_t, size_t);
+static void *(*real_memalign)(size_t, size_t);
+
+/*
+ * dlsym() сам зовёт calloc(). Пока настоящие функции не найдены, память
+ * выдаётся из статического буфера; free() таких блоков ничего не делает.
+ */
+static _Alignas(16) char boot_buf[1 << 16];
+static _Atomic size_t boot_used;
+static int resolving;
+
+static void *boot_alloc(size_t n) {
+    n = (n + 15) & ~(size_t)15;
+    size_t off = atomic_fetch_add(&boot_used, n);
+    return off + n <= sizeof(boot_buf) ? boot_buf + off : NULL;
+}
+
+static int is_boot(const void *p) {
+    return (const char *)p >= boot_buf && (const char *)p < boot_buf + sizeof(boot_buf);
+}
+
+static void resolve(void) {
+    resolving = 1;
+    real_malloc = dlsym(RTLD_NEXT, "malloc");
+    real_calloc = dlsym(RTLD_NEXT, "calloc");
+    real_realloc = dlsym(RTLD_NEXT, "realloc");
+    real_posix_memalign = dlsym(RTLD_NEXT, "posix_memalign");
+    real_aligned_alloc = dlsym(RTLD_NEXT, "aligned_alloc");
+    real_memalign = dlsym(RTLD_NEXT, "memalign");
+    // free последним: по нему хуки понимают, что загрузка закончена
+    real_free = dlsym(RTLD_NEXT, "free");
+    resolving = 0;
+}
+
+/* ---------- Настройки ---------- */
+
+static uint64_t rate = 524288;
+static const char *out_prefix = "heapprof";
+static int want_pprof = 1, want_folded = 1;
+static int folded_metric;           // 0 alloc_space, 1 alloc_objects, 2 inuse_space, 3 inuse_objects
+static int (*unw_backtrace_fn)(void **, int);
+static _Atomic int enabled;         // таблицы выделены, можно сэмплировать
+static _Atomic int dump_pending;
+static _Atomic unsigned dump_seq;
+
+/* ---------- Состояние потока ---------- */
+
+static __thread int64_t until_sample TLS;   // байт до следующего сэмпла
+static __thread uint64_t rng TLS;
+static __thread int in_hook TLS;            // мы внутри профилировщика: без сэмплов
+static __thread uintptr_t stack_hi TLS;     // верх стека потока (для проверки fp)
+
+static inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+// Экспоненциальный шаг со средним rate: -ln(U) * rate
+static int64_t next_interval(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    double u = (double)((rng >> 11) + 1) * 0x1.0p-53;   // (0, 1]
+    double v = -log(u) * (double)rate;
+    return v < 1.0 ? 1 : v > 4e18 ? (int64_t)4e18 : (int64_t)v;
+}
+
+/* ---------- Стек ---------- */
+
+static void thread_stack_bounds(void) {
+    pthread_attr_t attr;
+    void *addr;
+    size_t size;
+    stack_hi = UINTPTR_MAX;
+    // Для главного потока glibc читает /proc/self/maps (и зовёт malloc: in_hook уже стоит)
+    if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+        if (pthread_attr_getstack(&attr, &addr, &size) == 0) stack_hi = (uintptr_t)addr + size;
+        pthread_attr_destroy(&attr);
+    }
+}
+
+/*
+ * Цепочка frame pointer'ов: [fp] — fp вызывающего, [fp+8] — адрес возврата.
+ * Код без frame pointer'ов держит в rbp что угодно, поэтому каждый следующий
+ * fp должен быть выше предыдущего, выровнен и не выходить за верх стека.
+ */
+static inline __attribute__((always_inline)) int walk_fp(uintptr_t *pc, int skip) {
+    uintptr_t fp = (uintptr_t)__builtin_frame_address(0);
+    int n = 0;
+    while (n < MAX_DEPTH && fp && (fp & 7) == 0 && fp + 2 * sizeof(uintptr_t) <= stack_hi) {
+        const uintptr_t *frame = (const uintptr_t *)fp;
+        uintptr_t ret = frame[1], next = frame[0];
+        if (!ret) break;
+        if (skip > 0) skip--;
+        else pc[n++] = ret;
+        if (next <= fp) break;
+        fp = next;
+    }
+    return n;
+}
+
+/* ---------- Таблица стеков ---------- */
+
+static uint32_t intern_stack(const uintptr_t *pc, int depth) {
+    uint64_t h = 0x9E3779B97F4A7C15ull;
+    for (int i = 0; i < depth; i++) h = mix64(h ^ pc[i]);
+    h |= 1;
+
+    for (uint32_t i = (uint32_t)h & (STACK_SLOTS - 1), probes = 0; probes < STACK_SLOTS;
+         i = (i + 1) & (STACK_SLOTS - 1), probes++) {
+        struct stack_entry *e = &stacks[i];
+        uint64_t cur = atomic_load_explicit(&e->hash, memory_order_acquire);
+        if (cur == 0) {
+            if (atomic_compare_exchange_strong(&e->hash, &cur, h)) {
+                e->depth = (uint32_t)depth;
+                memcpy(e->pc, pc, (size_t)depth * sizeof(uintptr_t));
+                atomic_store_explicit(&e->ready, 1, memory_order_release);
+                atomic_fetch_add_explicit(&n_stacks, 1, memory_order_relaxed);
+                return i;
+            }
+            // cur теперь — хэш того, кто занял слот раньше нас
+        }
+        if (cur != h) continue;
+        while (!atomic_load_explicit(&e->ready, memory_order_acquire))
+            ;   // другой поток дописывает pc[] этого слота
+        if (e->depth == (uint32_t)depth && memcmp(e->pc, pc, (size_t)depth * sizeof(uintptr_t)) == 0)
+            return i;
+    }
+    return UINT32_MAX;
+}
+
+/* ---------- Живые сэмплы ---------- */
+
+// Один multiply: фильтр проверяется на каждом free()
+static inline uint32_t filter_slot(uintptr_t p) { return (uint32_t)(((p >> 4) * 0x9E3779B97F4A7C15ull) >> 48); }
+
+static void live_insert(uintptr_t p, uint32_t stack, uint64_t size) {
+    uint32_t home = (uint32_t)mix64(p) & (LIVE_SLOTS - 1);
+    for (uint32_t k = 0; k < LIVE_PROBES; k++) {
+        struct live_entry *e = &live[(home + k) & (LIVE_SLOTS - 1)];
+        uintptr_t cur = atomic_load_explicit(&e->ptr, memory_order_relaxed);
+        // Один и тот же p не может быть живым дважды: free() удаляет его до настоящего free
+        while (cur == 0 || cur == TOMBSTONE) {
+            if (atomic_compare_exchange_weak(&e->ptr, &cur, p)) {
+                e->stack = stack;
+                e->size = size;
+                atomic_fetch_add_explicit(&filter[filter_slot(p)], 1, memory_order_release);
+                return;
+            }
+        }
+    }
+    atomic_fetch_add_explicit(&n_dropped, 1, memory_order_relaxed);
+}
+
+// Фильтр сказал «возможно»: ищем p среди живых сэмплов и учитываем освобождение
+static __attribute__((noinline)) void live_remove(uintptr_t p, uint32_t f) {
+    uint32_t home = (uint32_t)mix64(p) & (LIVE_SLOTS - 1);
+    for (uint32_t k = 0; k < LIVE_PROBES; k++) {
+        struct live_entry *e = &live[(home + k) & (LIVE_SLOTS - 1)];
+        uintptr_t cur = atomic_load_explicit(&e->ptr, memory_order_acquire);
+        if (cur == 0) return;
+        if (cur != p) continue;
+        // Поля читаем до освобождения слота: после него их может перезаписать другой поток
+        uint32_t stack = e->stack;
+        uint64_t size = e->size;
+        atomic_store_explicit(&e->ptr, TOMBSTONE, memory_order_release);
+        atomic_fetch_sub_explicit(&filter[f], 1, memory_order_relaxed);
+        if (stack != UINT32_MAX) {
+            atomic_fetch_add_explicit(&stacks[stack].free_n, 1, memory_order_relaxed);
+            atomic_fetch_add_explicit(&stacks[stack].free_b, size, memory_order_relaxed);
+        }
+        return;
+    }
+}
+
+/* ---------- Дамп ---------- */
+
+static void dump(const char *why);
+
+static __attribute__((noinline)) void sample_slow(void *p, size_t size) {
+    in_hook = 1;
+    if (!rng) {
+        // Первое выделение потока: только запускаем отсчёт
+        rng = mix64((uintptr_t)&until_sample ^ (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32)) | 1;
+        thread_stack_bounds();
+        until_sample = next_interval() - (int64_t)size;
+        if (until_sample > 0) goto out;
+    }
+    until_sample = next_interval();
+
+    uintptr_t pc[MAX_DEPTH + 2];
+    int depth;
+    if (unw_backtrace_fn) {
+        // unw_backtrace начинает с sample_slow, затем хук: оба пропускаем
+        void *raw[MAX_DEPTH + 2];
+        int n = unw_backtrace_fn(raw, MAX_DEPTH + 2);
+        depth = n > 2 ? n - 2 : 0;
+        for (int i = 0; i < depth; i++) pc[i] = (uintptr_t)raw[i + 2];
+    } else {
+        // Первый адрес возврата ведёт в хук (malloc/calloc/...): пропускаем
+        depth = walk_fp(pc, 1);
+    }
+    uint32_t stack = intern_stack(pc, depth);
+    if (stack != UINT32_MAX) {
+        atomic_fetch_add_explicit(&stacks[stack].alloc_n, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&stacks[stack].alloc_b, size, memory_order_relaxed);
+    } else {
+        atomic_fetch_add_explicit(&n_dropped, 1, memory_order_relaxed);
+    }
+    live_insert((uintptr_t)p, stack, size);
+
+    if (atomic_load_explicit(&dump_pending, memory_order_relaxed) &&
+        atomic_exchange(&dump_pending, 0))
+        dump("signal");
+out:
+    in_hook = 0;
+}
+
+static inline void maybe_sample(void *p, size_t size) {
+    if (!p || in_hook || !atomic_load_explicit(&enabled, memory_order_relaxed)) return;
+    until_sample -= (int64_t)size;
+    if (__builtin_expect(until_sample > 0, 1)) return;
+    sample_slow(p, size);
+}
+
+// Пока профилировщик выключен, фильтр пуст: отдельная проверка enabled не нужна
+static inline void note_free(void *p) {
+    uint32_t f = filter_slot((uintptr_t)p);
+    if (__builtin_expect(atomic_load_explicit(&filter[f], memory_order_acquire) != 0, 0))
+        live_remove((uintptr_t)p, f);
+}
+
+/* ---------- Перехватчики ---------- */
+
+HOOK void *malloc(size_t size) {
+    if (__builtin_expect(!real_free, 0)) {
+        if (resolving) return boot_alloc(size);
+        resolve();
+    }
+    void *p = real_malloc(size);
+    maybe_sample(p, size);
+    return p;
+}
+
+HOOK void *calloc(size_t n, size_t size) {
+    if (__builtin_expect(!real_free, 0)) {
+        if (resolving) return boot_alloc(n * size);     // буфер и так нулевой
+        resolve();
+    }
+    void *p = real_calloc(n, size);
+    maybe_sample(p, n * size);      // при переполнении real_calloc вернёт NULL
+    return p;
+}
+
+HOOK void free(void *p) {
+    if (!p || is_boot(p)) return;
+    if (__builtin_expect(!real_free, 0)) resolve();
+    note_free(p);
+    real_free(p);
+}
+
+HOOK void *realloc(void *old, size_t size) {
+    if (__builtin_expect(!real_free, 0)) {
+        if (resolving) return boot_alloc(size);
+        resolve();
+    }
+    if (is_boot(old)) {
+        void *p = malloc(size);
+        if (p) memcpy(p, old, (size_t)(boot_buf + sizeof(boot_buf) - (char *)old) < size
+                              ? (size_t)(boot_buf + sizeof(boot_buf) - (char *)old) : size);
+        return p;
+    }
+    // Старый блок «освобождается» до вызова: после него адрес может достаться другому потоку
+    if (old) note_free(old);
+    void *p = real_realloc(old, size);
+    maybe_sample(p, size);
+    return p;
+}
+
+HOOK int posix_memalign(void **out, size_t align, size_t size) {
+    if (__builtin_expect(!real_free, 0)) resolve();
+    int rc = real_posix_memalign(out, align, size);
+    if (rc == 0) maybe_sample(*out, size);
+    return rc;
+}
+
+HOOK void *aligned_alloc(size_t align, size_t size) {
+    if (__builtin_expect(!real_free, 0)) resolve();
+    void *p = real_aligned_alloc(align, size);
+    maybe_sample(p, size);
+    return p;
+}
+
+HOOK void *memalign(size_t align, size_t size) {
+    if (__builtin_expect(!real_free, 0)) resolve();
+    void *p = real_memalign(align, size);
+    maybe_sample(p, size);
+    return p;
+}
+
+/* ---------- Запись профиля ---------- */
+
+// Та же поправка, что делает pprof для heap_v2: один сэмпл среднего размера avg
+// «стоит» 1 / (1 - exp(-avg/rate)) выделений
+static double unsample_scale(uint64_t n, uint64_t bytes) {
+    if (n == 0 || rate == 0) return 1.0;
+    double avg = (double)bytes / (double)n;
+    return 1.0 / (1.0 - exp(-avg / (double)rate));
+}
+
+static void frame_name(uintptr_t pc, char *buf, size_t len) {
+    Dl_info info;
+    // pc — адрес возврата: pc-1 попадает в ту же функцию, что и сам call
+    if (dladdr((void *)(pc - 1), &info) && info.dli_sname) {
+        snprintf(buf, len, "%s", info.dli_sname);
+    } else if (info.dli_fname) {
+        const char *base = strrchr(info.dli_fname, '/');
+        snprintf(buf, len, "%s+0x%lx", base ? base + 1 : info.dli_fname,
+                 (unsigned long)(pc - (uintptr_t)info.dli_fbase));
+    } else {
+        snprintf(buf, len, "0x%lx", (unsigned long)pc);
+    }
+}
+
+static void write_pprof(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "heapprof: %s: %s\n", path, strerror(errno));
+        return;
+    }
+    uint64_t tn = 0, tb = 0, an = 0, ab = 0;
+    for (uint32_t i = 0; i < STACK_SLOTS; i++) {
+        struct stack_entry *e = &stacks[i];
+        if (!atomic_load(&e->ready)) continue;
+        uint64_t n = atomic_load(&e->alloc_n), b = atomic_load(&e->alloc_b);
+        uint64_t fn = atomic_load(&e->free_n), fb = atomic_load(&e->free_b);
+        an += n;
+        ab += b;
+        tn += n - (fn < n ? fn : n);
+        tb += b - (fb < b ? fb : b);
+    }
+    fprintf(f, "heap profile: %llu: %llu [%llu: %llu] @ heap_v2/%llu\n", (unsigned long long)tn,
+            (unsigned long long)tb, (unsigned long long)an, (unsigned long long)ab, (unsigned long long)rate);
+    for (uint32_t i = 0; i < STACK_SLOTS; i++) {
+        struct stack_entry *e = &stacks[i];
+        if (!atomic_load(&e->ready)) continue;
+        uint64_t n = atomic_load(&e->alloc_n), b = atomic_load(&e->alloc_b);
+        uint64_t fn = atomic_load(&e->free_n), fb = atomic_load(&e->free_b);
+        if (n == 0) continue;
+        fprintf(f, "%llu: %llu [%llu: %llu] @", (unsigned long long)(n - (fn < n ? fn : n)),
+                (unsigned long long)(b - (fb < b ? fb : b)), (unsigned long long)n, (unsigned long long)b);
+        for (uint32_t k = 0; k < e->depth; k++) fprintf(f, " 0x%lx", (unsigned long)e->pc[k]);
+        fputc('\n', f);
+    }
+    // Карта памяти нужна pprof, чтобы сопоставить адреса с файлами и символами
+    fputs("\nMAPPED_LIBRARIES:\n", f);
+    FILE *maps = fopen("/proc/self/maps", "r");
+    if (maps) {
+        char buf[4096];
+        size_t got;
+        while ((got = fread(buf, 1, sizeof(buf), maps)) > 0) fwrite(buf, 1, got, f);
+        fclose(maps);
+    }
+    fclose(f);
+}
+
+static void write_folded(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "heapprof: %s: %s\n", path, strerror(errno));
+        return;
+    }
+    char name[256];
+    for (uint32_t i = 0; i < STACK_SLOTS; i++) {
+        struct stack_entry *e = &stacks[i];
+        if (!atomic_load(&e->ready)) continue;
+        uint64_t n = atomic_load(&e->alloc_n), b = atomic_load(&e->alloc_b);
+        uint64_t fn = atomic_load(&e->free_n), fb = atomic_load(&e->free_b);
+        if (folded_metric >= 2) {
+            n -= fn < n ? fn : n;
+            b -= fb < b ? fb : b;
+        }
+        if (n == 0) continue;
+        double scale = unsample_scale(atomic_load(&e->alloc_n), atomic_load(&e->alloc_b));
+        double value = (folded_metric & 1) ? (double)n * scale : (double)b * scale;
+        // flamegraph.pl: от корня к листу через ';'
+        for (int k = (int)e->depth - 1; k >= 0; k--) {
+            frame_name(e->pc[k], name, sizeof(name));
+            for (char *c = name; *c; c++)
+                if (*c == ';' || *c == ' ') *c = '_';
+            fprintf(f, "%s%s", name, k ? ";" : "");
+        }
+        if (e->depth == 0) fputs("[unknown]", f);
+        fprintf(f, " %.0f\n", value);
+    }
+    fclose(f);
+}
+
+static void dump(const char *why) {
+    static _Atomic int dumping;
+    if (!stacks || atomic_exchange(&dumping, 1)) return;
+    int saved = in_hook;
+    in_hook = 1;
+    unsigned seq = atomic_fetch_add(&dump_seq, 1) + 1;
+    char path[512];
+    if (want_pprof) {
+        snprintf(path, sizeof(path), "%s.%d.%u.heap", out_prefix, (int)getpid(), seq);
+        write_pprof(path);
+    }
+    if (want_folded) {
+        snprintf(path, sizeof(path), "%s.%d.%u.folded", out_prefix, (int)getpid(), seq);
+        write_folded(path);
+    }
+    fprintf(stderr, "heapprof: dump #%u (%s): %llu stacks, %llu dropped samples -> %s.%d.%u.*\n", seq, why,
+            (unsigned long long)atomic_load(&n_stacks), (unsigned long long)atomic_load(&n_dropped),
+            out_prefix, (int)getpid(), seq);
+    in_hook = saved;
+    atomic_store(&dumping, 0);
+}
+
+static void on_dump_signal(int sig) {
+    (void)sig;
+    atomic_store(&dump_pending, 1);
+}
+
+/* ---------- Инициализация ---------- */
+
+__attribute__((constructor)) static void heapprof_init(void) {
+    if (!real_free) resolve();
+    in_hook = 1;
+
+    const char *s;
+    if ((s = getenv("HEAPPROF_RATE"))) rate = strtoull(s, NULL, 10);
+    if ((s = getenv("HEAPPROF_OUT")) && *s) out_prefix = s;
+    if ((s = getenv("HEAPPROF_FORMAT"))) {
+        want_pprof = strcmp(s, "folded") != 0;
+        want_folded = strcmp(s, "pprof") != 0;
+    }
+    if ((s = getenv("HEAPPROF_METRIC"))) {
+        if (strcmp(s, "alloc_objects") == 0) folded_metric = 1;
+        else if (strcmp(s, "inuse_space") == 0) folded_metric = 2;
+        else if (strcmp(s, "inuse_objects") == 0) folded_metric = 3;
+    }
+    if ((s = getenv("HEAPPROF_UNWIND")) && strcmp(s, "libunwind") == 0) {
+        void *h = dlopen("libunwind.so.8", RTLD_NOW | RTLD_LOCAL);
+        if (h) unw_backtrace_fn = (int (*)(void **, int))dlsym(h, "unw_backtrace");
+        if (!unw_backtrace_fn)
+            fprintf(stderr, "heapprof: libunwind not available (%s), using frame pointers\n", dlerror());
+    }
+    if (rate == 0) {
+        in_hook = 0;
+        return;
+    }
+
+    // mmap, а не malloc: страницы таблиц появляются в RSS, только когда заняты
+    stacks = mmap(NULL, STACK_SLOTS * sizeof(*stacks), PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    live = mmap(NULL, LIVE_SLOTS * sizeof(*live), PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (stacks == MAP_FAILED || live == MAP_FAILED) {
+        fprintf(stderr, "heapprof: mmap: %s, profiling disabled\n", strerror(errno));
+        stacks = NULL;
+        in_hook = 0;
+        return;
+    }
+
+    int sig = SIGRTMIN + 3;
+    if ((s = getenv("HEAPPROF_SIGNAL"))) sig = atoi(s);
+    if (sig > 0 && sig < NSIG) {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = on_dump_signal;
+        sa.sa_flags = SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        sigaction(sig, &sa, NULL);
+    }
+    atomic_store(&enabled, 1);
+    in_hook = 0;
+}
+
+__attribute__((destructor)) static void heapprof_fini(void) {
+    if (atomic_load(&enabled)) dump("exit");
+}
@@ -0,0 +1,574 @@
+/*
+ * mytracer_seccomp.c - трассировщик syscalls с фильтром seccomp-BPF
+ *
+ * Наивный tracer из задания C* останавливает процесс на КАЖДОМ входе и
+ * выходе из syscall (PTRACE_SYSCALL) — отсюда замедление в 10–100 раз.
+ * Здесь в дочернем процессе перед execvp() ставится seccomp-фильтр,
+ * который возвращает SECCOMP_RET_TRACE только для выбранных syscalls.
+ * Остальные вызовы выполняются без остановок (PTRACE_CONT), а tracer
+ * просыпается лишь на PTRACE_EVENT_SECCOMP.
+ *
+ * Возможности:
+ *   - -e open,openat,...   какие syscalls трассировать (имена или номера)
+ *   - -f                   следовать за fork/vfork/clone (потоки и дети)
+ *   - -c                   вместо построчного вывода — сводка по количеству
+ *   - --naive              старый режим PTRACE_SYSCALL (для сравнения overhead)
+ *   - строки аргументов читаются process_vm_readv() целыми кусками
+ *     (до границы страницы), а не по слову через PTRACE_PEEKDATA
+ *
+ * Компиляция: make
+ * Использование:
+ *   ./mytracer_seccomp -e openat,execve ls /
+ *   ./mytracer_seccomp -f -c -e clone,openat make -j4
+ *   ./mytracer_seccomp --naive -e openat ls /
+ *
+ * Только x86_64 (регистры user_regs_struct, AUDIT_ARCH_X86_64).
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <getopt.h>
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/user.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef __x86_64__
+#error "mytracer_seccomp supports only x86_64"
+#endif
+
+#define MAX_NR 512          // верхняя граница номеров syscalls x86_64
+#define MAX_TASKS 1024      // сколько потоков/процессов отслеживаем одновременно
+#define STR_MAX 256         // сколько байт строки-аргумента показывать
+
+/* ---------- Таблица syscalls: имя и индекс аргумента-строки (или -1) ---------- */
+
+struct sc_info {
+    int nr;
+    const char *name;
+    int str_arg;
+};
+
+#define SC(n, s) { SYS_##n, #n, s }
+
+static const struct sc_info sc_table[] = {
+    SC(read, -1), SC(write, -1), SC(open, 0), SC(close, -1),
+    SC(stat, 0), SC(fstat, -1), SC(lstat, 0), SC(poll, -1),
+    SC(lseek, -1), SC(mmap, -1), SC(mprotect, -1), SC(munmap, -1),
+    SC(brk, -1), SC(rt_sigaction, -1), SC(rt_sigprocmask, -1), SC(ioctl, -1),
+    SC(pread64, -1), SC(pwrite64, -1), SC(readv, -1), SC(writev, -1),
+    SC(access, 0), SC(pipe, -1), SC(select, -1), SC(sched_yield, -1),
+    SC(madvise, -1), SC(dup, -1), SC(dup2, -1), SC(nanosleep, -1),
+    SC(getpid, -1), SC(socket, -1), SC(connect, -1), SC(accept, -1),
+    SC(sendto, -1), SC(recvfrom, -1), SC(clone, -1), SC(fork, -1),
+    SC(vfork, -1), SC(execve, 0), SC(exit, -1), SC(wait4, -1),
+    SC(kill, -1), SC(uname, -1), SC(fcntl, -1), SC(flock, -1),
+    SC(fsync, -1), SC(truncate, 0), SC(ftruncate, -1), SC(getdents, -1),
+    SC(getcwd, -1), SC(chdir, 0), SC(rename, 0), SC(mkdir, 0),
+    SC(rmdir, 0), SC(creat, 0), SC(link, 0), SC(unlink, 0),
+    SC(symlink, 0), SC(readlink, 0), SC(chmod, 0), SC(chown, 0),
+    SC(umask, -1), SC(getrlimit, -1), SC(getuid, -1), SC(getgid, -1),
+    SC(geteuid, -1), SC(getegid, -1), SC(getppid, -1), SC(arch_prctl, -1),
+    SC(gettid, -1), SC(futex, -1), SC(getdents64, -1), SC(set_tid_address, -1),
+    SC(clock_gettime, -1), SC(clock_nanosleep, -1), SC(exit_group, -1),
+    SC(epoll_wait, -1), SC(tgkill, -1), SC(openat, 1), SC(mkdirat, 1),
+    SC(newfstatat, 1), SC(unlinkat, 1), SC(renameat, 1), SC(readlinkat, 1),
+    SC(faccessat, 1), SC(set_robust_list, -1), SC(epoll_pwait, -1),
+    SC(pipe2, -1), SC(dup3, -1), SC(prlimit64, -1), SC(getrandom, -1),
+    SC(execveat, 1), SC(statx, 1), SC(rseq, -1),
+#ifdef SYS_clone3
+    SC(clone3, -1),
+#endif
+#ifdef SYS_faccessat2
+    SC(faccessat2, 1),
+#endif
+};
+
+#define SC_COUNT (sizeof(sc_table) / sizeof(sc_table[0]))
+
+static const struct sc_info *sc_by_nr[MAX_NR];
+
+static void sc_index_init(void) {
+    for (size_t i = 0; i < SC_COUNT; i++) {
+        if (sc_table[i].nr >= 0 && sc_table[i].nr < MAX_NR)
+            sc_by_nr[sc_table[i].nr] = &sc_table[i];
+    }
+}
+
+static int sc_lookup_name(const char *name) {
+    char *end;
+    long nr = strtol(name, &end, 10);
+    if (*name && *end == '\0')
+        return (nr >= 0 && nr < MAX_NR) ? (int)nr : -1;
+    for (size_t i = 0; i < SC_COUNT; i++) {
+        if (strcmp(sc_table[i].name, name) == 0)
+            return sc_table[i].nr;
+    }
+    return -1;
+}
+
+/* ---------- Состояние трассировки ---------- */
+
+static unsigned char selected[MAX_NR];   // 1 = трассировать этот syscall
+static int trace_all = 1;                // -e не задан → все syscalls
+static int follow_forks = 0;
+static int summary_only = 0;
+static int naive_mode = 0;
+static unsigned long counts[MAX_NR];
+static FILE *out;
+
+/*
+ * Потоки/процессы, за которыми следим. in_syscall отличает вход от выхода
+ * в наивном режиме и "ждём syscall-exit-stop" в режиме seccomp.
+ */
+struct task {
+    pid_t tid;
+    int in_syscall;
+    int started;        // первая (автоматическая) остановка SIGSTOP уже поглощена
+    struct user_regs_struct entry;
+    char line[STR_MAX + 128];   // "name(args)", сформированная на входе
+};
+
+static struct task tasks[MAX_TASKS];
+static int live_tasks = 0;
+static pid_t root_pid = 0;
+
+static struct task *task_get(pid_t tid, int create) {
+    struct task *free_slot = NULL;
+    for (int i = 0; i < MAX_TASKS; i++) {
+        if (tasks[i].tid == tid)
+            return &tasks[i];
+        if (!free_slot && tasks[i].tid == 0)
+            free_slot = &tasks[i];
+    }
+    if (!create || !free_slot)
+        return NULL;
+    memset(free_slot, 0, sizeof(*free_slot));
+    free_slot->tid = tid;
+    live_tasks++;
+    return free_slot;
+}
+
+static void task_drop(pid_t tid) {
+    struct task *t = task_get(tid, 0);
+    if (t) {
+        t->tid = 0;
+        live_tasks--;
+    }
+}
+
+/* ---------- Чтение памяти tracee ---------- */
+
+/*
+ * Читаем C-строку по адресу addr. process_vm_readv() копирует сразу до
+ * конца текущей страницы (читать через границу нельзя: следующая страница
+ * может быть не отображена). Если вызов недоступен (например, запрещён
+ * политикой), откатываемся на PTRACE_PEEKDATA по слову.
+ */
+static int read_string(pid_t tid, unsigned long addr, char *buf, size_t cap) {
+    const unsigned long page = 4096;
+    size_t n = 0;
+
+    if (addr == 0) {
+        snprintf(buf, cap, "NULL");
+        return -1;
+    }
+
+    while (n + 1 < cap) {
+        size_t chunk = page - ((addr + n) % page);
+        if (chunk > cap - 1 - n)
+            chunk = cap - 1 - n;
+
+        struct iovec local = { buf + n, chunk };
+        struct iovec remote = { (void *)(addr + n), chunk };
+        ssize_t got = process_vm_readv(tid, &local, 1, &remote, 1, 0);
+        if (got <= 0) {
+            if (n > 0 || (errno != ENOSYS && errno != EPERM))
+                break;
+            // fallback: по слову через ptrace
+            while (n + sizeof(long) < cap) {
+                errno = 0;
+                long word = ptrace(PTRACE_PEEKDATA, tid, addr + n, NULL);
+                if (errno)
+                    break;
+                memcpy(buf + n, &word, sizeof(word));
+                if (memchr(&word, '\0', sizeof(word))) {
+                    buf[cap - 1] = '\0';
+                    return 0;
+                }
+                n += sizeof(word);
+            }
+            break;
+        }
+        if (memchr(buf + n, '\0', (size_t)got))
+            return 0;
+        n += (size_t)got;
+    }
+    buf[n] = '\0';
+    return 0;
+}
+
+/* ---------- Вывод ---------- */
+
+static unsigned long long arg_of(const struct user_regs_struct *r, int i) {
+    switch (i) {
+        case 0: return r->rdi;
+        case 1: return r->rsi;
+        case 2: return r->rdx;
+        case 3: return r->r10;
+        case 4: return r->r8;
+        default: return r->r9;
+    }
+}
+
+/*
+ * Аргументы форматируем на ВХОДЕ: после успешного execve() память старой
+ * программы уже не существует, а строки нужно прочитать до выполнения вызова.
+ */
+static void format_call(pid_t tid, const struct user_regs_struct *entry,
+                        char *line, size_t cap) {
+    long nr = (long)entry->orig_rax;
+    const struct sc_info *info = (nr >= 0 && nr < MAX_NR) ? sc_by_nr[nr] : NULL;
+    char str[STR_MAX];
+    size_t len = 0;
+
+    if (follow_forks)
+        len += snprintf(line + len, cap - len, "[pid %d] ", tid);
+    if (info)
+        len += snprintf(line + len, cap - len, "%s(", info->name);
+    else
+        len += snprintf(line + len, cap - len, "syscall_%ld(", nr);
+
+    for (int i = 0; i < 3 && len < cap; i++) {
+        const char *sep = i ? ", " : "";
+        if (info && info->str_arg == i) {
+            read_string(tid, arg_of(entry, i), str, sizeof(str));
+            len += snprintf(line + len, cap - len, "%s\"%s\"", sep, str);
+        } else {
+            len += snprintf(line + len, cap - len, "%s0x%llx", sep, arg_of(entry, i));
+        }
+    }
+    if (len < cap)
+        snprintf(line + len, cap - len, ")");
+}
+
+static int is_selected(long nr) {
+    return trace_all || (nr >= 0 && nr < MAX_NR && selected[nr]);
+}
+
+/*
+ * В режиме seccomp за потомками следим всегда (см. main), но без -f
+ * печатаем и считаем только вызовы корневого процесса, как strace.
+ */
+static int is_shown(pid_t tid, long nr) {
+    return (follow_forks || tid == root_pid) && is_selected(nr);
+}
+
+/* ---------- seccomp-фильтр (выполняется в дочернем процессе) ---------- */
+
+static int install_filter(void) {
+    // 4 инструкции заголовка + по одной на syscall + 2 return
+    struct sock_filter prog[4 + MAX_NR + 2];
+    unsigned n = 0, count = 0;
+
+    for (int nr = 0; nr < MAX_NR; nr++)
+        count += selected[nr];
+
+    // Чужая архитектура (например, int 0x80 из 32-бит) — пропускаем без трассировки
+    prog[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+                                             offsetof(struct seccomp_data, arch));
+    prog[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,
+                                             AUDIT_ARCH_X86_64, 1, 0);
+    prog[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW);
+    prog[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+                                             offsetof(struct seccomp_data, nr));
+
+    // Для i-го сравнения: совпало → прыжок на RET_TRACE (последняя инструкция).
+    // Без -e (или слишком длинный список для 8-битного смещения прыжка)
+    // трассируем всё подряд.
+    unsigned left = count;
+    for (int nr = 0; nr < MAX_NR && !trace_all && count < 250; nr++) {
+        if (!selected[nr])
+            continue;
+        left--;
+        prog[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,
+                                                 (unsigned)nr, (unsigned char)(left + 1), 0);
+    }
+    if (!trace_all && count < 250)
+        prog[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW);
+    prog[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRACE);
+
+    struct sock_fprog fprog = { .len = (unsigned short)n, .filter = prog };
+
+    if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) == -1) {
+        perror("prctl(PR_SET_NO_NEW_PRIVS)");
+        return -1;
+    }
+    if (prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &fprog) == -1) {
+        perror("prctl(PR_SET_SECCOMP)");
+        return -1;
+    }
+    return 0;
+}
+
+/* ---------- Основной цикл ---------- */
+
+static void on_syscall_stop(pid_t tid, struct task *t) {
+    struct user_regs_struct regs;
+    if (ptrace(PTRACE_GETREGS, tid, 0, &regs) == -1)
+        return;
+
+    if (!t->in_syscall) {
+        t->entry = regs;
+        t->in_syscall = 1;
+        long nr = (long)regs.orig_rax;
+        if (!is_shown(tid, nr))
+            return;
+        if (nr >= 0 && nr < MAX_NR)
+            counts[nr]++;
+        if (!summary_only)
+            format_call(tid, &regs, t->line, sizeof(t->line));
+        return;
+    }
+
+    t->in_syscall = 0;
+    if (!summary_only && is_shown(tid, (long)t->entry.orig_rax))
+        fprintf(out, "%s = %lld\n", t->line, (long long)regs.rax);
+}
+
+static int trace_loop(void) {
+    int exit_code = 0;
+
+    while (live_tasks > 0) {
+        int status;
+        pid_t tid = waitpid(-1, &status, __WALL);
+        if (tid == -1) {
+            if (errno == EINTR)
+                continue;
+            if (errno != ECHILD)
+                perror("waitpid");
+            break;
+        }
+
+        if (WIFEXITED(status) || WIFSIGNALED(status)) {
+            // exit/exit_group не возвращаются — результата нет, как "= ?" в strace
+            struct task *gone = task_get(tid, 0);
+            if (gone && gone->in_syscall && !summary_only &&
+                is_shown(tid, (long)gone->entry.orig_rax))
+                fprintf(out, "%s = ?\n", gone->line);
+            if (tid == root_pid) {
+                if (WIFEXITED(status))
+                    exit_code = WEXITSTATUS(status);
+                else
+                    exit_code = 128 + WTERMSIG(status);
+            }
+            task_drop(tid);
+            continue;
+        }
+        if (!WIFSTOPPED(status))
+            continue;
+
+        struct task *t = task_get(tid, 1);
+        int sig = WSTOPSIG(status);
+        int event = (unsigned)status >> 16;
+        int inject = 0;
+        enum __ptrace_request resume = naive_mode ? PTRACE_SYSCALL : PTRACE_CONT;
+
+        if (!t) {
+            // Таблица заполнена: поток не отслеживаем, но и не оставляем
+            // остановленным. Остановки ptrace и SIGSTOP (первая остановка
+            // нового потока неотличима от обычной) ему не доставляем.
+            static int warned;
+            if (!warned) {
+                fprintf(stderr, "more than %d tasks, some threads are not traced\n", MAX_TASKS);
+                warned = 1;
+            }
+            inject = sig == (SIGTRAP | 0x80) || event || sig == SIGSTOP ? 0 : sig;
+            if (ptrace(resume, tid, 0, inject) == -1 && errno != ESRCH)
+                perror("ptrace(resume)");
+            continue;
+        }
+
+        if (sig == (SIGTRAP | 0x80)) {
+            // syscall-stop: в naive — и вход, и выход; в seccomp — только выход
+            if (naive_mode) {
+                on_syscall_stop(tid, t);
+            } else if (t->in_syscall) {
+                on_syscall_stop(tid, t);
+            }
+        } else if (sig == SIGTRAP && event == PTRACE_EVENT_SECCOMP) {
+            // Вход в выбранный syscall. Чтобы увидеть результат, продолжаем
+            // до syscall-exit-stop (на ядрах >= 4.8 следующая остановка — выход).
+            t->in_syscall = 0;
+            on_syscall_stop(tid, t);
+            resume = PTRACE_SYSCALL;
+        } else if (sig == SIGTRAP && (event == PTRACE_EVENT_FORK ||
+                                      event == PTRACE_EVENT_VFORK ||
+                                      event == PTRACE_EVENT_CLONE)) {
+            unsigned long child;
+            if (ptrace(PTRACE_GETEVENTMSG, tid, 0, &child) == 0)
+                task_get((pid_t)child, 1);
+            // В режиме seccomp fork/clone сам мог быть выбран: сохраняем ожидание выхода
+            if (!naive_mode && t->in_syscall)
+                resume = PTRACE_SYSCALL;
+        } else if (sig == SIGTRAP && event == PTRACE_EVENT_EXEC) {
+            if (!naive_mode && t->in_syscall)
+                resume = PTRACE_SYSCALL;
+        } else if (sig == SIGSTOP && event == 0 && !t->started) {
+            // Первая остановка нового потока (автоматический SIGSTOP от
+            // PTRACE_O_TRACECLONE/FORK) — не доставляем сигнал.
+            t->started = 1;
+        } else {
+            inject = sig;   // обычный сигнал — доставить процессу
+        }
+
+        if (ptrace(resume, tid, 0, inject) == -1 && errno != ESRCH)
+            perror("ptrace(resume)");
+    }
+    return exit_code;
+}
+
+static void print_summary(void) {
+    unsigned long total = 0;
+    fprintf(out, "%-20s %10s\n", "syscall", "calls");
+    fprintf(out, "%-20s %10s\n", "--------------------", "----------");
+    for (int nr = 0; nr < MAX_NR; nr++) {
+        if (!counts[nr])
+            continue;
+        total += counts[nr];
+        if (sc_by_nr[nr])
+            fprintf(out, "%-20s %10lu\n", sc_by_nr[nr]->name, counts[nr]);
+        else
+            fprintf(out, "syscall_%-12d %10lu\n", nr, counts[nr]);
+    }
+    fprintf(out, "%-20s %10lu\n", "total", total);
+}
+
+static void print_usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-e syscall[,syscall...]] [-f] [-c] [-o FILE] [--naive] <program> [args...]\n"
+            "  -e LIST   trace only these syscalls (names or numbers)\n"
+            "  -f        follow fork/vfork/clone\n"
+            "  -c        print call counts instead of each call\n"
+            "  -o FILE   write trace to FILE (default: stderr)\n"
+            "  --naive   stop on every syscall entry/exit (PTRACE_SYSCALL)\n",
+            prog);
+}
+
+static int parse_list(char *list) {
+    for (char *tok = strtok(list, ","); tok; tok = strtok(NULL, ",")) {
+        int nr = sc_lookup_name(tok);
+        if (nr < 0) {
+            fprintf(stderr, "unknown syscall: %s\n", tok);
+            return -1;
+        }
+        selected[nr] = 1;
+        trace_all = 0;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    const char *out_path = NULL;
+
+    static struct option opts[] = {
+        {"naive", no_argument, 0, 'N'},
+        {0, 0, 0, 0}
+    };
+
+    sc_index_init();
+    out = stderr;
+
+    int c;
+    while ((c = getopt_long(argc, argv, "+e:fco:h", opts, NULL)) != -1) {
+        switch (c) {
+            case 'e': if (parse_list(optarg) < 0) return 1; break;
+            case 'f': follow_forks = 1; break;
+            case 'c': summary_only = 1; break;
+            case 'o': out_path = optarg; break;
+            case 'N': naive_mode = 1; break;
+            default: print_usage(argv[0]); return 1;
+        }
+    }
+    if (optind >= argc) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (out_path) {
+        out = fopen(out_path, "w");
+        if (!out) {
+            perror(out_path);
+            return 1;
+        }
+    }
+
+    pid_t child = fork();
+    if (child == -1) {
+        perror("fork");
+        return 1;
+    }
+
+    if (child == 0) {
+        if (ptrace(PTRACE_TRACEME, 0, NULL, NULL) == -1) {
+            perror("ptrace(PTRACE_TRACEME)");
+            _exit(1);
+        }
+        // Ждём, пока родитель выставит опции (иначе SECCOMP_RET_TRACE без
+        // PTRACE_O_TRACESECCOMP вернёт ENOSYS)
+        raise(SIGSTOP);
+        if (!naive_mode && install_filter() == -1)
+            _exit(1);
+        execvp(argv[optind], &argv[optind]);
+        perror("execvp");
+        _exit(127);
+    }
+
+    int status;
+    if (waitpid(child, &status, 0) == -1 || !WIFSTOPPED(status)) {
+        fprintf(stderr, "child did not stop\n");
+        return 1;
+    }
+
+    long options = PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL | PTRACE_O_TRACEEXEC;
+    if (!naive_mode)
+        options |= PTRACE_O_TRACESECCOMP;
+    // Фильтр seccomp наследуется потомками: без трассировщика их выбранные
+    // syscalls получили бы ENOSYS, поэтому в этом режиме следим за всеми
+    if (follow_forks || !naive_mode)
+        options |= PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK | PTRACE_O_TRACECLONE;
+    if (ptrace(PTRACE_SETOPTIONS, child, 0, options) == -1) {
+        perror("ptrace(PTRACE_SETOPTIONS)");
+        kill(child, SIGKILL);
+        return 1;
+    }
+
+    root_pid = child;
+    task_get(child, 1)->started = 1;   // начальный SIGSTOP уже поглощён
+
+    if (ptrace(naive_mode ? PTRACE_SYSCALL : PTRACE_CONT, child, 0, 0) == -1) {
+        perror("ptrace(resume)");
+        kill(child, SIGKILL);
+        return 1;
+    }
+
+    int code = trace_loop();
+
+    if (summary_only)
+        print_summary();
+    if (out != stderr)
+        fclose(out);
+    return code;
+}
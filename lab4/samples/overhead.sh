@@ -0,0 +1,53 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Сравнение overhead: без трассировки, наивный PTRACE_SYSCALL и seccomp-BPF.
+#
+# Usage:
+#   bash overhead.sh                       # ls -R /usr/include, трассируем openat
+#   bash overhead.sh -e openat,execve -- find /usr/share -name '*.txt'
+
+script_dir="$(cd "$(dirname "$0")" && pwd)"
+tracer="${script_dir}/mytracer_seccomp"
+SYSCALLS="openat"
+RUNS=3
+
+while [[ $# -gt 0 ]]; do
+  case "$1" in
+    -e) SYSCALLS="$2"; shift 2 ;;
+    -n) RUNS="$2"; shift 2 ;;
+    --) shift; break ;;
+    -h|--help) echo "Usage: $0 [-e syscalls] [-n runs] [-- command args...]"; exit 0 ;;
+    *) break ;;
+  esac
+done
+
+if [[ $# -eq 0 ]]; then
+  set -- ls -R /usr/include
+fi
+
+make -C "${script_dir}" >/dev/null
+
+# Лучшее из RUNS запусков, секунды
+measure() {
+  local best=""
+  for _ in $(seq "${RUNS}"); do
+    local t0 t1
+    t0=$(date +%s.%N)
+    "$@" >/dev/null 2>&1 || true
+    t1=$(date +%s.%N)
+    best=$(awk -v a="${best}" -v t0="${t0}" -v t1="${t1}" 'BEGIN{ b=t1-t0; if (a=="" || b<a) print b; else print a }')
+  done
+  echo "${best}"
+}
+
+base=$(measure "$@")
+naive=$(measure "${tracer}" --naive -f -e "${SYSCALLS}" -o /dev/null "$@")
+secc=$(measure "${tracer}" -f -e "${SYSCALLS}" -o /dev/null "$@")
+
+awk -v base="${base}" -v naive="${naive}" -v secc="${secc}" 'BEGIN{
+  printf "%-24s %10s %10s\n", "method", "time_s", "slowdown"
+  printf "%-24s %10.3f %9.1fx\n", "no tracing", base, 1
+  printf "%-24s %10.3f %9.1fx\n", "naive (PTRACE_SYSCALL)", naive, naive/base
+  printf "%-24s %10.3f %9.1fx\n", "seccomp-bpf", secc, secc/base
+}'
@@ -0,0 +1,300 @@
+/*
+ * chardev_bench.c - замер пропускной способности /dev/mychardev
+ *
+ * N потоков-писателей пишут блоки в устройство, M потоков-читателей
+ * (у каждого свой open(), то есть свой курсор) читают поток. Через
+ * заданное время печатается MB/s записи и чтения.
+ *
+ * С -m потоки работают через mmap() кольца (см. chardev_uapi.h): данные
+ * копируются memcpy прямо в общую память, syscalls — только ioctl для
+ * сна/пробуждения. Запуск с -m и без него сравнивает два пути.
+ *
+ * Компиляция: make chardev_bench
+ * Использование:
+ *   ./chardev_bench [-d /dev/mychardev] [-m] [-w N] [-r M] [-b BYTES] [-t SEC]
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "chardev_uapi.h"
+
+static const char *dev_path = "/dev/mychardev";
+static size_t block = 4096;
+static atomic_int stop;
+
+/* Отображение кольца для режима -m */
+static struct chardev_ctrl *ctrl;
+static char *ring_data;
+static uint64_t ring_mask;
+
+struct worker {
+    pthread_t thread;
+    int fd;
+    uint64_t bytes;
+};
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int map_ring(int fd) {
+    long page = sysconf(_SC_PAGESIZE);
+    void *p = mmap(NULL, (size_t)page, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        perror("mmap(ctrl)");
+        return -1;
+    }
+    struct chardev_ctrl *c = p;
+    uint64_t size = c->size, off = c->data_offset;
+    unsigned version = c->version;
+    munmap(p, (size_t)page);
+    if (version != CHARDEV_CTRL_VERSION) {
+        fprintf(stderr, "unsupported ctrl version %u\n", version);
+        return -1;
+    }
+
+    p = mmap(NULL, off + size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        perror("mmap(ring)");
+        return -1;
+    }
+    ctrl = p;
+    ring_data = (char *)p + off;
+    ring_mask = size - 1;
+    if (block > size)
+        block = size;
+    return 0;
+}
+
+static void ring_put(uint64_t pos, const char *src, size_t n) {
+    size_t off = pos & ring_mask;
+    size_t first = n < ring_mask + 1 - off ? n : ring_mask + 1 - off;
+    memcpy(ring_data + off, src, first);
+    memcpy(ring_data, src + first, n - first);
+}
+
+static void ring_get(char *dst, uint64_t pos, size_t n) {
+    size_t off = pos & ring_mask;
+    size_t first = n < ring_mask + 1 - off ? n : ring_mask + 1 - off;
+    memcpy(dst, ring_data + off, first);
+    memcpy(dst + first, ring_data, n - first);
+}
+
+static uint64_t ring_oldest(void) {
+    uint64_t res = __atomic_load_n(&ctrl->reserve, __ATOMIC_ACQUIRE);
+    return res > ring_mask + 1 ? res - (ring_mask + 1) : 0;
+}
+
+static void *mmap_writer_main(void *arg) {
+    struct worker *w = arg;
+    char *buf = malloc(block);
+    if (!buf)
+        return NULL;
+    memset(buf, 'w', block);
+
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+        uint64_t start = __atomic_fetch_add(&ctrl->reserve, block, __ATOMIC_SEQ_CST);
+        ring_put(start, buf, block);
+        // Писатель в ядре пропускает зависший диапазон по таймауту
+        // (commit уйдёт дальше start) — тогда публиковать уже нечего,
+        // а CAS не даст сдвинуть commit назад
+        uint64_t c = start;
+        while (!__atomic_compare_exchange_n(&ctrl->commit, &c, start + block, 0,
+                                            __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) {
+            if (c > start)
+                break;
+            c = start;
+            __builtin_ia32_pause();
+        }
+        if (c > start)
+            continue;
+        // Пара к atomic_inc(waiters) + smp_mb в ядре: будим, только если кто-то спит
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&ctrl->waiters, __ATOMIC_RELAXED))
+            ioctl(w->fd, CHARDEV_IOC_NOTIFY);
+        w->bytes += block;
+    }
+    free(buf);
+    return NULL;
+}
+
+static void *mmap_reader_main(void *arg) {
+    struct worker *w = arg;
+    char *buf = malloc(block);
+    if (!buf)
+        return NULL;
+
+    uint64_t cursor = ring_oldest();
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+        uint64_t head = __atomic_load_n(&ctrl->commit, __ATOMIC_ACQUIRE);
+        if (head == cursor) {
+            // Спим в ядре; main в конце пишет байт, чтобы разбудить всех
+            ioctl(w->fd, CHARDEV_IOC_WAIT, &cursor);
+            continue;
+        }
+        uint64_t oldest = ring_oldest();
+        if (cursor < oldest)
+            cursor = oldest;
+        if (cursor >= head)
+            continue;
+        size_t n = head - cursor < block ? (size_t)(head - cursor) : block;
+        ring_get(buf, cursor, n);
+        if (cursor < ring_oldest())
+            continue;           // затёрто во время копирования — повторить
+        cursor += n;
+        w->bytes += n;
+    }
+    free(buf);
+    return NULL;
+}
+
+static void *writer_main(void *arg) {
+    struct worker *w = arg;
+    char *buf = malloc(block);
+    if (!buf)
+        return NULL;
+    memset(buf, 'w', block);
+
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+        ssize_t n = write(w->fd, buf, block);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("write");
+            break;
+        }
+        w->bytes += (uint64_t)n;
+    }
+    free(buf);
+    return NULL;
+}
+
+static void *reader_main(void *arg) {
+    struct worker *w = arg;
+    char *buf = malloc(block);
+    if (!buf)
+        return NULL;
+
+    struct pollfd pfd = { .fd = w->fd, .events = POLLIN };
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+        // poll с таймаутом, чтобы заметить stop даже без новых данных
+        int pr = poll(&pfd, 1, 100);
+        if (pr <= 0)
+            continue;
+        ssize_t n = read(w->fd, buf, block);
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            perror("read");
+            break;
+        }
+        w->bytes += (uint64_t)n;
+    }
+    free(buf);
+    return NULL;
+}
+
+static void print_usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-d DEVICE] [-m] [-w WRITERS] [-r READERS] [-b BYTES] [-t SEC]\n"
+            "  -m  exchange data through mmap() instead of read()/write()\n",
+            prog);
+}
+
+int main(int argc, char **argv) {
+    int writers = 1, readers = 1, duration = 5, use_mmap = 0;
+
+    int c;
+    while ((c = getopt(argc, argv, "d:mw:r:b:t:h")) != -1) {
+        switch (c) {
+            case 'd': dev_path = optarg; break;
+            case 'm': use_mmap = 1; break;
+            case 'w': writers = atoi(optarg); break;
+            case 'r': readers = atoi(optarg); break;
+            case 'b': block = (size_t)atol(optarg); break;
+            case 't': duration = atoi(optarg); break;
+            default: print_usage(argv[0]); return 1;
+        }
+    }
+    if (writers < 0 || readers < 0 || block == 0 || duration <= 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    struct worker *ws = calloc((size_t)(writers + readers), sizeof(*ws));
+    if (!ws)
+        return 1;
+
+    // MAP_SHARED + PROT_WRITE требует fd, открытый на чтение и запись
+    int ctl_fd = open(dev_path, O_RDWR);
+    if (ctl_fd < 0) {
+        perror(dev_path);
+        return 1;
+    }
+    for (int i = 0; i < writers + readers; i++) {
+        int flags = use_mmap ? O_RDWR : (i < writers ? O_WRONLY : (O_RDONLY | O_NONBLOCK));
+        ws[i].fd = open(dev_path, flags);
+        if (ws[i].fd < 0) {
+            perror(dev_path);
+            return 1;
+        }
+    }
+    if (use_mmap && map_ring(ctl_fd) < 0)
+        return 1;
+
+    void *(*wfn)(void *) = use_mmap ? mmap_writer_main : writer_main;
+    void *(*rfn)(void *) = use_mmap ? mmap_reader_main : reader_main;
+
+    double t0 = now_sec();
+    for (int i = 0; i < writers + readers; i++)
+        pthread_create(&ws[i].thread, NULL, i < writers ? wfn : rfn, &ws[i]);
+
+    sleep((unsigned)duration);
+    atomic_store(&stop, 1);
+
+    for (int i = 0; i < writers; i++)
+        pthread_join(ws[i].thread, NULL);
+    double elapsed = now_sec() - t0;
+    // Читатели в CHARDEV_IOC_WAIT проснутся от нового байта
+    if (use_mmap && write(ctl_fd, "", 1) < 0)
+        perror("write");
+    for (int i = writers; i < writers + readers; i++)
+        pthread_join(ws[i].thread, NULL);
+    close(ctl_fd);
+
+    uint64_t wbytes = 0, rbytes = 0;
+    for (int i = 0; i < writers + readers; i++) {
+        if (i < writers)
+            wbytes += ws[i].bytes;
+        else
+            rbytes += ws[i].bytes;
+        close(ws[i].fd);
+    }
+
+    printf("mode=%s writers=%d readers=%d block=%zu time=%.2fs\n",
+           use_mmap ? "mmap" : "read/write", writers, readers, block, elapsed);
+    printf("write: %10.1f MB/s\n", wbytes / elapsed / 1e6);
+    printf("read:  %10.1f MB/s total, %.1f MB/s per reader\n",
+           rbytes / elapsed / 1e6, readers ? rbytes / elapsed / 1e6 / readers : 0.0);
+    if (readers && wbytes)
+        printf("delivered: %.1f%% of written bytes per reader (rest overwritten)\n",
+               100.0 * rbytes / readers / wbytes);
+
+    free(ws);
+    return 0;
+}
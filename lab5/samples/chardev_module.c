@@ -1,16 +1,36 @@
 /*
- * chardev_module.c - Простой character device
+ * chardev_module.c - Потоковый character device на кольцевом буфере
  *
  * Создаёт устройство /dev/mychardev, которое:
- * - Принимает данные при записи (до 1024 байт)
- * - Возвращает сохранённые данные при чтении
+ * - Принимает данные при записи и дописывает их в кольцевой буфер
+ *   (размер — степень двойки, параметр модуля ring_size)
+ * - У каждого открытого файла свой курсор чтения: все читатели видят
+ *   весь поток, а не только последнее сообщение
+ * - read() блокируется, пока нет новых данных (или -EAGAIN с O_NONBLOCK),
+ *   поддерживается poll()/select()/epoll
+ * - Писатели никогда не ждут читателей: при переполнении самые старые
+ *   данные перезаписываются, отставший читатель перескакивает вперёд
+ *
+ * Быстрый путь без глобального mutex:
+ * - писатель резервирует диапазон атомарным fetch_add на счётчике reserve,
+ *   копирует данные и публикует их, сдвигая commit по порядку
+ *   резервирования (store-release);
+ * - читатель читает [cursor, commit) и после копирования проверяет, не
+ *   перезаписали ли писатели прочитанный участок (как seqlock).
+ *
+ * mmap(): то же кольцо (управляющая страница + данные, см. chardev_uapi.h)
+ * отображается в user space, и процессы обмениваются данными без
+ * copy_to_user/copy_from_user и без syscalls; ioctl нужен только чтобы
+ * уснуть (CHARDEV_IOC_WAIT) или разбудить спящих (CHARDEV_IOC_NOTIFY).
  *
  * Компиляция: make
  * Использование:
- *   sudo insmod chardev_module.ko
+ *   sudo insmod chardev_module.ko ring_size=1048576
  *   sudo mknod /dev/mychardev c <MAJOR> 0
  *   echo "Hello" > /dev/mychardev
- *   cat /dev/mychardev
+ *   timeout 1 cat /dev/mychardev
+ *   ./chardev_bench -w 4 -r 2 -t 5      # пропускная способность, MB/s
+ *   ./chardev_bench -m -w 4 -r 2 -t 5   # то же через mmap, без syscalls
  *   sudo rmmod chardev_module
  */
 
@@ -20,97 +40,403 @@
 #include <linux/fs.h>
 #include <linux/cdev.h>
 #include <linux/uaccess.h>
+#include <linux/moduleparam.h>
+#include <linux/log2.h>
+#include <linux/vmalloc.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/mutex.h>
+#include <linux/atomic.h>
+#include <linux/mm.h>
+
+#include "chardev_uapi.h"
+#include "lab5_stats.h"
 
 #define DEVICE_NAME "mychardev"
-#define BUF_SIZE 1024
+#define RING_MIN_SIZE PAGE_SIZE
+#define RING_MAX_SIZE (64UL << 20)
+
+static unsigned int ring_size = 65536;
+module_param(ring_size, uint, 0444);
+MODULE_PARM_DESC(ring_size, "Ring buffer size in bytes (rounded up to a power of two)");
+
+static unsigned int commit_timeout_ms = 200;
+module_param(commit_timeout_ms, uint, 0644);
+MODULE_PARM_DESC(commit_timeout_ms, "How long a writer waits for a stalled predecessor before skipping its range");
+
+/*
+ * Позиции в потоке — монотонные 64-битные счётчики байт; индекс в буфере
+ * получаем маской (pos & ring.mask). Переполнение u64 на практике недостижимо.
+ */
+struct chardev_ring {
+    void *area;                   // vmalloc_user: управляющая страница + данные
+    struct chardev_ctrl *ctrl;    // reserve/commit/waiters, видны и через mmap
+    char *data;
+    u64 size;
+    u64 mask;
+    wait_queue_head_t read_wq;    // читатели, ждущие новых данных
+    wait_queue_head_t commit_wq;  // писатели, ждущие своей очереди на публикацию
+};
 
-// TODO: Объявите глобальные переменные:
-// - Номер устройства (dev_t dev_num)
-// - cdev структура (struct cdev my_cdev)
-// - Буфер для хранения данных (char device_buffer[BUF_SIZE])
-// - Размер данных в буфере (int buffer_size = 0)
+/* Состояние одного открытого файла (file->private_data) */
+struct chardev_reader {
+    u64 cursor;                   // позиция следующего байта для чтения
+    u64 lost;                     // сколько байт пропущено из-за перезаписи
+    struct mutex lock;            // только для потоков, делящих один fd
+};
 
 static dev_t dev_num;
 static struct cdev my_cdev;
-static char device_buffer[BUF_SIZE];
-static int buffer_size = 0;
+static struct chardev_ring ring;
+
+/*
+ * Per-CPU счётчики из proc_module (если он загружен раньше нас).
+ * symbol_get() вместо прямого вызова — чтобы не требовать proc_module.
+ */
+static void (*stats_add)(unsigned int id, u64 delta);
+
+static inline void chardev_stat(unsigned int id, u64 delta)
+{
+    if (stats_add)
+        stats_add(id, delta);
+}
+
+/* Самая старая позиция, данные с которой ещё гарантированно не затёрты */
+static u64 ring_oldest(void)
+{
+    u64 res = atomic64_read(&ring.ctrl->reserve);
+    return res > ring.size ? res - ring.size : 0;
+}
 
-// TODO: Реализуйте функцию открытия устройства
-// Вызывается при open("/dev/mychardev", ...)
 static int dev_open(struct inode *inode, struct file *file)
 {
-    // TODO: Выведите сообщение в dmesg
-    // printk(KERN_INFO "chardev: Device opened\n");
+    struct chardev_reader *r;
+
+    r = kzalloc(sizeof(*r), GFP_KERNEL);
+    if (!r)
+        return -ENOMEM;
+
+    mutex_init(&r->lock);
+    // Новый читатель начинает с самых старых сохранённых данных
+    r->cursor = ring_oldest();
+    file->private_data = r;
+    stream_open(inode, file);   // поток: lseek/pread не имеют смысла
+    chardev_stat(LAB5_STAT_CHARDEV_OPENS, 1);
 
-    printk(KERN_INFO "chardev: Device opened (TODO: implement)\n");
-    return 0;  // 0 = успех
+    printk(KERN_INFO "chardev: Device opened\n");
+    return 0;
 }
 
-// TODO: Реализуйте функцию закрытия устройства
-// Вызывается при close()
 static int dev_release(struct inode *inode, struct file *file)
 {
-    // TODO: Выведите сообщение в dmesg
-    // printk(KERN_INFO "chardev: Device closed\n");
+    struct chardev_reader *r = file->private_data;
+
+    if (r->lost)
+        printk(KERN_INFO "chardev: Reader lost %llu bytes to overwrite\n", r->lost);
+    kfree(r);
 
-    printk(KERN_INFO "chardev: Device closed (TODO: implement)\n");
+    printk(KERN_INFO "chardev: Device closed\n");
     return 0;
 }
 
-// TODO: Реализуйте функцию чтения из устройства
-// Вызывается при read() или cat /dev/mychardev
+/* Копирование участка кольца [pos, pos+n) в user space (с переходом через конец) */
+static int ring_copy_out(char __user *buf, u64 pos, size_t n)
+{
+    size_t off = pos & ring.mask;
+    size_t first = min_t(size_t, n, ring.size - off);
+
+    if (copy_to_user(buf, ring.data + off, first))
+        return -EFAULT;
+    if (n > first && copy_to_user(buf + first, ring.data, n - first))
+        return -EFAULT;
+    return 0;
+}
+
+static int ring_copy_in(u64 pos, const char __user *buf, size_t n)
+{
+    size_t off = pos & ring.mask;
+    size_t first = min_t(size_t, n, ring.size - off);
+
+    if (copy_from_user(ring.data + off, buf, first))
+        return -EFAULT;
+    if (n > first && copy_from_user(ring.data, buf + first, n - first))
+        return -EFAULT;
+    return 0;
+}
+
+static void ring_zero(u64 pos, size_t n)
+{
+    size_t off = pos & ring.mask;
+    size_t first = min_t(size_t, n, ring.size - off);
+
+    memset(ring.data + off, 0, first);
+    if (n > first)
+        memset(ring.data, 0, n - first);
+}
+
+/*
+ * Ждём, пока commit уйдёт от cursor. waiters виден писателям через mmap:
+ * user-space писатель делает CHARDEV_IOC_NOTIFY, только если кто-то спит.
+ * Пара "inc waiters + проверка commit" / "store commit + проверка waiters"
+ * с полными барьерами с обеих сторон не теряет пробуждений.
+ */
+static int ring_wait(u64 cursor, bool nonblock)
+{
+    int ret;
+
+    if (nonblock)
+        return -EAGAIN;
+
+    chardev_stat(LAB5_STAT_CHARDEV_READ_WAITS, 1);
+    atomic_inc(&ring.ctrl->waiters);
+    smp_mb__after_atomic();
+    ret = wait_event_interruptible(ring.read_wq,
+                                   atomic64_read(&ring.ctrl->commit) != cursor);
+    atomic_dec(&ring.ctrl->waiters);
+    return ret ? -ERESTARTSYS : 0;
+}
+
 static ssize_t dev_read(struct file *file, char __user *buf,
                         size_t len, loff_t *off)
 {
-    int bytes_to_read;
-
-    // TODO: Реализуйте логику чтения:
-    //
-    // 1. Проверьте, есть ли данные для чтения (*off >= buffer_size)
-    //    Если нет, верните 0 (EOF)
-    //
-    // 2. Вычислите, сколько байт можно прочитать:
-    //    bytes_to_read = min(len, buffer_size - *off)
-    //
-    // 3. Скопируйте данные из device_buffer в user space:
-    //    if (copy_to_user(buf, device_buffer + *off, bytes_to_read))
-    //        return -EFAULT;
-    //
-    // 4. Обновите позицию чтения: *off += bytes_to_read
-    //
-    // 5. Верните количество прочитанных байт
-
-    printk(KERN_INFO "chardev: Read request (TODO: implement)\n");
-    return 0;  // TODO: вернуть реальное количество байт
+    struct chardev_reader *r = file->private_data;
+    u64 pos, head, oldest;
+    size_t n;
+    ssize_t ret;
+
+    if (len == 0)
+        return 0;
+
+    if (mutex_lock_interruptible(&r->lock))
+        return -ERESTARTSYS;
+
+    for (;;) {
+        head = atomic64_read_acquire(&ring.ctrl->commit);
+        if (head != r->cursor)
+            break;
+
+        mutex_unlock(&r->lock);
+        ret = ring_wait(r->cursor, file->f_flags & O_NONBLOCK);
+        if (ret)
+            return ret;
+        if (mutex_lock_interruptible(&r->lock))
+            return -ERESTARTSYS;
+    }
+
+    for (;;) {
+        pos = r->cursor;
+        oldest = ring_oldest();
+        if (pos < oldest) {
+            r->lost += oldest - pos;
+            chardev_stat(LAB5_STAT_CHARDEV_LOST_BYTES, oldest - pos);
+            pos = oldest;
+        } else if (pos > atomic64_read(&ring.ctrl->reserve)) {
+            // Курсор правее reserve — счётчики испортили через mmap
+            pos = oldest;
+        }
+        if (pos >= head) {
+            // Писатели зарезервировали больше кольца, но ещё не опубликовали
+            // Писатель может копировать из медленного user space (page fault),
+            // поэтому ожидание уступает CPU и прерывается сигналом
+            r->cursor = pos;
+            if (signal_pending(current)) {
+                ret = -ERESTARTSYS;
+                goto out;
+            }
+            cpu_relax();
+            cond_resched();
+            head = atomic64_read_acquire(&ring.ctrl->commit);
+            continue;
+        }
+        // head тоже приходит из mapping: больше кольца копировать нельзя
+        n = min_t(u64, min_t(u64, len, head - pos), ring.size);
+
+        if (ring_copy_out(buf, pos, n)) {
+            ret = -EFAULT;
+            goto out;
+        }
+
+        // Не перезаписали ли писатели то, что мы только что скопировали?
+        smp_rmb();
+        if (pos >= ring_oldest())
+            break;
+        r->cursor = pos;
+        head = atomic64_read_acquire(&ring.ctrl->commit);
+    }
+
+    r->cursor = pos + n;
+    chardev_stat(LAB5_STAT_CHARDEV_READS, 1);
+    chardev_stat(LAB5_STAT_CHARDEV_READ_BYTES, n);
+    ret = n;
+out:
+    mutex_unlock(&r->lock);
+    return ret;
+}
+
+/*
+ * Пропустить зависший диапазон предшественника [c, start): занулить его и
+ * сдвинуть commit на start. Данные зависшего писателя теряются, зато поток
+ * не стоит. Если тот всё же успел опубликоваться, cmpxchg не пройдёт, а
+ * читатель в худшем случае увидит нули вместо его данных.
+ */
+static void ring_skip(u64 c, u64 start)
+{
+    ring_zero(c, min_t(u64, start - c, ring.size));
+    if (atomic64_cmpxchg_release(&ring.ctrl->commit, c, start) != c)
+        return;
+    printk_ratelimited(KERN_WARNING "chardev: skipped %llu bytes of a stalled writer\n",
+                       start - c);
+    wake_up_all(&ring.commit_wq);
+}
+
+/*
+ * Опубликовать [start, start+n): дождаться commit == start и сдвинуть commit.
+ *
+ * Ожидание ограничено: предшественник мог застрять в page fault, умереть
+ * между reserve и commit или (через mmap) вообще не дойти до commit.
+ * Если commit не двигается commit_timeout_ms, его диапазон пропускается.
+ * Соседи-писатели из ядра будят commit_wq сразу; user-space писатели через
+ * mmap commit_wq не будят, поэтому сон нарезан по одному тику.
+ *
+ * Фатальный сигнал отпускает писателя сразу: он зануляет свой участок и
+ * уходит, а следующие за ним пропустят этот участок по таймауту.
+ */
+static int ring_commit(u64 start, size_t n, bool zeroed)
+{
+    unsigned long timeout = msecs_to_jiffies(commit_timeout_ms);
+    unsigned long deadline = jiffies + timeout;
+    u64 c, last = start;
+    int spins;
+
+    for (;;) {
+        c = atomic64_read_acquire(&ring.ctrl->commit);
+        if (c == start) {
+            if (atomic64_cmpxchg_release(&ring.ctrl->commit, start, start + n) == start)
+                break;
+            continue;
+        }
+        if (c > start) {
+            // commit правее всего зарезервированного — его испортили через
+            // mmap; откатываем к себе, остальные писатели опубликуются следом
+            if (c > atomic64_read(&ring.ctrl->reserve)) {
+                if (atomic64_cmpxchg(&ring.ctrl->commit, c, start) == c)
+                    printk_ratelimited(KERN_WARNING "chardev: commit %llu beyond reserve, reset to %llu\n",
+                                       c, start);
+                continue;
+            }
+            return -ETIMEDOUT;  // нас самих пропустили по таймауту
+        }
+        if (c != last) {        // предшественники двигаются — таймаут заново
+            last = c;
+            deadline = jiffies + timeout;
+        }
+        if (fatal_signal_pending(current)) {
+            if (!zeroed)
+                ring_zero(start, n);
+            return -EINTR;
+        }
+        if (time_after_eq(jiffies, deadline)) {
+            ring_skip(c, start);
+            continue;
+        }
+
+        // Обычно предшественник дописывает за микросекунды: сначала крутимся
+        for (spins = 0; spins < 100 && atomic64_read(&ring.ctrl->commit) == c; spins++)
+            cpu_relax();
+        if (spins < 100)
+            continue;
+
+        wait_event_killable_timeout(ring.commit_wq,
+                                    atomic64_read(&ring.ctrl->commit) != c, 1);
+    }
+
+    if (wq_has_sleeper(&ring.commit_wq))
+        wake_up_all(&ring.commit_wq);
+    if (wq_has_sleeper(&ring.read_wq))
+        wake_up_interruptible(&ring.read_wq);
+    return 0;
 }
 
-// TODO: Реализуйте функцию записи в устройство
-// Вызывается при write() или echo "text" > /dev/mychardev
 static ssize_t dev_write(struct file *file, const char __user *buf,
                          size_t len, loff_t *off)
 {
-    int bytes_to_write;
-
-    // TODO: Реализуйте логику записи:
-    //
-    // 1. Вычислите, сколько байт можно записать (не больше BUF_SIZE):
-    //    bytes_to_write = min(len, BUF_SIZE)
-    //
-    // 2. Очистите буфер перед записью (необязательно, но удобно):
-    //    memset(device_buffer, 0, BUF_SIZE);
-    //
-    // 3. Скопируйте данные из user space в device_buffer:
-    //    if (copy_from_user(device_buffer, buf, bytes_to_write))
-    //        return -EFAULT;
-    //
-    // 4. Сохраните размер данных: buffer_size = bytes_to_write
-    //
-    // 5. Выведите сообщение (опционально)
-    //
-    // 6. Верните количество записанных байт
-
-    printk(KERN_INFO "chardev: Write request (TODO: implement)\n");
-    return len;  // TODO: вернуть реальное количество байт
+    u64 start;
+    size_t n = min_t(size_t, len, ring.size);
+    int err, ret;
+
+    if (n == 0)
+        return 0;
+
+    // 1. Резервируем [start, start+n) — единственная атомарная операция
+    start = atomic64_fetch_add(n, &ring.ctrl->reserve);
+
+    // 2. Копируем без блокировок: участки разных писателей не пересекаются
+    err = ring_copy_in(start, buf, n);
+    if (err)
+        ring_zero(start, n);
+
+    // 3. Публикуем строго по порядку резервирования (см. ring_commit)
+    ret = ring_commit(start, n, err != 0);
+    if (ret)
+        return ret;
+    if (err)
+        return err;
+    chardev_stat(LAB5_STAT_CHARDEV_WRITES, 1);
+    chardev_stat(LAB5_STAT_CHARDEV_WRITE_BYTES, n);
+    return n;
+}
+
+/*
+ * mmap(): управляющая страница + данные кольца одним отображением.
+ * Память выделена vmalloc_user(), поэтому годится remap_vmalloc_range().
+ */
+static int dev_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    unsigned long len = vma->vm_end - vma->vm_start;
+
+    // На 32-битных архитектурах atomic64_t может быть реализован через
+    // spinlock ядра — user-space атомарные операции с ним не согласованы
+    if (!IS_ENABLED(CONFIG_64BIT))
+        return -ENODEV;
+    if (vma->vm_pgoff != 0 || len > PAGE_SIZE + ring.size)
+        return -EINVAL;
+
+    chardev_stat(LAB5_STAT_CHARDEV_MMAPS, 1);
+    return remap_vmalloc_range(vma, ring.area, 0);
+}
+
+static long dev_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+    u64 cursor;
+
+    switch (cmd) {
+    case CHARDEV_IOC_NOTIFY:
+        chardev_stat(LAB5_STAT_CHARDEV_NOTIFIES, 1);
+        wake_up_interruptible(&ring.read_wq);
+        wake_up_all(&ring.commit_wq);
+        return 0;
+    case CHARDEV_IOC_WAIT:
+        if (copy_from_user(&cursor, (void __user *)arg, sizeof(cursor)))
+            return -EFAULT;
+        if (atomic64_read_acquire(&ring.ctrl->commit) != cursor)
+            return 0;
+        return ring_wait(cursor, file->f_flags & O_NONBLOCK);
+    default:
+        return -ENOTTY;
+    }
+}
+
+static __poll_t dev_poll(struct file *file, poll_table *wait)
+{
+    struct chardev_reader *r = file->private_data;
+    __poll_t mask = EPOLLOUT | EPOLLWRNORM;   // писатели никогда не блокируются
+
+    poll_wait(file, &ring.read_wq, wait);
+    if (atomic64_read_acquire(&ring.ctrl->commit) != READ_ONCE(r->cursor))
+        mask |= EPOLLIN | EPOLLRDNORM;
+    return mask;
 }
 
 // Таблица операций для устройства
@@ -120,58 +446,74 @@ static struct file_operations fops = {
     .release = dev_release,
     .read = dev_read,
     .write = dev_write,
+    .poll = dev_poll,
+    .mmap = dev_mmap,
+    .unlocked_ioctl = dev_ioctl,
 };
 
-// TODO: Функция инициализации модуля
 static int __init chardev_init(void)
 {
     int ret;
 
     printk(KERN_INFO "chardev: Initializing\n");
 
-    // TODO: 1. Выделить major и minor номера
-    // alloc_chrdev_region выделяет диапазон номеров устройств
-    //
-    // ret = alloc_chrdev_region(&dev_num, 0, 1, DEVICE_NAME);
-    // if (ret < 0) {
-    //     printk(KERN_ERR "chardev: Failed to allocate major number\n");
-    //     return ret;
-    // }
-    //
-    // printk(KERN_INFO "chardev: Registered with major number %d\n", MAJOR(dev_num));
-
-    // TODO: 2. Инициализировать cdev структуру
-    // cdev_init связывает cdev с file_operations
-    //
-    // cdev_init(&my_cdev, &fops);
-    // my_cdev.owner = THIS_MODULE;
-
-    // TODO: 3. Добавить cdev в систему
-    // cdev_add регистрирует устройство в ядре
-    //
-    // ret = cdev_add(&my_cdev, dev_num, 1);
-    // if (ret < 0) {
-    //     unregister_chrdev_region(dev_num, 1);
-    //     printk(KERN_ERR "chardev: Failed to add cdev\n");
-    //     return ret;
-    // }
-
-    printk(KERN_INFO "chardev: Device registered (TODO: implement registration)\n");
-    printk(KERN_INFO "chardev: Create device with: mknod /dev/%s c <MAJOR> 0\n", DEVICE_NAME);
+    ring.size = clamp_t(u64, roundup_pow_of_two(max(ring_size, 1U)),
+                        RING_MIN_SIZE, RING_MAX_SIZE);
+    ring.mask = ring.size - 1;
+    ring.area = vmalloc_user(PAGE_SIZE + ring.size);   // обнулена
+    if (!ring.area)
+        return -ENOMEM;
+    ring.ctrl = ring.area;
+    ring.data = (char *)ring.area + PAGE_SIZE;
+    ring.ctrl->version = CHARDEV_CTRL_VERSION;
+    ring.ctrl->size = ring.size;
+    ring.ctrl->data_offset = PAGE_SIZE;
+    init_waitqueue_head(&ring.read_wq);
+    init_waitqueue_head(&ring.commit_wq);
+    // До cdev_add(): после него устройство уже могут открыть
+    stats_add = symbol_get(lab5_stats_add);
+
+    ret = alloc_chrdev_region(&dev_num, 0, 1, DEVICE_NAME);
+    if (ret < 0) {
+        printk(KERN_ERR "chardev: Failed to allocate major number\n");
+        goto err_free;
+    }
+
+    printk(KERN_INFO "chardev: Registered with major number %d\n", MAJOR(dev_num));
+
+    cdev_init(&my_cdev, &fops);
+    my_cdev.owner = THIS_MODULE;
 
+    ret = cdev_add(&my_cdev, dev_num, 1);
+    if (ret < 0) {
+        printk(KERN_ERR "chardev: Failed to add cdev\n");
+        goto err_region;
+    }
+
+    printk(KERN_INFO "chardev: Ring buffer %llu bytes, stats %s\n", ring.size,
+           stats_add ? "in /proc/lab5/stats" : "off (proc_module not loaded)");
+    printk(KERN_INFO "chardev: Create device with: mknod /dev/%s c %d 0\n",
+           DEVICE_NAME, MAJOR(dev_num));
     return 0;
+
+err_region:
+    unregister_chrdev_region(dev_num, 1);
+err_free:
+    if (stats_add)
+        symbol_put(lab5_stats_add);
+    vfree(ring.area);
+    return ret;
 }
 
-// TODO: Функция выгрузки модуля
 static void __exit chardev_exit(void)
 {
-    // TODO: 1. Удалить cdev из системы
-    // cdev_del(&my_cdev);
+    cdev_del(&my_cdev);
+    unregister_chrdev_region(dev_num, 1);
+    vfree(ring.area);
+    if (stats_add)
+        symbol_put(lab5_stats_add);
 
-    // TODO: 2. Освободить major и minor номера
-    // unregister_chrdev_region(dev_num, 1);
-
-    printk(KERN_INFO "chardev: Device unregistered (TODO: implement cleanup)\n");
+    printk(KERN_INFO "chardev: Device unregistered\n");
 }
 
 module_init(chardev_init);
@@ -179,86 +521,42 @@ module_exit(chardev_exit);
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Your Name");  // TODO: Ваше имя
-MODULE_DESCRIPTION("Simple character device driver");
-MODULE_VERSION("1.0");
+MODULE_DESCRIPTION("Streaming character device with a lock-free ring buffer");
+MODULE_VERSION("2.0");
 
 /*
- * ЗАДАНИЯ для студента:
- *
- * 1. Реализуйте все TODO в коде выше
- *
- * 2. В dev_read():
- *    - Проверьте границы (не читаем за пределы буфера)
- *    - Используйте copy_to_user для копирования данных
- *    - Правильно обрабатывайте *off (позицию чтения)
- *
- * 3. В dev_write():
- *    - Ограничьте запись размером BUF_SIZE
- *    - Используйте copy_from_user для копирования данных
- *    - Сохраните реальный размер данных
- *
- * 4. В chardev_init():
- *    - Выделите major/minor с помощью alloc_chrdev_region
- *    - Инициализируйте cdev
- *    - Добавьте cdev в систему
- *    - Обрабатывайте ошибки (если что-то пошло не так, откатите действия)
+ * ПРОВЕРКА:
  *
- * 5. В chardev_exit():
- *    - Удалите cdev
- *    - Освободите номера устройств
- *
- * 6. Протестируйте:
- *    $ make
- *    $ sudo insmod chardev_module.ko
+ *    $ make && make chardev_bench
+ *    $ sudo insmod chardev_module.ko ring_size=1048576
  *    $ dmesg | tail -5
  *    # Найдите MAJOR number в выводе
  *    $ sudo mknod /dev/mychardev c <MAJOR> 0
  *    $ sudo chmod 666 /dev/mychardev
- *    $ echo "Hello, kernel!" > /dev/mychardev
- *    $ cat /dev/mychardev
- *    $ dmesg | tail -10
+ *    $ echo "Test" > /dev/mychardev
+ *    $ echo "New data" > /dev/mychardev
+ *    $ timeout 1 cat /dev/mychardev      # cat блокируется в ожидании данных
+ *    Test
+ *    New data
+ *    $ ./chardev_bench -w 4 -r 2 -t 5
  *    $ sudo rm /dev/mychardev
  *    $ sudo rmmod chardev_module
  *
- * ОЖИДАЕМЫЙ РЕЗУЛЬТАТ:
- *
- * $ echo "Test" > /dev/mychardev
- * $ cat /dev/mychardev
- * Test
- *
- * $ echo "New data" > /dev/mychardev
- * $ cat /dev/mychardev
- * New data
- *
- * $ dmesg | tail -10
- * [12345.678] chardev: Device opened
- * [12345.679] chardev: Write request
- * [12345.680] chardev: Device closed
- * [12346.789] chardev: Device opened
- * [12346.790] chardev: Read request
- * [12346.791] chardev: Device closed
- *
- * ЧАСТЫЕ ОШИБКИ:
- *
- * 1. "No such device" при cat:
- *    - Проверьте, что mknod выполнен с правильным MAJOR
- *    - Проверьте ls -l /dev/mychardev
+ * Два терминала:
+ *    $ cat /dev/mychardev                # ждёт
+ *    $ echo "live" > /dev/mychardev      # в первом терминале появится "live"
  *
- * 2. "Permission denied":
- *    - Выполните: sudo chmod 666 /dev/mychardev
+ * ВОПРОСЫ ДЛЯ РАЗБОРА:
  *
- * 3. Пустой вывод при cat:
- *    - Проверьте, что dev_write правильно сохранил данные
- *    - Проверьте buffer_size
+ * 1. Почему позиции хранятся как u64, а не как индекс в буфере?
+ *    (Не нужно отличать "пусто" от "полно"; вычитание даёт объём данных.)
  *
- * 4. Kernel panic при чтении/записи:
- *    - Проверьте границы массивов
- *    - Убедитесь, что используете copy_to_user/copy_from_user
+ * 2. Зачем писателю ждать commit == start перед публикацией?
+ *    (Читатель не должен увидеть дыру, пока более ранний писатель ещё копирует.)
  *
- * ДОПОЛНИТЕЛЬНО (*):
+ * 3. Почему проверка перезаписи делается ПОСЛЕ copy_to_user()?
+ *    (Писатель мог затереть участок во время копирования; если так — повторяем.)
  *
- * - Добавьте поддержку lseek (изменение позиции чтения)
- * - Добавьте ioctl для управления устройством
- * - Сделайте буфер динамическим (kmalloc вместо статического массива)
- * - Добавьте mutex для защиты от одновременного доступа
+ * 4. Что будет, если писатель упадёт с -EFAULT посередине?
+ *    (Участок обнуляется и всё равно публикуется, иначе остальные писатели зависнут.)
  */
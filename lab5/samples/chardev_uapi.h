@@ -0,0 +1,56 @@
+/*
+ * chardev_uapi.h - общий для модуля и user space интерфейс /dev/mychardev
+ *
+ * mmap() устройства с offset 0 отображает:
+ *   [0, PAGE_SIZE)                      — управляющая страница struct chardev_ctrl
+ *   [data_offset, data_offset + size)   — данные кольцевого буфера
+ *
+ * Позиции reserve/commit — монотонные счётчики байт, индекс в данных —
+ * pos & (size - 1). Протокол тот же, что у read()/write() внутри модуля:
+ *   писатель: start = fetch_add(reserve, n); копирует; ждёт commit == start;
+ *             store-release commit = start + n; если waiters > 0 — NOTIFY
+ *             (если commit уже > start — диапазон пропущен, см. ниже)
+ *   читатель: head = load-acquire commit; копирует [cursor, head);
+ *             если cursor < reserve - size — данные затёрты, повторить
+ *
+ * Кто может писать в mapping, может испортить поток для всех, но не ядро:
+ * модуль не доверяет счётчикам из управляющей страницы. Писатель в ядре
+ * ждёт предшественника не дольше commit_timeout_ms и потом пропускает
+ * (зануляет) его диапазон, commit > reserve считается порчей и
+ * откатывается, а read() никогда не копирует больше size байт.
+ */
+
+#ifndef CHARDEV_UAPI_H
+#define CHARDEV_UAPI_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+#define CHARDEV_CTRL_VERSION 1
+
+struct chardev_ctrl {
+    /* Каждый счётчик на своей кэш-линии: писатели бьют в reserve, читатели — в commit */
+#ifdef __KERNEL__
+    atomic64_t reserve;
+    __u8 pad0[56];
+    atomic64_t commit;
+    __u8 pad1[56];
+    atomic_t waiters;           // сколько читателей спит в read()/CHARDEV_IOC_WAIT
+#else
+    __u64 reserve;
+    __u8 pad0[56];
+    __u64 commit;
+    __u8 pad1[56];
+    __u32 waiters;
+#endif
+    __u32 version;
+    __u64 size;                 // размер данных, степень двойки
+    __u64 data_offset;          // смещение данных в mapping (= PAGE_SIZE)
+};
+
+/* Разбудить читателей после публикации через mmap */
+#define CHARDEV_IOC_NOTIFY  _IO('k', 1)
+/* Спать, пока commit == *cursor (или -EAGAIN при O_NONBLOCK) */
+#define CHARDEV_IOC_WAIT    _IOW('k', 2, __u64)
+
+#endif /* CHARDEV_UAPI_H */
@@ -0,0 +1,49 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Перевод /proc/kbench/results (kbench_module) в CSV.
+#
+# Usage:
+#   bash kbench_csv.sh [FILE]           # сводка: строка на workload/size/phase
+#   bash kbench_csv.sh --hist [FILE]    # гистограмма: строка на непустую корзину
+#
+# FILE по умолчанию /proc/kbench/results. Колонки сводки берутся из первой
+# строки result, так что новые поля модуля попадают в CSV без правки скрипта.
+# В --hist le_ns — верхняя граница корзины, count — число пачек (batch операций).
+
+mode=summary
+if [[ "${1:-}" == "--hist" ]]; then
+  mode=hist
+  shift
+fi
+file="${1:-/proc/kbench/results}"
+
+awk -v mode="${mode}" '
+  # "key=value" -> значение; поля без "=" пропускаются
+  function val(f) { return substr(f, index(f, "=") + 1) }
+  function key(f) { return substr(f, 1, index(f, "=") - 1) }
+
+  mode == "summary" && $1 == "result" {
+    if (!header) {
+      line = ""
+      for (i = 2; i <= NF; i++) line = line (i > 2 ? "," : "") key($i)
+      print line
+      header = 1
+    }
+    line = ""
+    for (i = 2; i <= NF; i++) line = line (i > 2 ? "," : "") val($i)
+    print line
+  }
+
+  mode == "hist" && $1 == "hist" {
+    if (!header) {
+      print "workload,size,phase,le_ns,count"
+      header = 1
+    }
+    prefix = val($2) "," val($3) "," val($4)
+    for (i = 5; i <= NF; i++) {
+      split($i, kv, ":")
+      print prefix "," kv[1] "," kv[2]
+    }
+  }
+' "${file}"
@@ -0,0 +1,927 @@
+/*
+ * kbench_module.c - микробенчмарки ядра на kthread'ах, по одному на CPU
+ *
+ * Вырос из hello_module: параметры модуля задают не приветствие, а нагрузку.
+ * Сколько стоят операции, из которых состоят драйверы lab5:
+ *   kmalloc       kmalloc/kfree объекта размера size
+ *   kmem_cache    то же из собственного (не слитого с kmalloc-N) kmem_cache на каждый размер
+ *   percpu_pool   per-CPU стек готовых объектов, kmalloc только при промахе
+ *   copy_user     copy_to_user/copy_from_user в буфер процесса, запустившего замер
+ *   spinlock      чтение общей структуры под spinlock, write_pct% пачек — запись
+ *   mutex         то же под mutex
+ *   rcu           чтение под rcu_read_lock, запись — копия + rcu_assign_pointer + kfree_rcu
+ *
+ * Запуск: echo run > /proc/kbench/ctl. Запись возвращается, когда все замеры
+ * закончились. Результаты — /proc/kbench/results: строка result со сводкой
+ * (p50/p90/p99/p99.9) и строка hist с гистограммой на каждую фазу.
+ * kbench_csv.sh переводит их в CSV.
+ *
+ * Потоки: threads штук (0 — по одному на каждый online CPU), каждый привязан
+ * к своему CPU через kthread_bind и стартует по общему флагу, так что
+ * конкуренция за lock/slab начинается одновременно.
+ *
+ * Время: ktime_get_ns() вокруг пачки из batch операций, в гистограмму идёт
+ * среднее на операцию в пачке. Сам ktime_get_ns стоит 15-30 нс, столько же,
+ * сколько kmalloc из per-CPU кэша. Цена таймера меряется перед запуском и
+ * выводится в заголовке (timer_ns) — на неё делится одна пачка, не операция.
+ *
+ * Требуется ядро >= 5.8 (proc_ops, kthread_use_mm).
+ *
+ * Компиляция: make
+ * Использование:
+ *   sudo insmod kbench_module.ko workloads=kmalloc,kmem_cache,percpu_pool sizes=64,256,4096 iterations=200000
+ *   echo run | sudo tee /proc/kbench/ctl
+ *   cat /proc/kbench/results
+ *   ./kbench_csv.sh /proc/kbench/results > kbench.csv
+ *   sudo rmmod kbench_module
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/moduleparam.h>
+#include <linux/kthread.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/mman.h>
+#include <linux/sched/mm.h>
+#include <linux/percpu.h>
+#include <linux/cpumask.h>
+#include <linux/completion.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/rcupdate.h>
+#include <linux/timekeeping.h>
+#include <linux/uaccess.h>
+#include <linux/delay.h>
+#include <linux/math64.h>
+
+#define KB_PROC_DIR     "kbench"
+#define KB_MAX_SIZES    8
+#define KB_MAX_BATCH    64          // объектов в пачке и в per-CPU пуле
+#define KB_MAX_THREADS  256
+#define KB_MAX_SIZE     (1U << 20)
+#define KB_MAX_RESULTS  128
+#define KB_SUB_BITS     3           // 8 корзин на степень двойки, ошибка <= 12.5%
+#define KB_BUCKETS      ((40 - KB_SUB_BITS + 2) << KB_SUB_BITS)
+
+/* ---------- Параметры ---------- */
+
+static char *workloads = "all";
+module_param(workloads, charp, 0644);
+MODULE_PARM_DESC(workloads, "Comma-separated: kmalloc,kmem_cache,percpu_pool,copy_user,spinlock,mutex,rcu or all");
+
+static unsigned int sizes[KB_MAX_SIZES] = { 64, 256, 1024, 4096 };
+static int nr_sizes = 4;
+module_param_array(sizes, uint, &nr_sizes, 0644);
+MODULE_PARM_DESC(sizes, "Object/copy sizes in bytes for the sized workloads (8..1048576)");
+
+static unsigned int iterations = 100000;
+module_param(iterations, uint, 0644);
+MODULE_PARM_DESC(iterations, "Operations per thread per workload and size");
+
+static unsigned int threads;
+module_param(threads, uint, 0644);
+MODULE_PARM_DESC(threads, "Kthreads, bound round-robin to online CPUs (0 = one per online CPU)");
+
+static unsigned int batch = 16;
+module_param(batch, uint, 0644);
+MODULE_PARM_DESC(batch, "Operations per timed batch (1..64)");
+
+static unsigned int write_pct = 10;
+module_param(write_pct, uint, 0644);
+MODULE_PARM_DESC(write_pct, "Share of write batches for spinlock/mutex/rcu, percent");
+
+/* ---------- Нагрузки ---------- */
+
+enum kb_workload {
+    KB_KMALLOC,
+    KB_KMEM_CACHE,
+    KB_PERCPU_POOL,
+    KB_COPY_USER,
+    KB_SPINLOCK,
+    KB_MUTEX,
+    KB_RCU,
+    KB_NR_WORKLOADS
+};
+
+static const struct {
+    const char *name;
+    bool sized;                 // перебирать sizes или один прогон
+    const char *phase[2];
+} kb_workloads[KB_NR_WORKLOADS] = {
+    [KB_KMALLOC]     = { "kmalloc",     true,  { "alloc", "free" } },
+    [KB_KMEM_CACHE]  = { "kmem_cache",  true,  { "alloc", "free" } },
+    [KB_PERCPU_POOL] = { "percpu_pool", true,  { "alloc", "free" } },
+    [KB_COPY_USER]   = { "copy_user",   true,  { "to_user", "from_user" } },
+    [KB_SPINLOCK]    = { "spinlock",    false, { "read", "write" } },
+    [KB_MUTEX]       = { "mutex",       false, { "read", "write" } },
+    [KB_RCU]         = { "rcu",         false, { "read", "write" } },
+};
+
+struct kb_hist {
+    u64 count, sum, min, max;
+    u64 b[KB_BUCKETS];
+};
+
+struct kb_pool {
+    unsigned int n;
+    void *objs[KB_MAX_BATCH];
+};
+
+/* Общие данные для spinlock/mutex/rcu */
+struct kb_data {
+    u64 v[8];
+    struct rcu_head rcu;
+};
+
+static DEFINE_SPINLOCK(kb_spin);
+static DEFINE_MUTEX(kb_mutex);
+static struct kb_data kb_locked;
+static struct kb_data __rcu *kb_rcu_ptr;
+
+struct kb_run;
+
+struct kb_thread {
+    struct task_struct *task;
+    struct kb_run *run;
+    unsigned int idx;
+    u64 rng;
+    u64 sink;                   // чтобы компилятор не выкинул чтения
+    int err;
+    void *kbuf;                 // copy_user: источник/приёмник в ядре
+    void *objs[KB_MAX_BATCH];
+    struct kb_hist hist[2];
+};
+
+struct kb_run {
+    enum kb_workload wl;
+    unsigned int size, iterations, batch, write_pct, nthreads;
+    atomic_t ready, remaining;
+    bool go, stop;
+    struct completion done;
+    struct kmem_cache *cache;
+    struct kb_pool __percpu *pool;
+    struct mm_struct *mm;       // copy_user: адресное пространство писателя ctl
+    unsigned long ubuf;
+    size_t ulen, ustride;
+    struct kb_thread t[];
+};
+
+struct kb_result {
+    enum kb_workload wl;
+    unsigned int size, phase, nthreads;
+    struct kb_hist h;
+};
+
+static DEFINE_MUTEX(kb_lock);   // один замер за раз; results читаются под ним же
+static struct kb_result *results;
+static unsigned int nr_results, run_id;
+static u64 run_timer_ns, run_ms;
+static unsigned int run_threads, run_batch, run_iterations, run_write_pct;
+static int run_err;
+static struct proc_dir_entry *proc_dir;
+
+/* ---------- Гистограмма ---------- */
+
+static unsigned int kb_bucket(u64 v)
+{
+    unsigned int msb;
+
+    if (v < (1U << KB_SUB_BITS))
+        return (unsigned int)v;
+    msb = fls64(v) - 1;
+    if (msb > 40)
+        return KB_BUCKETS - 1;
+    return ((msb - KB_SUB_BITS + 1) << KB_SUB_BITS) |
+           (unsigned int)((v >> (msb - KB_SUB_BITS)) & ((1U << KB_SUB_BITS) - 1));
+}
+
+static u64 kb_bucket_upper(unsigned int b)
+{
+    unsigned int msb;
+    u64 lo;
+
+    if (b < (1U << KB_SUB_BITS))
+        return b;
+    msb = (b >> KB_SUB_BITS) + KB_SUB_BITS - 1;
+    lo = (1ULL << msb) | ((u64)(b & ((1U << KB_SUB_BITS) - 1)) << (msb - KB_SUB_BITS));
+    return lo + (1ULL << (msb - KB_SUB_BITS)) - 1;
+}
+
+static void kb_hist_add(struct kb_hist *h, u64 v)
+{
+    if (!h->count || v < h->min)
+        h->min = v;
+    if (v > h->max)
+        h->max = v;
+    h->count++;
+    h->sum += v;
+    h->b[kb_bucket(v)]++;
+}
+
+static void kb_hist_merge(struct kb_hist *d, const struct kb_hist *s)
+{
+    unsigned int i;
+
+    if (!s->count)
+        return;
+    if (!d->count || s->min < d->min)
+        d->min = s->min;
+    if (s->max > d->max)
+        d->max = s->max;
+    d->count += s->count;
+    d->sum += s->sum;
+    for (i = 0; i < KB_BUCKETS; i++)
+        d->b[i] += s->b[i];
+}
+
+/* Верхняя граница корзины, в которую попал q-квантиль; q в промилле */
+static u64 kb_hist_pct(const struct kb_hist *h, unsigned int permille)
+{
+    u64 rank = div_u64(h->count * permille, 1000), seen = 0;
+    unsigned int i;
+
+    if (!h->count)
+        return 0;
+    if (!rank)
+        rank = 1;
+    for (i = 0; i < KB_BUCKETS; i++) {
+        seen += h->b[i];
+        if (seen >= rank)
+            return min(kb_bucket_upper(i), h->max);
+    }
+    return h->max;
+}
+
+/* ---------- Операции (одна пачка) ---------- */
+
+static u64 kb_rand(struct kb_thread *t)
+{
+    u64 x = t->rng;
+
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return t->rng = x;
+}
+
+static void *kb_pool_get(struct kb_run *r)
+{
+    struct kb_pool *p = get_cpu_ptr(r->pool);
+    void *obj = p->n ? p->objs[--p->n] : NULL;
+
+    put_cpu_ptr(r->pool);
+    return obj ? obj : kmalloc(r->size, GFP_KERNEL);
+}
+
+static void kb_pool_put(struct kb_run *r, void *obj)
+{
+    struct kb_pool *p = get_cpu_ptr(r->pool);
+
+    if (p->n < KB_MAX_BATCH) {
+        p->objs[p->n++] = obj;
+        obj = NULL;
+    }
+    put_cpu_ptr(r->pool);
+    kfree(obj);
+}
+
+static void *kb_alloc(struct kb_run *r)
+{
+    switch (r->wl) {
+    case KB_KMEM_CACHE:
+        return kmem_cache_alloc(r->cache, GFP_KERNEL);
+    case KB_PERCPU_POOL:
+        return kb_pool_get(r);
+    default:
+        return kmalloc(r->size, GFP_KERNEL);
+    }
+}
+
+static void kb_free(struct kb_run *r, void *obj)
+{
+    if (!obj)
+        return;
+    switch (r->wl) {
+    case KB_KMEM_CACHE:
+        kmem_cache_free(r->cache, obj);
+        break;
+    case KB_PERCPU_POOL:
+        kb_pool_put(r, obj);
+        break;
+    default:
+        kfree(obj);
+    }
+}
+
+/* Выделить пачку, записать по слову в каждый объект, освободить */
+static int kb_batch_alloc(struct kb_thread *t)
+{
+    struct kb_run *r = t->run;
+    unsigned int i, n = r->batch;
+    int err = 0;
+    u64 t0, t1, t2;
+
+    t0 = ktime_get_ns();
+    for (i = 0; i < n; i++) {
+        t->objs[i] = kb_alloc(r);
+        if (likely(t->objs[i]))
+            *(u64 *)t->objs[i] = i;
+    }
+    t1 = ktime_get_ns();
+    for (i = 0; i < n; i++) {
+        if (unlikely(!t->objs[i]))
+            err = -ENOMEM;
+        kb_free(r, t->objs[i]);
+    }
+    t2 = ktime_get_ns();
+    if (err)
+        return err;
+    kb_hist_add(&t->hist[0], div_u64(t1 - t0, n));
+    kb_hist_add(&t->hist[1], div_u64(t2 - t1, n));
+    return 0;
+}
+
+static int kb_batch_copy(struct kb_thread *t)
+{
+    struct kb_run *r = t->run;
+    void __user *u = (void __user *)(r->ubuf + t->idx * r->ustride);
+    unsigned int i, n = r->batch;
+    unsigned long left = 0;
+    u64 t0, t1, t2;
+
+    t0 = ktime_get_ns();
+    for (i = 0; i < n; i++)
+        left |= copy_to_user(u, t->kbuf, r->size);
+    t1 = ktime_get_ns();
+    for (i = 0; i < n; i++)
+        left |= copy_from_user(t->kbuf, u, r->size);
+    t2 = ktime_get_ns();
+    if (left)
+        return -EFAULT;
+    kb_hist_add(&t->hist[0], div_u64(t1 - t0, n));
+    kb_hist_add(&t->hist[1], div_u64(t2 - t1, n));
+    return 0;
+}
+
+static u64 kb_sum(const struct kb_data *d)
+{
+    return d->v[0] + d->v[1] + d->v[2] + d->v[3] + d->v[4] + d->v[5] + d->v[6] + d->v[7];
+}
+
+/* RCU-запись: копия, изменение, публикация; старая версия — после grace period */
+static int kb_rcu_update(unsigned int slot)
+{
+    struct kb_data *new = kmalloc(sizeof(*new), GFP_KERNEL), *old;
+
+    if (!new)
+        return -ENOMEM;
+    spin_lock(&kb_spin);
+    old = rcu_dereference_protected(kb_rcu_ptr, lockdep_is_held(&kb_spin));
+    *new = *old;
+    new->v[slot]++;
+    rcu_assign_pointer(kb_rcu_ptr, new);
+    spin_unlock(&kb_spin);
+    kfree_rcu(old, rcu);
+    return 0;
+}
+
+/* Пачка целиком из чтений или (write_pct% пачек) из записей */
+static int kb_batch_lock(struct kb_thread *t)
+{
+    struct kb_run *r = t->run;
+    unsigned int i, n = r->batch, slot = t->idx & 7;
+    bool write = (u32)kb_rand(t) % 100 < r->write_pct;
+    u64 sum = 0, t0, t1;
+    int err = 0;
+
+    t0 = ktime_get_ns();
+    switch (r->wl) {
+    case KB_SPINLOCK:
+        for (i = 0; i < n; i++) {
+            spin_lock(&kb_spin);
+            if (write)
+                kb_locked.v[slot]++;
+            else
+                sum += kb_sum(&kb_locked);
+            spin_unlock(&kb_spin);
+        }
+        break;
+    case KB_MUTEX:
+        for (i = 0; i < n; i++) {
+            mutex_lock(&kb_mutex);
+            if (write)
+                kb_locked.v[slot]++;
+            else
+                sum += kb_sum(&kb_locked);
+            mutex_unlock(&kb_mutex);
+        }
+        break;
+    default:
+        for (i = 0; i < n; i++) {
+            if (write) {
+                err = kb_rcu_update(slot);
+                if (err)
+                    break;
+            } else {
+                rcu_read_lock();
+                sum += kb_sum(rcu_dereference(kb_rcu_ptr));
+                rcu_read_unlock();
+            }
+        }
+        break;
+    }
+    t1 = ktime_get_ns();
+    t->sink += sum;
+    if (err)
+        return err;
+    kb_hist_add(&t->hist[write], div_u64(t1 - t0, n));
+    return 0;
+}
+
+/* ---------- Потоки ---------- */
+
+static int kb_thread_fn(void *arg)
+{
+    struct kb_thread *t = arg;
+    struct kb_run *r = t->run;
+    unsigned int done;
+    int (*op)(struct kb_thread *);
+
+    switch (r->wl) {
+    case KB_COPY_USER:
+        op = kb_batch_copy;
+        break;
+    case KB_SPINLOCK:
+    case KB_MUTEX:
+    case KB_RCU:
+        op = kb_batch_lock;
+        break;
+    default:
+        op = kb_batch_alloc;
+    }
+
+    if (r->wl == KB_COPY_USER) {
+        t->kbuf = kvmalloc(r->size, GFP_KERNEL);
+        if (t->kbuf) {
+            memset(t->kbuf, 0x5a, r->size);
+            kthread_use_mm(r->mm);
+        } else {
+            t->err = -ENOMEM;
+        }
+    }
+
+    /* Старт по общему флагу: все потоки начинают конкурировать вместе */
+    atomic_inc(&r->ready);
+    while (!READ_ONCE(r->go))
+        cond_resched();
+
+    for (done = 0; !t->err && done < r->iterations && !READ_ONCE(r->stop); done += r->batch) {
+        t->err = op(t);
+        cond_resched();         // вне замера; без него длинный прогон ловит soft lockup
+    }
+
+    if (r->wl == KB_COPY_USER && t->kbuf) {
+        kthread_unuse_mm(r->mm);
+        kvfree(t->kbuf);
+    }
+    if (atomic_dec_and_test(&r->remaining))
+        complete(&r->done);
+
+    /* Ждём kthread_stop: task_struct нужен вызывающему до конца */
+    set_current_state(TASK_INTERRUPTIBLE);
+    while (!kthread_should_stop()) {
+        schedule();
+        set_current_state(TASK_INTERRUPTIBLE);
+    }
+    __set_current_state(TASK_RUNNING);
+    return 0;
+}
+
+/*
+ * Кэш с флагами 0 и без конструктора slab сливает с уже существующим того же
+ * размера (kmalloc-N или другим общим) — сравнение с kmalloc потеряло бы смысл.
+ * SLAB_NO_MERGE есть с 6.5; на старых ядрах слияние запрещает любой ctor.
+ */
+#ifdef SLAB_NO_MERGE
+#define KB_CACHE_FLAGS  SLAB_NO_MERGE
+#define KB_CACHE_CTOR   NULL
+#else
+#define KB_CACHE_FLAGS  0
+static void kb_cache_ctor(void *obj)
+{
+}
+#define KB_CACHE_CTOR   kb_cache_ctor
+#endif
+
+static int kb_run_setup(struct kb_run *r)
+{
+    int cpu;
+    unsigned int i;
+
+    switch (r->wl) {
+    case KB_KMEM_CACHE: {
+        char name[32];
+
+        snprintf(name, sizeof(name), "kbench_%u", r->size);
+        r->cache = kmem_cache_create(name, r->size, 0, KB_CACHE_FLAGS, KB_CACHE_CTOR);
+        return r->cache ? 0 : -ENOMEM;
+    }
+    case KB_PERCPU_POOL:
+        r->pool = alloc_percpu(struct kb_pool);
+        if (!r->pool)
+            return -ENOMEM;
+        for_each_possible_cpu(cpu) {
+            struct kb_pool *p = per_cpu_ptr(r->pool, cpu);
+
+            for (i = 0; i < r->batch; i++) {
+                p->objs[p->n] = kmalloc(r->size, GFP_KERNEL);
+                if (!p->objs[p->n])
+                    return -ENOMEM;
+                p->n++;
+            }
+        }
+        return 0;
+    case KB_COPY_USER:
+        /* Буфер в адресном пространстве процесса, записавшего run в ctl */
+        if (!current->mm)
+            return -EINVAL;
+        r->ustride = PAGE_ALIGN(r->size);
+        r->ulen = r->ustride * r->nthreads;
+        r->ubuf = vm_mmap(NULL, 0, r->ulen, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, 0);
+        if (IS_ERR_VALUE(r->ubuf)) {
+            int err = (int)r->ubuf;
+
+            r->ubuf = 0;
+            return err;
+        }
+        r->mm = current->mm;
+        mmget(r->mm);
+        return 0;
+    default:
+        return 0;
+    }
+}
+
+static void kb_run_cleanup(struct kb_run *r)
+{
+    int cpu;
+
+    if (r->cache)
+        kmem_cache_destroy(r->cache);
+    if (r->pool) {
+        for_each_possible_cpu(cpu) {
+            struct kb_pool *p = per_cpu_ptr(r->pool, cpu);
+
+            while (p->n)
+                kfree(p->objs[--p->n]);
+        }
+        free_percpu(r->pool);
+    }
+    if (r->ubuf)
+        vm_munmap(r->ubuf, r->ulen);
+    if (r->mm)
+        mmput(r->mm);
+}
+
+/* Один прогон: нагрузка wl, размер size, все потоки. Результаты — в results[] */
+static int kb_run_one(enum kb_workload wl, unsigned int size, unsigned int nthreads)
+{
+    struct kb_run *r;
+    unsigned int i, ph;
+    int cpu, err;
+
+    if (nr_results + 2 > KB_MAX_RESULTS)
+        return -ENOSPC;
+    r = kvzalloc(struct_size(r, t, nthreads), GFP_KERNEL);
+    if (!r)
+        return -ENOMEM;
+    r->wl = wl;
+    r->size = size;
+    r->iterations = run_iterations;
+    r->batch = run_batch;
+    r->write_pct = run_write_pct;
+    r->nthreads = nthreads;
+    atomic_set(&r->ready, 0);
+    atomic_set(&r->remaining, nthreads);
+    init_completion(&r->done);
+
+    err = kb_run_setup(r);
+    if (err)
+        goto out;
+
+    cpu = cpumask_first(cpu_online_mask);
+    for (i = 0; i < nthreads; i++) {
+        struct kb_thread *t = &r->t[i];
+
+        t->run = r;
+        t->idx = i;
+        t->rng = 0x9E3779B97F4A7C15ULL * (i + 1);
+        t->task = kthread_create(kb_thread_fn, t, "kbench/%d", cpu);
+        if (IS_ERR(t->task)) {
+            err = PTR_ERR(t->task);
+            t->task = NULL;
+            break;
+        }
+        kthread_bind(t->task, cpu);
+        cpu = cpumask_next(cpu, cpu_online_mask);
+        if (cpu >= nr_cpu_ids)
+            cpu = cpumask_first(cpu_online_mask);
+    }
+    if (err) {
+        /* Ни один поток ещё не запущен: kthread_stop не даст им войти в kb_thread_fn */
+        for (i = 0; i < nthreads && r->t[i].task; i++)
+            kthread_stop(r->t[i].task);
+        goto out;
+    }
+
+    for (i = 0; i < nthreads; i++)
+        wake_up_process(r->t[i].task);
+    while (atomic_read(&r->ready) < nthreads)
+        msleep(1);
+    WRITE_ONCE(r->go, true);
+
+    if (wait_for_completion_killable(&r->done)) {
+        WRITE_ONCE(r->stop, true);
+        wait_for_completion(&r->done);
+        err = -EINTR;
+    }
+    for (i = 0; i < nthreads; i++) {
+        kthread_stop(r->t[i].task);
+        if (r->t[i].err && !err)
+            err = r->t[i].err;
+    }
+
+    for (ph = 0; ph < 2 && !err; ph++) {
+        struct kb_result *res = &results[nr_results];
+
+        memset(res, 0, sizeof(*res));
+        res->wl = wl;
+        res->size = size;
+        res->phase = ph;
+        res->nthreads = nthreads;
+        for (i = 0; i < nthreads; i++)
+            kb_hist_merge(&res->h, &r->t[i].hist[ph]);
+        if (res->h.count)
+            nr_results++;
+    }
+out:
+    kb_run_cleanup(r);
+    kvfree(r);
+    return err;
+}
+
+/* Цена пары ktime_get_ns(): минимум по 1000 замеров */
+static u64 kb_timer_cost(void)
+{
+    u64 best = U64_MAX, t0, t1;
+    int i;
+
+    for (i = 0; i < 1000; i++) {
+        t0 = ktime_get_ns();
+        t1 = ktime_get_ns();
+        best = min(best, t1 - t0);
+    }
+    return best;
+}
+
+/* Разобрать workloads: "all" или имена через запятую. Маска или -EINVAL */
+static long kb_parse_workloads(const char *s)
+{
+    long mask = 0;
+    int i;
+
+    if (!s || !*s || !strcmp(s, "all"))
+        return (1L << KB_NR_WORKLOADS) - 1;
+    while (*s) {
+        size_t len = strcspn(s, ",\n");
+
+        for (i = 0; i < KB_NR_WORKLOADS; i++)
+            if (strlen(kb_workloads[i].name) == len && !strncmp(s, kb_workloads[i].name, len))
+                break;
+        if (i == KB_NR_WORKLOADS) {
+            printk(KERN_ERR "kbench: unknown workload '%.*s'\n", (int)len, s);
+            return -EINVAL;
+        }
+        mask |= 1L << i;
+        s += len;
+        if (*s)
+            s++;
+    }
+    return mask;
+}
+
+static int kb_run_all(void)
+{
+    unsigned int run_sizes[KB_MAX_SIZES], n_sizes, nthreads, i;
+    long mask;
+    int wl, err = 0;
+    u64 start;
+
+    if (!mutex_trylock(&kb_lock))
+        return -EBUSY;
+
+    /* Снимок параметров: их можно менять через sysfs во время замера */
+    kernel_param_lock(THIS_MODULE);
+    mask = kb_parse_workloads(workloads);
+    n_sizes = min_t(unsigned int, nr_sizes, KB_MAX_SIZES);
+    memcpy(run_sizes, sizes, sizeof(run_sizes));
+    run_iterations = iterations;
+    run_batch = clamp_t(unsigned int, batch, 1, KB_MAX_BATCH);
+    run_write_pct = min_t(unsigned int, write_pct, 100);
+    nthreads = threads ? threads : num_online_cpus();
+    kernel_param_unlock(THIS_MODULE);
+
+    if (mask < 0) {
+        mutex_unlock(&kb_lock);
+        return mask;
+    }
+    nthreads = min_t(unsigned int, nthreads, KB_MAX_THREADS);
+    nr_results = 0;
+    run_id++;
+    run_threads = nthreads;
+    run_timer_ns = kb_timer_cost();
+    start = ktime_get_ns();
+
+    for (wl = 0; wl < KB_NR_WORKLOADS && !err; wl++) {
+        if (!(mask & (1L << wl)))
+            continue;
+        if (!kb_workloads[wl].sized) {
+            err = kb_run_one(wl, 0, nthreads);
+            continue;
+        }
+        for (i = 0; i < n_sizes && !err; i++) {
+            if (run_sizes[i] < sizeof(u64) || run_sizes[i] > KB_MAX_SIZE) {
+                printk(KERN_WARNING "kbench: size %u out of range, skipped\n", run_sizes[i]);
+                continue;
+            }
+            err = kb_run_one(wl, run_sizes[i], nthreads);
+        }
+        if (err)
+            printk(KERN_ERR "kbench: %s failed: %d\n", kb_workloads[wl].name, err);
+    }
+
+    run_ms = div_u64(ktime_get_ns() - start, NSEC_PER_MSEC);
+    run_err = err;
+    printk(KERN_INFO "kbench: run %u done in %llu ms, %u results\n", run_id, run_ms, nr_results);
+    mutex_unlock(&kb_lock);
+    return err;
+}
+
+/* ---------- /proc/kbench ---------- */
+
+static ssize_t kb_ctl_write(struct file *file, const char __user *ubuf,
+                            size_t count, loff_t *ppos)
+{
+    char cmd[16];
+    size_t n = min(count, sizeof(cmd) - 1);
+    int err;
+
+    if (copy_from_user(cmd, ubuf, n))
+        return -EFAULT;
+    cmd[n] = '\0';
+
+    if (!strncmp(cmd, "run", 3)) {
+        err = kb_run_all();
+    } else if (!strncmp(cmd, "clear", 5)) {
+        mutex_lock(&kb_lock);
+        nr_results = 0;
+        mutex_unlock(&kb_lock);
+        err = 0;
+    } else {
+        err = -EINVAL;
+    }
+    return err ? err : count;
+}
+
+static const struct proc_ops kb_ctl_ops = {
+    .proc_write = kb_ctl_write,
+    .proc_lseek = noop_llseek,
+};
+
+/*
+ * Одна строка result и одна строка hist на фазу. В hist пары
+ * "верхняя_граница_нс:число_пачек", только непустые корзины.
+ */
+static int kb_results_show(struct seq_file *m, void *v)
+{
+    static const unsigned int pct[] = { 500, 900, 990, 999 };
+    static const char *const pct_name[] = { "p50", "p90", "p99", "p999" };
+    unsigned int i, b, k;
+
+    if (mutex_lock_interruptible(&kb_lock))
+        return -EINTR;
+    seq_printf(m, "# kbench run=%u err=%d cpus=%u threads=%u iterations=%u batch=%u write_pct=%u timer_ns=%llu elapsed_ms=%llu kmem_cache=unmerged\n",
+               run_id, run_err, num_online_cpus(), run_threads, run_iterations, run_batch,
+               run_write_pct, run_timer_ns, run_ms);
+    for (i = 0; i < nr_results; i++) {
+        const struct kb_result *r = &results[i];
+        const char *wl = kb_workloads[r->wl].name, *ph = kb_workloads[r->wl].phase[r->phase];
+
+        seq_printf(m, "result workload=%s size=%u phase=%s threads=%u batches=%llu ops=%llu mean_ns=%llu min_ns=%llu",
+                   wl, r->size, ph, r->nthreads, r->h.count, r->h.count * run_batch,
+                   div64_u64(r->h.sum, r->h.count), r->h.min);
+        for (k = 0; k < ARRAY_SIZE(pct); k++)
+            seq_printf(m, " %s_ns=%llu", pct_name[k], kb_hist_pct(&r->h, pct[k]));
+        seq_printf(m, " max_ns=%llu\n", r->h.max);
+
+        seq_printf(m, "hist workload=%s size=%u phase=%s", wl, r->size, ph);
+        for (b = 0; b < KB_BUCKETS; b++)
+            if (r->h.b[b])
+                seq_printf(m, " %llu:%llu", kb_bucket_upper(b), r->h.b[b]);
+        seq_putc(m, '\n');
+    }
+    mutex_unlock(&kb_lock);
+    return 0;
+}
+
+static int kb_results_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, kb_results_show, NULL);
+}
+
+static const struct proc_ops kb_results_ops = {
+    .proc_open = kb_results_open,
+    .proc_read = seq_read,
+    .proc_lseek = seq_lseek,
+    .proc_release = single_release,
+};
+
+/* ---------- init/exit ---------- */
+
+static int __init kbench_init(void)
+{
+    struct kb_data *d;
+
+    results = kvcalloc(KB_MAX_RESULTS, sizeof(*results), GFP_KERNEL);
+    d = kzalloc(sizeof(*d), GFP_KERNEL);
+    if (!results || !d) {
+        kvfree(results);
+        kfree(d);
+        return -ENOMEM;
+    }
+    RCU_INIT_POINTER(kb_rcu_ptr, d);
+
+    proc_dir = proc_mkdir(KB_PROC_DIR, NULL);
+    if (!proc_dir ||
+        !proc_create("ctl", 0200, proc_dir, &kb_ctl_ops) ||
+        !proc_create("results", 0444, proc_dir, &kb_results_ops)) {
+        printk(KERN_ERR "kbench: Failed to create /proc/%s\n", KB_PROC_DIR);
+        proc_remove(proc_dir);
+        kvfree(results);
+        kfree(d);
+        return -ENOMEM;
+    }
+
+    printk(KERN_INFO "kbench: loaded, workloads=%s iterations=%u batch=%u; echo run > /proc/%s/ctl\n",
+           workloads, iterations, batch, KB_PROC_DIR);
+    return 0;
+}
+
+static void __exit kbench_exit(void)
+{
+    proc_remove(proc_dir);          // ждёт незавершённые write/read
+    rcu_barrier();                  // kfree_rcu от rcu-записей должны отработать до выгрузки
+    kfree(rcu_dereference_protected(kb_rcu_ptr, 1));
+    kvfree(results);
+    printk(KERN_INFO "kbench: unloaded\n");
+}
+
+module_init(kbench_init);
+module_exit(kbench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Your Name");  // TODO: Ваше имя
+MODULE_DESCRIPTION("Kernel microbenchmarks on per-CPU kthreads with histograms in /proc");
+MODULE_VERSION("1.0");
+
+/*
+ * ПРОВЕРКА:
+ *
+ *    $ make
+ *    $ sudo insmod kbench_module.ko workloads=kmalloc,percpu_pool,spinlock,rcu sizes=64,4096 iterations=50000
+ *    $ echo run | sudo tee /proc/kbench/ctl
+ *    $ cat /proc/kbench/results
+ *    # kbench run=1 err=0 cpus=4 threads=4 iterations=50000 batch=16 write_pct=10 timer_ns=18 elapsed_ms=412 kmem_cache=unmerged
+ *    result workload=kmalloc size=64 phase=alloc threads=4 batches=12500 ops=200000 mean_ns=21 ...
+ *    hist workload=kmalloc size=64 phase=alloc 17:310 19:4870 21:5102 ...
+ *    ...
+ *    $ echo 8 | sudo tee /sys/module/kbench_module/parameters/threads   # и снова run
+ *    $ ./kbench_csv.sh /proc/kbench/results
+ *    $ sudo rmmod kbench_module
+ *
+ * ВОПРОСЫ ДЛЯ РАЗБОРА:
+ *
+ * 1. Почему percpu_pool быстрее kmalloc, хотя SLUB тоже держит per-CPU кэш?
+ *    (Нет cmpxchg по freelist и проверок slab; цена — память, которая лежит в пуле.)
+ *
+ * 2. Почему чтение под spinlock дорожает с числом потоков, а под RCU — нет?
+ *    (Каждый spin_lock пишет в общую кэш-линию; rcu_read_lock ничего общего не пишет.)
+ *
+ * 3. Почему mutex на коротких секциях ведёт себя почти как spinlock?
+ *    (Оптимистичное ожидание: пока владелец работает на CPU, mutex крутится, а не спит.)
+ */
@@ -0,0 +1,65 @@
+/*
+ * lab5_stats.h - общие счётчики модулей lab5
+ *
+ * Счётчики живут в proc_module как per-CPU переменные: на горячем пути
+ * модуль делает только this_cpu_add() в свою копию, без атомиков и
+ * без общей кэш-линии. Суммирование по CPU — только при чтении
+ * /proc/lab5/stats (текст) или /proc/lab5/stats.bin (двоичный снимок).
+ *
+ * Другие модули берут lab5_stats_add() через symbol_get(), поэтому
+ * proc_module не обязателен: без него счётчики просто не ведутся.
+ */
+
+#ifndef LAB5_STATS_H
+#define LAB5_STATS_H
+
+#include <linux/types.h>
+
+enum lab5_stat {
+    LAB5_STAT_PROC_READS,
+    LAB5_STAT_CHARDEV_OPENS,
+    LAB5_STAT_CHARDEV_READS,
+    LAB5_STAT_CHARDEV_READ_BYTES,
+    LAB5_STAT_CHARDEV_WRITES,
+    LAB5_STAT_CHARDEV_WRITE_BYTES,
+    LAB5_STAT_CHARDEV_READ_WAITS,
+    LAB5_STAT_CHARDEV_LOST_BYTES,
+    LAB5_STAT_CHARDEV_MMAPS,
+    LAB5_STAT_CHARDEV_NOTIFIES,
+    LAB5_STAT_COUNT
+};
+
+#define LAB5_STAT_NAMES {           \
+    "proc_reads",                   \
+    "chardev_opens",                \
+    "chardev_reads",                \
+    "chardev_read_bytes",           \
+    "chardev_writes",               \
+    "chardev_write_bytes",          \
+    "chardev_read_waits",           \
+    "chardev_lost_bytes",           \
+    "chardev_mmaps",                \
+    "chardev_notifies",             \
+}
+
+/*
+ * Формат /proc/lab5/stats.bin: заголовок, затем count значений __u64
+ * в порядке enum lab5_stat. Новые счётчики добавляются только в конец.
+ */
+#define LAB5_STATS_MAGIC   0x5453354cU   /* "L5ST" little-endian */
+#define LAB5_STATS_VERSION 1
+
+struct lab5_stats_bin_hdr {
+    __u32 magic;
+    __u16 version;
+    __u16 count;
+    __u32 nr_cpus;
+    __u32 reserved;
+    __u64 timestamp_ns;     /* ktime_get_ns() на момент снимка */
+};
+
+#ifdef __KERNEL__
+void lab5_stats_add(unsigned int id, u64 delta);
+#endif
+
+#endif /* LAB5_STATS_H */
@@ -1,13 +1,24 @@
 /*
- * proc_module.c - Модуль с /proc файлом
+ * proc_module.c - /proc файлы и per-CPU статистика модулей lab5
  *
- * Создаёт файл /proc/student_info с информацией о студенте
- * и счётчиком обращений.
+ * Создаёт:
+ *   /proc/student_info     — информация о студенте и счётчик обращений
+ *   /proc/lab5/stats       — все счётчики lab5: сумма и разбивка по CPU
+ *   /proc/lab5/stats.bin   — то же в двоичном виде для сборщика метрик
+ *                            (формат — struct lab5_stats_bin_hdr в lab5_stats.h)
+ *
+ * Счётчики — DEFINE_PER_CPU: на горячем пути this_cpu_add() без атомиков
+ * и без общей кэш-линии, суммирование по CPU только при чтении.
+ * Другие модули (chardev_module) получают lab5_stats_add() через symbol_get().
+ *
+ * Вывод идёт через seq_file: ядро само режет его по размеру буфера
+ * read() и корректно ведёт *ppos, сколько бы строк ни было.
  *
  * Компиляция: make
  * Использование:
  *   sudo insmod proc_module.ko
  *   cat /proc/student_info
+ *   cat /proc/lab5/stats
  *   sudo rmmod proc_module
  */
 
@@ -15,109 +26,235 @@
 #include <linux/kernel.h>
 #include <linux/init.h>
 #include <linux/proc_fs.h>
+#include <linux/seq_file.h>
 #include <linux/uaccess.h>
 #include <linux/jiffies.h>
+#include <linux/percpu.h>
+#include <linux/cpumask.h>
+#include <linux/slab.h>
+#include <linux/timekeeping.h>
+
+#include "lab5_stats.h"
 
 #define PROC_NAME "student_info"
-#define MAX_SIZE 1024
+#define PROC_DIR "lab5"
+
+// TODO: Ваши данные
+#define STUDENT_NAME "Ivan Ivanov"
+#define STUDENT_GROUP 6
+#define STUDENT_SUBGROUP 1
+
+struct lab5_pcpu_stats {
+    u64 v[LAB5_STAT_COUNT];
+};
+
+static DEFINE_PER_CPU(struct lab5_pcpu_stats, lab5_pcpu);
 
-// TODO: Объявите глобальные переменные:
-// - Указатель на proc_dir_entry (для хранения proc файла)
-// - Счётчик обращений (int read_count = 0)
-// - Время загрузки модуля (unsigned long load_time)
+static const char *const stat_names[LAB5_STAT_COUNT] = LAB5_STAT_NAMES;
 
 static struct proc_dir_entry *proc_file = NULL;
-static int read_count = 0;
+static struct proc_dir_entry *proc_dir = NULL;
 static unsigned long load_time = 0;
 
-// TODO: Реализуйте функцию чтения из /proc файла
-// Эта функция вызывается когда кто-то делает: cat /proc/student_info
-static ssize_t proc_read(struct file *file, char __user *ubuf,
-                         size_t count, loff_t *ppos)
+/* ---------- Счётчики ---------- */
+
+void lab5_stats_add(unsigned int id, u64 delta)
 {
-    char buf[MAX_SIZE];
-    int len;
+    if (id < LAB5_STAT_COUNT)
+        this_cpu_add(lab5_pcpu.v[id], delta);
+}
+EXPORT_SYMBOL_GPL(lab5_stats_add);
 
-    // Если уже читали (повторный вызов), возвращаем 0 (EOF)
-    if (*ppos > 0)
-        return 0;
+static u64 stat_sum(unsigned int id)
+{
+    u64 sum = 0;
+    int cpu;
+
+    for_each_possible_cpu(cpu)
+        sum += READ_ONCE(per_cpu(lab5_pcpu, cpu).v[id]);
+    return sum;
+}
 
-    // TODO: Увеличьте счётчик обращений
-    // read_count++;
-
-    // TODO: Заполните buf информацией:
-    // - Ваше имя (например: "Name: Ivan Ivanov")
-    // - Группа и подгруппа (например: "Group: 6, Subgroup: 1")
-    // - Время загрузки модуля в jiffies (например: "Module loaded at: 12345 jiffies")
-    // - Счётчик обращений (например: "Read count: 3")
-    //
-    // Используйте snprintf для форматирования
-    //
-    // Пример:
-    // len = snprintf(buf, sizeof(buf),
-    //     "Name: %s\n"
-    //     "Group: %d, Subgroup: %d\n"
-    //     "Module loaded at: %lu jiffies\n"
-    //     "Read count: %d\n",
-    //     "Ivan Ivanov", 6, 1, load_time, read_count);
-
-    len = snprintf(buf, sizeof(buf),
-        "TODO: Fill with your information\n"
-        "Read count: %d\n", read_count);
-
-    // TODO: Скопируйте данные из kernel space в user space
-    // Используйте copy_to_user(ubuf, buf, len)
-    // Проверьте возвращаемое значение (если != 0, значит ошибка)
-    //
-    // if (copy_to_user(ubuf, buf, len))
-    //     return -EFAULT;
-
-    // Обновляем позицию чтения
-    *ppos = len;
-
-    return len;
+/* ---------- /proc/student_info ---------- */
+
+static int student_info_show(struct seq_file *m, void *v)
+{
+    seq_printf(m, "Name: %s\n", STUDENT_NAME);
+    seq_printf(m, "Group: %d, Subgroup: %d\n", STUDENT_GROUP, STUDENT_SUBGROUP);
+    seq_printf(m, "Module loaded at: %lu jiffies\n", load_time);
+    seq_printf(m, "Uptime: %u seconds\n", jiffies_to_msecs(jiffies - load_time) / 1000);
+    seq_printf(m, "Read count: %llu\n", stat_sum(LAB5_STAT_PROC_READS));
+    return 0;
+}
+
+static int student_info_open(struct inode *inode, struct file *file)
+{
+    // Считаем в open(): show() seq_file может вызвать повторно
+    this_cpu_inc(lab5_pcpu.v[LAB5_STAT_PROC_READS]);
+    return single_open(file, student_info_show, NULL);
 }
 
-// Структура операций для proc файла
 static const struct proc_ops proc_file_ops = {
-    .proc_read = proc_read,
+    .proc_open = student_info_open,
+    .proc_read = seq_read,
+    .proc_lseek = seq_lseek,
+    .proc_release = single_release,
 };
 
-// TODO: Функция инициализации модуля
+/* ---------- /proc/lab5/stats: итератор по счётчикам ---------- */
+
+/*
+ * Одна строка на счётчик: имя, сумма, значения по онлайн-CPU.
+ * На машине с сотнями CPU строки длинные — seq_file сам перезапустит
+ * итератор с нужной позиции, если вывод не влез в буфер read().
+ */
+static void *stats_start(struct seq_file *m, loff_t *pos)
+{
+    if (*pos == 0)
+        return SEQ_START_TOKEN;
+    return *pos <= LAB5_STAT_COUNT ? (void *)(uintptr_t)*pos : NULL;
+}
+
+static void *stats_next(struct seq_file *m, void *v, loff_t *pos)
+{
+    ++*pos;
+    return stats_start(m, pos);
+}
+
+static void stats_stop(struct seq_file *m, void *v)
+{
+}
+
+static int stats_show(struct seq_file *m, void *v)
+{
+    unsigned int id;
+    int cpu;
+
+    if (v == SEQ_START_TOKEN) {
+        char col[16];
+
+        seq_printf(m, "%-24s %20s", "counter", "total");
+        for_each_online_cpu(cpu) {
+            snprintf(col, sizeof(col), "cpu%d", cpu);
+            seq_printf(m, " %15s", col);
+        }
+        seq_putc(m, '\n');
+        return 0;
+    }
+
+    id = (unsigned int)(uintptr_t)v - 1;
+    seq_printf(m, "%-24s %20llu", stat_names[id], stat_sum(id));
+    for_each_online_cpu(cpu)
+        seq_printf(m, " %15llu", READ_ONCE(per_cpu(lab5_pcpu, cpu).v[id]));
+    seq_putc(m, '\n');
+    return 0;
+}
+
+static const struct seq_operations stats_seq_ops = {
+    .start = stats_start,
+    .next = stats_next,
+    .stop = stats_stop,
+    .show = stats_show,
+};
+
+static int stats_open(struct inode *inode, struct file *file)
+{
+    return seq_open(file, &stats_seq_ops);
+}
+
+static const struct proc_ops stats_ops = {
+    .proc_open = stats_open,
+    .proc_read = seq_read,
+    .proc_lseek = seq_lseek,
+    .proc_release = seq_release,
+};
+
+/* ---------- /proc/lab5/stats.bin: двоичный снимок ---------- */
+
+struct stats_snapshot {
+    struct lab5_stats_bin_hdr hdr;
+    __u64 values[LAB5_STAT_COUNT];
+};
+
+/*
+ * Снимок делается один раз в open(): все read() одного открытия видят
+ * согласованные данные, а сборщику не нужно парсить текст.
+ */
+static int stats_bin_open(struct inode *inode, struct file *file)
+{
+    struct stats_snapshot *snap;
+    unsigned int id;
+
+    snap = kzalloc(sizeof(*snap), GFP_KERNEL);
+    if (!snap)
+        return -ENOMEM;
+
+    snap->hdr.magic = LAB5_STATS_MAGIC;
+    snap->hdr.version = LAB5_STATS_VERSION;
+    snap->hdr.count = LAB5_STAT_COUNT;
+    snap->hdr.nr_cpus = num_possible_cpus();
+    snap->hdr.timestamp_ns = ktime_get_ns();
+    for (id = 0; id < LAB5_STAT_COUNT; id++)
+        snap->values[id] = stat_sum(id);
+
+    file->private_data = snap;
+    return 0;
+}
+
+static ssize_t stats_bin_read(struct file *file, char __user *ubuf,
+                              size_t count, loff_t *ppos)
+{
+    return simple_read_from_buffer(ubuf, count, ppos, file->private_data,
+                                   sizeof(struct stats_snapshot));
+}
+
+static int stats_bin_release(struct inode *inode, struct file *file)
+{
+    kfree(file->private_data);
+    return 0;
+}
+
+static const struct proc_ops stats_bin_ops = {
+    .proc_open = stats_bin_open,
+    .proc_read = stats_bin_read,
+    .proc_lseek = default_llseek,
+    .proc_release = stats_bin_release,
+};
+
+/* ---------- init/exit ---------- */
+
 static int __init proc_module_init(void)
 {
     printk(KERN_INFO "proc_module: Initializing\n");
 
-    // TODO: Сохраните текущее время загрузки
-    // load_time = jiffies;
+    load_time = jiffies;
 
-    // TODO: Создайте proc файл
-    // proc_create() создаёт файл в /proc
-    // Параметры: имя, права доступа, родительская директория, операции
-    //
-    // proc_file = proc_create(PROC_NAME, 0444, NULL, &proc_file_ops);
-    // if (!proc_file) {
-    //     printk(KERN_ERR "proc_module: Failed to create /proc/%s\n", PROC_NAME);
-    //     return -ENOMEM;
-    // }
+    proc_file = proc_create(PROC_NAME, 0444, NULL, &proc_file_ops);
+    if (!proc_file) {
+        printk(KERN_ERR "proc_module: Failed to create /proc/%s\n", PROC_NAME);
+        return -ENOMEM;
+    }
 
-    printk(KERN_INFO "proc_module: Created /proc/%s (TODO: implement)\n", PROC_NAME);
+    proc_dir = proc_mkdir(PROC_DIR, NULL);
+    if (!proc_dir ||
+        !proc_create("stats", 0444, proc_dir, &stats_ops) ||
+        !proc_create("stats.bin", 0444, proc_dir, &stats_bin_ops)) {
+        printk(KERN_ERR "proc_module: Failed to create /proc/%s\n", PROC_DIR);
+        proc_remove(proc_dir);      // proc_remove(NULL) безопасен
+        proc_remove(proc_file);
+        return -ENOMEM;
+    }
 
+    printk(KERN_INFO "proc_module: Created /proc/%s and /proc/%s/{stats,stats.bin}\n",
+           PROC_NAME, PROC_DIR);
     return 0;
 }
 
-// TODO: Функция выгрузки модуля
 static void __exit proc_module_exit(void)
 {
-    // TODO: Удалите proc файл
-    // Используйте proc_remove(proc_file);
-    //
-    // if (proc_file) {
-    //     proc_remove(proc_file);
-    //     printk(KERN_INFO "proc_module: Removed /proc/%s\n", PROC_NAME);
-    // }
-
-    printk(KERN_INFO "proc_module: Exiting (TODO: remove proc file)\n");
+    proc_remove(proc_dir);          // удаляет и вложенные файлы
+    proc_remove(proc_file);
+    printk(KERN_INFO "proc_module: Removed /proc/%s and /proc/%s\n", PROC_NAME, PROC_DIR);
 }
 
 module_init(proc_module_init);
@@ -125,64 +262,42 @@ module_exit(proc_module_exit);
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Your Name");  // TODO: Ваше имя
-MODULE_DESCRIPTION("Proc filesystem example");
-MODULE_VERSION("1.0");
+MODULE_DESCRIPTION("Proc filesystem example with per-CPU lab5 statistics");
+MODULE_VERSION("2.0");
 
 /*
- * ЗАДАНИЯ для студента:
- *
- * 1. Реализуйте все TODO в коде выше
- *
- * 2. В proc_read():
- *    - Увеличьте счётчик обращений
- *    - Заполните buf информацией о себе
- *    - Используйте copy_to_user для копирования в user space
- *
- * 3. В proc_module_init():
- *    - Сохраните текущие jiffies
- *    - Создайте /proc файл с помощью proc_create()
- *    - Проверьте на ошибки
+ * ПРОВЕРКА:
  *
- * 4. В proc_module_exit():
- *    - Удалите /proc файл с помощью proc_remove()
- *
- * 5. Протестируйте:
  *    $ make
- *    $ sudo insmod proc_module.ko
- *    $ cat /proc/student_info
+ *    $ sudo insmod proc_module.ko        # до chardev_module, чтобы тот нашёл счётчики
+ *    $ sudo insmod chardev_module.ko
  *    $ cat /proc/student_info
- *    $ cat /proc/student_info
- *    $ sudo rmmod proc_module
- *    $ dmesg | tail -10
- *
- * ОЖИДАЕМЫЙ РЕЗУЛЬТАТ:
+ *    Name: Ivan Ivanov
+ *    Group: 6, Subgroup: 1
+ *    Module loaded at: 4295123456 jiffies
+ *    Uptime: 12 seconds
+ *    Read count: 1
  *
- * $ cat /proc/student_info
- * Name: Ivan Ivanov
- * Group: 6, Subgroup: 1
- * Module loaded at: 4295123456 jiffies
- * Read count: 1
+ *    $ echo hi > /dev/mychardev
+ *    $ cat /proc/lab5/stats
+ *    counter                                 total            cpu0            cpu1
+ *    proc_reads                                  1               1               0
+ *    chardev_opens                               1               0               1
+ *    ...
  *
- * $ cat /proc/student_info
- * Name: Ivan Ivanov
- * Group: 6, Subgroup: 1
- * Module loaded at: 4295123456 jiffies
- * Read count: 2
+ *    $ python3 -c 'import struct; d=open("/proc/lab5/stats.bin","rb").read(); \
+ *          h=struct.unpack_from("<IHHIIQ", d); print(h, struct.unpack_from("<%dQ" % h[2], d, 24))'
  *
- * ОТЛАДКА:
+ *    $ sudo rmmod chardev_module proc_module
  *
- * Если cat /proc/student_info выдаёт ошибку:
- * 1. Проверьте dmesg на наличие ошибок
- * 2. Проверьте, создался ли файл: ls -la /proc/student_info
- * 3. Убедитесь, что proc_create вернула не-NULL
+ * ВОПРОСЫ ДЛЯ РАЗБОРА:
  *
- * Если данные не обновляются:
- * 1. Проверьте, увеличивается ли read_count
- * 2. Убедитесь, что *ppos правильно обрабатывается
+ * 1. Почему this_cpu_add() дешевле atomic64_add() на общем счётчике?
+ *    (Нет общей кэш-линии, которую гоняют между CPU; на x86 — одна инструкция.)
  *
- * ДОПОЛНИТЕЛЬНО (*):
+ * 2. Почему сумма при чтении может "отставать" на единицы?
+ *    (Копии CPU читаются по очереди без блокировки — это снимок "примерно сейчас".)
  *
- * - Добавьте uptime в секундах (используйте jiffies_to_msecs)
- * - Добавьте текущее время (используйте ktime_get_real_seconds)
- * - Форматируйте вывод более красиво (ASCII табличка)
+ * 3. Зачем seq_file, если вывод помещается в одну страницу?
+ *    (Не нужно вручную вести *ppos; при росте вывода ничего не ломается.)
  */
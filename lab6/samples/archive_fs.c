@@ -0,0 +1,307 @@
+/*
+ * archive_fs - tar-архив как read-only файловая система (Вариант 1, Задание B)
+ *
+ * Архив не распаковывается и не сканируется на каждый getattr/readdir:
+ * при первом монтировании строится индекс <archive>.idx (см. tar_index.h),
+ * дальше он только отображается через mmap(). Поиск пути — одна проба
+ * в хэш-таблице, readdir — непрерывный диапазон детей каталога, read —
+ * один pread() из архива по смещению из индекса.
+ *
+ * Все операции только читают общий mmap и общий источник архива (pread не
+ * двигает позицию), поэтому многопоточный цикл FUSE обслуживает open/read
+ * параллельно без единой блокировки.
+ *
+ * .tar.gz и .tar.zst читаются через archive_src: точки входа в сжатый
+ * поток (<archive>.zidx), общий LRU-кэш распакованных блоков и пул,
+ * который распаковывает следующие блоки при последовательном чтении.
+ *
+ * Использование:
+ *   ./archive_fs [-v] [--index=FILE] [--cache=MB] [--span=MB] [--threads=N]
+ *                <archive.tar[.gz|.zst]> <mount_point> [fuse_options]
+ *
+ * Компиляция: make archive_fs
+ */
+
+#define FUSE_USE_VERSION 31
+
+#include <fuse.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "archive_src.h"
+#include "tar_index.h"
+
+static struct tar_index idx;
+static struct archive_src *src;
+static int verbose = 0;
+static int prefetch_threads = ARCHIVE_SRC_DEFAULT_THREADS;
+static uint64_t readahead_bytes = 8ull << 20;
+
+/* Состояние открытого файла: для распознавания последовательного чтения */
+struct open_file {
+    uint32_t entry;
+    uint64_t next_off;      // где закончилось предыдущее чтение
+};
+
+/* Логирование как в passthrough_fuse, но только с -v: на горячем пути дорого */
+static void log_operation(const char *op, const char *path, int result) {
+    if (!verbose)
+        return;
+    time_t now = time(NULL);
+    char timestamp[64];
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", localtime(&now));
+
+    fprintf(stderr, "[%s] %s: %s (result: %d)\n", timestamp, op, path, result);
+}
+
+/*
+ * init - архив неизменен, поэтому ядру можно кэшировать всё:
+ * атрибуты, отсутствующие имена и страницы файлов.
+ */
+static void *archive_init(struct fuse_conn_info *conn, struct fuse_config *cfg) {
+    (void) conn;
+    cfg->use_ino = 1;
+    cfg->kernel_cache = 1;
+    cfg->entry_timeout = 3600.0;
+    cfg->attr_timeout = 3600.0;
+    cfg->negative_timeout = 3600.0;
+
+    // Здесь, а не в main: после ухода в фон потоки должны жить в демоне
+    int err = archive_src_start_prefetch(src, prefetch_threads);
+    if (err)
+        fprintf(stderr, "prefetch disabled: %s\n", strerror(-err));
+    return NULL;
+}
+
+static void archive_destroy(void *private_data) {
+    (void) private_data;
+    struct archive_src_stats st;
+    archive_src_get_stats(src, &st);
+    if (verbose && archive_src_kind(src) != ARCHIVE_TAR)
+        fprintf(stderr, "cache: %llu hits, %llu misses, %llu prefetched, %llu evicted\n",
+                (unsigned long long)st.hits, (unsigned long long)st.misses,
+                (unsigned long long)st.prefetched, (unsigned long long)st.evicted);
+}
+
+static int archive_getattr(const char *path, struct stat *stbuf,
+                           struct fuse_file_info *fi) {
+    (void) fi;
+    long i = tar_index_lookup(&idx, path);
+    if (i < 0) {
+        log_operation("GETATTR", path, -ENOENT);
+        return -ENOENT;
+    }
+    tar_index_stat(&idx, tar_index_entry(&idx, (uint32_t)i), stbuf);
+    log_operation("GETATTR", path, 0);
+    return 0;
+}
+
+/*
+ * readdir с собственными смещениями: 1 — ".", 2 — "..", 3+k — k-й ребёнок.
+ * Каталог с миллионом файлов отдаётся порциями без повторного обхода.
+ */
+static int archive_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
+                           off_t offset, struct fuse_file_info *fi,
+                           enum fuse_readdir_flags flags) {
+    (void) fi;
+    long i = tar_index_lookup(&idx, path);
+    if (i < 0) {
+        log_operation("READDIR", path, -ENOENT);
+        return -ENOENT;
+    }
+    const struct tidx_entry *dir = tar_index_entry(&idx, (uint32_t)i);
+    if (!S_ISDIR(dir->mode)) {
+        log_operation("READDIR", path, -ENOTDIR);
+        return -ENOTDIR;
+    }
+
+    enum fuse_fill_dir_flags fill = (flags & FUSE_READDIR_PLUS) ? FUSE_FILL_DIR_PLUS : 0;
+    struct stat st;
+
+    if (offset < 1) {
+        tar_index_stat(&idx, dir, &st);
+        if (filler(buf, ".", &st, 1, fill))
+            return 0;
+    }
+    if (offset < 2) {
+        tar_index_stat(&idx, tar_index_entry(&idx, dir->parent), &st);
+        if (filler(buf, "..", &st, 2, fill))
+            return 0;
+    }
+    for (uint32_t k = offset > 2 ? (uint32_t)(offset - 2) : 0; k < dir->child_count; k++) {
+        const struct tidx_entry *e = tar_index_entry(&idx, idx.children[dir->child_start + k]);
+        tar_index_stat(&idx, e, &st);
+        if (filler(buf, tar_index_basename(&idx, e), &st, (off_t)k + 3, fill))
+            break;
+    }
+
+    log_operation("READDIR", path, 0);
+    return 0;
+}
+
+/*
+ * open - никакого своего fd на файл: в fi->fh только номер записи и
+ * позиция для упреждения, все чтения идут через общий src.
+ */
+static int archive_open(const char *path, struct fuse_file_info *fi) {
+    if ((fi->flags & O_ACCMODE) != O_RDONLY) {
+        log_operation("OPEN", path, -EROFS);
+        return -EROFS;
+    }
+    long i = tar_index_lookup(&idx, path);
+    if (i < 0) {
+        log_operation("OPEN", path, -ENOENT);
+        return -ENOENT;
+    }
+    if (S_ISDIR(tar_index_entry(&idx, (uint32_t)i)->mode)) {
+        log_operation("OPEN", path, -EISDIR);
+        return -EISDIR;
+    }
+    struct open_file *of = malloc(sizeof(*of));
+    if (!of)
+        return -ENOMEM;
+    of->entry = (uint32_t)i;
+    of->next_off = 0;
+    fi->fh = (uint64_t)(uintptr_t)of;
+    fi->keep_cache = 1;         // содержимое не меняется между открытиями
+    log_operation("OPEN", path, 0);
+    return 0;
+}
+
+static int archive_read(const char *path, char *buf, size_t size, off_t offset,
+                        struct fuse_file_info *fi) {
+    struct open_file *of = (struct open_file *)(uintptr_t)fi->fh;
+    const struct tidx_entry *e = tar_index_entry(&idx, of->entry);
+    if (offset < 0 || (uint64_t)offset >= e->size)
+        return 0;
+    if (size > e->size - (uint64_t)offset)
+        size = (size_t)(e->size - (uint64_t)offset);
+
+    // Последовательное чтение: заранее распаковать следующие блоки файла.
+    // Гонка между потоками одного fh безвредна — это лишь подсказка.
+    uint64_t end = (uint64_t)offset + size;
+    if (__atomic_exchange_n(&of->next_off, end, __ATOMIC_RELAXED) == (uint64_t)offset &&
+        end < e->size) {
+        uint64_t ahead = e->size - end < readahead_bytes ? e->size - end : readahead_bytes;
+        archive_src_prefetch(src, e->data_offset + end, ahead);
+    }
+
+    ssize_t res = archive_src_pread(src, buf, size, e->data_offset + (uint64_t)offset);
+    if (verbose)
+        fprintf(stderr, "READ: %s (%zu bytes at offset %ld, result: %zd)\n",
+                path, size, (long)offset, res);
+    return (int)res;
+}
+
+static int archive_release(const char *path, struct fuse_file_info *fi) {
+    (void) path;
+    free((struct open_file *)(uintptr_t)fi->fh);
+    return 0;
+}
+
+static int archive_readlink(const char *path, char *buf, size_t size) {
+    long i = tar_index_lookup(&idx, path);
+    const char *target = i < 0 ? NULL : tar_index_link(&idx, tar_index_entry(&idx, (uint32_t)i));
+    if (!target) {
+        log_operation("READLINK", path, -EINVAL);
+        return i < 0 ? -ENOENT : -EINVAL;
+    }
+    snprintf(buf, size, "%s", target);
+    log_operation("READLINK", path, 0);
+    return 0;
+}
+
+static struct fuse_operations archive_oper = {
+    .init       = archive_init,
+    .destroy    = archive_destroy,
+    .getattr    = archive_getattr,
+    .readdir    = archive_readdir,
+    .open       = archive_open,
+    .read       = archive_read,
+    .release    = archive_release,
+    .readlink   = archive_readlink,
+};
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-v] [--index=FILE] [--cache=MB] [--span=MB] [--threads=N]\n"
+                    "          <archive.tar[.gz|.zst]> <mount_point> [fuse_options]\n", prog);
+    fprintf(stderr, "Example: %s build.tar /mnt/archive -f\n", prog);
+    fprintf(stderr, "\nОпции:\n");
+    fprintf(stderr, "  -v            логировать каждую операцию\n");
+    fprintf(stderr, "  --index=FILE  где хранить индекс (по умолчанию <archive>.idx)\n");
+    fprintf(stderr, "  --cache=MB    кэш распакованных блоков (по умолчанию 256)\n");
+    fprintf(stderr, "  --span=MB     шаг точек входа в сжатый поток (по умолчанию 4)\n");
+    fprintf(stderr, "  --threads=N   потоки упреждающей распаковки (по умолчанию 2)\n");
+    fprintf(stderr, "  -f            foreground mode (не уходить в фон)\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *index_path = NULL;
+    struct archive_src_opts opts = {0};
+    int argi = 1;
+
+    for (; argi < argc && argv[argi][0] == '-'; argi++) {
+        if (!strcmp(argv[argi], "-v"))
+            verbose = 1;
+        else if (!strncmp(argv[argi], "--index=", 8))
+            index_path = argv[argi] + 8;
+        else if (!strncmp(argv[argi], "--cache=", 8))
+            opts.cache_bytes = strtoull(argv[argi] + 8, NULL, 10) << 20;
+        else if (!strncmp(argv[argi], "--span=", 7))
+            opts.span = strtoull(argv[argi] + 7, NULL, 10) << 20;
+        else if (!strncmp(argv[argi], "--threads=", 10))
+            prefetch_threads = atoi(argv[argi] + 10);
+        else
+            break;
+    }
+    if (argc - argi < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const char *archive = argv[argi];
+    struct timespec t0, t1;
+    int rebuilt = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int zrebuilt = 0;
+    int err = archive_src_open(archive, &opts, &src, &zrebuilt);
+    if (!err)
+        err = tar_index_open(archive, src, index_path, &idx, &rebuilt);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (err) {
+        fprintf(stderr, "%s: cannot index archive: %s\n", archive, strerror(-err));
+        return 1;
+    }
+    static const char *const kinds[] = { "tar", "tar.gz", "tar.zst" };
+    fprintf(stderr, "%s (%s): %u entries, index %s in %.1f ms\n", archive,
+            kinds[archive_src_kind(src)], idx.hdr->entry_count,
+            rebuilt || zrebuilt ? "built" : "loaded",
+            (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+
+    /* argv[0], точка монтирования и опции FUSE; всегда read-only */
+    int fuse_argc = 0;
+    char **fuse_argv = malloc(sizeof(char *) * (size_t)(argc - argi + 2));
+    if (!fuse_argv)
+        return 1;
+    fuse_argv[fuse_argc++] = argv[0];
+    for (int i = argi + 1; i < argc; i++)
+        fuse_argv[fuse_argc++] = argv[i];
+    fuse_argv[fuse_argc++] = "-oro,default_permissions";
+
+    fprintf(stderr, "Mounting %s at %s\n", archive, argv[argi + 1]);
+    fprintf(stderr, "To unmount: fusermount -u %s\n", argv[argi + 1]);
+
+    int ret = fuse_main(fuse_argc, fuse_argv, &archive_oper, NULL);
+
+    free(fuse_argv);
+    tar_index_close(&idx);
+    archive_src_close(src);
+    return ret;
+}
@@ -0,0 +1,968 @@
+/*
+ * archive_src.c - несжатый поток .tar / .tar.gz / .tar.zst (см. archive_src.h)
+ *
+ * Формат <archive>.zidx (отображается через mmap):
+ *
+ *   struct zidx_header
+ *   struct zidx_point points[point_count]      — по возрастанию out
+ *   unsigned char     windows[point_count][32K] — только для gzip
+ *
+ * Блок кэша i — несжатые байты [points[i].out, points[i + 1].out).
+ * Потоки, одновременно попросившие один блок, ждут одну распаковку
+ * (состояние BLOCK_LOADING), а не делают её каждый сам.
+ *
+ * zstd собирается, только если есть libzstd (Makefile задаёт HAVE_ZSTD).
+ */
+
+#define _GNU_SOURCE
+#include "archive_src.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#define ZIDX_MAGIC     "TARZIDX"
+#define ZIDX_VERSION   1
+#define GZ_WINDOW      32768
+#define IN_CHUNK       (256 * 1024)
+#define MAX_BLOCK      (256ull << 20)   // блок больше — архив без точек входа
+#define PREFETCH_QUEUE 64
+
+struct zidx_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t kind;
+    uint64_t archive_size;      // сжатый файл: для проверки актуальности
+    int64_t archive_mtime_sec;
+    int64_t archive_mtime_nsec;
+    uint64_t span;
+    uint64_t total_out;         // размер несжатого потока
+    uint32_t point_count;
+    uint32_t window_size;       // GZ_WINDOW для gzip, 0 для zstd
+    uint64_t off_points;
+    uint64_t off_windows;
+};
+
+struct zidx_point {
+    uint64_t in;                // смещение в сжатом файле
+    uint64_t out;               // смещение в несжатом потоке
+    uint32_t bits;              // gzip: непрочитанные биты байта in - 1
+    uint32_t reserved;
+};
+
+enum block_state { BLOCK_LOADING, BLOCK_READY, BLOCK_FAILED };
+
+struct zblock {
+    uint32_t id;
+    enum block_state state;
+    int refs;
+    int err;
+    char *data;
+    size_t len;
+    struct zblock *prev, *next;     // LRU: только READY-блоки
+};
+
+struct archive_src {
+    int fd;
+    struct stat st;
+    enum archive_kind kind;
+    uint64_t size;
+
+    void *map;
+    size_t map_size;
+    const struct zidx_header *zh;
+    const struct zidx_point *points;
+    const unsigned char *windows;
+    uint32_t nblocks;
+
+    pthread_mutex_t lock;
+    pthread_cond_t loaded;          // блок сменил состояние LOADING
+    struct zblock **slots;          // по номеру блока; NULL — не в кэше
+    struct zblock lru;              // lru.next — самый свежий
+    uint64_t cache_limit;
+    struct archive_src_stats stats;
+
+    pthread_t *threads;
+    int nthreads;
+    pthread_cond_t queue_cond;
+    uint32_t queue[PREFETCH_QUEUE];
+    unsigned queue_head, queue_len;
+    unsigned char *queued;
+    int stopping;
+};
+
+/* ---------- Ввод-вывод ---------- */
+
+static int pread_full(int fd, void *buf, size_t n, uint64_t off) {
+    char *p = buf;
+    while (n > 0) {
+        ssize_t r = pread(fd, p, n, (off_t)off);
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            return -errno;
+        }
+        if (r == 0)
+            return -EIO;
+        p += r;
+        n -= (size_t)r;
+        off += (uint64_t)r;
+    }
+    return 0;
+}
+
+static int write_full(int fd, const void *buf, size_t n) {
+    const char *p = buf;
+    while (n > 0) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0) {
+            if (errno == EINTR)
+                continue;
+            return -errno;
+        }
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+char *archive_sidecar_path(const char *archive, const struct stat *st,
+                           const char *suffix, int fallback) {
+    char *p;
+    int r;
+    if (!fallback)
+        r = asprintf(&p, "%s%s", archive, suffix);
+    else {
+        const char *tmpdir = getenv("TMPDIR");
+        const char *base = strrchr(archive, '/');
+        r = asprintf(&p, "%s/%s.%llx-%llx%s", tmpdir && *tmpdir ? tmpdir : "/tmp",
+                     base ? base + 1 : archive, (unsigned long long)st->st_dev,
+                     (unsigned long long)st->st_ino, suffix);
+    }
+    return r < 0 ? NULL : p;
+}
+
+/* ---------- Построение индекса точек входа ---------- */
+
+struct point_list {
+    struct zidx_point *v;
+    unsigned char *windows;
+    size_t n, cap;
+    size_t window_size;
+};
+
+static int point_add(struct point_list *pl, uint64_t in, uint64_t out, unsigned bits,
+                     const unsigned char *win, size_t win_pos) {
+    if (pl->n == pl->cap) {
+        size_t cap = pl->cap ? pl->cap * 2 : 256;
+        struct zidx_point *v = realloc(pl->v, cap * sizeof(*v));
+        if (!v)
+            return -ENOMEM;
+        pl->v = v;
+        if (pl->window_size) {
+            unsigned char *w = realloc(pl->windows, cap * pl->window_size);
+            if (!w)
+                return -ENOMEM;
+            pl->windows = w;
+        }
+        pl->cap = cap;
+    }
+    pl->v[pl->n] = (struct zidx_point){ .in = in, .out = out, .bits = bits };
+    if (pl->window_size) {
+        // Кольцевой буфер вывода -> последние 32 KiB по порядку
+        unsigned char *dst = pl->windows + pl->n * pl->window_size;
+        memcpy(dst, win + win_pos, pl->window_size - win_pos);
+        memcpy(dst + pl->window_size - win_pos, win, win_pos);
+    }
+    pl->n++;
+    return 0;
+}
+
+/*
+ * gzip: распаковка с Z_BLOCK останавливается на каждой границе
+ * deflate-блока; там, если с прошлой точки набралось span байт,
+ * запоминаем состояние. Несколько членов gzip подряд (pigz, bgzip,
+ * cat a.gz b.gz) — обычный случай, inflateReset между ними.
+ */
+static int gz_scan(int fd, uint64_t span, struct point_list *pl, uint64_t *total_out) {
+    unsigned char *in = malloc(IN_CHUNK), *win = malloc(GZ_WINDOW);
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if (!in || !win || inflateInit2(&z, 47) != Z_OK) {     // 32 + 15: заголовок gzip/zlib
+        free(in);
+        free(win);
+        return -ENOMEM;
+    }
+    pl->window_size = GZ_WINDOW;
+    memset(win, 0, GZ_WINDOW);
+
+    uint64_t totin = 0, totout = 0, last = 0;
+    int ret = Z_OK, err = 0;
+    for (;;) {
+        if (z.avail_in == 0) {
+            ssize_t r = read(fd, in, IN_CHUNK);
+            if (r < 0 && errno == EINTR)
+                continue;
+            if (r < 0) {
+                err = -errno;
+                break;
+            }
+            if (r == 0) {
+                if (ret != Z_STREAM_END)
+                    err = -EIO;     // поток оборван
+                break;
+            }
+            z.next_in = in;
+            z.avail_in = (uInt)r;
+        }
+        if (ret == Z_STREAM_END) {
+            if (z.next_in[0] != 0x1f)
+                break;              // за последним членом мусор/нули — как gzip -d
+            inflateReset(&z);
+        }
+        if (z.avail_out == 0) {
+            z.next_out = win;
+            z.avail_out = GZ_WINDOW;
+        }
+        totin += z.avail_in;
+        totout += z.avail_out;
+        ret = inflate(&z, Z_BLOCK);
+        totin -= z.avail_in;
+        totout -= z.avail_out;
+        if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR) {
+            err = ret == Z_MEM_ERROR ? -ENOMEM : -EINVAL;
+            break;
+        }
+        if (ret == Z_BUF_ERROR)
+            ret = Z_OK;
+        if ((z.data_type & 128) && !(z.data_type & 64) &&
+            (pl->n == 0 || totout - last >= span)) {
+            err = point_add(pl, totin, totout, (unsigned)z.data_type & 7,
+                            win, GZ_WINDOW - z.avail_out);
+            if (err)
+                break;
+            last = totout;
+        }
+    }
+
+    inflateEnd(&z);
+    free(in);
+    free(win);
+    *total_out = totout;
+    return err;
+}
+
+#ifdef HAVE_ZSTD
+/*
+ * zstd: точка входа — только начало кадра. ZSTD_decompressStream()
+ * возвращает 0, когда кадр полностью распакован и выдан.
+ */
+static int zstd_scan(int fd, uint64_t span, struct point_list *pl, uint64_t *total_out) {
+    size_t out_size = ZSTD_DStreamOutSize();
+    unsigned char *in = malloc(IN_CHUNK), *out = malloc(out_size);
+    ZSTD_DCtx *d = ZSTD_createDCtx();
+    int err = 0;
+    if (!in || !out || !d) {
+        err = -ENOMEM;
+        goto done;
+    }
+    pl->window_size = 0;
+    if ((err = point_add(pl, 0, 0, 0, NULL, 0)))
+        goto done;
+
+    uint64_t base = 0, totout = 0, last = 0;
+    int frame_done = 1;
+    for (;;) {
+        ssize_t r = read(fd, in, IN_CHUNK);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0) {
+            err = -errno;
+            break;
+        }
+        if (r == 0) {
+            if (!frame_done)
+                err = -EIO;
+            break;
+        }
+        ZSTD_inBuffer ib = { in, (size_t)r, 0 };
+        ZSTD_outBuffer ob;
+        do {
+            ob = (ZSTD_outBuffer){ out, out_size, 0 };
+            size_t rc = ZSTD_decompressStream(d, &ob, &ib);
+            if (ZSTD_isError(rc)) {
+                err = -EINVAL;
+                goto done;
+            }
+            totout += ob.pos;
+            frame_done = rc == 0;
+            if (frame_done && totout - last >= span) {
+                if ((err = point_add(pl, base + ib.pos, totout, 0, NULL, 0)))
+                    goto done;
+                last = totout;
+            }
+        } while (ib.pos < ib.size || ob.pos == ob.size);
+        base += (uint64_t)r;
+    }
+    *total_out = totout;
+
+done:
+    ZSTD_freeDCtx(d);
+    free(in);
+    free(out);
+    return err;
+}
+#endif
+
+static int build_zidx(int fd, const struct stat *st, enum archive_kind kind,
+                      uint64_t span, const char *path) {
+    struct point_list pl = {0};
+    uint64_t total = 0;
+    int err;
+
+    if (lseek(fd, 0, SEEK_SET) < 0)
+        return -errno;
+#ifdef HAVE_ZSTD
+    err = kind == ARCHIVE_ZSTD ? zstd_scan(fd, span, &pl, &total)
+                               : gz_scan(fd, span, &pl, &total);
+#else
+    err = gz_scan(fd, span, &pl, &total);
+#endif
+    // Точка ровно в конце потока — пустой блок, не нужна
+    if (!err && pl.n > 1 && pl.v[pl.n - 1].out == total)
+        pl.n--;
+    for (size_t i = 0; !err && i < pl.n; i++) {
+        uint64_t end = i + 1 < pl.n ? pl.v[i + 1].out : total;
+        if (end - pl.v[i].out > MAX_BLOCK) {
+            fprintf(stderr, "archive_src: no seek points for %llu MiB of stream; "
+                    "recompress in independent frames (pzstd, t2sz)\n",
+                    (unsigned long long)((end - pl.v[i].out) >> 20));
+            err = -EFBIG;
+        }
+    }
+    if (err || pl.n == 0) {
+        free(pl.v);
+        free(pl.windows);
+        return err ? err : -EINVAL;
+    }
+
+    struct zidx_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, ZIDX_MAGIC, sizeof(h.magic));
+    h.version = ZIDX_VERSION;
+    h.kind = kind;
+    h.archive_size = (uint64_t)st->st_size;
+    h.archive_mtime_sec = st->st_mtim.tv_sec;
+    h.archive_mtime_nsec = st->st_mtim.tv_nsec;
+    h.span = span;
+    h.total_out = total;
+    h.point_count = (uint32_t)pl.n;
+    h.window_size = (uint32_t)pl.window_size;
+    h.off_points = sizeof(h);
+    h.off_windows = h.off_points + pl.n * sizeof(struct zidx_point);
+
+    char *tmp;
+    if (asprintf(&tmp, "%s.tmp.%d", path, (int)getpid()) < 0) {
+        free(pl.v);
+        free(pl.windows);
+        return -ENOMEM;
+    }
+    // В общем $TMPDIR имя предсказуемо: чужой файл или symlink не трогаем
+    unlink(tmp);
+    int out = open(tmp, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0644);
+    if (out < 0)
+        err = -errno;
+    else {
+        err = write_full(out, &h, sizeof(h));
+        if (!err)
+            err = write_full(out, pl.v, pl.n * sizeof(struct zidx_point));
+        if (!err && pl.window_size)
+            err = write_full(out, pl.windows, pl.n * pl.window_size);
+        if (close(out) < 0 && !err)
+            err = -errno;
+        if (!err && rename(tmp, path) < 0)
+            err = -errno;
+        if (err)
+            unlink(tmp);
+    }
+    free(tmp);
+    free(pl.v);
+    free(pl.windows);
+    return err;
+}
+
+/*
+ * Точки приходят из файла: по ним считаются размеры блоков и смещения
+ * pread, поэтому out строго растёт от 0 и не выходит за total_out, блок
+ * не больше MAX_BLOCK, in лежит внутри архива, bits — биты одного байта.
+ */
+static int zidx_points_ok(const struct zidx_header *h, const struct zidx_point *p) {
+    for (uint32_t i = 0; i < h->point_count; i++) {
+        uint64_t end = i + 1 < h->point_count ? p[i + 1].out : h->total_out;
+        if (p[i].out > end || (p[i].out == end && i + 1 < h->point_count))
+            return 0;
+        if (end - p[i].out > MAX_BLOCK || p[i].in > h->archive_size || p[i].bits > 7 ||
+            (p[i].bits && p[i].in == 0))
+            return 0;
+    }
+    return p[0].out == 0;
+}
+
+/* trusted = 0 для запасного индекса в общем $TMPDIR: файл должен быть нашим */
+static int load_zidx(struct archive_src *s, const char *path, int trusted) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC | (trusted ? 0 : O_NOFOLLOW));
+    if (fd < 0)
+        return -errno;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(struct zidx_header)) {
+        close(fd);
+        return -EINVAL;
+    }
+    if (!trusted && (!S_ISREG(st.st_mode) || st.st_uid != geteuid() || (st.st_mode & (S_IWGRP | S_IWOTH)))) {
+        close(fd);
+        return -EPERM;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -errno;
+
+    const struct zidx_header *h = map;
+    uint64_t wsize = s->kind == ARCHIVE_GZIP ? GZ_WINDOW : 0;
+    int ok = !memcmp(h->magic, ZIDX_MAGIC, sizeof(h->magic)) &&
+             h->version == ZIDX_VERSION && h->kind == (uint32_t)s->kind &&
+             h->archive_size == (uint64_t)s->st.st_size &&
+             h->archive_mtime_sec == s->st.st_mtim.tv_sec &&
+             h->archive_mtime_nsec == s->st.st_mtim.tv_nsec &&
+             h->point_count > 0 && h->window_size == wsize &&
+             h->off_points >= sizeof(*h) && h->off_points <= (uint64_t)st.st_size &&
+             h->off_points + (uint64_t)h->point_count * sizeof(struct zidx_point) <= h->off_windows &&
+             h->off_windows + (uint64_t)h->point_count * wsize == (uint64_t)st.st_size &&
+             zidx_points_ok(h, (const struct zidx_point *)((const char *)map + h->off_points));
+    if (!ok) {
+        munmap(map, (size_t)st.st_size);
+        return -ESTALE;
+    }
+
+    s->map = map;
+    s->map_size = (size_t)st.st_size;
+    s->zh = h;
+    s->points = (const struct zidx_point *)((const char *)map + h->off_points);
+    s->windows = (const unsigned char *)map + h->off_windows;
+    s->nblocks = h->point_count;
+    s->size = h->total_out;
+    return 0;
+}
+
+/* ---------- Распаковка одного блока ---------- */
+
+static uint64_t block_end(const struct archive_src *s, uint32_t id) {
+    return id + 1 < s->nblocks ? s->points[id + 1].out : s->size;
+}
+
+/*
+ * gzip с точки входа: raw inflate, досылаем недочитанные биты и словарь.
+ * На конце члена пропускаем 8 байт трейлера и дальше разбираем
+ * следующий член вместе с его заголовком (windowBits 31).
+ */
+static int gz_decode(struct archive_src *s, uint32_t id, unsigned char *out, size_t len) {
+    const struct zidx_point *p = &s->points[id];
+    unsigned char *in = malloc(IN_CHUNK);
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if (!in || inflateInit2(&z, -15) != Z_OK) {
+        free(in);
+        return -ENOMEM;
+    }
+
+    int err = 0;
+    if (p->bits) {
+        unsigned char c;
+        if ((err = pread_full(s->fd, &c, 1, p->in - 1)) < 0)
+            goto done;
+        inflatePrime(&z, (int)p->bits, c >> (8 - p->bits));
+    }
+    if (p->out)
+        inflateSetDictionary(&z, s->windows + (size_t)id * GZ_WINDOW, GZ_WINDOW);
+
+    uint64_t pos = p->in;
+    size_t skip = 0;
+    int raw = 1;
+    z.next_out = out;
+    z.avail_out = (uInt)len;
+    while (z.avail_out > 0) {
+        if (z.avail_in == 0) {
+            ssize_t r = pread(s->fd, in, IN_CHUNK, (off_t)pos);
+            if (r < 0 && errno == EINTR)
+                continue;
+            if (r <= 0) {
+                err = r < 0 ? -errno : -EIO;
+                break;
+            }
+            pos += (uint64_t)r;
+            z.next_in = in;
+            z.avail_in = (uInt)r;
+        }
+        if (skip) {
+            size_t k = skip < z.avail_in ? skip : z.avail_in;
+            z.next_in += k;
+            z.avail_in -= (uInt)k;
+            skip -= k;
+            continue;
+        }
+        int ret = inflate(&z, Z_NO_FLUSH);
+        if (ret == Z_STREAM_END) {
+            if (raw) {
+                skip = 8;           // CRC32 + ISIZE: raw inflate их не читает
+                inflateReset2(&z, 31);
+                raw = 0;
+            } else
+                inflateReset(&z);
+            continue;
+        }
+        if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            err = ret == Z_MEM_ERROR ? -ENOMEM : -EIO;
+            break;
+        }
+    }
+
+done:
+    inflateEnd(&z);
+    free(in);
+    return err;
+}
+
+#ifdef HAVE_ZSTD
+static int zstd_decode(struct archive_src *s, uint32_t id, unsigned char *out, size_t len) {
+    unsigned char *in = malloc(IN_CHUNK);
+    ZSTD_DCtx *d = ZSTD_createDCtx();
+    int err = 0;
+    if (!in || !d) {
+        err = -ENOMEM;
+        goto done;
+    }
+
+    uint64_t pos = s->points[id].in;
+    ZSTD_outBuffer ob = { out, len, 0 };
+    while (ob.pos < ob.size) {
+        ssize_t r = pread(s->fd, in, IN_CHUNK, (off_t)pos);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0) {
+            err = r < 0 ? -errno : -EIO;
+            break;
+        }
+        pos += (uint64_t)r;
+        ZSTD_inBuffer ib = { in, (size_t)r, 0 };
+        while (ib.pos < ib.size && ob.pos < ob.size) {
+            size_t rc = ZSTD_decompressStream(d, &ob, &ib);
+            if (ZSTD_isError(rc)) {
+                err = -EIO;
+                goto done;
+            }
+        }
+    }
+
+done:
+    ZSTD_freeDCtx(d);
+    free(in);
+    return err;
+}
+#endif
+
+static int decode_block(struct archive_src *s, uint32_t id, unsigned char *out, size_t len) {
+#ifdef HAVE_ZSTD
+    if (s->kind == ARCHIVE_ZSTD)
+        return zstd_decode(s, id, out, len);
+#endif
+    return gz_decode(s, id, out, len);
+}
+
+/* ---------- LRU-кэш блоков ---------- */
+
+static void lru_unlink(struct zblock *b) {
+    b->prev->next = b->next;
+    b->next->prev = b->prev;
+    b->prev = b->next = NULL;
+}
+
+static void lru_push_front(struct archive_src *s, struct zblock *b) {
+    b->next = s->lru.next;
+    b->prev = &s->lru;
+    s->lru.next->prev = b;
+    s->lru.next = b;
+}
+
+static void block_free(struct zblock *b) {
+    free(b->data);
+    free(b);
+}
+
+/* Вытеснить самые старые неиспользуемые блоки сверх лимита (под lock) */
+static void cache_trim(struct archive_src *s) {
+    struct zblock *b = s->lru.prev;
+    while (s->stats.cached_bytes > s->cache_limit && b != &s->lru) {
+        struct zblock *prev = b->prev;
+        if (b->refs == 0) {
+            lru_unlink(b);
+            s->slots[b->id] = NULL;
+            s->stats.cached_bytes -= b->len;
+            s->stats.evicted++;
+            block_free(b);
+        }
+        b = prev;
+    }
+}
+
+/* Получить блок со ссылкой (отпускать block_put); NULL и *err при ошибке */
+static struct zblock *block_get(struct archive_src *s, uint32_t id, int prefetch, int *err) {
+    pthread_mutex_lock(&s->lock);
+    struct zblock *b = s->slots[id];
+    if (b) {
+        b->refs++;
+        if (b->state == BLOCK_READY) {
+            lru_unlink(b);
+            lru_push_front(s, b);
+            if (!prefetch)
+                s->stats.hits++;
+        }
+        while (b->state == BLOCK_LOADING)
+            pthread_cond_wait(&s->loaded, &s->lock);
+        if (b->state == BLOCK_FAILED) {
+            *err = b->err;
+            if (--b->refs == 0)
+                block_free(b);
+            b = NULL;
+        }
+        pthread_mutex_unlock(&s->lock);
+        return b;
+    }
+
+    b = calloc(1, sizeof(*b));
+    if (!b) {
+        pthread_mutex_unlock(&s->lock);
+        *err = -ENOMEM;
+        return NULL;
+    }
+    b->id = id;
+    b->state = BLOCK_LOADING;
+    b->refs = 1;
+    b->len = (size_t)(block_end(s, id) - s->points[id].out);
+    s->slots[id] = b;
+    if (prefetch)
+        s->stats.prefetched++;
+    else
+        s->stats.misses++;
+    pthread_mutex_unlock(&s->lock);
+
+    // Распаковка — без блокировки: другие блоки читаются параллельно
+    b->data = malloc(b->len ? b->len : 1);
+    int e = b->data ? decode_block(s, id, (unsigned char *)b->data, b->len) : -ENOMEM;
+
+    pthread_mutex_lock(&s->lock);
+    if (e) {
+        b->state = BLOCK_FAILED;
+        b->err = e;
+        s->slots[id] = NULL;        // следующая попытка распакует заново
+    } else {
+        b->state = BLOCK_READY;
+        lru_push_front(s, b);
+        s->stats.cached_bytes += b->len;
+        cache_trim(s);
+    }
+    pthread_cond_broadcast(&s->loaded);
+    if (e) {
+        *err = e;
+        if (--b->refs == 0)
+            block_free(b);
+        b = NULL;
+    }
+    pthread_mutex_unlock(&s->lock);
+    return b;
+}
+
+static void block_put(struct archive_src *s, struct zblock *b) {
+    pthread_mutex_lock(&s->lock);
+    b->refs--;
+    cache_trim(s);
+    pthread_mutex_unlock(&s->lock);
+}
+
+static uint32_t find_block(const struct archive_src *s, uint64_t off) {
+    uint32_t lo = 0, hi = s->nblocks;
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (s->points[mid].out <= off)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* ---------- Пул упреждающей распаковки ---------- */
+
+static void *prefetch_main(void *arg) {
+    struct archive_src *s = arg;
+    pthread_mutex_lock(&s->lock);
+    for (;;) {
+        while (!s->stopping && s->queue_len == 0)
+            pthread_cond_wait(&s->queue_cond, &s->lock);
+        if (s->stopping)
+            break;
+        uint32_t id = s->queue[s->queue_head];
+        s->queue_head = (s->queue_head + 1) % PREFETCH_QUEUE;
+        s->queue_len--;
+        s->queued[id] = 0;
+        pthread_mutex_unlock(&s->lock);
+
+        int err = 0;
+        struct zblock *b = block_get(s, id, 1, &err);
+        if (b)
+            block_put(s, b);
+
+        pthread_mutex_lock(&s->lock);
+    }
+    pthread_mutex_unlock(&s->lock);
+    return NULL;
+}
+
+void archive_src_prefetch(struct archive_src *s, uint64_t off, uint64_t len) {
+    if (len == 0 || off >= s->size)
+        return;
+    if (off + len > s->size)
+        len = s->size - off;
+    if (s->kind == ARCHIVE_TAR) {
+        posix_fadvise(s->fd, (off_t)off, (off_t)len, POSIX_FADV_WILLNEED);
+        return;
+    }
+    if (s->nthreads == 0)
+        return;     // пул не запущен — читатели распакуют сами
+
+    uint32_t first = find_block(s, off), last = find_block(s, off + len - 1);
+    pthread_mutex_lock(&s->lock);
+    for (uint32_t id = first; id <= last && s->queue_len < PREFETCH_QUEUE; id++) {
+        if (s->slots[id] || s->queued[id])
+            continue;
+        s->queue[(s->queue_head + s->queue_len) % PREFETCH_QUEUE] = id;
+        s->queue_len++;
+        s->queued[id] = 1;
+        pthread_cond_signal(&s->queue_cond);
+    }
+    pthread_mutex_unlock(&s->lock);
+}
+
+/* ---------- Открытие и чтение ---------- */
+
+static int detect_kind(int fd, enum archive_kind *kind) {
+    unsigned char m[4] = {0};
+    ssize_t r = pread(fd, m, sizeof(m), 0);
+    if (r < 0)
+        return -errno;
+    if (r >= 2 && m[0] == 0x1f && m[1] == 0x8b)
+        *kind = ARCHIVE_GZIP;
+    else if (r == 4 && m[0] == 0x28 && m[1] == 0xb5 && m[2] == 0x2f && m[3] == 0xfd) {
+#ifndef HAVE_ZSTD
+        fprintf(stderr, "archive_src: zstd archive, but built without libzstd\n");
+        return -EPROTONOSUPPORT;
+#endif
+        *kind = ARCHIVE_ZSTD;
+    } else
+        *kind = ARCHIVE_TAR;
+    return 0;
+}
+
+static int open_zidx(struct archive_src *s, const char *archive,
+                     const struct archive_src_opts *o, int *rebuilt) {
+    char *primary = o->zidx_path ? strdup(o->zidx_path)
+                                 : archive_sidecar_path(archive, &s->st, ".zidx", 0);
+    char *fallback = o->zidx_path ? NULL : archive_sidecar_path(archive, &s->st, ".zidx", 1);
+    if (!primary) {
+        free(fallback);
+        return -ENOMEM;
+    }
+
+    int err = load_zidx(s, primary, 1);
+    if (err && fallback)
+        err = load_zidx(s, fallback, 0);
+    if (err) {
+        const char *target = primary;
+        err = build_zidx(s->fd, &s->st, s->kind, o->span, target);
+        if ((err == -EACCES || err == -EROFS || err == -EPERM) && fallback) {
+            target = fallback;
+            err = build_zidx(s->fd, &s->st, s->kind, o->span, target);
+        }
+        if (!err) {
+            *rebuilt = 1;
+            err = load_zidx(s, target, target == primary);
+        }
+    }
+    free(primary);
+    free(fallback);
+    return err;
+}
+
+int archive_src_open(const char *path, const struct archive_src_opts *opts,
+                     struct archive_src **out, int *rebuilt) {
+    struct archive_src_opts o = {
+        .span = ARCHIVE_SRC_DEFAULT_SPAN,
+        .cache_bytes = ARCHIVE_SRC_DEFAULT_CACHE,
+    };
+    if (opts) {
+        o.zidx_path = opts->zidx_path;
+        if (opts->span)
+            o.span = opts->span;
+        if (opts->cache_bytes)
+            o.cache_bytes = opts->cache_bytes;
+    }
+    int dummy;
+    if (!rebuilt)
+        rebuilt = &dummy;
+    *rebuilt = 0;
+
+    struct archive_src *s = calloc(1, sizeof(*s));
+    if (!s)
+        return -ENOMEM;
+    s->fd = open(path, O_RDONLY | O_CLOEXEC);
+    int err = s->fd < 0 ? -errno : 0;
+    if (!err && fstat(s->fd, &s->st) < 0)
+        err = -errno;
+    if (!err)
+        err = detect_kind(s->fd, &s->kind);
+    if (err)
+        goto fail;
+
+    if (s->kind == ARCHIVE_TAR) {
+        s->size = (uint64_t)s->st.st_size;
+        *out = s;
+        return 0;
+    }
+
+    if ((err = open_zidx(s, path, &o, rebuilt)))
+        goto fail;
+    s->slots = calloc(s->nblocks, sizeof(*s->slots));
+    s->queued = calloc(s->nblocks, 1);
+    if (!s->slots || !s->queued) {
+        err = -ENOMEM;
+        goto fail;
+    }
+    s->lru.next = s->lru.prev = &s->lru;
+    s->cache_limit = o.cache_bytes;
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->loaded, NULL);
+    pthread_cond_init(&s->queue_cond, NULL);
+    *out = s;
+    return 0;
+
+fail:
+    if (s->map)
+        munmap(s->map, s->map_size);
+    free(s->slots);
+    free(s->queued);
+    if (s->fd >= 0)
+        close(s->fd);
+    free(s);
+    return err;
+}
+
+int archive_src_start_prefetch(struct archive_src *s, int nthreads) {
+    if (s->kind == ARCHIVE_TAR || nthreads <= 0 || s->threads)
+        return 0;       // для .tar хватает readahead ядра (posix_fadvise)
+    s->threads = calloc((size_t)nthreads, sizeof(*s->threads));
+    if (!s->threads)
+        return -ENOMEM;
+    for (int i = 0; i < nthreads; i++) {
+        int err = pthread_create(&s->threads[s->nthreads], NULL, prefetch_main, s);
+        if (err)
+            return s->nthreads ? 0 : -err;
+        s->nthreads++;
+    }
+    return 0;
+}
+
+void archive_src_close(struct archive_src *s) {
+    if (!s)
+        return;
+    if (s->kind != ARCHIVE_TAR) {
+        pthread_mutex_lock(&s->lock);
+        s->stopping = 1;
+        pthread_cond_broadcast(&s->queue_cond);
+        pthread_mutex_unlock(&s->lock);
+        for (int i = 0; i < s->nthreads; i++)
+            pthread_join(s->threads[i], NULL);
+        free(s->threads);
+
+        for (uint32_t i = 0; i < s->nblocks; i++)
+            if (s->slots[i])
+                block_free(s->slots[i]);
+        free(s->slots);
+        free(s->queued);
+        pthread_mutex_destroy(&s->lock);
+        pthread_cond_destroy(&s->loaded);
+        pthread_cond_destroy(&s->queue_cond);
+        munmap(s->map, s->map_size);
+    }
+    close(s->fd);
+    free(s);
+}
+
+ssize_t archive_src_pread(struct archive_src *s, void *buf, size_t n, uint64_t off) {
+    if (off >= s->size)
+        return 0;
+    if (n > s->size - off)
+        n = (size_t)(s->size - off);
+
+    if (s->kind == ARCHIVE_TAR) {
+        int err = pread_full(s->fd, buf, n, off);
+        return err ? err : (ssize_t)n;
+    }
+
+    size_t done = 0;
+    uint32_t id = find_block(s, off);
+    while (done < n) {
+        int err = 0;
+        struct zblock *b = block_get(s, id, 0, &err);
+        if (!b)
+            return done ? (ssize_t)done : err;
+        uint64_t boff = off + done - s->points[id].out;
+        size_t k = b->len - (size_t)boff;
+        if (k > n - done)
+            k = n - done;
+        memcpy((char *)buf + done, b->data + boff, k);
+        block_put(s, b);
+        done += k;
+        id++;
+    }
+    return (ssize_t)done;
+}
+
+uint64_t archive_src_size(const struct archive_src *s) {
+    return s->size;
+}
+
+enum archive_kind archive_src_kind(const struct archive_src *s) {
+    return s->kind;
+}
+
+const struct stat *archive_src_stat(const struct archive_src *s) {
+    return &s->st;
+}
+
+void archive_src_get_stats(struct archive_src *s, struct archive_src_stats *st) {
+    if (s->kind == ARCHIVE_TAR) {
+        memset(st, 0, sizeof(*st));
+        return;
+    }
+    pthread_mutex_lock(&s->lock);
+    *st = s->stats;
+    pthread_mutex_unlock(&s->lock);
+}
@@ -0,0 +1,92 @@
+/*
+ * archive_src.h - произвольный доступ к несжатому потоку архива
+ *
+ * Для .tar это просто pread(). Для .tar.gz и .tar.zst случайное чтение
+ * со смещения X без подготовки стоит O(X): поток нужно распаковать с
+ * начала. Поэтому при первом открытии архив один раз распаковывается
+ * целиком, и каждые span байт несжатого потока записывается точка
+ * входа (checkpoint) в <archive>.zidx:
+ *
+ *   gzip — граница deflate-блока: смещение в сжатом файле, недочитанные
+ *          биты и последние 32 KiB вывода (словарь для inflateSetDictionary);
+ *   zstd — граница кадра (frame): кадры независимы, словарь не нужен.
+ *          Один огромный кадр (обычный `zstd file.tar`) разбить нельзя —
+ *          такие архивы нужно сжимать кадрами, например pzstd или t2sz.
+ *
+ * Участок между соседними точками — блок кэша. Распакованные блоки
+ * живут в общем LRU-кэше (ограничен по байтам) и разделяются всеми
+ * открытыми файлами. Пул потоков заранее распаковывает следующие блоки,
+ * когда archive_fs видит последовательное чтение.
+ */
+
+#ifndef ARCHIVE_SRC_H
+#define ARCHIVE_SRC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+enum archive_kind {
+    ARCHIVE_TAR,
+    ARCHIVE_GZIP,
+    ARCHIVE_ZSTD,
+};
+
+struct archive_src_opts {
+    const char *zidx_path;      // NULL — "<archive>.zidx" (или $TMPDIR)
+    uint64_t span;              // шаг точек входа, байт несжатого потока
+    uint64_t cache_bytes;       // предел LRU-кэша распакованных блоков
+};
+
+#define ARCHIVE_SRC_DEFAULT_SPAN   (4ull << 20)
+#define ARCHIVE_SRC_DEFAULT_CACHE  (256ull << 20)
+#define ARCHIVE_SRC_DEFAULT_THREADS 2
+
+struct archive_src_stats {
+    uint64_t hits;              // блок уже был в кэше
+    uint64_t misses;            // блок пришлось распаковать при чтении
+    uint64_t prefetched;        // блок распакован пулом заранее
+    uint64_t evicted;
+    uint64_t cached_bytes;
+};
+
+struct archive_src;
+
+/*
+ * Открыть архив; тип определяется по сигнатуре, а не по расширению.
+ * opts == NULL — значения по умолчанию. *rebuilt = 1, если .zidx
+ * пришлось строить. Возвращает 0 или -errno.
+ */
+int archive_src_open(const char *path, const struct archive_src_opts *opts,
+                     struct archive_src **out, int *rebuilt);
+
+void archive_src_close(struct archive_src *src);
+
+/* Прочитать n байт несжатого потока со смещения off (как pread: меньше — только в конце) */
+ssize_t archive_src_pread(struct archive_src *src, void *buf, size_t n, uint64_t off);
+
+/*
+ * Запустить пул из nthreads потоков упреждающей распаковки. Отдельно от
+ * open: FUSE без -f уходит в фон через fork(), и потоки, созданные до
+ * этого, в демоне не выживут — пул запускается из init().
+ */
+int archive_src_start_prefetch(struct archive_src *src, int nthreads);
+
+/* Поставить в очередь пула распаковку блоков, покрывающих [off, off + len) */
+void archive_src_prefetch(struct archive_src *src, uint64_t off, uint64_t len);
+
+uint64_t archive_src_size(const struct archive_src *src);    // несжатый размер
+enum archive_kind archive_src_kind(const struct archive_src *src);
+const struct stat *archive_src_stat(const struct archive_src *src);  // stat сжатого файла
+void archive_src_get_stats(struct archive_src *src, struct archive_src_stats *st);
+
+/*
+ * Путь для файла-спутника архива: "<archive><suffix>", а при fallback —
+ * "$TMPDIR/<basename>.<dev>-<ino><suffix>" для каталогов только для чтения.
+ * Возвращает malloc-строку или NULL.
+ */
+char *archive_sidecar_path(const char *archive, const struct stat *st,
+                           const char *suffix, int fallback);
+
+#endif /* ARCHIVE_SRC_H */
@@ -0,0 +1,410 @@
+/*
+ * byte_xform.c - ядра побайтовых преобразований (см. byte_xform.h)
+ *
+ * Векторные ядра собраны с __attribute__((target(...))), поэтому файл
+ * компилируется без -mavx2/-mavx512*: инструкции появляются только внутри
+ * этих функций, а вызываются они, лишь если __builtin_cpu_supports()
+ * подтвердил поддержку. Не на x86 (XFORM_X86 == 0) остаются только
+ * скалярные ядра.
+ *
+ * Диапазон на векторе без ветвлений: t = x - lo (с переполнением),
+ * байт внутри [lo, hi] <=> min(t, hi - lo) == t (беззнаково).
+ */
+
+#define _GNU_SOURCE
+#include "byte_xform.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define XFORM_X86 1
+#include <immintrin.h>
+#else
+#define XFORM_X86 0
+#endif
+
+/* ---------- Скалярные ядра ---------- */
+
+static size_t key_start(const struct byte_xform *x, uint64_t stream_off) {
+    return (size_t)(stream_off % x->key_len);
+}
+
+/* Хвосты и скалярный путь: таблица для RANGES/LUT, ключ для XOR */
+static void scalar_tail(const struct byte_xform *x, uint8_t *dst, const uint8_t *src,
+                        size_t n, uint64_t stream_off) {
+    if (x->type == XFORM_XOR) {
+        size_t k = key_start(x, stream_off);
+        for (size_t i = 0; i < n; i++) {
+            dst[i] = src[i] ^ x->key[k];
+            if (++k == x->key_len)
+                k = 0;
+        }
+        return;
+    }
+    for (size_t i = 0; i < n; i++)
+        dst[i] = x->lut[src[i]];
+}
+
+static void kernel_scalar(const struct byte_xform *x, uint8_t *dst, const uint8_t *src,
+                          size_t n, uint64_t stream_off) {
+    scalar_tail(x, dst, src, n, stream_off);
+}
+
+/*
+ * Как пишут в учебном решении: условие на каждый байт (аналог
+ * if (c >= 'a' && c <= 'z') c -= 32 или toupper()) и деление для ключа.
+ */
+static void kernel_naive(const struct byte_xform *x, uint8_t *dst, const uint8_t *src,
+                         size_t n, uint64_t stream_off) {
+    for (size_t i = 0; i < n; i++) {
+        uint8_t c = src[i];
+        if (x->type == XFORM_XOR) {
+            c ^= x->key[(stream_off + i) % x->key_len];
+        } else if (x->type == XFORM_RANGES) {
+            for (int r = 0; r < x->nranges; r++) {
+                const struct xform_range *rg = &x->ranges[r];
+                uint8_t t = rg->fold ? (uint8_t)(c | 0x20) : c;
+                if (t >= rg->lo && t <= rg->hi) {
+                    c = (uint8_t)(c + rg->delta);
+                    break;
+                }
+            }
+        } else {
+            c = x->lut[c];
+        }
+        dst[i] = c;
+    }
+}
+
+#if XFORM_X86
+
+/* ---------- SSE2 ---------- */
+
+__attribute__((target("sse2")))
+static void kernel_sse2(const struct byte_xform *x, uint8_t *dst, const uint8_t *src,
+                        size_t n, uint64_t stream_off) {
+    size_t i = 0;
+    if (x->type == XFORM_XOR) {
+        size_t k = key_start(x, stream_off);
+        for (; i + 16 <= n; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+            __m128i kv = _mm_loadu_si128((const __m128i *)(x->key + k));
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(v, kv));
+            k = (k + 16) % x->key_len;
+        }
+    } else {
+        __m128i lo[XFORM_MAX_RANGES], span[XFORM_MAX_RANGES], delta[XFORM_MAX_RANGES];
+        const __m128i k20 = _mm_set1_epi8(0x20);
+        for (int r = 0; r < x->nranges; r++) {
+            lo[r] = _mm_set1_epi8((char)x->ranges[r].lo);
+            span[r] = _mm_set1_epi8((char)(x->ranges[r].hi - x->ranges[r].lo));
+            delta[r] = _mm_set1_epi8((char)x->ranges[r].delta);
+        }
+        for (; i + 16 <= n; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+            __m128i vf = _mm_or_si128(v, k20);
+            __m128i add = _mm_setzero_si128();
+            for (int r = 0; r < x->nranges; r++) {
+                __m128i t = _mm_sub_epi8(x->ranges[r].fold ? vf : v, lo[r]);
+                __m128i in = _mm_cmpeq_epi8(_mm_min_epu8(t, span[r]), t);
+                add = _mm_add_epi8(add, _mm_and_si128(in, delta[r]));
+            }
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_add_epi8(v, add));
+        }
+    }
+    scalar_tail(x, dst + i, src + i, n - i, stream_off + i);
+}
+
+/* ---------- AVX2 ---------- */
+
+__attribute__((target("avx2")))
+static void kernel_avx2(const struct byte_xform *x, uint8_t *dst, const uint8_t *src,
+                        size_t n, uint64_t stream_off) {
+    size_t i = 0;
+    if (x->type == XFORM_XOR) {
+        size_t k = key_start(x, stream_off);
+        for (; i + 32 <= n; i += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+            __m256i kv = _mm256_loadu_si256((const __m256i *)(x->key + k));
+            _mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(v, kv));
+            k = (k + 32) % x->key_len;
+        }
+    } else {
+        __m256i lo[XFORM_MAX_RANGES], span[XFORM_MAX_RANGES], delta[XFORM_MAX_RANGES];
+        const __m256i k20 = _mm256_set1_epi8(0x20);
+        for (int r = 0; r < x->nranges; r++) {
+            lo[r] = _mm256_set1_epi8((char)x->ranges[r].lo);
+            span[r] = _mm256_set1_epi8((char)(x->ranges[r].hi - x->ranges[r].lo));
+            delta[r] = _mm256_set1_epi8((char)x->ranges[r].delta);
+        }
+        for (; i + 32 <= n; i += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+            __m256i vf = _mm256_or_si256(v, k20);
+            __m256i add = _mm256_setzero_si256();
+            for (int r = 0; r < x->nranges; r++) {
+                __m256i t = _mm256_sub_epi8(x->ranges[r].fold ? vf : v, lo[r]);
+                __m256i in = _mm256_cmpeq_epi8(_mm256_min_epu8(t, span[r]), t);
+                add = _mm256_add_epi8(add, _mm256_and_si256(in, delta[r]));
+            }
+            _mm256_storeu_si256((__m256i *)(dst + i), _mm256_add_epi8(v, add));
+        }
+    }
+    scalar_tail(x, dst + i, src + i, n - i, stream_off + i);
+}
+
+/* ---------- AVX-512 ---------- */
+
+/* Хвост — маскированные load/store той же ширины, без скалярного цикла */
+__attribute__((target("avx512f,avx512bw")))
+static void kernel_avx512bw(const struct byte_xform *x, uint8_t *dst, const uint8_t *src,
+                            size_t n, uint64_t stream_off) {
+    if (x->type == XFORM_XOR) {
+        size_t k = key_start(x, stream_off);
+        for (size_t i = 0; i < n; i += 64) {
+            __mmask64 m = n - i >= 64 ? ~(__mmask64)0 : (((__mmask64)1 << (n - i)) - 1);
+            __m512i v = _mm512_maskz_loadu_epi8(m, src + i);
+            __m512i kv = _mm512_loadu_si512(x->key + k);
+            _mm512_mask_storeu_epi8(dst + i, m, _mm512_xor_si512(v, kv));
+            k = (k + 64) % x->key_len;
+        }
+        return;
+    }
+
+    __m512i lo[XFORM_MAX_RANGES], span[XFORM_MAX_RANGES], delta[XFORM_MAX_RANGES];
+    const __m512i k20 = _mm512_set1_epi8(0x20);
+    for (int r = 0; r < x->nranges; r++) {
+        lo[r] = _mm512_set1_epi8((char)x->ranges[r].lo);
+        span[r] = _mm512_set1_epi8((char)(x->ranges[r].hi - x->ranges[r].lo));
+        delta[r] = _mm512_set1_epi8((char)x->ranges[r].delta);
+    }
+    for (size_t i = 0; i < n; i += 64) {
+        __mmask64 m = n - i >= 64 ? ~(__mmask64)0 : (((__mmask64)1 << (n - i)) - 1);
+        __m512i v = _mm512_maskz_loadu_epi8(m, src + i);
+        __m512i vf = _mm512_or_si512(v, k20);
+        __m512i out = v;
+        for (int r = 0; r < x->nranges; r++) {
+            __m512i t = _mm512_sub_epi8(x->ranges[r].fold ? vf : v, lo[r]);
+            __mmask64 in = _mm512_cmple_epu8_mask(t, span[r]);
+            out = _mm512_mask_add_epi8(out, in, out, delta[r]);
+        }
+        _mm512_mask_storeu_epi8(dst + i, m, out);
+    }
+}
+
+/*
+ * Любая таблица из 256 байт за две перестановки: vpermi2b выбирает из
+ * 128 байт по младшим 7 битам, старший бит выбирает половину таблицы.
+ */
+__attribute__((target("avx512f,avx512bw,avx512vbmi")))
+static void kernel_avx512vbmi(const struct byte_xform *x, uint8_t *dst, const uint8_t *src,
+                              size_t n, uint64_t stream_off) {
+    (void) stream_off;
+    const __m512i t0 = _mm512_loadu_si512(x->lut);
+    const __m512i t1 = _mm512_loadu_si512(x->lut + 64);
+    const __m512i t2 = _mm512_loadu_si512(x->lut + 128);
+    const __m512i t3 = _mm512_loadu_si512(x->lut + 192);
+    for (size_t i = 0; i < n; i += 64) {
+        __mmask64 m = n - i >= 64 ? ~(__mmask64)0 : (((__mmask64)1 << (n - i)) - 1);
+        __m512i v = _mm512_maskz_loadu_epi8(m, src + i);
+        __m512i lo = _mm512_permutex2var_epi8(t0, v, t1);
+        __m512i hi = _mm512_permutex2var_epi8(t2, v, t3);
+        __m512i out = _mm512_mask_blend_epi8(_mm512_movepi8_mask(v), lo, hi);
+        _mm512_mask_storeu_epi8(dst + i, m, out);
+    }
+}
+
+#endif /* XFORM_X86 */
+
+/* ---------- Выбор ядра ---------- */
+
+static const struct xform_kernel k_naive = { "naive", kernel_naive };
+static const struct xform_kernel k_scalar = { "scalar", kernel_scalar };
+#if XFORM_X86
+static const struct xform_kernel k_sse2 = { "sse2", kernel_sse2 };
+static const struct xform_kernel k_avx2 = { "avx2", kernel_avx2 };
+static const struct xform_kernel k_avx512bw = { "avx512bw", kernel_avx512bw };
+static const struct xform_kernel k_avx512vbmi = { "avx512vbmi", kernel_avx512vbmi };
+#endif
+
+size_t xform_kernels(const struct byte_xform *x, const struct xform_kernel **out, size_t max) {
+    const struct xform_kernel *all[6];
+    size_t n = 0;
+
+    all[n++] = &k_naive;
+    all[n++] = &k_scalar;
+#if XFORM_X86
+    __builtin_cpu_init();
+    if (x->type != XFORM_LUT) {
+        if (__builtin_cpu_supports("sse2"))
+            all[n++] = &k_sse2;
+        if (__builtin_cpu_supports("avx2"))
+            all[n++] = &k_avx2;
+        if (__builtin_cpu_supports("avx512bw"))
+            all[n++] = &k_avx512bw;
+    }
+    // Таблица через vpermi2b подходит и для диапазонов — и дешевле сравнений
+    if (x->type != XFORM_XOR && __builtin_cpu_supports("avx512vbmi"))
+        all[n++] = &k_avx512vbmi;
+#else
+    (void) x;
+#endif
+
+    if (n > max)
+        n = max;
+    memcpy(out, all, n * sizeof(*out));
+    return n;
+}
+
+int xform_select(struct byte_xform *x, const char *name) {
+    const struct xform_kernel *list[8];
+    size_t n = xform_kernels(x, list, 8);
+    for (size_t i = 0; i < n; i++) {
+        if (!strcmp(list[i]->name, name)) {
+            x->kernel = list[i];
+            return 0;
+        }
+    }
+    return -ENOENT;
+}
+
+/* Последнее в списке — самое быстрое; XFORM_KERNEL переопределяет выбор */
+static void select_default(struct byte_xform *x) {
+    const struct xform_kernel *list[8];
+    size_t n = xform_kernels(x, list, 8);
+    x->kernel = list[n - 1];
+
+    const char *env = getenv("XFORM_KERNEL");
+    if (env && *env)
+        xform_select(x, env);
+}
+
+/* ---------- Построение преобразований ---------- */
+
+/*
+ * Разложить таблицу на участки с постоянным сдвигом. Пары участков,
+ * отличающиеся только регистром (A-M и a-m с одним delta), сливаются
+ * в одно правило с fold: для ROT13 вместо 4 сравнений получается 2.
+ */
+static int lut_to_ranges(struct byte_xform *x) {
+    struct xform_range r[16];
+    int n = 0;
+
+    for (int i = 0; i < 256;) {
+        uint8_t d = (uint8_t)(x->lut[i] - i);
+        if (d == 0) {
+            i++;
+            continue;
+        }
+        int j = i;
+        while (j + 1 < 256 && (uint8_t)(x->lut[j + 1] - (j + 1)) == d)
+            j++;
+        if (n == 16)
+            return 0;
+        r[n++] = (struct xform_range){ (uint8_t)i, (uint8_t)j, d, 0 };
+        i = j + 1;
+    }
+
+    for (int a = 0; a < n; a++) {
+        if (r[a].lo < 'A' || r[a].hi > 'Z')
+            continue;
+        for (int b = 0; b < n; b++) {
+            if (r[b].lo == (r[a].lo | 0x20) && r[b].hi == (r[a].hi | 0x20) &&
+                r[b].delta == r[a].delta && !r[b].fold) {
+                r[b].fold = 1;
+                r[a].delta = 0;         // пометка на удаление
+                break;
+            }
+        }
+    }
+
+    int m = 0;
+    for (int a = 0; a < n; a++)
+        if (r[a].delta)
+            r[m++] = r[a];
+    if (m > XFORM_MAX_RANGES)
+        return 0;
+    memcpy(x->ranges, r, (size_t)m * sizeof(r[0]));
+    x->nranges = m;
+    return 1;
+}
+
+int xform_init_lut(struct byte_xform *x, const uint8_t lut[256]) {
+    memset(x, 0, sizeof(*x));
+    memcpy(x->lut, lut, 256);
+    x->type = lut_to_ranges(x) ? XFORM_RANGES : XFORM_LUT;
+    x->involution = 1;
+    for (int i = 0; i < 256; i++)
+        if (lut[lut[i]] != i)
+            x->involution = 0;
+    select_default(x);
+    return 0;
+}
+
+int xform_init_rot13(struct byte_xform *x) {
+    uint8_t lut[256];
+    for (int i = 0; i < 256; i++) {
+        int c = i;
+        if (c >= 'a' && c <= 'z')
+            c = 'a' + (c - 'a' + 13) % 26;
+        else if (c >= 'A' && c <= 'Z')
+            c = 'A' + (c - 'A' + 13) % 26;
+        lut[i] = (uint8_t)c;
+    }
+    return xform_init_lut(x, lut);
+}
+
+/* Только ASCII: байты UTF-8 >= 0x80 не трогаем, как toupper() в локали "C" */
+int xform_init_upper(struct byte_xform *x) {
+    uint8_t lut[256];
+    for (int i = 0; i < 256; i++)
+        lut[i] = (uint8_t)(i >= 'a' && i <= 'z' ? i - 32 : i);
+    return xform_init_lut(x, lut);
+}
+
+int xform_init_lower(struct byte_xform *x) {
+    uint8_t lut[256];
+    for (int i = 0; i < 256; i++)
+        lut[i] = (uint8_t)(i >= 'A' && i <= 'Z' ? i + 32 : i);
+    return xform_init_lut(x, lut);
+}
+
+/*
+ * Ключ хранится повторённым до key_len + 64 байт: вектор с любого
+ * начала k < key_len читается одной невыровненной загрузкой.
+ */
+int xform_init_xor(struct byte_xform *x, const uint8_t *key, size_t key_len) {
+    if (key_len == 0)
+        return -EINVAL;
+    memset(x, 0, sizeof(*x));
+    x->type = XFORM_XOR;
+    x->key_len = key_len;
+    x->key = malloc(key_len + 64);
+    if (!x->key)
+        return -ENOMEM;
+    for (size_t i = 0; i < key_len + 64; i++)
+        x->key[i] = key[i % key_len];
+    for (int i = 0; i < 256; i++)
+        x->lut[i] = (uint8_t)i;
+    x->involution = 1;
+    select_default(x);
+    return 0;
+}
+
+int xform_init_name(struct byte_xform *x, const char *spec) {
+    if (!strcmp(spec, "rot13"))
+        return xform_init_rot13(x);
+    if (!strcmp(spec, "upper"))
+        return xform_init_upper(x);
+    if (!strcmp(spec, "lower"))
+        return xform_init_lower(x);
+    if (!strncmp(spec, "xor:", 4))
+        return xform_init_xor(x, (const uint8_t *)spec + 4, strlen(spec + 4));
+    return -EINVAL;
+}
+
+void xform_free(struct byte_xform *x) {
+    free(x->key);
+    memset(x, 0, sizeof(*x));
+}
@@ -0,0 +1,89 @@
+/*
+ * byte_xform.h - побайтовые преобразования буфера для FUSE (Вариант 2)
+ *
+ * ROT13 FS и Uppercase FS меняют каждый байт в read()/write(). Цикл с
+ * toupper() на каждый символ упирается в процессор раньше, чем в диск:
+ * вызов функции и ветвление на байт. Здесь преобразование описывается
+ * данными и выполняется векторно, 16/32/64 байта за инструкцию:
+ *
+ *   XFORM_RANGES — таблица, сводимая к "байт из [lo, hi] -> + delta"
+ *                  (ROT13, верхний/нижний регистр): сравнения и сложения;
+ *   XFORM_LUT    — произвольная таблица 256 байт: vpermi2b (AVX-512 VBMI)
+ *                  или скалярный проход по таблице;
+ *   XFORM_XOR    — XOR с повторяющимся ключом, зависит от смещения в файле.
+ *
+ * Ядро (SSE2 / AVX2 / AVX-512) выбирается при инициализации по cpuid;
+ * переменная окружения XFORM_KERNEL=<имя> задаёт его явно.
+ */
+
+#ifndef BYTE_XFORM_H
+#define BYTE_XFORM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define XFORM_MAX_RANGES 4
+
+enum xform_type {
+    XFORM_RANGES,
+    XFORM_LUT,
+    XFORM_XOR,
+};
+
+struct xform_range {
+    uint8_t lo, hi;         // включительно
+    uint8_t delta;          // прибавляется по модулю 256
+    uint8_t fold;           // сравнивать (x | 0x20): A-M и a-m одним правилом
+};
+
+struct byte_xform;
+
+/* dst может совпадать с src — преобразование на месте */
+typedef void (*xform_fn)(const struct byte_xform *x, uint8_t *dst,
+                         const uint8_t *src, size_t n, uint64_t stream_off);
+
+struct xform_kernel {
+    const char *name;
+    xform_fn fn;
+};
+
+struct byte_xform {
+    enum xform_type type;
+    uint8_t lut[256];               // всегда заполнена: скалярный путь и хвосты
+    struct xform_range ranges[XFORM_MAX_RANGES];
+    int nranges;
+    uint8_t *key;                   // XOR: ключ, повторённый до key_len + 64 байт
+    size_t key_len;
+    int involution;                 // f(f(x)) == x: тем же шифруется запись
+    const struct xform_kernel *kernel;
+};
+
+/* Из произвольной таблицы; сам находит, сводится ли она к диапазонам */
+int xform_init_lut(struct byte_xform *x, const uint8_t lut[256]);
+int xform_init_rot13(struct byte_xform *x);
+int xform_init_upper(struct byte_xform *x);
+int xform_init_lower(struct byte_xform *x);
+int xform_init_xor(struct byte_xform *x, const uint8_t *key, size_t key_len);
+
+/* "rot13", "upper", "lower", "xor:KEY"; 0 или -EINVAL */
+int xform_init_name(struct byte_xform *x, const char *spec);
+
+void xform_free(struct byte_xform *x);
+
+/* stream_off — смещение buf в файле (нужно XOR-ключу) */
+static inline void xform_apply(const struct byte_xform *x, void *dst, const void *src,
+                               size_t n, uint64_t stream_off) {
+    x->kernel->fn(x, (uint8_t *)dst, (const uint8_t *)src, n, stream_off);
+}
+
+/*
+ * Ядра, подходящие для x на этом процессоре, от простого к быстрому.
+ * Первое — "naive" (побайтовый цикл как в учебном решении), его
+ * диспетчер не выбирает: он нужен для сравнения в xform_bench.
+ */
+size_t xform_kernels(const struct byte_xform *x, const struct xform_kernel **out, size_t max);
+
+/* Выбрать ядро по имени; -ENOENT, если оно недоступно */
+int xform_select(struct byte_xform *x, const char *name);
+
+#endif /* BYTE_XFORM_H */
@@ -0,0 +1,546 @@
+/*
+ * fuse_replay.c - воспроизведение трассы passthrough_fuse --trace на любой ФС
+ *
+ * Каждому потоку демона из трассы соответствует свой поток здесь: он
+ * выполняет операции того потока в записанном порядке. Так сохраняется
+ * параллелизм исходной нагрузки, и её можно прогнать на другой версии
+ * демона (или на ФС без FUSE) и сравнить задержки.
+ *
+ * Режимы:
+ *   по умолчанию — как можно быстрее, каждый поток без пауз;
+ *   -t           — по записанному времени: операция стартует в том же
+ *                  смещении от начала, что и в трассе (-x ускоряет).
+ *
+ * Пути из трассы (относительно корня FUSE) дописываются к MOUNT.
+ * Файл открывается один раз на путь в каждом потоке и переиспользуется для
+ * read/write: в задержку попадает сама операция, а не open.
+ *
+ * Компиляция: make fuse_replay
+ * Использование: ./fuse_replay [-t] [-x SPEED] [-r] TRACE MOUNT
+ */
+
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "fuse_trace.h"
+
+#define MAX_PATH_ID (1u << 24)  // больше в трассе не бывает: массивы по path_id
+
+struct op {
+    struct ftrace_rec rec;
+    uint64_t lat_ns;            // задержка при воспроизведении
+    int64_t lag_ns;             // -t: насколько позже расписания стартовала
+    int64_t result;
+    int skipped;
+};
+
+/* fd потока на путь; gen — поколение пути, при котором fd открыт */
+struct fd_slot {
+    int fd;                     // fd + 1, 0 — ещё не открыт
+    uint32_t gen;
+};
+
+struct worker {
+    pthread_t thread;
+    struct op *begin, *end;
+    char *buf;
+    size_t buf_size;
+    struct fd_slot *rfds, *wfds;    // по path_id, только этого потока
+};
+
+static const char *const op_names[FSTAT_OP_COUNT] = FSTAT_OP_NAMES;
+
+static char **paths;            // по path_id, уже с префиксом MOUNT
+static uint32_t npaths;
+static uint32_t *path_gen;      // растёт на create/unlink/rename пути
+static int timed, readonly;
+static double speed = 1.0;
+static uint64_t t0_ns;
+static pthread_barrier_t start_barrier;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* ---------- Загрузка трассы ---------- */
+
+static int add_path(uint32_t id, const char *mount, const char *p, size_t len) {
+    if (id >= MAX_PATH_ID)
+        return -1;
+    if (id >= npaths) {
+        size_t n = npaths ? npaths : 1024;
+        while (n <= id)
+            n *= 2;
+        char **t = realloc(paths, n * sizeof(*t));
+        if (!t)
+            return -1;
+        memset(t + npaths, 0, (n - npaths) * sizeof(*t));
+        paths = t;
+        npaths = (uint32_t)n;
+    }
+    size_t mlen = strlen(mount);
+    char *full = malloc(mlen + len + 1);
+    if (!full)
+        return -1;
+    memcpy(full, mount, mlen);
+    memcpy(full + mlen, p, len);
+    full[mlen + len] = '\0';
+    free(paths[id]);
+    paths[id] = full;
+    return 0;
+}
+
+static struct op *load_trace(const char *file, const char *mount, size_t *nops) {
+    FILE *f = fopen(file, "rb");
+    if (!f) {
+        perror(file);
+        return NULL;
+    }
+
+    struct ftrace_header hdr;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || memcmp(hdr.magic, FTRACE_MAGIC, 8) ||
+        hdr.version != FTRACE_VERSION || hdr.rec_size != sizeof(struct ftrace_rec)) {
+        fprintf(stderr, "%s: not a trace of version %d\n", file, FTRACE_VERSION);
+        fclose(f);
+        return NULL;
+    }
+
+    struct op *ops = NULL;
+    size_t n = 0, cap = 0;
+    struct ftrace_rec r;
+    char pbuf[4096 + 8];
+    while (fread(&r, sizeof(r), 1, f) == 1) {
+        if (r.type == FTR_PATH) {
+            size_t padded = (r.size + 7) & ~(uint64_t)7;
+            if (padded > sizeof(pbuf) || fread(pbuf, 1, padded, f) != padded ||
+                add_path(r.path_id, mount, pbuf, r.size) < 0) {
+                fprintf(stderr, "%s: bad path record\n", file);
+                goto fail;
+            }
+            continue;
+        }
+        if (r.type != FTR_OP || r.op >= FSTAT_OP_COUNT)
+            continue;               // запись из более новой версии демона
+        if (n == cap) {
+            cap = cap ? cap * 2 : 65536;
+            struct op *t = realloc(ops, cap * sizeof(*t));
+            if (!t)
+                goto fail;
+            ops = t;
+        }
+        memset(&ops[n], 0, sizeof(ops[n]));
+        ops[n++].rec = r;
+    }
+    fclose(f);
+    *nops = n;
+    return ops;
+
+fail:
+    fclose(f);
+    free(ops);
+    return NULL;
+}
+
+static int cmp_tid_start(const void *a, const void *b) {
+    const struct ftrace_rec *x = &((const struct op *)a)->rec;
+    const struct ftrace_rec *y = &((const struct op *)b)->rec;
+    if (x->tid != y->tid)
+        return x->tid < y->tid ? -1 : 1;
+    return x->start_ns < y->start_ns ? -1 : x->start_ns > y->start_ns;
+}
+
+/* ---------- Выполнение ---------- */
+
+/*
+ * fd закрывает только поток-владелец: чужой close() освободил бы номер,
+ * который другой поток уже взял для pread/pwrite, и его перехватил бы
+ * следующий open() — запись ушла бы не в тот файл.
+ */
+static int cached_fd(struct fd_slot *cache, uint32_t id, int flags) {
+    struct fd_slot *s = &cache[id];
+    uint32_t gen = __atomic_load_n(&path_gen[id], __ATOMIC_ACQUIRE);
+    if (s->fd && s->gen == gen)
+        return s->fd - 1;
+    if (s->fd)
+        close(s->fd - 1);
+    s->fd = 0;
+    int fd = open(paths[id], flags | O_CLOEXEC);
+    if (fd < 0)
+        return -errno;
+    s->fd = fd + 1;
+    s->gen = gen;
+    return fd;
+}
+
+/* После create/unlink старый fd смотрит на другой inode: потоки откроют заново */
+static void drop_fds(uint32_t id) {
+    __atomic_fetch_add(&path_gen[id], 1, __ATOMIC_RELEASE);
+}
+
+static void close_fds(struct fd_slot *cache) {
+    for (uint32_t i = 0; cache && i < npaths; i++)
+        if (cache[i].fd)
+            close(cache[i].fd - 1);
+    free(cache);
+}
+
+static int mutating(int op) {
+    return op == FSTAT_WRITE || op == FSTAT_CREATE || op == FSTAT_UNLINK ||
+           op == FSTAT_MKDIR || op == FSTAT_RMDIR || op == FSTAT_COPY_FILE_RANGE ||
+           op == FSTAT_FALLOCATE || op == FSTAT_TRUNCATE || op == FSTAT_RENAME ||
+           op == FSTAT_UTIMENS;
+}
+
+static int two_paths(int op) {
+    return op == FSTAT_COPY_FILE_RANGE || op == FSTAT_RENAME;
+}
+
+static struct timespec utime_of(uint64_t v) {
+    struct timespec ts = { 0, 0 };
+    if (v == FTRACE_UTIME_NOW)
+        ts.tv_nsec = UTIME_NOW;
+    else if (v == FTRACE_UTIME_OMIT)
+        ts.tv_nsec = UTIME_OMIT;
+    else {
+        ts.tv_sec = (time_t)(v / 1000000000ull);
+        ts.tv_nsec = (long)(v % 1000000000ull);
+    }
+    return ts;
+}
+
+static long run_op(struct worker *w, struct op *o) {
+    const struct ftrace_rec *r = &o->rec;
+    const char *path = paths[r->path_id];
+    size_t size = r->size < w->buf_size ? r->size : w->buf_size;
+    long res;
+    int fd = -1, fd2 = -1;
+
+    // fd — до начала отсчёта
+    if (r->op == FSTAT_READ || r->op == FSTAT_LSEEK || r->op == FSTAT_COPY_FILE_RANGE) {
+        fd = cached_fd(w->rfds, r->path_id, O_RDONLY);
+        if (fd < 0)
+            return fd;
+    } else if (r->op == FSTAT_WRITE || r->op == FSTAT_FALLOCATE) {
+        fd = cached_fd(w->wfds, r->path_id, O_WRONLY);
+        if (fd < 0)
+            return fd;
+    }
+    if (r->op == FSTAT_COPY_FILE_RANGE) {
+        fd2 = cached_fd(w->wfds, r->path2_id, O_WRONLY);
+        if (fd2 < 0)
+            return fd2;
+    }
+
+    uint64_t t = now_ns();
+    switch (r->op) {
+        case FSTAT_GETATTR: {
+            struct stat st;
+            res = lstat(path, &st) < 0 ? -errno : 0;
+            break;
+        }
+        case FSTAT_READDIR: {
+            DIR *d = opendir(path);
+            if (!d) {
+                res = -errno;
+                break;
+            }
+            while (readdir(d))
+                ;
+            closedir(d);
+            res = 0;
+            break;
+        }
+        case FSTAT_OPEN: {
+            int flags = (int)r->size & ~(O_CREAT | O_EXCL);
+            if (readonly)
+                flags = (flags & ~(O_ACCMODE | O_TRUNC | O_APPEND)) | O_RDONLY;
+            int ofd = open(path, flags | O_CLOEXEC);
+            res = ofd < 0 ? -errno : 0;
+            if (ofd >= 0)
+                close(ofd);
+            break;
+        }
+        case FSTAT_READ:
+            res = pread(fd, w->buf, size, (off_t)r->offset);
+            if (res < 0)
+                res = -errno;
+            break;
+        case FSTAT_WRITE:
+            res = pwrite(fd, w->buf, size, (off_t)r->offset);
+            if (res < 0)
+                res = -errno;
+            break;
+        case FSTAT_CREATE: {
+            int cfd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, (mode_t)r->size & 07777);
+            res = cfd < 0 ? -errno : 0;
+            if (cfd >= 0)
+                close(cfd);
+            break;
+        }
+        case FSTAT_UNLINK:
+            res = unlink(path) < 0 ? -errno : 0;
+            break;
+        case FSTAT_MKDIR:
+            res = mkdir(path, (mode_t)r->size & 07777) < 0 ? -errno : 0;
+            break;
+        case FSTAT_RMDIR:
+            res = rmdir(path) < 0 ? -errno : 0;
+            break;
+        case FSTAT_COPY_FILE_RANGE: {
+            loff_t in = (loff_t)r->offset, out = (loff_t)r->offset2;
+            res = copy_file_range(fd, &in, fd2, &out, r->size, 0);
+            if (res < 0)
+                res = -errno;
+            break;
+        }
+        case FSTAT_FALLOCATE:
+            res = fallocate(fd, (int)r->offset2, (off_t)r->offset, (off_t)r->size) < 0 ? -errno : 0;
+            break;
+        case FSTAT_LSEEK:
+            res = lseek(fd, (off_t)r->offset, (int)r->size);
+            if (res < 0)
+                res = -errno;
+            break;
+        case FSTAT_TRUNCATE:
+            res = truncate(path, (off_t)r->offset) < 0 ? -errno : 0;
+            break;
+        case FSTAT_RENAME:
+            res = renameat2(AT_FDCWD, path, AT_FDCWD, paths[r->path2_id],
+                            (unsigned)r->size) < 0 ? -errno : 0;
+            break;
+        case FSTAT_UTIMENS: {
+            struct timespec tv[2] = { utime_of(r->offset), utime_of(r->offset2) };
+            res = utimensat(AT_FDCWD, path, tv, AT_SYMLINK_NOFOLLOW) < 0 ? -errno : 0;
+            break;
+        }
+        default:
+            res = -ENOSYS;
+    }
+    o->lat_ns = now_ns() - t;
+
+    if (r->op == FSTAT_CREATE || r->op == FSTAT_UNLINK || r->op == FSTAT_RENAME)
+        drop_fds(r->path_id);
+    if (r->op == FSTAT_RENAME)
+        drop_fds(r->path2_id);
+    return res;
+}
+
+static void *worker_main(void *arg) {
+    struct worker *w = arg;
+    pthread_barrier_wait(&start_barrier);
+
+    for (struct op *o = w->begin; o < w->end; o++) {
+        if (timed) {
+            uint64_t target = t0_ns + (uint64_t)(o->rec.start_ns / speed);
+            uint64_t now = now_ns();
+            if (now < target) {
+                struct timespec ts = { (time_t)(target / 1000000000ull), (long)(target % 1000000000ull) };
+                clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+                now = now_ns();
+            }
+            o->lag_ns = (int64_t)(now - target);
+        }
+        const struct ftrace_rec *r = &o->rec;
+        if ((readonly && mutating(r->op)) || r->path_id >= npaths || !paths[r->path_id] ||
+            (two_paths(r->op) && (r->path2_id >= npaths || !paths[r->path2_id]))) {
+            o->skipped = 1;
+            continue;
+        }
+        o->result = run_op(w, o);
+    }
+    return NULL;
+}
+
+/* ---------- Отчёт ---------- */
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double pct_us(const uint64_t *v, size_t n, double q) {
+    if (!n)
+        return 0;
+    size_t i = (size_t)(q * (double)(n - 1) + 0.5);
+    return v[i] / 1e3;
+}
+
+static void report(struct op *ops, size_t nops) {
+    uint64_t *rec = malloc((nops + 1) * sizeof(*rec));
+    uint64_t *rep = malloc((nops + 1) * sizeof(*rep));
+    if (!rec || !rep) {
+        free(rec);
+        free(rep);
+        return;
+    }
+
+    printf("\n%-15s %9s %8s %7s %8s | %9s %9s | %9s %9s %9s %9s %9s\n",
+           "op", "count", "skipped", "errors", "mismatch", "rec_p50", "rec_p99",
+           "p50_us", "p90_us", "p99_us", "p999_us", "max_us");
+    for (int op = 0; op < FSTAT_OP_COUNT; op++) {
+        size_t n = 0, nrep = 0, skipped = 0, errors = 0, mismatch = 0;
+        for (size_t i = 0; i < nops; i++) {
+            const struct op *o = &ops[i];
+            if (o->rec.op != op)
+                continue;
+            rec[n++] = o->rec.end_ns - o->rec.start_ns;
+            if (o->skipped) {
+                skipped++;
+                continue;
+            }
+            rep[nrep++] = o->lat_ns;
+            if (o->result < 0)
+                errors++;
+            // Успех/ошибка разошлись, или read/lseek/copy вернули другое число
+            if ((o->result < 0) != (o->rec.result < 0) ||
+                ((op == FSTAT_READ || op == FSTAT_LSEEK || op == FSTAT_COPY_FILE_RANGE) &&
+                 o->result != o->rec.result))
+                mismatch++;
+        }
+        if (!n)
+            continue;
+        qsort(rec, n, sizeof(*rec), cmp_u64);
+        qsort(rep, nrep, sizeof(*rep), cmp_u64);
+        printf("%-15s %9zu %8zu %7zu %8zu | %9.1f %9.1f | %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+               op_names[op], n, skipped, errors, mismatch,
+               pct_us(rec, n, 0.50), pct_us(rec, n, 0.99),
+               pct_us(rep, nrep, 0.50), pct_us(rep, nrep, 0.90), pct_us(rep, nrep, 0.99),
+               pct_us(rep, nrep, 0.999), nrep ? rep[nrep - 1] / 1e3 : 0.0);
+    }
+
+    if (timed) {
+        size_t n = 0;
+        for (size_t i = 0; i < nops; i++)
+            rep[n++] = ops[i].lag_ns > 0 ? (uint64_t)ops[i].lag_ns : 0;
+        qsort(rep, n, sizeof(*rep), cmp_u64);
+        printf("\nschedule lag: p50 %.1f us, p99 %.1f us, max %.1f us\n",
+               pct_us(rep, n, 0.50), pct_us(rep, n, 0.99), n ? rep[n - 1] / 1e3 : 0.0);
+    }
+    free(rec);
+    free(rep);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-t] [-x SPEED] [-r] TRACE MOUNT\n", prog);
+    fprintf(stderr, "  -t        replay at recorded timing (default: as fast as possible)\n");
+    fprintf(stderr, "  -x SPEED  time scale for -t, 2 = twice as fast\n");
+    fprintf(stderr, "  -r        skip ops that modify the filesystem (write, create, rename, ...)\n");
+}
+
+int main(int argc, char **argv) {
+    int c;
+    while ((c = getopt(argc, argv, "tx:rh")) != -1) {
+        switch (c) {
+            case 't': timed = 1; break;
+            case 'x': speed = atof(optarg); break;
+            case 'r': readonly = 1; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (argc - optind != 2 || speed <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    const char *mount = argv[optind + 1];
+
+    size_t nops;
+    struct op *ops = load_trace(argv[optind], mount, &nops);
+    if (!ops)
+        return 1;
+    if (!nops) {
+        fprintf(stderr, "trace is empty\n");
+        return 1;
+    }
+    path_gen = calloc(npaths ? npaths : 1, sizeof(*path_gen));
+    if (!path_gen)
+        return 1;
+
+    qsort(ops, nops, sizeof(*ops), cmp_tid_start);
+    size_t nworkers = 1;
+    uint64_t span = 0;
+    for (size_t i = 0; i < nops; i++) {
+        if (i && ops[i].rec.tid != ops[i - 1].rec.tid)
+            nworkers++;
+        if (ops[i].rec.end_ns > span)
+            span = ops[i].rec.end_ns;
+    }
+
+    struct worker *workers = calloc(nworkers, sizeof(*workers));
+    if (!workers)
+        return 1;
+    size_t k = 0;
+    for (size_t i = 0; i < nops; i++) {
+        if (i == 0 || ops[i].rec.tid != ops[i - 1].rec.tid) {
+            if (i)
+                workers[k++].end = &ops[i];
+            workers[k].begin = &ops[i];
+        }
+        struct worker *w = &workers[k];
+        if ((ops[i].rec.op == FSTAT_READ || ops[i].rec.op == FSTAT_WRITE) &&
+            ops[i].rec.size > w->buf_size)
+            w->buf_size = ops[i].rec.size;
+    }
+    workers[k].end = ops + nops;
+
+    printf("trace: %s, %zu ops, %zu threads, recorded span %.3f s\n",
+           argv[optind], nops, nworkers, span / 1e9);
+    printf("mode: %s", timed ? "timed" : "fast");
+    if (timed)
+        printf(" x%.2f", speed);
+    printf("%s, target %s\n", readonly ? ", read-only" : "", mount);
+
+    pthread_barrier_init(&start_barrier, NULL, (unsigned)nworkers + 1);
+    for (size_t i = 0; i < nworkers; i++) {
+        struct worker *w = &workers[i];
+        if (w->buf_size > (64u << 20))
+            w->buf_size = 64u << 20;
+        w->buf = malloc(w->buf_size ? w->buf_size : 1);
+        if (!w->buf)
+            return 1;
+        memset(w->buf, 'x', w->buf_size);
+        w->rfds = calloc(npaths ? npaths : 1, sizeof(*w->rfds));
+        w->wfds = calloc(npaths ? npaths : 1, sizeof(*w->wfds));
+        if (!w->rfds || !w->wfds)
+            return 1;
+        if (pthread_create(&w->thread, NULL, worker_main, w)) {
+            perror("pthread_create");
+            return 1;
+        }
+    }
+
+    // Запас, чтобы все потоки успели проснуться до первой операции
+    t0_ns = now_ns() + 10000000;
+    pthread_barrier_wait(&start_barrier);
+    uint64_t wall0 = now_ns();
+    for (size_t i = 0; i < nworkers; i++)
+        pthread_join(workers[i].thread, NULL);
+    double wall = (now_ns() - wall0) / 1e9;
+
+    printf("replayed in %.3f s, %.0f ops/s\n", wall, nops / wall);
+    report(ops, nops);
+
+    for (uint32_t i = 0; i < npaths; i++)
+        free(paths[i]);
+    for (size_t i = 0; i < nworkers; i++) {
+        close_fds(workers[i].rfds);
+        close_fds(workers[i].wfds);
+        free(workers[i].buf);
+    }
+    free(workers);
+    free(paths);
+    free(path_gen);
+    free(ops);
+    pthread_barrier_destroy(&start_barrier);
+    return 0;
+}
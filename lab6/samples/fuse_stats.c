@@ -0,0 +1,434 @@
+/*
+ * fuse_stats.c - счётчики по потокам, гистограммы задержек и Space-Saving
+ *
+ * Слот принадлежит одному потоку: счётчики меняются обычными store
+ * (__atomic с RELAXED — чтобы читатель видел целые 64-битные значения),
+ * без lock-префикса и без общей кэш-линии. Libfuse создаёт и убивает
+ * рабочие потоки по нагрузке, поэтому слот при выходе потока
+ * освобождается (деструктор pthread_key) и достаётся следующему —
+ * накопленные значения при этом не теряются.
+ *
+ * Таблица Space-Saving меняется несколькими полями сразу, поэтому её
+ * читатель сверяется с seqlock слота и повторяет копирование, если
+ * попал на запись. Писатель при этом никогда не ждёт.
+ */
+
+#define _GNU_SOURCE
+#include "fuse_stats.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_SLOTS   256
+#define SUB_BITS    3                               // 8 корзин на степень двойки
+#define MAX_MSB     40                              // ~18 минут в нс
+#define NBUCKETS    ((MAX_MSB - SUB_BITS + 2) << SUB_BITS)
+#define PATH_KEEP   128
+
+struct op_stats {
+    uint64_t calls;
+    uint64_t errors;
+    uint64_t bytes;
+    uint64_t max_ns;
+    uint64_t hist[NBUCKETS];
+};
+
+struct hh_entry {
+    uint64_t hash;
+    uint64_t count;
+    uint64_t error;         // Space-Saving: count завышен не больше чем на error
+    uint64_t bytes;
+    char path[PATH_KEEP];
+};
+
+struct fstat_slot {
+    _Alignas(64) int in_use;
+    uint64_t seq;           // seqlock для top[]
+    int top_used;
+    struct hh_entry top[FSTAT_TOPK];
+    struct op_stats ops[FSTAT_OP_COUNT];
+};
+
+static struct fstat_slot *slots[MAX_SLOTS];
+static unsigned nslots;
+static struct fstat_slot overflow_slot;     // если потоков больше MAX_SLOTS
+static pthread_mutex_t overflow_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread struct fstat_slot *my_slot;
+static pthread_key_t slot_key;
+static pthread_once_t slot_once = PTHREAD_ONCE_INIT;
+static uint64_t start_time_ns;
+
+static const char *const op_names[FSTAT_OP_COUNT] = FSTAT_OP_NAMES;
+
+uint64_t fstat_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* ---------- Слоты ---------- */
+
+static void slot_release(void *p) {
+    struct fstat_slot *s = p;
+    __atomic_store_n(&s->in_use, 0, __ATOMIC_RELEASE);
+}
+
+static void slot_key_init(void) {
+    pthread_key_create(&slot_key, slot_release);
+    start_time_ns = fstat_now_ns();
+}
+
+static struct fstat_slot *get_slot(void) {
+    if (my_slot)
+        return my_slot;
+    pthread_once(&slot_once, slot_key_init);
+
+    // Сначала — свободный слот ушедшего потока
+    unsigned n = __atomic_load_n(&nslots, __ATOMIC_ACQUIRE);
+    for (unsigned i = 0; i < n && i < MAX_SLOTS; i++) {
+        struct fstat_slot *s = __atomic_load_n(&slots[i], __ATOMIC_ACQUIRE);
+        int expected = 0;
+        if (s && __atomic_compare_exchange_n(&s->in_use, &expected, 1, 0,
+                                             __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            my_slot = s;
+            pthread_setspecific(slot_key, s);
+            return s;
+        }
+    }
+
+    unsigned idx = __atomic_fetch_add(&nslots, 1, __ATOMIC_ACQ_REL);
+    struct fstat_slot *s = NULL;
+    if (idx < MAX_SLOTS)
+        s = aligned_alloc(64, (sizeof(*s) + 63) & ~(size_t)63);
+    if (!s)
+        return NULL;        // запись пойдёт в overflow_slot под мьютексом
+    memset(s, 0, sizeof(*s));
+    s->in_use = 1;
+    __atomic_store_n(&slots[idx], s, __ATOMIC_RELEASE);
+    my_slot = s;
+    pthread_setspecific(slot_key, s);
+    return s;
+}
+
+/* ---------- Гистограмма ---------- */
+
+static unsigned bucket_of(uint64_t v) {
+    if (v < (1u << SUB_BITS))
+        return (unsigned)v;
+    unsigned msb = 63 - (unsigned)__builtin_clzll(v);
+    if (msb > MAX_MSB)
+        return NBUCKETS - 1;
+    return ((msb - SUB_BITS + 1) << SUB_BITS) | (unsigned)((v >> (msb - SUB_BITS)) & ((1u << SUB_BITS) - 1));
+}
+
+/* Верхняя граница корзины (включительно) — консервативная оценка перцентиля */
+static uint64_t bucket_upper(unsigned b) {
+    if (b < (1u << SUB_BITS))
+        return b;
+    unsigned msb = (b >> SUB_BITS) + SUB_BITS - 1;
+    uint64_t sub = b & ((1u << SUB_BITS) - 1);
+    uint64_t lo = (1ull << msb) | (sub << (msb - SUB_BITS));
+    return lo + (1ull << (msb - SUB_BITS)) - 1;
+}
+
+static void bump(uint64_t *p, uint64_t d) {
+    __atomic_store_n(p, *p + d, __ATOMIC_RELAXED);
+}
+
+/* ---------- Space-Saving ---------- */
+
+static uint64_t path_hash(const char *s) {
+    uint64_t h = 1469598103934665603ULL;
+    for (; *s; s++) {
+        h ^= (unsigned char)*s;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static void hh_update(struct fstat_slot *s, const char *path, uint64_t bytes) {
+    uint64_t h = path_hash(path);
+    struct hh_entry *e = NULL, *min = NULL;
+
+    for (int i = 0; i < s->top_used; i++) {
+        if (s->top[i].hash == h) {
+            e = &s->top[i];
+            break;
+        }
+        if (!min || s->top[i].count < min->count)
+            min = &s->top[i];
+    }
+
+    uint64_t seq = s->seq;
+    __atomic_store_n(&s->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    if (e) {
+        e->count++;
+        e->bytes += bytes;
+    } else {
+        // Новый путь: свободная запись или вытесняем минимальную,
+        // унаследовав её счёт как верхнюю оценку ошибки
+        uint64_t base = 0;
+        if (s->top_used < FSTAT_TOPK)
+            e = &s->top[s->top_used++];
+        else {
+            e = min;
+            base = min->count;
+        }
+        e->hash = h;
+        e->count = base + 1;
+        e->error = base;
+        e->bytes = bytes;
+        snprintf(e->path, sizeof(e->path), "%s", path);
+    }
+    __atomic_store_n(&s->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/* ---------- Запись ---------- */
+
+static void record_into(struct fstat_slot *s, enum fstat_op op, const char *path,
+                        long result, uint64_t ns) {
+    struct op_stats *o = &s->ops[op];
+    bump(&o->calls, 1);
+    if (result < 0)
+        bump(&o->errors, 1);
+    else if (op == FSTAT_READ || op == FSTAT_WRITE || op == FSTAT_COPY_FILE_RANGE)
+        bump(&o->bytes, (uint64_t)result);
+    if (ns > o->max_ns)
+        __atomic_store_n(&o->max_ns, ns, __ATOMIC_RELAXED);
+    bump(&o->hist[bucket_of(ns)], 1);
+
+    // Горячие файлы — по обращениям к содержимому, не по getattr
+    if (path && result >= 0 && (op == FSTAT_OPEN || op == FSTAT_READ || op == FSTAT_WRITE))
+        hh_update(s, path, op == FSTAT_OPEN ? 0 : (uint64_t)result);
+}
+
+void fstat_record(enum fstat_op op, const char *path, long result, uint64_t start_ns) {
+    uint64_t ns = fstat_now_ns() - start_ns;
+    struct fstat_slot *s = get_slot();
+    if (s) {
+        record_into(s, op, path, result, ns);
+        return;
+    }
+    pthread_mutex_lock(&overflow_lock);
+    record_into(&overflow_slot, op, path, result, ns);
+    pthread_mutex_unlock(&overflow_lock);
+}
+
+/* ---------- Снимок ---------- */
+
+struct snapshot {
+    struct op_stats ops[FSTAT_OP_COUNT];
+    struct hh_entry *top;
+    size_t ntop;
+    unsigned threads;
+    uint64_t uptime_ns;
+};
+
+static void snap_slot(struct snapshot *sn, struct fstat_slot *s) {
+    for (int op = 0; op < FSTAT_OP_COUNT; op++) {
+        const struct op_stats *o = &s->ops[op];
+        struct op_stats *d = &sn->ops[op];
+        d->calls += __atomic_load_n(&o->calls, __ATOMIC_RELAXED);
+        d->errors += __atomic_load_n(&o->errors, __ATOMIC_RELAXED);
+        d->bytes += __atomic_load_n(&o->bytes, __ATOMIC_RELAXED);
+        uint64_t mx = __atomic_load_n(&o->max_ns, __ATOMIC_RELAXED);
+        if (mx > d->max_ns)
+            d->max_ns = mx;
+        for (int b = 0; b < NBUCKETS; b++)
+            d->hist[b] += __atomic_load_n(&o->hist[b], __ATOMIC_RELAXED);
+    }
+
+    // Копия таблицы под seqlock; записи разных потоков по одному пути
+    // складываются (оценки ошибок тоже)
+    struct hh_entry copy[FSTAT_TOPK];
+    int used = 0;
+    for (int attempt = 0; attempt < 1000; attempt++) {
+        uint64_t s1 = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+        if (s1 & 1)
+            continue;
+        used = __atomic_load_n(&s->top_used, __ATOMIC_RELAXED);
+        memcpy(copy, s->top, sizeof(copy[0]) * (size_t)used);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&s->seq, __ATOMIC_RELAXED) == s1)
+            break;
+        used = 0;
+    }
+    for (int i = 0; i < used; i++) {
+        size_t j;
+        for (j = 0; j < sn->ntop; j++)
+            if (sn->top[j].hash == copy[i].hash)
+                break;
+        if (j == sn->ntop)
+            sn->top[sn->ntop++] = copy[i];
+        else {
+            sn->top[j].count += copy[i].count;
+            sn->top[j].error += copy[i].error;
+            sn->top[j].bytes += copy[i].bytes;
+        }
+    }
+}
+
+static int cmp_hh(const void *a, const void *b) {
+    const struct hh_entry *x = a, *y = b;
+    return x->count < y->count ? 1 : x->count > y->count ? -1 : 0;
+}
+
+static struct snapshot *take_snapshot(void) {
+    pthread_once(&slot_once, slot_key_init);
+    struct snapshot *sn = calloc(1, sizeof(*sn));
+    if (!sn)
+        return NULL;
+    unsigned n = __atomic_load_n(&nslots, __ATOMIC_ACQUIRE);
+    if (n > MAX_SLOTS)
+        n = MAX_SLOTS;
+    sn->top = calloc((size_t)(n + 1) * FSTAT_TOPK, sizeof(*sn->top));
+    if (!sn->top) {
+        free(sn);
+        return NULL;
+    }
+    for (unsigned i = 0; i < n; i++) {
+        struct fstat_slot *s = __atomic_load_n(&slots[i], __ATOMIC_ACQUIRE);
+        if (s) {
+            snap_slot(sn, s);
+            sn->threads++;
+        }
+    }
+    pthread_mutex_lock(&overflow_lock);
+    snap_slot(sn, &overflow_slot);
+    pthread_mutex_unlock(&overflow_lock);
+
+    qsort(sn->top, sn->ntop, sizeof(*sn->top), cmp_hh);
+    sn->uptime_ns = fstat_now_ns() - start_time_ns;
+    return sn;
+}
+
+static void free_snapshot(struct snapshot *sn) {
+    free(sn->top);
+    free(sn);
+}
+
+static uint64_t percentile(const struct op_stats *o, double q) {
+    uint64_t total = 0;
+    for (int b = 0; b < NBUCKETS; b++)
+        total += o->hist[b];
+    if (total == 0)
+        return 0;
+    uint64_t rank = (uint64_t)(q * (double)total + 0.5), seen = 0;
+    if (rank == 0)
+        rank = 1;
+    for (int b = 0; b < NBUCKETS; b++) {
+        seen += o->hist[b];
+        if (seen >= rank) {
+            uint64_t up = bucket_upper((unsigned)b);
+            return up < o->max_ns ? up : o->max_ns;
+        }
+    }
+    return o->max_ns;
+}
+
+/* ---------- .stats ---------- */
+
+char *fstat_render_text(size_t *len) {
+    struct snapshot *sn = take_snapshot();
+    char *buf = NULL;
+    FILE *f = open_memstream(&buf, len);
+    if (!sn || !f) {
+        if (f)
+            fclose(f);
+        free(buf);
+        if (sn)
+            free_snapshot(sn);
+        return NULL;
+    }
+
+    // Первые строки — формат из задания
+    fprintf(f, "reads: %llu\n", (unsigned long long)sn->ops[FSTAT_READ].calls);
+    fprintf(f, "writes: %llu\n", (unsigned long long)sn->ops[FSTAT_WRITE].calls);
+    fprintf(f, "opens: %llu\n", (unsigned long long)sn->ops[FSTAT_OPEN].calls);
+    fprintf(f, "bytes_read: %llu\n", (unsigned long long)sn->ops[FSTAT_READ].bytes);
+    fprintf(f, "bytes_written: %llu\n", (unsigned long long)sn->ops[FSTAT_WRITE].bytes);
+
+    fprintf(f, "\nuptime: %.1f s, threads: %u\n\n", sn->uptime_ns / 1e9, sn->threads);
+    fprintf(f, "%-15s %10s %8s %10s %10s %10s %10s %10s\n",
+            "op", "calls", "errors", "p50_us", "p90_us", "p99_us", "p999_us", "max_us");
+    for (int op = 0; op < FSTAT_OP_COUNT; op++) {
+        const struct op_stats *o = &sn->ops[op];
+        if (!o->calls)
+            continue;
+        fprintf(f, "%-15s %10llu %8llu %10.1f %10.1f %10.1f %10.1f %10.1f\n", op_names[op],
+                (unsigned long long)o->calls, (unsigned long long)o->errors,
+                percentile(o, 0.50) / 1e3, percentile(o, 0.90) / 1e3,
+                percentile(o, 0.99) / 1e3, percentile(o, 0.999) / 1e3, o->max_ns / 1e3);
+    }
+
+    fprintf(f, "\ntop paths (open/read/write; count may be overestimated by up to err):\n");
+    fprintf(f, "%10s %10s %14s  %s\n", "count", "err", "bytes", "path");
+    for (size_t i = 0; i < sn->ntop && i < FSTAT_TOPN; i++)
+        fprintf(f, "%10llu %10llu %14llu  %s\n", (unsigned long long)sn->top[i].count,
+                (unsigned long long)sn->top[i].error, (unsigned long long)sn->top[i].bytes,
+                sn->top[i].path);
+
+    fclose(f);
+    free_snapshot(sn);
+    return buf;
+}
+
+/* ---------- .stats.json ---------- */
+
+static void json_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\')
+            fprintf(f, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(f, "\\u%04x", c);
+        else
+            fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+char *fstat_render_json(size_t *len) {
+    struct snapshot *sn = take_snapshot();
+    char *buf = NULL;
+    FILE *f = open_memstream(&buf, len);
+    if (!sn || !f) {
+        if (f)
+            fclose(f);
+        free(buf);
+        if (sn)
+            free_snapshot(sn);
+        return NULL;
+    }
+
+    fprintf(f, "{\"uptime_ns\":%llu,\"threads\":%u,\"ops\":{",
+            (unsigned long long)sn->uptime_ns, sn->threads);
+    for (int op = 0; op < FSTAT_OP_COUNT; op++) {
+        const struct op_stats *o = &sn->ops[op];
+        fprintf(f, "%s\"%s\":{\"calls\":%llu,\"errors\":%llu,\"bytes\":%llu,"
+                "\"latency_ns\":{\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu}}",
+                op ? "," : "", op_names[op], (unsigned long long)o->calls,
+                (unsigned long long)o->errors, (unsigned long long)o->bytes,
+                (unsigned long long)percentile(o, 0.50), (unsigned long long)percentile(o, 0.90),
+                (unsigned long long)percentile(o, 0.99), (unsigned long long)percentile(o, 0.999),
+                (unsigned long long)o->max_ns);
+    }
+    fprintf(f, "},\"top_paths\":[");
+    for (size_t i = 0; i < sn->ntop && i < FSTAT_TOPN; i++) {
+        fprintf(f, "%s{\"path\":", i ? "," : "");
+        json_string(f, sn->top[i].path);
+        fprintf(f, ",\"count\":%llu,\"error\":%llu,\"bytes\":%llu}",
+                (unsigned long long)sn->top[i].count, (unsigned long long)sn->top[i].error,
+                (unsigned long long)sn->top[i].bytes);
+    }
+    fprintf(f, "]}\n");
+
+    fclose(f);
+    free_snapshot(sn);
+    return buf;
+}
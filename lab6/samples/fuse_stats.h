@@ -0,0 +1,75 @@
+/*
+ * fuse_stats.h - статистика операций для Monitoring FS (Вариант 1, Задание C)
+ *
+ * Глобальный мьютекс вокруг счётчиков превращает многопоточный демон
+ * FUSE в однопоточный. Здесь у каждого потока свой слот, выровненный
+ * на кэш-линию: поток пишет только в него, обычными store без lock-
+ * префикса. Суммирование по слотам — только при чтении .stats.
+ *
+ * В слоте на каждую операцию:
+ *   - вызовы, ошибки, байты, максимум задержки;
+ *   - гистограмма задержек (8 корзин на степень двойки, ошибка <= 12.5%),
+ *     из неё считаются p50/p90/p99/p99.9.
+ * Плюс "горячие" пути: алгоритм Space-Saving на FSTAT_TOPK записей
+ * на поток — память ограничена, сколько бы разных файлов ни было.
+ */
+
+#ifndef FUSE_STATS_H
+#define FUSE_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum fstat_op {
+    FSTAT_GETATTR,
+    FSTAT_READDIR,
+    FSTAT_OPEN,
+    FSTAT_READ,
+    FSTAT_WRITE,
+    FSTAT_CREATE,
+    FSTAT_UNLINK,
+    FSTAT_MKDIR,
+    FSTAT_RMDIR,
+    FSTAT_COPY_FILE_RANGE,
+    FSTAT_FALLOCATE,
+    FSTAT_LSEEK,
+    FSTAT_TRUNCATE,
+    FSTAT_RENAME,
+    FSTAT_UTIMENS,
+    FSTAT_OP_COUNT
+};
+
+#define FSTAT_OP_NAMES {    \
+    "getattr",              \
+    "readdir",              \
+    "open",                 \
+    "read",                 \
+    "write",                \
+    "create",               \
+    "unlink",               \
+    "mkdir",                \
+    "rmdir",                \
+    "copy_file_range",      \
+    "fallocate",            \
+    "lseek",                \
+    "truncate",             \
+    "rename",               \
+    "utimens",              \
+}
+
+#define FSTAT_TOPK 64       // записей Space-Saving на поток
+#define FSTAT_TOPN 10       // сколько путей показывать
+
+uint64_t fstat_now_ns(void);
+
+/*
+ * Учесть завершённую операцию. result < 0 — ошибка (-errno), для
+ * read/write/copy_file_range result > 0 — число байт. path может быть NULL.
+ */
+void fstat_record(enum fstat_op op, const char *path, long result, uint64_t start_ns);
+
+/* Снимок в текст (.stats) или JSON (.stats.json); malloc-буфер, *len — длина */
+char *fstat_render_text(size_t *len);
+char *fstat_render_json(size_t *len);
+
+#endif /* FUSE_STATS_H */
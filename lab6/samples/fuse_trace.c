@@ -0,0 +1,295 @@
+/*
+ * fuse_trace.c - запись бинарной трассы операций (формат — fuse_trace.h)
+ *
+ * Каждый поток копит записи в своём буфере и пишет его в файл одним
+ * write(), когда буфер заполнится или поток завершится. Номер пути
+ * поток сначала ищет в своём маленьком кэше; в общую таблицу под
+ * мьютексом идёт только промах, а новый путь сразу пишется в файл.
+ */
+
+#define _GNU_SOURCE
+#include "fuse_trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TBUF_SIZE   (64 * 1024)
+#define PATH_CACHE  256             // прямое отображение hash -> id на поток
+
+struct tbuf {
+    pthread_mutex_t lock;           // владелец и ftrace_close
+    int owned;
+    uint32_t tid;
+    size_t used;
+    struct tbuf *next;
+    struct {
+        uint64_t hash;
+        uint32_t id;
+    } cache[PATH_CACHE];
+    unsigned char data[TBUF_SIZE];
+};
+
+struct path_slot {
+    uint64_t hash;
+    uint32_t id;                    // 0 — пусто
+    char *path;
+};
+
+static int trace_fd = -1;           // проверка "трасса включена"
+static int out_fd = -1;             // куда писать; под file_lock
+static uint64_t base_ns;
+static int trace_failed;
+static pthread_mutex_t file_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct tbuf *all_bufs;
+static uint32_t next_tid;
+static pthread_mutex_t bufs_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t buf_key;
+static __thread struct tbuf *my_buf;
+
+static struct path_slot *paths;
+static size_t paths_cap, paths_used;
+static pthread_mutex_t paths_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t path_hash(const char *s) {
+    uint64_t h = 1469598103934665603ULL;
+    for (; *s; s++) {
+        h ^= (unsigned char)*s;
+        h *= 1099511628211ULL;
+    }
+    return h ? h : 1;               // 0 — пустой слот кэша
+}
+
+/* Записать в файл целиком; при ошибке трасса выключается (операции не страдают) */
+static void write_out(const void *buf, size_t n) {
+    pthread_mutex_lock(&file_lock);
+    const char *p = buf;
+    while (n && out_fd >= 0 && !trace_failed) {
+        ssize_t w = write(out_fd, p, n);
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w <= 0) {
+            trace_failed = 1;
+            fprintf(stderr, "fuse_trace: write failed: %s, tracing stopped\n", strerror(errno));
+            break;
+        }
+        p += w;
+        n -= (size_t)w;
+    }
+    pthread_mutex_unlock(&file_lock);
+}
+
+/* ---------- Пути ---------- */
+
+static int paths_grow(void) {
+    size_t cap = paths_cap ? paths_cap * 2 : 4096;
+    struct path_slot *t = calloc(cap, sizeof(*t));
+    if (!t)
+        return -1;
+    for (size_t i = 0; i < paths_cap; i++) {
+        if (!paths[i].id)
+            continue;
+        size_t j = paths[i].hash & (cap - 1);
+        while (t[j].id)
+            j = (j + 1) & (cap - 1);
+        t[j] = paths[i];
+    }
+    free(paths);
+    paths = t;
+    paths_cap = cap;
+    return 0;
+}
+
+static uint32_t intern_path(const char *path, uint64_t h) {
+    pthread_mutex_lock(&paths_lock);
+    if ((paths_used + 1) * 2 > paths_cap && paths_grow() < 0) {
+        pthread_mutex_unlock(&paths_lock);
+        return 0;
+    }
+    size_t j = h & (paths_cap - 1);
+    while (paths[j].id) {
+        if (paths[j].hash == h && !strcmp(paths[j].path, path)) {
+            uint32_t id = paths[j].id;
+            pthread_mutex_unlock(&paths_lock);
+            return id;
+        }
+        j = (j + 1) & (paths_cap - 1);
+    }
+
+    size_t len = strlen(path);
+    char *copy = strdup(path);
+    if (!copy) {
+        pthread_mutex_unlock(&paths_lock);
+        return 0;
+    }
+    uint32_t id = (uint32_t)++paths_used;
+    paths[j] = (struct path_slot){ .hash = h, .id = id, .path = copy };
+
+    // Путь в файл до того, как id попадёт хоть в одну запись FTR_OP
+    size_t padded = (len + 7) & ~(size_t)7;
+    size_t total = sizeof(struct ftrace_rec) + padded;
+    unsigned char *rec = calloc(1, total);
+    if (rec) {
+        struct ftrace_rec *r = (struct ftrace_rec *)rec;
+        r->type = FTR_PATH;
+        r->path_id = id;
+        r->size = len;
+        memcpy(rec + sizeof(*r), path, len);
+        write_out(rec, total);
+        free(rec);
+    }
+    pthread_mutex_unlock(&paths_lock);
+    return id;
+}
+
+/* ---------- Буферы потоков ---------- */
+
+static void flush_locked(struct tbuf *tb) {
+    if (tb->used) {
+        write_out(tb->data, tb->used);
+        tb->used = 0;
+    }
+}
+
+static void buf_release(void *p) {
+    struct tbuf *tb = p;
+    pthread_mutex_lock(&tb->lock);
+    flush_locked(tb);
+    tb->owned = 0;
+    pthread_mutex_unlock(&tb->lock);
+}
+
+static struct tbuf *get_buf(void) {
+    if (my_buf)
+        return my_buf;
+
+    pthread_mutex_lock(&bufs_lock);
+    struct tbuf *tb;
+    for (tb = all_bufs; tb; tb = tb->next)
+        if (!tb->owned)
+            break;
+    if (!tb) {
+        tb = calloc(1, sizeof(*tb));
+        if (!tb) {
+            pthread_mutex_unlock(&bufs_lock);
+            return NULL;
+        }
+        pthread_mutex_init(&tb->lock, NULL);
+        tb->next = all_bufs;
+        all_bufs = tb;
+    }
+    // Новый поток — новый tid; кэш путей остаётся валидным
+    tb->owned = 1;
+    tb->tid = next_tid++;
+    pthread_mutex_unlock(&bufs_lock);
+
+    my_buf = tb;
+    pthread_setspecific(buf_key, tb);
+    return tb;
+}
+
+static uint32_t path_id(struct tbuf *tb, const char *path) {
+    uint64_t h = path_hash(path);
+    unsigned slot = (unsigned)(h ^ (h >> 32)) & (PATH_CACHE - 1);
+    if (tb->cache[slot].hash == h)
+        return tb->cache[slot].id;
+    uint32_t id = intern_path(path, h);
+    if (id) {
+        tb->cache[slot].hash = h;
+        tb->cache[slot].id = id;
+    }
+    return id;
+}
+
+/* ---------- API ---------- */
+
+int ftrace_open(const char *file) {
+    int fd = open(file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return -errno;
+    if (pthread_key_create(&buf_key, buf_release)) {
+        close(fd);
+        return -EAGAIN;
+    }
+
+    struct timespec rt;
+    clock_gettime(CLOCK_REALTIME, &rt);
+    struct ftrace_header hdr = {
+        .magic = FTRACE_MAGIC,
+        .version = FTRACE_VERSION,
+        .rec_size = sizeof(struct ftrace_rec),
+        .start_realtime_ns = (uint64_t)rt.tv_sec * 1000000000ull + (uint64_t)rt.tv_nsec,
+    };
+    if (write(fd, &hdr, sizeof(hdr)) != (ssize_t)sizeof(hdr)) {
+        int err = errno ? errno : EIO;
+        close(fd);
+        return -err;
+    }
+    base_ns = fstat_now_ns();
+    out_fd = fd;
+    __atomic_store_n(&trace_fd, fd, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void ftrace_record(enum fstat_op op, const char *path, uint64_t offset,
+                   uint64_t size, long result, uint64_t start_ns) {
+    ftrace_record2(op, path, offset, NULL, 0, size, result, start_ns);
+}
+
+void ftrace_record2(enum fstat_op op, const char *path, uint64_t offset,
+                    const char *path2, uint64_t offset2, uint64_t size,
+                    long result, uint64_t start_ns) {
+    if (__atomic_load_n(&trace_fd, __ATOMIC_ACQUIRE) < 0 || trace_failed)
+        return;
+    uint64_t end_ns = fstat_now_ns();
+    struct tbuf *tb = get_buf();
+    if (!tb)
+        return;
+
+    struct ftrace_rec r = {
+        .type = FTR_OP,
+        .op = (uint8_t)op,
+        .tid = tb->tid,
+        .path_id = path ? path_id(tb, path) : 0,
+        .path2_id = path2 ? path_id(tb, path2) : 0,
+        .result = result,
+        .offset = offset,
+        .offset2 = offset2,
+        .size = size,
+        .start_ns = start_ns > base_ns ? start_ns - base_ns : 0,
+        .end_ns = end_ns - base_ns,
+    };
+
+    pthread_mutex_lock(&tb->lock);         // без конкуренции: чужой только ftrace_close
+    if (tb->used + sizeof(r) > TBUF_SIZE)
+        flush_locked(tb);
+    memcpy(tb->data + tb->used, &r, sizeof(r));
+    tb->used += sizeof(r);
+    pthread_mutex_unlock(&tb->lock);
+}
+
+void ftrace_close(void) {
+    if (__atomic_exchange_n(&trace_fd, -1, __ATOMIC_ACQ_REL) < 0)
+        return;
+
+    pthread_mutex_lock(&bufs_lock);
+    for (struct tbuf *tb = all_bufs; tb; tb = tb->next) {
+        pthread_mutex_lock(&tb->lock);
+        flush_locked(tb);
+        pthread_mutex_unlock(&tb->lock);
+    }
+    pthread_mutex_unlock(&bufs_lock);
+
+    // Буферы не освобождаются: живой поток ещё может держать свой указатель.
+    // Запись, успевшая проскочить проверку trace_fd, просто не попадёт в файл
+    pthread_mutex_lock(&file_lock);
+    close(out_fd);
+    out_fd = -1;
+    pthread_mutex_unlock(&file_lock);
+}
@@ -0,0 +1,82 @@
+/*
+ * fuse_trace.h - бинарная трасса операций FUSE (запись и формат файла)
+ *
+ * Текстовый лог log_operation() не годится, чтобы воспроизвести
+ * нагрузку: секундные метки, нет потока, смещения и размера. Трасса
+ * пишет на каждую операцию запись фиксированного размера, а путь
+ * заменяет номером — строка пути пишется в файл один раз.
+ *
+ * Формат файла:
+ *   struct ftrace_header
+ *   поток записей struct ftrace_rec в произвольном порядке:
+ *     FTR_PATH — path_id, size = длина пути; за записью идут байты
+ *                пути, дополненные нулями до кратного 8;
+ *     FTR_OP   — одна завершённая операция.
+ * Записи разных потоков перемешаны (у каждого потока свой буфер),
+ * воспроизведение сортирует их само — см. fuse_replay.c.
+ *
+ * Код операции — enum fstat_op из fuse_stats.h; новые операции
+ * добавляются только в конец перечисления, старые трассы остаются
+ * читаемыми.
+ */
+
+#ifndef FUSE_TRACE_H
+#define FUSE_TRACE_H
+
+#include <stdint.h>
+
+#include "fuse_stats.h"
+
+#define FTRACE_MAGIC    "FTRACE1"
+#define FTRACE_VERSION  2       // 2: второй путь и смещение, 64-битный result
+
+enum ftrace_type {
+    FTR_PATH = 1,
+    FTR_OP   = 2,
+};
+
+struct ftrace_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t rec_size;              // sizeof(struct ftrace_rec)
+    uint64_t start_realtime_ns;     // CLOCK_REALTIME в момент начала записи
+};
+
+struct ftrace_rec {
+    uint8_t type;                   // enum ftrace_type
+    uint8_t op;                     // enum fstat_op
+    uint16_t reserved;
+    uint32_t tid;                   // номер потока демона, с 0
+    uint32_t path_id;               // 0 — без пути
+    uint32_t path2_id;              // rename — куда, copy_file_range — приёмник
+    int64_t result;                 // как вернула операция: >= 0 или -errno
+    uint64_t offset;                // truncate — новый размер, utimens — atime
+    uint64_t offset2;               // copy_file_range — смещение в приёмнике,
+                                    // fallocate — mode, utimens — mtime
+    uint64_t size;                  // read/write/copy/fallocate — длина, open — флаги,
+                                    // create/mkdir — mode, lseek — whence,
+                                    // rename — флаги
+    uint64_t start_ns;              // от начала трассы, CLOCK_MONOTONIC
+    uint64_t end_ns;
+};
+
+/* Время utimens в offset/offset2: нс с эпохи или особые значения */
+#define FTRACE_UTIME_NOW    UINT64_MAX
+#define FTRACE_UTIME_OMIT   (UINT64_MAX - 1)
+
+/* Начать запись в файл (создаётся/обрезается). 0 или -errno */
+int ftrace_open(const char *file);
+
+/* Записать операцию; start_ns — fstat_now_ns() в её начале. Без ftrace_open — ничего */
+void ftrace_record(enum fstat_op op, const char *path, uint64_t offset,
+                   uint64_t size, long result, uint64_t start_ns);
+
+/* То же для операций с двумя путями или смещениями (rename, copy_file_range, ...) */
+void ftrace_record2(enum fstat_op op, const char *path, uint64_t offset,
+                    const char *path2, uint64_t offset2, uint64_t size,
+                    long result, uint64_t start_ns);
+
+/* Сбросить буферы всех потоков и закрыть файл */
+void ftrace_close(void);
+
+#endif /* FUSE_TRACE_H */
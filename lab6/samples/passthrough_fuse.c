@@ -2,13 +2,34 @@
  * Простой пример FUSE filesystem - passthrough с логированием
  *
  * Эта программа "зеркалирует" директорию и логирует все операции.
- * Использование: ./passthrough_fuse <source_dir> <mount_point>
+ * Использование: ./passthrough_fuse [--xform=SPEC] [--stats] [--trace=FILE] [--metrics] [--quiet] <source_dir> <mount_point>
  *
- * Компиляция: gcc -Wall passthrough_fuse.c -lfuse3 -o passthrough_fuse
+ * --xform=rot13|upper|lower|xor:KEY — побайтовое преобразование в read
+ * (Вариант 2): данные меняются прямо в буфере FUSE векторным ядром из
+ * byte_xform.c. Если преобразование обратно самому себе (rot13, xor),
+ * write применяет его же — на диске файлы лежат зашифрованными.
+ *
+ * --stats — Monitoring FS (Вариант 1): в корне появляются виртуальные
+ * файлы .stats и .stats.json. Счётчики ведутся без общих блокировок
+ * (fuse_stats.c), снимок собирается при открытии файла. --quiet
+ * отключает построчный лог в stderr — под нагрузкой он дороже самих
+ * операций.
+ *
+ * --trace=FILE — бинарная трасса всех операций (fuse_trace.h): поток,
+ * смещение, размер, время начала и конца в нс. Её воспроизводит
+ * fuse_replay на любой точке монтирования.
+ *
+ * --metrics — задержки, ошибки и байты по операциям в разделяемой памяти
+ * /dev/shm/passthrough_fuse.<pid> (lab2/samples/metrics_shm.h). Читает
+ * lab2/samples/metrics_dump в формате Prometheus, без обращений к ФС.
+ *
+ * Компиляция: gcc -Wall -I../../lab2/samples passthrough_fuse.c byte_xform.c fuse_stats.c fuse_trace.c
+ *             ../../lab2/samples/metrics_shm.c -lfuse3 -lpthread -o passthrough_fuse
  * или используйте Makefile
  */
 
 #define FUSE_USE_VERSION 31
+#define _GNU_SOURCE             /* copy_file_range, fallocate, renameat2 */
 
 #include <fuse.h>
 #include <stdio.h>
@@ -16,6 +37,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -23,11 +45,83 @@
 #include <time.h>
 #include <sys/stat.h>
 
+#include "byte_xform.h"
+#include "fuse_stats.h"
+#include "fuse_trace.h"
+#include "metrics_shm.h"
+
 /* Глобальная переменная для хранения базовой директории */
 static char *base_path = NULL;
 
+/* Преобразование содержимого (NULL — обычный passthrough) */
+static struct byte_xform xform_storage;
+static struct byte_xform *xform = NULL;
+
+static int stats_enabled = 0;
+static int trace_enabled = 0;
+static int quiet = 0;
+static int metrics_enabled = 0;
+
+/*
+ * --metrics: сегмент создаётся в init (после ухода в фон — у демона
+ * другой pid), до этого все указатели NULL и metric_* ничего не делают.
+ * Счётчики общие для всех потоков FUSE — атомарный add; гистограмма
+ * операции защищена своим seqlock.
+ */
+static struct metrics *metrics;
+static struct metric_hist *m_latency[FSTAT_OP_COUNT];
+static _Atomic uint64_t *m_errors[FSTAT_OP_COUNT];
+static _Atomic uint64_t *m_bytes[FSTAT_OP_COUNT];
+
+/* Снимок статистики, отданный открытому .stats (fi->fh) */
+struct stats_snapshot {
+    char *data;
+    size_t len;
+};
+
+/* Начало операции — только если нужна статистика или трасса */
+static uint64_t op_start(void) {
+    return stats_enabled || trace_enabled || metrics ? fstat_now_ns() : 0;
+}
+
+/* Поля записи трассы — см. struct ftrace_rec в fuse_trace.h */
+static void op_done2(enum fstat_op op, const char *path, uint64_t offset,
+                     const char *path2, uint64_t offset2, uint64_t size,
+                     long result, uint64_t t0) {
+    if (stats_enabled)
+        fstat_record(op, path, result, t0);
+    if (trace_enabled)
+        ftrace_record2(op, path, offset, path2, offset2, size, result, t0);
+    if (metrics) {
+        metric_observe(m_latency[op], fstat_now_ns() - t0);
+        if (result < 0)
+            metric_add(m_errors[op], 1);
+        else
+            metric_add(m_bytes[op], (uint64_t)result);    /* NULL кроме read/write/copy_file_range */
+    }
+}
+
+/* size — размер запроса для read/write, флаги для open, mode для create/mkdir */
+static void op_done(enum fstat_op op, const char *path, uint64_t offset, uint64_t size,
+                    long result, uint64_t t0) {
+    op_done2(op, path, offset, NULL, 0, size, result, t0);
+}
+
+/* 1 — /.stats, 2 — /.stats.json, 0 — обычный путь */
+static int stats_file(const char *path) {
+    if (!stats_enabled)
+        return 0;
+    if (!strcmp(path, "/.stats"))
+        return 1;
+    if (!strcmp(path, "/.stats.json"))
+        return 2;
+    return 0;
+}
+
 /* Вспомогательная функция: получить текущий timestamp для логов */
 static void log_operation(const char *op, const char *path, int result) {
+    if (quiet)
+        return;
     time_t now = time(NULL);
     char timestamp[64];
     strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", localtime(&now));
@@ -48,15 +142,31 @@ static void get_full_path(char *fullpath, const char *path) {
 static int passthrough_getattr(const char *path, struct stat *stbuf,
                                 struct fuse_file_info *fi) {
     (void) fi;
+    if (stats_file(path)) {
+        /* Размер заранее неизвестен: файл читается с direct_io до EOF */
+        memset(stbuf, 0, sizeof(*stbuf));
+        stbuf->st_mode = S_IFREG | 0444;
+        stbuf->st_nlink = 1;
+        stbuf->st_uid = getuid();
+        stbuf->st_gid = getgid();
+        stbuf->st_mtime = stbuf->st_ctime = stbuf->st_atime = time(NULL);
+        return 0;
+    }
+
+    uint64_t t0 = op_start();
     char fullpath[1024];
     get_full_path(fullpath, path);
 
     int res = lstat(fullpath, stbuf);
     log_operation("GETATTR", path, res);
 
-    if (res == -1)
-        return -errno;
+    if (res == -1) {
+        res = -errno;
+        op_done(FSTAT_GETATTR, path, 0, 0, res, t0);
+        return res;
+    }
 
+    op_done(FSTAT_GETATTR, path, 0, 0, 0, t0);
     return 0;
 }
 
@@ -71,13 +181,21 @@ static int passthrough_readdir(const char *path, void *buf, fuse_fill_dir_t fill
     (void) fi;
     (void) flags;
 
+    uint64_t t0 = op_start();
     char fullpath[1024];
     get_full_path(fullpath, path);
 
     DIR *dp = opendir(fullpath);
     if (dp == NULL) {
-        log_operation("READDIR", path, -errno);
-        return -errno;
+        int res = -errno;
+        log_operation("READDIR", path, res);
+        op_done(FSTAT_READDIR, path, 0, 0, res, t0);
+        return res;
+    }
+
+    if (stats_enabled && !strcmp(path, "/")) {
+        filler(buf, ".stats", NULL, 0, 0);
+        filler(buf, ".stats.json", NULL, 0, 0);
     }
 
     struct dirent *de;
@@ -93,6 +211,7 @@ static int passthrough_readdir(const char *path, void *buf, fuse_fill_dir_t fill
 
     closedir(dp);
     log_operation("READDIR", path, 0);
+    op_done(FSTAT_READDIR, path, 0, 0, 0, t0);
     return 0;
 }
 
@@ -101,17 +220,39 @@ static int passthrough_readdir(const char *path, void *buf, fuse_fill_dir_t fill
  * Вызывается перед чтением/записью
  */
 static int passthrough_open(const char *path, struct fuse_file_info *fi) {
+    int sf = stats_file(path);
+    if (sf) {
+        if ((fi->flags & O_ACCMODE) != O_RDONLY)
+            return -EACCES;
+        /* Снимок на всё время открытия: read по частям видит одно состояние */
+        struct stats_snapshot *snap = malloc(sizeof(*snap));
+        if (!snap)
+            return -ENOMEM;
+        snap->data = sf == 1 ? fstat_render_text(&snap->len) : fstat_render_json(&snap->len);
+        if (!snap->data) {
+            free(snap);
+            return -ENOMEM;
+        }
+        fi->fh = (uint64_t)(uintptr_t)snap;
+        fi->direct_io = 1;
+        return 0;
+    }
+
+    uint64_t t0 = op_start();
     char fullpath[1024];
     get_full_path(fullpath, path);
 
     int fd = open(fullpath, fi->flags);
     if (fd == -1) {
-        log_operation("OPEN", path, -errno);
-        return -errno;
+        int res = -errno;
+        log_operation("OPEN", path, res);
+        op_done(FSTAT_OPEN, path, 0, (uint64_t)fi->flags, res, t0);
+        return res;
     }
 
     close(fd);
     log_operation("OPEN", path, 0);
+    op_done(FSTAT_OPEN, path, 0, (uint64_t)fi->flags, 0, t0);
     return 0;
 }
 
@@ -121,25 +262,41 @@ static int passthrough_open(const char *path, struct fuse_file_info *fi) {
  */
 static int passthrough_read(const char *path, char *buf, size_t size, off_t offset,
                             struct fuse_file_info *fi) {
-    (void) fi;
+    if (stats_file(path)) {
+        struct stats_snapshot *snap = (struct stats_snapshot *)(uintptr_t)fi->fh;
+        if ((size_t)offset >= snap->len)
+            return 0;
+        if (size > snap->len - (size_t)offset)
+            size = snap->len - (size_t)offset;
+        memcpy(buf, snap->data + offset, size);
+        return (int)size;
+    }
+
+    uint64_t t0 = op_start();
     char fullpath[1024];
     get_full_path(fullpath, path);
 
     int fd = open(fullpath, O_RDONLY);
     if (fd == -1) {
-        log_operation("READ", path, -errno);
-        return -errno;
+        int res = -errno;
+        log_operation("READ", path, res);
+        op_done(FSTAT_READ, path, (uint64_t)offset, size, res, t0);
+        return res;
     }
 
     int res = pread(fd, buf, size, offset);
     if (res == -1)
         res = -errno;
+    else if (xform)
+        xform_apply(xform, buf, buf, (size_t)res, (uint64_t)offset);   // на месте
 
     close(fd);
 
-    fprintf(stderr, "[%s] READ: %s (%zu bytes at offset %ld, result: %d)\n",
-            "timestamp", path, size, offset, res);
+    if (!quiet)
+        fprintf(stderr, "[%s] READ: %s (%zu bytes at offset %ld, result: %d)\n",
+                "timestamp", path, size, offset, res);
 
+    op_done(FSTAT_READ, path, (uint64_t)offset, size, res, t0);
     return res;
 }
 
@@ -150,13 +307,34 @@ static int passthrough_read(const char *path, char *buf, size_t size, off_t offs
 static int passthrough_write(const char *path, const char *buf, size_t size,
                              off_t offset, struct fuse_file_info *fi) {
     (void) fi;
+    uint64_t t0 = op_start();
     char fullpath[1024];
     get_full_path(fullpath, path);
 
     int fd = open(fullpath, O_WRONLY);
     if (fd == -1) {
-        log_operation("WRITE", path, -errno);
-        return -errno;
+        int res = -errno;
+        log_operation("WRITE", path, res);
+        op_done(FSTAT_WRITE, path, (uint64_t)offset, size, res, t0);
+        return res;
+    }
+
+    /* Буфер записи const: шифруем в копию, по одной на поток FUSE */
+    if (xform && xform->involution) {
+        static __thread char *scratch = NULL;
+        static __thread size_t scratch_size = 0;
+        if (scratch_size < size) {
+            char *p = realloc(scratch, size);
+            if (!p) {
+                close(fd);
+                op_done(FSTAT_WRITE, path, (uint64_t)offset, size, -ENOMEM, t0);
+                return -ENOMEM;
+            }
+            scratch = p;
+            scratch_size = size;
+        }
+        xform_apply(xform, scratch, buf, size, (uint64_t)offset);
+        buf = scratch;
     }
 
     int res = pwrite(fd, buf, size, offset);
@@ -165,9 +343,11 @@ static int passthrough_write(const char *path, const char *buf, size_t size,
 
     close(fd);
 
-    fprintf(stderr, "[%s] WRITE: %s (%zu bytes at offset %ld, result: %d)\n",
-            "timestamp", path, size, offset, res);
+    if (!quiet)
+        fprintf(stderr, "[%s] WRITE: %s (%zu bytes at offset %ld, result: %d)\n",
+                "timestamp", path, size, offset, res);
 
+    op_done(FSTAT_WRITE, path, (uint64_t)offset, size, res, t0);
     return res;
 }
 
@@ -177,19 +357,26 @@ static int passthrough_write(const char *path, const char *buf, size_t size,
  */
 static int passthrough_create(const char *path, mode_t mode,
                                struct fuse_file_info *fi) {
+    if (stats_file(path))
+        return -EEXIST;
+
+    uint64_t t0 = op_start();
     char fullpath[1024];
     get_full_path(fullpath, path);
 
     int fd = creat(fullpath, mode);
     if (fd == -1) {
-        log_operation("CREATE", path, -errno);
-        return -errno;
+        int res = -errno;
+        log_operation("CREATE", path, res);
+        op_done(FSTAT_CREATE, path, 0, mode, res, t0);
+        return res;
     }
 
     fi->fh = fd;
     close(fd);
 
     log_operation("CREATE", path, 0);
+    op_done(FSTAT_CREATE, path, 0, mode, 0, t0);
     return 0;
 }
 
@@ -198,6 +385,10 @@ static int passthrough_create(const char *path, mode_t mode,
  * Вызывается при: rm
  */
 static int passthrough_unlink(const char *path) {
+    if (stats_file(path))
+        return -EPERM;
+
+    uint64_t t0 = op_start();
     char fullpath[1024];
     get_full_path(fullpath, path);
 
@@ -205,9 +396,10 @@ static int passthrough_unlink(const char *path) {
     log_operation("UNLINK", path, res);
 
     if (res == -1)
-        return -errno;
+        res = -errno;
 
-    return 0;
+    op_done(FSTAT_UNLINK, path, 0, 0, res, t0);
+    return res;
 }
 
 /*
@@ -215,6 +407,7 @@ static int passthrough_unlink(const char *path) {
  * Вызывается при: mkdir
  */
 static int passthrough_mkdir(const char *path, mode_t mode) {
+    uint64_t t0 = op_start();
     char fullpath[1024];
     get_full_path(fullpath, path);
 
@@ -222,9 +415,10 @@ static int passthrough_mkdir(const char *path, mode_t mode) {
     log_operation("MKDIR", path, res);
 
     if (res == -1)
-        return -errno;
+        res = -errno;
 
-    return 0;
+    op_done(FSTAT_MKDIR, path, 0, mode, res, t0);
+    return res;
 }
 
 /*
@@ -232,6 +426,7 @@ static int passthrough_mkdir(const char *path, mode_t mode) {
  * Вызывается при: rmdir
  */
 static int passthrough_rmdir(const char *path) {
+    uint64_t t0 = op_start();
     char fullpath[1024];
     get_full_path(fullpath, path);
 
@@ -239,22 +434,252 @@ static int passthrough_rmdir(const char *path) {
     log_operation("RMDIR", path, res);
 
     if (res == -1)
-        return -errno;
+        res = -errno;
 
+    op_done(FSTAT_RMDIR, path, 0, 0, res, t0);
+    return res;
+}
+
+/*
+ * release - закрыть файл
+ * Нужна только для .stats: освободить снимок, созданный в open
+ */
+static int passthrough_release(const char *path, struct fuse_file_info *fi) {
+    if (stats_file(path)) {
+        struct stats_snapshot *snap = (struct stats_snapshot *)(uintptr_t)fi->fh;
+        free(snap->data);
+        free(snap);
+    }
     return 0;
 }
 
+/*
+ * truncate - изменить размер файла
+ * Вызывается при: truncate, open(O_TRUNC), cp поверх существующего файла
+ */
+static int passthrough_truncate(const char *path, off_t size, struct fuse_file_info *fi) {
+    (void) fi;
+    if (stats_file(path))
+        return -EACCES;
+
+    uint64_t t0 = op_start();
+    char fullpath[1024];
+    get_full_path(fullpath, path);
+
+    int res = truncate(fullpath, size);
+    if (res == -1)
+        res = -errno;
+    log_operation("TRUNCATE", path, res);
+
+    op_done(FSTAT_TRUNCATE, path, (uint64_t)size, 0, res, t0);
+    return res;
+}
+
+/*
+ * rename - переименовать/переместить файл
+ * Вызывается при: mv, а также rsync и редакторами (запись во временный файл + rename)
+ */
+static int passthrough_rename(const char *from, const char *to, unsigned int flags) {
+    if (stats_file(from) || stats_file(to))
+        return -EPERM;
+
+    uint64_t t0 = op_start();
+    char full_from[1024], full_to[1024];
+    get_full_path(full_from, from);
+    get_full_path(full_to, to);
+
+    /* RENAME_NOREPLACE / RENAME_EXCHANGE есть только у renameat2 */
+    int res = flags ? renameat2(AT_FDCWD, full_from, AT_FDCWD, full_to, flags)
+                    : rename(full_from, full_to);
+    if (res == -1)
+        res = -errno;
+    log_operation("RENAME", from, res);
+
+    op_done2(FSTAT_RENAME, from, 0, to, 0, flags, res, t0);
+    return res;
+}
+
+/* Время для трассы: нс с эпохи или FTRACE_UTIME_NOW/OMIT */
+static uint64_t utime_code(const struct timespec *ts) {
+    if (!ts || ts->tv_nsec == UTIME_NOW)
+        return FTRACE_UTIME_NOW;
+    if (ts->tv_nsec == UTIME_OMIT)
+        return FTRACE_UTIME_OMIT;
+    return (uint64_t)ts->tv_sec * 1000000000ull + (uint64_t)ts->tv_nsec;
+}
+
+/*
+ * utimens - изменить временные метки
+ * Вызывается при: touch, cp -p, rsync -t
+ */
+static int passthrough_utimens(const char *path, const struct timespec tv[2],
+                               struct fuse_file_info *fi) {
+    (void) fi;
+    if (stats_file(path))
+        return -EPERM;
+
+    uint64_t t0 = op_start();
+    char fullpath[1024];
+    get_full_path(fullpath, path);
+
+    int res = utimensat(AT_FDCWD, fullpath, tv, AT_SYMLINK_NOFOLLOW);
+    if (res == -1)
+        res = -errno;
+    log_operation("UTIMENS", path, res);
+
+    op_done2(FSTAT_UTIMENS, path, utime_code(tv ? &tv[0] : NULL), NULL,
+             utime_code(tv ? &tv[1] : NULL), 0, res, t0);
+    return res;
+}
+
+/*
+ * fallocate - выделить место или пробить дыру (FALLOC_FL_PUNCH_HOLE)
+ * Вызывается при: fallocate, qemu-img, загрузчиках с предвыделением
+ */
+static int passthrough_fallocate(const char *path, int mode, off_t offset,
+                                 off_t length, struct fuse_file_info *fi) {
+    (void) fi;
+    if (stats_file(path))
+        return -EACCES;
+
+    uint64_t t0 = op_start();
+    char fullpath[1024];
+    get_full_path(fullpath, path);
+
+    int fd = open(fullpath, O_WRONLY);
+    int res = fd == -1 ? -1 : fallocate(fd, mode, offset, length);
+    if (res == -1)
+        res = -errno;
+    if (fd != -1)
+        close(fd);
+    log_operation("FALLOCATE", path, res);
+
+    op_done2(FSTAT_FALLOCATE, path, (uint64_t)offset, NULL, (uint64_t)mode,
+             (uint64_t)length, res, t0);
+    return res;
+}
+
+/*
+ * copy_file_range - копирование внутри ФС без передачи данных через демон
+ * Вызывается при: cp (coreutils >= 9), rsync, qemu-img convert
+ *
+ * Передаётся ФС-источнику: там сработает reflink (btrfs, xfs) или
+ * копирование в ядре. С --xform байты на диске и в read различаются,
+ * поэтому отказываемся — ядро само перейдёт на обычные read/write.
+ */
+static ssize_t passthrough_copy_file_range(const char *path_in, struct fuse_file_info *fi_in,
+                                           off_t offset_in, const char *path_out,
+                                           struct fuse_file_info *fi_out, off_t offset_out,
+                                           size_t size, int flags) {
+    (void) fi_in;
+    (void) fi_out;
+    if (xform || stats_file(path_in) || stats_file(path_out))
+        return -EOPNOTSUPP;
+
+    uint64_t t0 = op_start();
+    char full_in[1024], full_out[1024];
+    get_full_path(full_in, path_in);
+    get_full_path(full_out, path_out);
+
+    ssize_t res = -1;
+    int fd_in = open(full_in, O_RDONLY);
+    int fd_out = fd_in == -1 ? -1 : open(full_out, O_WRONLY);
+    if (fd_out != -1) {
+        loff_t in = offset_in, out = offset_out;
+        res = copy_file_range(fd_in, &in, fd_out, &out, size, (unsigned int)flags);
+    }
+    if (res == -1)
+        res = -errno;
+    if (fd_out != -1)
+        close(fd_out);
+    if (fd_in != -1)
+        close(fd_in);
+
+    if (!quiet)
+        fprintf(stderr, "[%s] COPY_FILE_RANGE: %s -> %s (%zu bytes, result: %zd)\n",
+                "timestamp", path_in, path_out, size, res);
+
+    op_done2(FSTAT_COPY_FILE_RANGE, path_in, (uint64_t)offset_in, path_out,
+             (uint64_t)offset_out, size, res, t0);
+    return res;
+}
+
+/*
+ * lseek - SEEK_DATA / SEEK_HOLE (остальное ядро считает само)
+ * Вызывается при: cp --sparse, tar -S, qemu-img — чтобы пропускать дыры
+ */
+static off_t passthrough_lseek(const char *path, off_t off, int whence,
+                               struct fuse_file_info *fi) {
+    if (stats_file(path)) {
+        /* Снимок без дыр; -ENOSYS отключил бы lseek для всей ФС */
+        struct stats_snapshot *snap = (struct stats_snapshot *)(uintptr_t)fi->fh;
+        if (off < 0 || (size_t)off >= snap->len)
+            return -ENXIO;
+        return whence == SEEK_HOLE ? (off_t)snap->len : off;
+    }
+
+    uint64_t t0 = op_start();
+    char fullpath[1024];
+    get_full_path(fullpath, path);
+
+    int fd = open(fullpath, O_RDONLY);
+    off_t res = fd == -1 ? -1 : lseek(fd, off, whence);
+    if (res == -1)
+        res = -errno;
+    if (fd != -1)
+        close(fd);
+    log_operation("LSEEK", path, (int)(res < 0 ? res : 0));
+
+    op_done(FSTAT_LSEEK, path, (uint64_t)off, (uint64_t)whence, res, t0);
+    return res;
+}
+
 /*
  * TODO: Реализуйте дополнительные операции:
- * - rename: переименование/перемещение файлов
  * - chmod: изменение прав доступа
  * - chown: изменение владельца
- * - truncate: изменение размера файла
- * - utimens: изменение временных меток
  */
 
+static void *passthrough_init(struct fuse_conn_info *conn, struct fuse_config *cfg) {
+    (void) conn;
+    (void) cfg;
+    if (!metrics_enabled)
+        return NULL;
+    static const char *const names[FSTAT_OP_COUNT] = FSTAT_OP_NAMES;
+    struct metrics *m = metrics_open("passthrough_fuse");
+    if (!m) {
+        perror("metrics_open");
+        return NULL;
+    }
+    char name[METRICS_NAME];
+    for (int op = 0; op < FSTAT_OP_COUNT; op++) {
+        snprintf(name, sizeof(name), "fuse_op_latency_ns{op=\"%s\"}", names[op]);
+        m_latency[op] = metrics_histogram(m, name, "Operation latency inside the daemon");
+        snprintf(name, sizeof(name), "fuse_op_errors_total{op=\"%s\"}", names[op]);
+        m_errors[op] = metrics_counter(m, name, "Operations that returned -errno");
+    }
+    static const enum fstat_op data_ops[] = { FSTAT_READ, FSTAT_WRITE, FSTAT_COPY_FILE_RANGE };
+    for (size_t i = 0; i < sizeof(data_ops) / sizeof(data_ops[0]); i++) {
+        snprintf(name, sizeof(name), "fuse_bytes_total{op=\"%s\"}", names[data_ops[i]]);
+        m_bytes[data_ops[i]] = metrics_counter(m, name, "Bytes moved by successful operations");
+    }
+    /* init отрабатывает до первого запроса: потоки увидят готовые указатели */
+    metrics = m;
+    fprintf(stderr, "Metrics in /dev/shm%s\n", metrics_name(m));
+    return NULL;
+}
+
+static void passthrough_destroy(void *private_data) {
+    (void) private_data;
+    struct metrics *m = metrics;
+    metrics = NULL;
+    metrics_close(m);
+}
+
 /* Структура с указателями на все операции */
 static struct fuse_operations passthrough_oper = {
+    .init       = passthrough_init,
+    .destroy    = passthrough_destroy,
     .getattr    = passthrough_getattr,
     .readdir    = passthrough_readdir,
     .open       = passthrough_open,
@@ -264,14 +689,52 @@ static struct fuse_operations passthrough_oper = {
     .unlink     = passthrough_unlink,
     .mkdir      = passthrough_mkdir,
     .rmdir      = passthrough_rmdir,
+    .release    = passthrough_release,
+    .truncate   = passthrough_truncate,
+    .rename     = passthrough_rename,
+    .utimens    = passthrough_utimens,
+    .fallocate  = passthrough_fallocate,
+    .copy_file_range = passthrough_copy_file_range,
+    .lseek      = passthrough_lseek,
 };
 
 int main(int argc, char *argv[]) {
+    /* Собственные опции идут до source_dir */
+    const char *trace_file = NULL;
+    while (argc > 1 && !strncmp(argv[1], "--", 2) && argv[1][2]) {
+        if (!strncmp(argv[1], "--xform=", 8)) {
+            if (xform_init_name(&xform_storage, argv[1] + 8) < 0) {
+                fprintf(stderr, "Unknown transform: %s (rot13, upper, lower, xor:KEY)\n", argv[1] + 8);
+                return 1;
+            }
+            xform = &xform_storage;
+            fprintf(stderr, "Transform %s, kernel %s\n", argv[1] + 8, xform->kernel->name);
+        } else if (!strcmp(argv[1], "--stats")) {
+            stats_enabled = 1;
+        } else if (!strncmp(argv[1], "--trace=", 8)) {
+            trace_file = argv[1] + 8;
+        } else if (!strcmp(argv[1], "--metrics")) {
+            metrics_enabled = 1;
+        } else if (!strcmp(argv[1], "--quiet")) {
+            quiet = 1;
+        } else {
+            break;
+        }
+        argv[1] = argv[0];
+        argv++;
+        argc--;
+    }
+
     /* Проверка аргументов */
     if (argc < 3) {
-        fprintf(stderr, "Usage: %s <source_dir> <mount_point> [fuse_options]\n", argv[0]);
+        fprintf(stderr, "Usage: %s [--xform=SPEC] [--stats] [--trace=FILE] [--metrics] [--quiet] <source_dir> <mount_point> [fuse_options]\n", argv[0]);
         fprintf(stderr, "Example: %s /tmp/source /mnt/fuse -f\n", argv[0]);
         fprintf(stderr, "\nОпции:\n");
+        fprintf(stderr, "  --xform=SPEC  rot13, upper, lower или xor:KEY (Вариант 2)\n");
+        fprintf(stderr, "  --stats       виртуальные /.stats и /.stats.json (Вариант 1)\n");
+        fprintf(stderr, "  --trace=FILE  записать бинарную трассу для fuse_replay\n");
+        fprintf(stderr, "  --metrics     метрики в /dev/shm/passthrough_fuse.<pid> (lab2/samples/metrics_dump)\n");
+        fprintf(stderr, "  --quiet       не писать лог операций в stderr\n");
         fprintf(stderr, "  -f  foreground mode (не уходить в фон)\n");
         fprintf(stderr, "  -d  debug mode (включить отладочный вывод)\n");
         return 1;
@@ -284,6 +747,16 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    /* Открыть до fuse_main: демон потом делает chdir("/") */
+    if (trace_file) {
+        int err = ftrace_open(trace_file);
+        if (err < 0) {
+            fprintf(stderr, "%s: %s\n", trace_file, strerror(-err));
+            return 1;
+        }
+        trace_enabled = 1;
+    }
+
     fprintf(stderr, "Mounting %s at %s\n", base_path, argv[2]);
     fprintf(stderr, "To unmount: fusermount -u %s\n", argv[2]);
 
@@ -298,6 +771,8 @@ int main(int argc, char *argv[]) {
 
     int ret = fuse_main(fuse_argc, fuse_argv, &passthrough_oper, NULL);
 
+    ftrace_close();
+
     free(fuse_argv);
     free(base_path);
 
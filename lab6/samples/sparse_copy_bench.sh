@@ -0,0 +1,71 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Копирование разреженного образа внутри точки монтирования passthrough_fuse.
+# Сравнивает сборки демона: без copy_file_range/SEEK_DATA каждый байт
+# (и нули дыр) идёт через демон, с ними — копирует ФС-источник.
+#
+# Usage:
+#   bash sparse_copy_bench.sh                                   # ./passthrough_fuse
+#   bash sparse_copy_bench.sh /tmp/base/lab6/samples/passthrough_fuse ./passthrough_fuse
+#   SIZE_GB=2 DATA_MB=64 bash sparse_copy_bench.sh ...
+#
+# Сборка "до" из любого коммита:
+#   git worktree add /tmp/base <commit> && make -C /tmp/base/lab6/samples
+
+script_dir="$(cd "$(dirname "$0")" && pwd)"
+SIZE_GB="${SIZE_GB:-10}"
+DATA_MB="${DATA_MB:-256}"       # данные в 8 экстентах, остальное — дыры
+CHECK="${CHECK:-1}"             # сверить копию с оригиналом (cmp мимо FUSE)
+
+if [[ $# -eq 0 ]]; then
+  make -C "${script_dir}" passthrough_fuse >/dev/null
+  set -- "${script_dir}/passthrough_fuse"
+fi
+
+unmount() {
+  fusermount3 -u "$1" 2>/dev/null || fusermount -u "$1" 2>/dev/null || umount "$1"
+}
+
+src="$(mktemp -d /var/tmp/sparse_src.XXXXXX)"
+mnt="$(mktemp -d /tmp/sparse_mnt.XXXXXX)"
+cleanup() {
+  mountpoint -q "${mnt}" && unmount "${mnt}"
+  rm -rf "${src}" "${mnt}"
+}
+trap cleanup EXIT
+
+echo "Creating ${SIZE_GB} GiB sparse image with ${DATA_MB} MiB of data in ${src}..."
+truncate -s "${SIZE_GB}G" "${src}/image.raw"
+for k in $(seq 0 7); do
+  dd if=/dev/urandom of="${src}/image.raw" bs=1M count=$((DATA_MB / 8)) \
+     seek=$((k * SIZE_GB * 1024 / 8)) conv=notrunc status=none
+done
+
+results=()
+for bin in "$@"; do
+  "${bin}" "${src}" "${mnt}" >/dev/null 2>&1     # демон: после fork лог уходит в /dev/null
+  for _ in $(seq 50); do mountpoint -q "${mnt}" && break; sleep 0.1; done
+
+  sync
+  echo 3 > /proc/sys/vm/drop_caches 2>/dev/null || true
+  t0=$(date +%s.%N)
+  status=ok
+  cp --sparse=auto "${mnt}/image.raw" "${mnt}/copy.raw" 2>/dev/null || status=failed
+  t1=$(date +%s.%N)
+  unmount "${mnt}"
+
+  alloc_mb=$(du -m "${src}/copy.raw" 2>/dev/null | cut -f1 || echo 0)
+  if [[ "${status}" == ok && "${CHECK}" == 1 ]]; then
+    cmp -s "${src}/image.raw" "${src}/copy.raw" || status=MISMATCH
+  fi
+  rm -f "${src}/copy.raw"
+  results+=("${bin}|${t0}|${t1}|${alloc_mb}|${status}")
+done
+
+printf "%-48s %10s %12s %12s %8s\n" "daemon" "time_s" "GiB/s" "alloc_MiB" "status"
+for r in "${results[@]}"; do
+  IFS='|' read -r bin t0 t1 alloc status <<<"${r}"
+  awk -v bin="${bin}" -v t0="${t0}" -v t1="${t1}" -v gb="${SIZE_GB}" -v alloc="${alloc}" -v st="${status}" \
+    'BEGIN{ t = t1 - t0; printf "%-48s %10.2f %12.2f %12d %8s\n", bin, t, gb / t, alloc, st }'
+done
@@ -0,0 +1,805 @@
+/*
+ * tar_index.c - построение и загрузка индекса tar-архива (см. tar_index.h)
+ *
+ * Поддерживаются ustar/POSIX (prefix + name), длинные имена GNU ('L'/'K'),
+ * расширенные заголовки pax ('x': path, linkpath, size, mtime, uid, gid),
+ * размеры в base-256 (GNU, файлы > 8 GiB), жёсткие ссылки (запись получает
+ * смещение данных цели). Каталоги, которых нет в архиве явно, создаются.
+ * Если путь встречается несколько раз, побеждает последняя запись — как
+ * при распаковке tar.
+ *
+ * Архив читается через archive_src, поэтому смещения в индексе — это
+ * смещения в несжатом tar-потоке, и для .tar.gz/.tar.zst всё работает
+ * так же (первое монтирование сжатого архива распаковывает его дважды:
+ * для точек входа .zidx и для заголовков tar).
+ */
+
+#define _GNU_SOURCE
+#include "tar_index.h"
+#include "archive_src.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define TAR_BLOCK 512
+
+/* Запись на этапе построения */
+struct build_entry {
+    char *path;
+    char *link;
+    uint64_t data_offset;
+    uint64_t size;
+    int64_t mtime;
+    uint32_t mode;
+    uint32_t uid;
+    uint32_t gid;
+    long seq;           // порядок в архиве; -1 у созданных каталогов
+    int hardlink;       // link — путь цели внутри архива
+};
+
+struct build {
+    struct build_entry *v;
+    size_t n, cap;
+};
+
+/* ---------- Разбор заголовков tar ---------- */
+
+static int read_full(struct archive_src *src, void *buf, size_t n, uint64_t off) {
+    ssize_t r = archive_src_pread(src, buf, n, off);
+    if (r < 0)
+        return (int)r;
+    return (size_t)r == n ? 0 : -EIO;   // архив обрезан
+}
+
+/* Числовое поле: восьмеричное ASCII или base-256 (старший бит первого байта) */
+static uint64_t parse_num(const char *f, size_t len) {
+    const unsigned char *u = (const unsigned char *)f;
+    uint64_t v = 0;
+
+    if (u[0] & 0x80) {
+        v = u[0] & 0x3f;
+        for (size_t i = 1; i < len; i++)
+            v = (v << 8) | u[i];
+        return v;
+    }
+    size_t i = 0;
+    while (i < len && (f[i] == ' ' || f[i] == '\0'))
+        i++;
+    for (; i < len && f[i] >= '0' && f[i] <= '7'; i++)
+        v = (v << 3) | (uint64_t)(f[i] - '0');
+    return v;
+}
+
+static int checksum_ok(const unsigned char *h) {
+    uint64_t stored = parse_num((const char *)h + 148, 8);
+    uint64_t sum = 0;
+    for (int i = 0; i < TAR_BLOCK; i++)
+        sum += (i >= 148 && i < 156) ? ' ' : h[i];
+    return sum == stored;
+}
+
+static int is_zero_block(const unsigned char *h) {
+    for (int i = 0; i < TAR_BLOCK; i++)
+        if (h[i])
+            return 0;
+    return 1;
+}
+
+static char *field_dup(const char *f, size_t len) {
+    return strndup(f, strnlen(f, len));
+}
+
+/* Данные служебной записи ('L', 'K', 'x') целиком в память */
+static char *read_blob(struct archive_src *src, uint64_t off, uint64_t size) {
+    if (size > (1u << 24))
+        return NULL;            // 16 MiB на имя — явно мусор
+    char *p = malloc(size + 1);
+    if (!p)
+        return NULL;
+    if (read_full(src, p, size, off) < 0) {
+        free(p);
+        return NULL;
+    }
+    p[size] = '\0';
+    return p;
+}
+
+struct pax_attrs {
+    char *path;
+    char *linkpath;
+    int has_size, has_mtime, has_uid, has_gid;
+    uint64_t size;
+    int64_t mtime;
+    uint32_t uid, gid;
+};
+
+static void pax_free(struct pax_attrs *pax) {
+    free(pax->path);
+    free(pax->linkpath);
+    memset(pax, 0, sizeof(*pax));
+}
+
+/* Записи pax: "<len> <key>=<value>\n" */
+static void pax_parse(struct pax_attrs *pax, const char *p, size_t size) {
+    const char *end = p + size;
+    while (p < end) {
+        char *sp;
+        unsigned long len = strtoul(p, &sp, 10);
+        if (len == 0 || *sp != ' ' || len > (size_t)(end - p))
+            break;
+        const char *key = sp + 1, *rec_end = p + len - 1;   // без '\n'
+        const char *eq = memchr(key, '=', (size_t)(rec_end - key));
+        if (eq) {
+            size_t klen = (size_t)(eq - key);
+            const char *val = eq + 1;
+            size_t vlen = (size_t)(rec_end - val);
+            if (klen == 4 && !memcmp(key, "path", 4)) {
+                free(pax->path);
+                pax->path = strndup(val, vlen);
+            } else if (klen == 8 && !memcmp(key, "linkpath", 8)) {
+                free(pax->linkpath);
+                pax->linkpath = strndup(val, vlen);
+            } else if (klen == 4 && !memcmp(key, "size", 4)) {
+                pax->size = strtoull(val, NULL, 10);
+                pax->has_size = 1;
+            } else if (klen == 5 && !memcmp(key, "mtime", 5)) {
+                pax->mtime = strtoll(val, NULL, 10);    // дробная часть не нужна
+                pax->has_mtime = 1;
+            } else if (klen == 3 && !memcmp(key, "uid", 3)) {
+                pax->uid = (uint32_t)strtoul(val, NULL, 10);
+                pax->has_uid = 1;
+            } else if (klen == 3 && !memcmp(key, "gid", 3)) {
+                pax->gid = (uint32_t)strtoul(val, NULL, 10);
+                pax->has_gid = 1;
+            }
+        }
+        p += len;
+    }
+}
+
+/*
+ * Привести путь к виду "a/b/c": без ведущих "/" и "./", без пустых
+ * компонентов и "." в середине, без "/" в конце. Пути с ".." отбрасываются
+ * (возвращается NULL) — внутри смонтированного архива им не место.
+ */
+static char *normalize_path(const char *in) {
+    size_t len = strlen(in);
+    char *out = malloc(len + 1);
+    if (!out)
+        return NULL;
+
+    size_t o = 0;
+    const char *p = in;
+    while (*p) {
+        while (*p == '/')
+            p++;
+        const char *s = p;
+        while (*p && *p != '/')
+            p++;
+        size_t clen = (size_t)(p - s);
+        if (clen == 0 || (clen == 1 && s[0] == '.'))
+            continue;
+        if (clen == 2 && s[0] == '.' && s[1] == '.') {
+            free(out);
+            return NULL;
+        }
+        if (o)
+            out[o++] = '/';
+        memcpy(out + o, s, clen);
+        o += clen;
+    }
+    out[o] = '\0';
+    return out;
+}
+
+static struct build_entry *build_push(struct build *b) {
+    if (b->n == b->cap) {
+        size_t cap = b->cap ? b->cap * 2 : 1024;
+        struct build_entry *v = realloc(b->v, cap * sizeof(*v));
+        if (!v)
+            return NULL;
+        b->v = v;
+        b->cap = cap;
+    }
+    struct build_entry *e = &b->v[b->n++];
+    memset(e, 0, sizeof(*e));
+    return e;
+}
+
+static void build_free(struct build *b) {
+    for (size_t i = 0; i < b->n; i++) {
+        free(b->v[i].path);
+        free(b->v[i].link);
+    }
+    free(b->v);
+    memset(b, 0, sizeof(*b));
+}
+
+/* Один последовательный проход по архиву */
+static int scan_archive(struct archive_src *src, uint64_t archive_size, struct build *b) {
+    unsigned char h[TAR_BLOCK];
+    struct pax_attrs pax = {0};
+    char *long_name = NULL, *long_link = NULL;
+    uint64_t off = 0;
+    long seq = 0;
+    int err = 0;
+
+    while (off + TAR_BLOCK <= archive_size) {
+        if ((err = read_full(src, h, TAR_BLOCK, off)) < 0)
+            break;
+        if (is_zero_block(h))
+            break;              // конец архива
+        if (!checksum_ok(h)) {
+            fprintf(stderr, "tar_index: bad header checksum at offset %llu\n",
+                    (unsigned long long)off);
+            err = -EINVAL;
+            break;
+        }
+
+        char type = (char)h[156];
+        uint64_t size = parse_num((const char *)h + 124, 12);
+        if (pax.has_size)
+            size = pax.size;
+        uint64_t data = off + TAR_BLOCK;
+        uint64_t next = data + ((size + TAR_BLOCK - 1) & ~(uint64_t)(TAR_BLOCK - 1));
+        if (next > archive_size || next < data) {
+            err = -EIO;
+            break;
+        }
+
+        // Служебные записи относятся к следующему заголовку
+        if (type == 'L' || type == 'K' || type == 'x') {
+            char *blob = read_blob(src, data, size);
+            if (!blob) {
+                err = -EIO;
+                break;
+            }
+            if (type == 'L') {
+                free(long_name);
+                long_name = blob;
+            } else if (type == 'K') {
+                free(long_link);
+                long_link = blob;
+            } else {
+                pax_parse(&pax, blob, size);
+                free(blob);
+            }
+            off = next;
+            continue;
+        }
+        if (type == 'g') {      // глобальный pax — игнорируем
+            off = next;
+            continue;
+        }
+
+        uint32_t ftype;
+        switch (type) {
+            case '0': case '\0': case '7': ftype = S_IFREG; break;
+            case '1': ftype = S_IFREG; break;
+            case '2': ftype = S_IFLNK; break;
+            case '5': ftype = S_IFDIR; break;
+            default: ftype = 0; break;      // устройства, FIFO — пропускаем
+        }
+
+        char *raw = NULL;
+        if (pax.path)
+            raw = strdup(pax.path);
+        else if (long_name)
+            raw = strdup(long_name);
+        else if (!memcmp(h + 257, "ustar\0", 6) && h[345]) {
+            // POSIX ustar: полное имя = prefix + "/" + name
+            char *prefix = field_dup((const char *)h + 345, 155);
+            char *name = field_dup((const char *)h, 100);
+            if (prefix && name && asprintf(&raw, "%s/%s", prefix, name) < 0)
+                raw = NULL;
+            free(prefix);
+            free(name);
+        } else
+            raw = field_dup((const char *)h, 100);
+
+        char *path = raw ? normalize_path(raw) : NULL;
+        free(raw);
+
+        if (ftype && path) {
+            struct build_entry *e = build_push(b);
+            if (!e) {
+                free(path);
+                err = -ENOMEM;
+                break;
+            }
+            e->path = path;
+            path = NULL;
+            e->mode = ftype | ((uint32_t)parse_num((const char *)h + 100, 8) & 07777);
+            e->uid = pax.has_uid ? pax.uid : (uint32_t)parse_num((const char *)h + 108, 8);
+            e->gid = pax.has_gid ? pax.gid : (uint32_t)parse_num((const char *)h + 116, 8);
+            e->mtime = pax.has_mtime ? pax.mtime : (int64_t)parse_num((const char *)h + 136, 12);
+            e->seq = seq++;
+            if (type == '1' || type == '2') {
+                const char *l = pax.linkpath ? pax.linkpath : long_link;
+                e->link = l ? strdup(l) : field_dup((const char *)h + 157, 100);
+                e->hardlink = type == '1';
+            } else if (ftype == S_IFREG) {
+                e->data_offset = data;
+                e->size = size;
+            }
+        }
+        free(path);
+
+        pax_free(&pax);
+        free(long_name);
+        free(long_link);
+        long_name = long_link = NULL;
+        off = next;
+    }
+
+    pax_free(&pax);
+    free(long_name);
+    free(long_link);
+    return err;
+}
+
+/* ---------- Упорядочивание и дерево каталогов ---------- */
+
+static int cmp_build(const void *a, const void *b) {
+    const struct build_entry *x = a, *y = b;
+    int c = strcmp(x->path, y->path);
+    if (c)
+        return c;
+    return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+/* Отсортировать и оставить для каждого пути последнюю запись */
+static void sort_dedup(struct build *b) {
+    qsort(b->v, b->n, sizeof(*b->v), cmp_build);
+    size_t o = 0;
+    for (size_t i = 0; i < b->n; i++) {
+        if (i + 1 < b->n && !strcmp(b->v[i].path, b->v[i + 1].path)) {
+            free(b->v[i].path);
+            free(b->v[i].link);
+            continue;
+        }
+        b->v[o++] = b->v[i];
+    }
+    b->n = o;
+}
+
+static long find_path_n(const struct build *b, size_t n, const char *path) {
+    size_t lo = 0, hi = n;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        int c = strcmp(b->v[mid].path, path);
+        if (c == 0)
+            return (long)mid;
+        if (c < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return -1;
+}
+
+static long find_path(const struct build *b, const char *path) {
+    return find_path_n(b, b->n, path);
+}
+
+/*
+ * Добавить корень и все промежуточные каталоги, которых нет в архиве.
+ * Подъём по предкам останавливается на первом существующем: его предков
+ * уже обработали вместе с ним. Соседние файлы одного каталога идут подряд,
+ * поэтому достаточно помнить последний добавленный каталог; редкие
+ * повторы убирает sort_dedup().
+ */
+static int add_implicit_dirs(struct build *b, int64_t mtime) {
+    size_t n = b->n;
+    char *last = NULL;
+    int err = 0;
+
+    if (find_path_n(b, n, "") < 0) {
+        struct build_entry *e = build_push(b);
+        if (!e || !(e->path = strdup("")))
+            return -ENOMEM;
+        e->mode = S_IFDIR | 0755;
+        e->mtime = mtime;
+        e->seq = -1;
+    }
+
+    for (size_t i = 0; i < n && !err; i++) {
+        char *tmp = strdup(b->v[i].path);
+        if (!tmp)
+            return -ENOMEM;
+        char *slash;
+        int first = 1;
+        while ((slash = strrchr(tmp, '/'))) {
+            *slash = '\0';
+            if (find_path_n(b, n, tmp) >= 0 || (last && !strcmp(last, tmp)))
+                break;
+            struct build_entry *e = build_push(b);
+            if (!e || !(e->path = strdup(tmp))) {
+                err = -ENOMEM;
+                break;
+            }
+            e->mode = S_IFDIR | 0755;
+            e->mtime = mtime;
+            e->seq = -1;
+            if (first) {
+                free(last);
+                if (!(last = strdup(tmp))) {
+                    err = -ENOMEM;
+                    break;
+                }
+                first = 0;
+            }
+        }
+        free(tmp);
+    }
+    free(last);
+    if (!err && b->n != n)
+        sort_dedup(b);      // явная запись каталога (seq >= 0) переживает неявную
+    return err;
+}
+
+/* Жёсткая ссылка получает данные и атрибуты файла-цели */
+static void resolve_hardlinks(struct build *b) {
+    for (size_t i = 0; i < b->n; i++) {
+        struct build_entry *e = &b->v[i];
+        const struct build_entry *t = e;
+        for (int depth = 0; depth < 8 && t->hardlink; depth++) {
+            char *target = t->link ? normalize_path(t->link) : NULL;
+            long j = target ? find_path(b, target) : -1;
+            free(target);
+            t = j >= 0 ? &b->v[j] : NULL;
+            if (!t)
+                break;
+        }
+        if (!e->hardlink)
+            continue;
+        if (t && !t->hardlink && S_ISREG(t->mode)) {
+            e->data_offset = t->data_offset;
+            e->size = t->size;
+        }
+        // Иначе остаётся пустым файлом: цель вне архива
+    }
+    for (size_t i = 0; i < b->n; i++) {
+        if (b->v[i].hardlink) {
+            b->v[i].hardlink = 0;
+            free(b->v[i].link);
+            b->v[i].link = NULL;
+        }
+    }
+}
+
+/* ---------- Запись файла индекса ---------- */
+
+static uint64_t fnv1a(const char *s) {
+    uint64_t h = 1469598103934665603ULL;
+    for (; *s; s++) {
+        h ^= (unsigned char)*s;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static uint64_t align8(uint64_t v) {
+    return (v + 7) & ~(uint64_t)7;
+}
+
+static int write_full(int fd, const void *buf, size_t n) {
+    const char *p = buf;
+    while (n > 0) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0) {
+            if (errno == EINTR)
+                continue;
+            return -errno;
+        }
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+/* Собрать образ индекса в памяти и атомарно (tmp + rename) сохранить */
+static int write_index(const struct build *b, const struct stat *ast, const char *index_path) {
+    uint32_t n = (uint32_t)b->n;
+    uint32_t slots = 16;
+    while (slots < 2 * n)
+        slots <<= 1;
+
+    uint64_t strings_size = 0;
+    for (size_t i = 0; i < b->n; i++) {
+        strings_size += strlen(b->v[i].path) + 1;
+        if (b->v[i].link)
+            strings_size += strlen(b->v[i].link) + 1;
+    }
+    if (b->n >= UINT32_MAX || strings_size >= UINT32_MAX)
+        return -EFBIG;
+
+    struct tidx_header hdr = {0};
+    memcpy(hdr.magic, TIDX_MAGIC, sizeof(hdr.magic));
+    hdr.version = TIDX_VERSION;
+    hdr.entry_count = n;
+    hdr.archive_size = (uint64_t)ast->st_size;
+    hdr.archive_mtime_sec = ast->st_mtim.tv_sec;
+    hdr.archive_mtime_nsec = ast->st_mtim.tv_nsec;
+    hdr.hash_slots = slots;
+    hdr.child_count = n - 1;            // у каждой записи, кроме корня, один родитель
+    hdr.off_entries = align8(sizeof(hdr));
+    hdr.off_hash = align8(hdr.off_entries + (uint64_t)n * sizeof(struct tidx_entry));
+    hdr.off_children = align8(hdr.off_hash + (uint64_t)slots * sizeof(uint32_t));
+    hdr.off_strings = align8(hdr.off_children + (uint64_t)hdr.child_count * sizeof(uint32_t));
+    hdr.strings_size = strings_size;
+
+    size_t total = (size_t)(hdr.off_strings + strings_size);
+    char *img = calloc(1, total);
+    if (!img)
+        return -ENOMEM;
+    memcpy(img, &hdr, sizeof(hdr));
+    struct tidx_entry *ents = (struct tidx_entry *)(img + hdr.off_entries);
+    uint32_t *hash = (uint32_t *)(img + hdr.off_hash);
+    uint32_t *children = (uint32_t *)(img + hdr.off_children);
+    char *strings = img + hdr.off_strings;
+
+    // Строки, атрибуты и хэш-таблица
+    uint32_t so = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        const struct build_entry *be = &b->v[i];
+        struct tidx_entry *e = &ents[i];
+        size_t len = strlen(be->path);
+        const char *slash = strrchr(be->path, '/');
+
+        e->data_offset = be->data_offset;
+        e->size = be->size;
+        e->mtime = be->mtime;
+        e->mode = be->mode;
+        e->uid = be->uid;
+        e->gid = be->gid;
+        e->name_off = so;
+        e->name_len = (uint32_t)len;
+        e->base_off = slash ? (uint32_t)(slash - be->path + 1) : 0;
+        e->parent = TIDX_NONE;
+        e->link_off = TIDX_NONE;
+        memcpy(strings + so, be->path, len + 1);
+        so += (uint32_t)len + 1;
+        if (be->link) {
+            size_t llen = strlen(be->link);
+            e->link_off = so;
+            memcpy(strings + so, be->link, llen + 1);
+            so += (uint32_t)llen + 1;
+            e->size = llen;
+        }
+
+        uint32_t s = (uint32_t)fnv1a(be->path) & (slots - 1);
+        while (hash[s])
+            s = (s + 1) & (slots - 1);
+        hash[s] = i + 1;
+    }
+
+    // Родители: после сортировки корень "" — запись 0
+    for (uint32_t i = 1; i < n; i++) {
+        const char *path = strings + ents[i].name_off;
+        uint32_t plen = ents[i].base_off ? ents[i].base_off - 1 : 0;
+        char *parent = strndup(path, plen);
+        long p = parent ? find_path(b, parent) : -1;
+        free(parent);
+        if (p >= 0 && S_ISDIR(ents[p].mode)) {
+            ents[i].parent = (uint32_t)p;
+            ents[p].child_count++;
+        }
+    }
+
+    // Дети каждого каталога — непрерывный диапазон, в порядке имён
+    uint32_t pos = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        ents[i].child_start = pos;
+        pos += ents[i].child_count;
+        ents[i].child_count = 0;
+    }
+    for (uint32_t i = 1; i < n; i++) {
+        uint32_t p = ents[i].parent;
+        if (p != TIDX_NONE)
+            children[ents[p].child_start + ents[p].child_count++] = i;
+    }
+    ents[0].parent = 0;
+
+    char *tmp;
+    if (asprintf(&tmp, "%s.tmp.%d", index_path, (int)getpid()) < 0) {
+        free(img);
+        return -ENOMEM;
+    }
+    int err = 0;
+    // Имя предсказуемо, а каталог может быть общим ($TMPDIR): только новый файл
+    unlink(tmp);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0644);
+    if (fd < 0)
+        err = -errno;
+    else {
+        err = write_full(fd, img, total);
+        if (close(fd) < 0 && !err)
+            err = -errno;
+        if (!err && rename(tmp, index_path) < 0)
+            err = -errno;
+        if (err)
+            unlink(tmp);
+    }
+    free(tmp);
+    free(img);
+    return err;
+}
+
+/* ---------- Загрузка ---------- */
+
+/*
+ * Ссылки внутри индекса: имена в strings, дети, родители и слоты хэша —
+ * в пределах своих таблиц. Без этого обрезанный или подложенный файл
+ * даёт чтение за границей отображения в демоне. Один проход, O(n).
+ */
+static int index_refs_ok(const struct tidx_header *h, const char *map) {
+    const struct tidx_entry *ents = (const struct tidx_entry *)(map + h->off_entries);
+    const uint32_t *hash = (const uint32_t *)(map + h->off_hash);
+    const uint32_t *children = (const uint32_t *)(map + h->off_children);
+    const char *strings = map + h->off_strings;
+    uint64_t n = h->entry_count;
+
+    for (uint64_t i = 0; i < n; i++) {
+        const struct tidx_entry *e = &ents[i];
+        if ((uint64_t)e->name_off + e->name_len >= h->strings_size ||
+            strings[e->name_off + e->name_len] != '\0' || e->base_off > e->name_len ||
+            (e->link_off != TIDX_NONE && e->link_off >= h->strings_size) ||
+            (e->parent != TIDX_NONE && e->parent >= n) ||
+            (uint64_t)e->child_start + e->child_count > h->child_count)
+            return 0;
+    }
+    for (uint64_t i = 0; i < h->child_count; i++)
+        if (children[i] >= n)
+            return 0;
+    for (uint64_t i = 0; i < h->hash_slots; i++)
+        if (hash[i] > n)            // индекс + 1, 0 — пусто
+            return 0;
+    return 1;
+}
+
+/*
+ * trusted == 0 — запасной индекс из общего $TMPDIR: размер и mtime архива
+ * видны всем через stat, так что подложить подходящий файл может кто угодно.
+ * Берём только обычный файл, свой и не доступный на запись другим.
+ */
+static int load_index(const char *index_path, const struct stat *ast, struct tar_index *idx, int trusted) {
+    int fd = open(index_path, O_RDONLY | O_CLOEXEC | (trusted ? 0 : O_NOFOLLOW));
+    if (fd < 0)
+        return -errno;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(struct tidx_header)) {
+        close(fd);
+        return -EINVAL;
+    }
+    if (!trusted && (!S_ISREG(st.st_mode) || st.st_uid != geteuid() || (st.st_mode & (S_IWGRP | S_IWOTH)))) {
+        close(fd);
+        return -EPERM;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -errno;
+
+    const struct tidx_header *h = map;
+    uint64_t fsize = (uint64_t)st.st_size;
+    int ok = !memcmp(h->magic, TIDX_MAGIC, sizeof(h->magic)) &&
+             h->version == TIDX_VERSION &&
+             h->archive_size == (uint64_t)ast->st_size &&
+             h->archive_mtime_sec == ast->st_mtim.tv_sec &&
+             h->archive_mtime_nsec == ast->st_mtim.tv_nsec &&
+             h->entry_count > 0 &&
+             h->hash_slots && !(h->hash_slots & (h->hash_slots - 1)) &&
+             h->off_entries + (uint64_t)h->entry_count * sizeof(struct tidx_entry) <= h->off_hash &&
+             h->off_hash + (uint64_t)h->hash_slots * sizeof(uint32_t) <= h->off_children &&
+             h->off_children + (uint64_t)h->child_count * sizeof(uint32_t) <= h->off_strings &&
+             h->off_strings + h->strings_size == fsize &&
+             h->strings_size > 0 && ((const char *)map)[fsize - 1] == '\0' &&
+             index_refs_ok(h, map);
+    if (!ok) {
+        munmap(map, (size_t)st.st_size);
+        return -ESTALE;
+    }
+
+    idx->map = map;
+    idx->map_size = (size_t)st.st_size;
+    idx->hdr = h;
+    idx->entries = (const struct tidx_entry *)((const char *)map + h->off_entries);
+    idx->hash = (const uint32_t *)((const char *)map + h->off_hash);
+    idx->children = (const uint32_t *)((const char *)map + h->off_children);
+    idx->strings = (const char *)map + h->off_strings;
+    return 0;
+}
+
+static int build_index(struct archive_src *src, const struct stat *ast, const char *index_path) {
+    struct build b = {0};
+    int err = scan_archive(src, archive_src_size(src), &b);
+    if (!err) {
+        sort_dedup(&b);
+        err = add_implicit_dirs(&b, ast->st_mtim.tv_sec);
+    }
+    if (!err) {
+        resolve_hardlinks(&b);
+        err = write_index(&b, ast, index_path);
+    }
+    build_free(&b);
+    return err;
+}
+
+int tar_index_open(const char *archive_path, struct archive_src *src,
+                   const char *index_path, struct tar_index *idx, int *rebuilt) {
+    memset(idx, 0, sizeof(*idx));
+    if (rebuilt)
+        *rebuilt = 0;
+
+    const struct stat *ast = archive_src_stat(src);
+    char *primary = index_path ? strdup(index_path) : archive_sidecar_path(archive_path, ast, ".idx", 0);
+    char *fallback = index_path ? NULL : archive_sidecar_path(archive_path, ast, ".idx", 1);
+    if (!primary) {
+        free(fallback);
+        return -ENOMEM;
+    }
+
+    int err = load_index(primary, ast, idx, 1);
+    if (err && fallback)
+        err = load_index(fallback, ast, idx, 0);
+    if (err) {
+        const char *target = primary;
+        err = build_index(src, ast, target);
+        if ((err == -EACCES || err == -EROFS || err == -EPERM) && fallback) {
+            target = fallback;
+            err = build_index(src, ast, target);
+        }
+        if (!err) {
+            if (rebuilt)
+                *rebuilt = 1;
+            err = load_index(target, ast, idx, target == primary);
+        }
+    }
+
+    free(primary);
+    free(fallback);
+    return err;
+}
+
+void tar_index_close(struct tar_index *idx) {
+    if (idx->map)
+        munmap(idx->map, idx->map_size);
+    memset(idx, 0, sizeof(*idx));
+}
+
+long tar_index_lookup(const struct tar_index *idx, const char *path) {
+    while (*path == '/')
+        path++;
+    uint32_t mask = idx->hdr->hash_slots - 1;
+    uint32_t s = (uint32_t)fnv1a(path) & mask;
+    for (uint32_t probes = 0; probes <= mask; probes++) {
+        uint32_t v = idx->hash[s];
+        if (!v)
+            return -1;
+        if (!strcmp(idx->strings + idx->entries[v - 1].name_off, path))
+            return (long)(v - 1);
+        s = (s + 1) & mask;
+    }
+    return -1;
+}
+
+void tar_index_stat(const struct tar_index *idx, const struct tidx_entry *e, struct stat *st) {
+    memset(st, 0, sizeof(*st));
+    st->st_ino = (ino_t)(e - idx->entries) + 1;
+    st->st_mode = e->mode & ~(uint32_t)0222;
+    st->st_nlink = S_ISDIR(e->mode) ? 2 : 1;
+    st->st_uid = e->uid;
+    st->st_gid = e->gid;
+    st->st_size = (off_t)e->size;
+    st->st_blksize = 4096;
+    st->st_blocks = (blkcnt_t)((e->size + 511) / 512);
+    st->st_mtime = st->st_ctime = st->st_atime = (time_t)e->mtime;
+}
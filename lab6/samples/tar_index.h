@@ -0,0 +1,114 @@
+/*
+ * tar_index.h - индекс tar-архива для archive_fs
+ *
+ * При первом монтировании архив один раз сканируется последовательно,
+ * и рядом с ним сохраняется индекс <archive>.idx — бинарный файл, который
+ * потом просто отображается через mmap(). Повторное монтирование
+ * занимает миллисекунды: ни один заголовок tar больше не читается.
+ *
+ * Индекс действителен, пока совпадают размер и mtime архива (они
+ * записаны в заголовок индекса); иначе он перестраивается. Для сжатых
+ * архивов data_offset — смещение в несжатом потоке (см. archive_src.h).
+ *
+ * Раскладка файла индекса (все поля little-endian, выровнены на 8):
+ *
+ *   struct tidx_header
+ *   struct tidx_entry   entries[entry_count]   — отсортированы по пути
+ *   uint32_t            hash[hash_slots]       — открытая адресация,
+ *                                                 индекс записи + 1 (0 = пусто)
+ *   uint32_t            children[child_count]  — дети каталогов подряд
+ *   char                strings[strings_size]  — пути и цели ссылок, с '\0'
+ *
+ * Запись 0 — корень архива (путь "").
+ */
+
+#ifndef TAR_INDEX_H
+#define TAR_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+struct archive_src;
+
+#define TIDX_MAGIC   "TARIDX1"
+#define TIDX_VERSION 1
+#define TIDX_NONE    UINT32_MAX
+
+struct tidx_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_count;
+    uint64_t archive_size;      // для проверки актуальности
+    int64_t archive_mtime_sec;
+    int64_t archive_mtime_nsec;
+    uint32_t hash_slots;        // степень двойки
+    uint32_t child_count;
+    uint64_t off_entries;
+    uint64_t off_hash;
+    uint64_t off_children;
+    uint64_t off_strings;
+    uint64_t strings_size;
+};
+
+struct tidx_entry {
+    uint64_t data_offset;       // где лежат данные файла внутри tar-потока
+    uint64_t size;
+    int64_t mtime;
+    uint32_t mode;              // тип и права, как st_mode
+    uint32_t uid;
+    uint32_t gid;
+    uint32_t name_off;          // полный путь в strings
+    uint32_t name_len;
+    uint32_t base_off;          // начало последнего компонента пути (от name_off)
+    uint32_t parent;
+    uint32_t child_start;       // для каталогов: диапазон в children[]
+    uint32_t child_count;
+    uint32_t link_off;          // цель symlink в strings (или TIDX_NONE)
+};
+
+struct tar_index {
+    void *map;
+    size_t map_size;
+    const struct tidx_header *hdr;
+    const struct tidx_entry *entries;
+    const uint32_t *hash;
+    const uint32_t *children;
+    const char *strings;
+};
+
+/*
+ * Открыть индекс архива: отобразить готовый, если он актуален, иначе
+ * построить (читая src) и сохранить. index_path == NULL — "<archive>.idx",
+ * а если рядом с архивом писать нельзя — файл в $TMPDIR (или /tmp).
+ * *rebuilt (если не NULL) = 1, когда индекс пришлось строить.
+ * Возвращает 0 или -errno.
+ */
+int tar_index_open(const char *archive_path, struct archive_src *src,
+                   const char *index_path, struct tar_index *idx, int *rebuilt);
+
+void tar_index_close(struct tar_index *idx);
+
+/* Поиск по пути ("/a/b" или "a/b"); возвращает номер записи или -1. O(1). */
+long tar_index_lookup(const struct tar_index *idx, const char *path);
+
+static inline const struct tidx_entry *tar_index_entry(const struct tar_index *idx, uint32_t i) {
+    return &idx->entries[i];
+}
+
+static inline const char *tar_index_path(const struct tar_index *idx, const struct tidx_entry *e) {
+    return idx->strings + e->name_off;
+}
+
+static inline const char *tar_index_basename(const struct tar_index *idx, const struct tidx_entry *e) {
+    return idx->strings + e->name_off + e->base_off;
+}
+
+static inline const char *tar_index_link(const struct tar_index *idx, const struct tidx_entry *e) {
+    return e->link_off == TIDX_NONE ? NULL : idx->strings + e->link_off;
+}
+
+/* Заполнить struct stat для записи (read-only: права на запись сняты) */
+void tar_index_stat(const struct tar_index *idx, const struct tidx_entry *e, struct stat *st);
+
+#endif /* TAR_INDEX_H */
@@ -0,0 +1,161 @@
+/*
+ * xform_bench.c - скорость ядер byte_xform (GB/s) против побайтового цикла
+ *
+ * Для каждого преобразования (rot13, upper, xor, произвольная таблица)
+ * и каждого ядра, доступного на этом процессоре:
+ *   1. проверяет, что результат совпадает с naive на случайных данных
+ *      с невыровненным началом и хвостом;
+ *   2. меряет пропускную способность на месте (как в read() FUSE) для
+ *      буферов 4 KiB (страница), 128 KiB (max_read FUSE) и 4 MiB.
+ *
+ * Компиляция: make xform_bench
+ * Использование: ./xform_bench [-t SEC_PER_POINT] [-k KERNEL]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "byte_xform.h"
+
+static const size_t sizes[] = { 4096, 128 * 1024, 4 * 1024 * 1024 };
+#define NSIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void fill_text(uint8_t *buf, size_t n, unsigned seed) {
+    // Похоже на текст: буквы обоих регистров, цифры, пробелы и немного UTF-8
+    static const char alphabet[] =
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 .,\n\xd0\xb0";
+    for (size_t i = 0; i < n; i++)
+        buf[i] = (uint8_t)alphabet[rand_r(&seed) % (sizeof(alphabet) - 1)];
+}
+
+/* Сверка с naive: разные выравнивания, длины и смещения в потоке */
+static int verify(struct byte_xform *x, const struct xform_kernel *k) {
+    enum { N = 4096 + 77 };
+    static uint8_t src[N], ref[N], out[N];
+    fill_text(src, N, 7);
+    for (int i = 0; i < N; i++)
+        src[i] ^= (uint8_t)(i * 37);        // все 256 значений байта
+
+    const struct xform_kernel *saved = x->kernel;
+    for (size_t start = 0; start < 70; start += 13) {
+        for (size_t len = 0; len + start <= N; len += len < 200 ? 1 : 997) {
+            uint64_t off = 12345 + start;
+            xform_select(x, "naive");
+            xform_apply(x, ref, src + start, len, off);
+            x->kernel = k;
+            memcpy(out, src + start, len);
+            xform_apply(x, out, out, len, off);      // на месте
+            if (memcmp(out, ref, len)) {
+                fprintf(stderr, "MISMATCH: kernel %s, start %zu, len %zu\n", k->name, start, len);
+                x->kernel = saved;
+                return -1;
+            }
+        }
+    }
+    x->kernel = saved;
+    return 0;
+}
+
+static double measure(struct byte_xform *x, uint8_t *buf, size_t n, double seconds) {
+    uint64_t bytes = 0, off = 0;
+    double t0 = now_sec(), t;
+    do {
+        for (int rep = 0; rep < 16; rep++) {
+            xform_apply(x, buf, buf, n, off);
+            off += n;
+            bytes += n;
+        }
+        t = now_sec();
+    } while (t - t0 < seconds);
+    return bytes / (t - t0) / 1e9;
+}
+
+static int bench(const char *title, struct byte_xform *x, uint8_t *buf,
+                 double seconds, const char *only) {
+    const struct xform_kernel *list[8];
+    size_t n = xform_kernels(x, list, 8);
+    double base[NSIZES] = {0};
+    int fails = 0;
+
+    printf("\n%s (%s, default kernel: %s)\n", title,
+           x->type == XFORM_RANGES ? "ranges" : x->type == XFORM_LUT ? "lut" : "xor",
+           x->kernel->name);
+    printf("  %-12s %12s %12s %12s %9s\n", "kernel", "4K GB/s", "128K GB/s", "4M GB/s", "vs naive");
+
+    for (size_t i = 0; i < n; i++) {
+        if (only && strcmp(list[i]->name, only) && strcmp(list[i]->name, "naive"))
+            continue;
+        if (verify(x, list[i]) < 0) {
+            fails++;
+            continue;
+        }
+        x->kernel = list[i];
+        double gbps[NSIZES];
+        for (size_t s = 0; s < NSIZES; s++) {
+            gbps[s] = measure(x, buf, sizes[s], seconds);
+            if (i == 0)
+                base[s] = gbps[s];
+        }
+        printf("  %-12s %12.2f %12.2f %12.2f %8.1fx\n", list[i]->name,
+               gbps[0], gbps[1], gbps[2], base[1] > 0 ? gbps[1] / base[1] : 0.0);
+    }
+    return fails;
+}
+
+int main(int argc, char **argv) {
+    double seconds = 0.3;
+    const char *only = NULL;
+    int c;
+    while ((c = getopt(argc, argv, "t:k:h")) != -1) {
+        switch (c) {
+            case 't': seconds = atof(optarg); break;
+            case 'k': only = optarg; break;
+            default:
+                fprintf(stderr, "Usage: %s [-t SEC_PER_POINT] [-k KERNEL]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    uint8_t *buf = aligned_alloc(64, sizes[NSIZES - 1]);
+    if (!buf)
+        return 1;
+    fill_text(buf, sizes[NSIZES - 1], 1);
+
+    struct byte_xform x;
+    int fails = 0;
+
+    xform_init_rot13(&x);
+    fails += bench("rot13", &x, buf, seconds, only);
+    xform_free(&x);
+
+    xform_init_upper(&x);
+    fails += bench("upper", &x, buf, seconds, only);
+    xform_free(&x);
+
+    xform_init_xor(&x, (const uint8_t *)"lab6-secret-key", 15);
+    fails += bench("xor (15-byte key)", &x, buf, seconds, only);
+    xform_free(&x);
+
+    // Перестановка байтов, не сводимая к диапазонам
+    uint8_t lut[256];
+    for (int i = 0; i < 256; i++)
+        lut[i] = (uint8_t)(i * 167 + 13);
+    xform_init_lut(&x, lut);
+    fails += bench("random permutation lut", &x, buf, seconds, only);
+    xform_free(&x);
+
+    free(buf);
+    if (fails)
+        fprintf(stderr, "\n%d kernel(s) failed verification\n", fails);
+    return fails ? 1 : 0;
+}